@@ -285,6 +285,11 @@ class Env(object):
         else:
             self.CFLAGS.append("-Wno-unknown-pragmas")
 
+        # NUMA
+        if Config.USE_NUMA:
+            self.DEFINES.append("-DCAFFE2_USE_NUMA")
+            self.LIBS.append("numa")
+
         # MPI
         self.MPIRUN = Config.MPIRUN
         ret, out = GetSubprocessOutput(
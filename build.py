@@ -71,6 +71,10 @@ class Config(object):
     # of that.
     USE_OPENMP = True
 
+    # Whether to build with NUMA support, which needs libnuma. Even if built,
+    # it is only used when the --caffe2_cpu_numa_enabled flag is set.
+    USE_NUMA = False
+
     # Manually specified defines.
     DEFINES = ["-DNDEBUG"]
 
@@ -0,0 +1,83 @@
+#include "caffe2/core/arena.h"
+
+#include <algorithm>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_int64(
+    caffe2_arena_chunk_bytes,
+    4 << 20,
+    "The default size of the chunks an Arena allocates from.");
+
+namespace caffe2 {
+
+namespace {
+
+thread_local Arena* current_arena = nullptr;
+
+size_t RoundUp(size_t bytes, size_t multiple) {
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+}  // namespace
+
+Arena::Arena(size_t chunk_bytes)
+    : chunk_bytes_(RoundUp(chunk_bytes, gCaffe2Alignment)) {
+  CAFFE_ENFORCE(chunk_bytes_ > 0, "The chunks of an arena cannot be empty.");
+}
+
+Arena::~Arena() {
+  for (void* chunk : chunks_) {
+    CPUContext::Delete(chunk);
+  }
+}
+
+void* Arena::Allocate(size_t nbytes) {
+  nbytes = RoundUp(std::max<size_t>(nbytes, 1), gCaffe2Alignment);
+  std::lock_guard<std::mutex> lock(mutex_);
+  allocated_bytes_ += nbytes;
+  if (nbytes > chunk_bytes_ / 4) {
+    // Large allocations get their own chunk, so that the rest of the current
+    // chunk is not wasted.
+    return AllocateChunk(nbytes);
+  }
+  if (static_cast<size_t>(end_ - next_) < nbytes) {
+    next_ = static_cast<char*>(AllocateChunk(chunk_bytes_));
+    end_ = next_ + chunk_bytes_;
+  }
+  void* data = next_;
+  next_ += nbytes;
+  return data;
+}
+
+void* Arena::AllocateChunk(size_t nbytes) {
+  void* chunk = CPUContext::NewUninitialized(nbytes);
+  chunks_.push_back(chunk);
+  reserved_bytes_ += nbytes;
+  return chunk;
+}
+
+size_t Arena::allocated_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return allocated_bytes_;
+}
+
+size_t Arena::reserved_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reserved_bytes_;
+}
+
+Arena* Arena::Current() {
+  return current_arena;
+}
+
+ArenaScope::ArenaScope(Arena* arena) : previous_(current_arena) {
+  current_arena = arena;
+}
+
+ArenaScope::~ArenaScope() {
+  current_arena = previous_;
+}
+
+}  // namespace caffe2
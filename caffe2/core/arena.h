@@ -0,0 +1,85 @@
+#ifndef CAFFE2_CORE_ARENA_H_
+#define CAFFE2_CORE_ARENA_H_
+
+#include <cstddef>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_int64(caffe2_arena_chunk_bytes);
+
+namespace caffe2 {
+
+class CPUContext;
+
+/**
+ * @brief A bump allocator whose memory is only freed all at once, when the
+ * arena is destroyed.
+ *
+ * The arena carves allocations out of chunks obtained from the CPU allocator.
+ * Allocations larger than a quarter of the chunk size get a chunk of their
+ * own. Allocating is thread safe.
+ *
+ * A Workspace with an arena (see Workspace::EnableArena()) makes the CPU
+ * tensors allocated by its operators use it, which is meant for short-lived
+ * workspaces, such as the one of a single inference request.
+ */
+class Arena {
+ public:
+  explicit Arena(size_t chunk_bytes = FLAGS_caffe2_arena_chunk_bytes);
+  ~Arena();
+
+  // Returns memory aligned to gCaffe2Alignment, whose content is unspecified.
+  void* Allocate(size_t nbytes);
+
+  // The bytes handed out by Allocate(), and the bytes of the chunks.
+  size_t allocated_bytes() const;
+  size_t reserved_bytes() const;
+
+  // The arena that CPU tensors allocate from on the calling thread, if any.
+  static Arena* Current();
+
+ private:
+  void* AllocateChunk(size_t nbytes);
+
+  const size_t chunk_bytes_;
+  mutable std::mutex mutex_;
+  std::vector<void*> chunks_;
+  char* next_ = nullptr;
+  char* end_ = nullptr;
+  size_t allocated_bytes_ = 0;
+  size_t reserved_bytes_ = 0;
+
+  DISABLE_COPY_AND_ASSIGN(Arena);
+};
+
+/**
+ * Makes the CPU tensors allocated on the calling thread use the given arena,
+ * or no arena if it is null, until the scope ends.
+ */
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena* arena);
+  ~ArenaScope();
+
+ private:
+  Arena* previous_;
+  DISABLE_COPY_AND_ASSIGN(ArenaScope);
+};
+
+// The arena that tensors of the given context allocate from on the calling
+// thread. Only CPU tensors use arenas.
+template <class Context>
+inline Arena* CurrentArena() {
+  return nullptr;
+}
+template <>
+inline Arena* CurrentArena<CPUContext>() {
+  return Arena::Current();
+}
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_ARENA_H_
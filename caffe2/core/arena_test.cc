@@ -0,0 +1,73 @@
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/arena.h"
+#include "caffe2/core/tensor.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+size_t Aligned(size_t nbytes) {
+  return (nbytes + gCaffe2Alignment - 1) / gCaffe2Alignment * gCaffe2Alignment;
+}
+
+}  // namespace
+
+TEST(ArenaTest, Allocate) {
+  Arena arena(1024);
+  char* first = static_cast<char*>(arena.Allocate(1));
+  char* second = static_cast<char*>(arena.Allocate(100));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % gCaffe2Alignment, 0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % gCaffe2Alignment, 0);
+  EXPECT_EQ(second, first + gCaffe2Alignment);
+  EXPECT_EQ(arena.reserved_bytes(), 1024);
+
+  // Large allocations get their own chunk and leave the current one alone.
+  char* large = static_cast<char*>(arena.Allocate(4096));
+  large[4095] = 1;
+  EXPECT_EQ(arena.reserved_bytes(), 1024 + 4096);
+  char* third = static_cast<char*>(arena.Allocate(1));
+  EXPECT_EQ(third, second + Aligned(100));
+}
+
+TEST(ArenaTest, AllocateFromThreads) {
+  Arena arena(1024);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&arena, i]() {
+      for (int j = 0; j < 100; ++j) {
+        memset(arena.Allocate(100), i, 100);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(arena.allocated_bytes(), 400 * Aligned(100));
+}
+
+TEST(ArenaTest, TensorsUseTheScopedArena) {
+  Arena arena;
+  TensorCPU outside(vector<int>{10});
+  TensorCPU inside(vector<int>{10});
+  {
+    ArenaScope scope(&arena);
+    EXPECT_EQ(Arena::Current(), &arena);
+    inside.mutable_data<float>();
+    inside.mutable_data<std::string>()[9] = "arena";
+    {
+      ArenaScope no_arena(nullptr);
+      outside.mutable_data<float>();
+    }
+    EXPECT_EQ(Arena::Current(), &arena);
+  }
+  EXPECT_EQ(Arena::Current(), nullptr);
+  EXPECT_EQ(
+      arena.allocated_bytes(),
+      Aligned(10 * sizeof(float)) + Aligned(10 * sizeof(std::string)));
+  EXPECT_EQ(inside.data<std::string>()[9], "arena");
+}
+
+}  // namespace caffe2
@@ -175,12 +175,18 @@ class Blob {
   }
 
   /**
-   * Deserializes from a string containing either BlobProto or TensorProto. If
-   * the deserialization fails, the content in the blob should no longer be
-   * trusted.
+   * Deserializes from a string containing either BlobProto or TensorProto, or
+   * a tensor chunk in the raw format. If the deserialization fails, the content
+   * in the blob should no longer be trusted.
    */
   bool Deserialize(const string& content);
   bool Deserialize(const BlobProto& proto);
+  /**
+   * Deserializes a tensor chunk in the raw format of
+   * TensorSerializer::SerializeRaw(), given its header as parsed by
+   * ParseRawTensorHeader() and its data.
+   */
+  bool DeserializeRaw(const BlobProto& header, const char* data, size_t nbytes);
 
  private:
   /**
@@ -1,14 +1,22 @@
 #include "caffe2/core/blob_serialization.h"
 
+#include <cstring>
 #include <sstream>
 #include <mutex>
 
 #include "caffe2/core/blob.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
 
 CAFFE2_DEFINE_int(
     caffe2_tensor_chunk_size,
     1000000,
     "Chunk size to split tensor data into");
+CAFFE2_DEFINE_int(
+    caffe2_serialization_num_workers,
+    8,
+    "The number of threads that serialize and deserialize tensor chunks in "
+    "the Save and Load operators.");
 
 namespace caffe2 {
 namespace {
@@ -69,6 +77,101 @@ std::string tensorDeviceTypeName(const DeviceType& d) {
 };
 }
 
+WorkerPool* SerializationWorkerPool() {
+  // Intentionally leaked, like the pool of ScheduleIOTask(), so that its
+  // threads are not joined during static destruction.
+  static WorkerPool* pool =
+      new WorkerPool(FLAGS_caffe2_serialization_num_workers);
+  return pool;
+}
+
+bool IsRawTensor(const string& value) {
+  return value.size() >= sizeof(kRawTensorMagic) &&
+      memcmp(value.data(), kRawTensorMagic, sizeof(kRawTensorMagic)) == 0;
+}
+
+size_t ParseRawTensorHeader(const string& value, BlobProto* header) {
+  CAFFE_ENFORCE(IsRawTensor(value), "Not a raw tensor.");
+  uint64_t header_size = 0;
+  CAFFE_ENFORCE(
+      value.size() >= sizeof(kRawTensorMagic) + sizeof(header_size),
+      "Truncated raw tensor header.");
+  memcpy(
+      &header_size,
+      value.data() + sizeof(kRawTensorMagic),
+      sizeof(header_size));
+  const size_t offset = detail::RawTensorDataOffset(header_size);
+  CAFFE_ENFORCE(offset <= value.size(), "Truncated raw tensor header.");
+  TensorProto* tensor = header->mutable_tensor();
+  CAFFE_ENFORCE(
+      tensor->ParseFromArray(
+          value.data() + sizeof(kRawTensorMagic) + sizeof(header_size),
+          header_size),
+      "Corrupted raw tensor header.");
+  header->set_name(tensor->name());
+  header->set_type(kTensorBlobType);
+  return offset;
+}
+
+bool PeekTensorChunk(const string& value, TensorProto* header) {
+  using ::google::protobuf::internal::WireFormatLite;
+  header->Clear();
+  if (IsRawTensor(value)) {
+    BlobProto blob_header;
+    ParseRawTensorHeader(value, &blob_header);
+    header->Swap(blob_header.mutable_tensor());
+    return true;
+  }
+  ::google::protobuf::io::CodedInputStream input(
+      reinterpret_cast<const uint8_t*>(value.data()), value.size());
+  // The field numbers of BlobProto.tensor, and of TensorProto.dims and
+  // TensorProto.segment. The other fields are skipped, the data of the tensor
+  // among them.
+  const int kTensor = 3;
+  const int kDims = 1;
+  const int kSegment = 11;
+  bool in_tensor = false;
+  while (uint32_t tag = input.ReadTag()) {
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    const auto wire_type = WireFormatLite::GetTagWireType(tag);
+    if (!in_tensor && field == kTensor &&
+        wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t length;
+      if (!input.ReadVarint32(&length)) {
+        return false;
+      }
+      input.PushLimit(length);
+      in_tensor = true;
+    } else if (in_tensor && field == kDims) {
+      if (wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+        if (!WireFormatLite::ReadPackedPrimitive<
+                int64_t,
+                WireFormatLite::TYPE_INT64>(&input, header->mutable_dims())) {
+          return false;
+        }
+      } else {
+        int64_t dim;
+        if (!WireFormatLite::ReadPrimitive<
+                int64_t,
+                WireFormatLite::TYPE_INT64>(&input, &dim)) {
+          return false;
+        }
+        header->add_dims(dim);
+      }
+    } else if (
+        in_tensor && field == kSegment &&
+        wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!WireFormatLite::ReadMessageNoVirtual(
+              &input, header->mutable_segment())) {
+        return false;
+      }
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // The blob serialization member function implementation.
 void Blob::Serialize(
     const string& name,
@@ -106,6 +209,11 @@ CAFFE_DEFINE_REGISTRY(BlobDeserializerRegistry, BlobDeserializerBase);
 
 bool Blob::Deserialize(const string& content) {
   BlobProto blob_proto;
+  if (IsRawTensor(content)) {
+    const size_t offset = ParseRawTensorHeader(content, &blob_proto);
+    return DeserializeRaw(
+        blob_proto, content.data() + offset, content.size() - offset);
+  }
   if (!blob_proto.ParseFromString(content)) {
     LOG(ERROR) << "Cannot parse content into a BlobProto.";
     return false;
@@ -132,6 +240,16 @@ bool Blob::Deserialize(const BlobProto& blob_proto) {
   }
 }
 
+bool Blob::DeserializeRaw(
+    const BlobProto& header,
+    const char* data,
+    size_t nbytes) {
+  auto deserializer = CreateDeserializer(
+      tensorDeviceTypeName(header.tensor().device_detail().device_type()));
+  return CHECK_NOTNULL(deserializer.get())
+      ->DeserializeRaw(header, data, nbytes, this);
+}
+
 namespace {
 // Serialize TensorCPU.
 REGISTER_BLOB_SERIALIZER(
@@ -1,6 +1,7 @@
 #ifndef CAFFE2_CORE_BLOB_SERIALIZATION_H_
 #define CAFFE2_CORE_BLOB_SERIALIZATION_H_
 
+#include <cstring>
 #include <limits>
 #include <future>
 
@@ -8,16 +9,38 @@
 
 #include "caffe2/core/blob.h"
 #include "caffe2/core/blob_serializer_base.h"
+#include "caffe2/core/chunk_codec.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/typeid.h"
 #include "caffe2/core/types.h"
+#include "caffe2/core/worker_pool.h"
 
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
+CAFFE2_DECLARE_int(caffe2_serialization_num_workers);
 
 namespace caffe2 {
 
 constexpr auto kTensorBlobType = "Tensor";
 
+// The values written by TensorSerializer::SerializeRaw() start with this magic,
+// which no serialized BlobProto starts with.
+constexpr char kRawTensorMagic[8] = {'C', '2', 'R', 'A', 'W', 'T', '0', '1'};
+
+// Returns a process-wide pool of --caffe2_serialization_num_workers threads
+// that serializes and deserializes the chunks of the Save and Load operators,
+// created on first use.
+WorkerPool* SerializationWorkerPool();
+
+// Returns whether a serialized value is a tensor chunk in the raw format.
+bool IsRawTensor(const string& value);
+// Parses the header of a raw tensor chunk into a BlobProto holding a tensor
+// without data, and returns the offset of the data in the value.
+size_t ParseRawTensorHeader(const string& value, BlobProto* header);
+// Reads the dims and the segment of a serialized tensor chunk into header,
+// without parsing the data of the tensor. The header is left empty if the
+// value is not a tensor. Returns false if the value cannot be parsed.
+bool PeekTensorChunk(const string& value, TensorProto* header);
+
 // The Blob serialization registry and serializer creator functions.
 CAFFE_DECLARE_TYPED_REGISTRY(
     BlobSerializerRegistry,
@@ -51,8 +74,43 @@ class TensorSerializer : public BlobSerializerBase {
       SerializationAcceptor acceptor) override;
   void Serialize(const Tensor<Context>& tensor, const string& name,
                  TensorProto* proto, size_t chunkBegin, int32_t chunkSize);
+  /**
+   * Serializes a Blob like Serialize() does, but in the raw format for tensors
+   * of fundamental types: each chunk is a small header followed by the bytes
+   * of its data, aligned to 64 bytes from the start of the value, which are
+   * copied once from the tensor. Other tensors are serialized as TensorProtos.
+   */
+  void SerializeRaw(
+      const Blob& blob,
+      const string& name,
+      SerializationAcceptor acceptor);
+  string SerializeRaw(const Tensor<Context>& tensor, const string& name,
+                      size_t chunkBegin, int32_t chunkSize,
+                      const string& compression = "");
+  /**
+   * Serializes a chunk of a tensor into a BlobProto, or in the raw format if
+   * raw is set and the type of the tensor has a raw representation. If a
+   * compression codec is given, the data of tensors of fundamental types is
+   * compressed with it.
+   */
+  string SerializeChunk(const Tensor<Context>& tensor, const string& name,
+                        size_t chunkBegin, int32_t chunkSize, bool raw,
+                        const string& compression = "");
 
  private:
+  // Fills in all of the TensorProto of a chunk of a tensor of a fundamental
+  // type but its data, and clips the chunk to the tensor.
+  void SerializeHeader(const Tensor<Context>& input, const string& name,
+                       size_t chunkBegin, int32_t* chunkSize,
+                       TensorProto* header);
+  // Compresses the data of a chunk with the given codec.
+  string Compress(const Tensor<Context>& input, size_t chunkBegin,
+                  int32_t chunkSize, const string& compression);
+  void SerializeChunks(
+      const Tensor<Context>& tensor,
+      const string& name,
+      SerializationAcceptor acceptor,
+      bool raw);
   // A utility function to store the device context detauls.
   void StoreDeviceDetail(const Tensor<Context>& input, TensorProto* proto);
   Context context_;
@@ -68,6 +126,16 @@ class BlobDeserializerBase {
 
   // Deserializes from a BlobProto object.
   virtual bool Deserialize(const BlobProto& proto, Blob* blob) = 0;
+  // Deserializes a chunk in the raw format of TensorSerializer::SerializeRaw(),
+  // which only tensors support.
+  virtual bool DeserializeRaw(
+      const BlobProto& header,
+      const char* data,
+      size_t nbytes,
+      Blob* blob) {
+    LOG(ERROR) << "The raw format is only supported for tensors.";
+    return false;
+  }
 };
 
 CAFFE_DECLARE_REGISTRY(BlobDeserializerRegistry, BlobDeserializerBase);
@@ -91,6 +159,23 @@ class TensorDeserializer : public BlobDeserializerBase {
  public:
   bool Deserialize(const BlobProto& proto, Blob* blob) override;
   bool Deserialize(const TensorProto& proto, Tensor<Context>* tensor);
+  bool DeserializeRaw(
+      const BlobProto& header,
+      const char* data,
+      size_t nbytes,
+      Blob* blob) override;
+  bool DeserializeRaw(
+      const TensorProto& header,
+      const char* data,
+      size_t nbytes,
+      Tensor<Context>* tensor);
+
+ private:
+  // Resizes the tensor to the dimensions of the proto, and returns the range of
+  // items of the chunk it holds, which is empty if the tensor is empty.
+  std::pair<TIndex, TIndex> ChunkRange(
+      const TensorProto& proto,
+      Tensor<Context>* tensor);
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -168,6 +253,17 @@ inline void CopyFromProtoWithCast(
   context->template Copy<DstType, CPUContext, Context>(size, buffer.get(), dst);
 }
 
+// A raw tensor chunk is the magic, the size of the header as a uint64, the
+// header, a serialized TensorProto without data, and the data, which starts at
+// the first multiple of kRawTensorAlignment after the header.
+constexpr size_t kRawTensorAlignment = 64;
+
+inline size_t RawTensorDataOffset(size_t header_size) {
+  const size_t end = sizeof(kRawTensorMagic) + sizeof(uint64_t) + header_size;
+  return (end + kRawTensorAlignment - 1) / kRawTensorAlignment *
+      kRawTensorAlignment;
+}
+
 }  // namespace detail
 
 template <class Context>
@@ -176,8 +272,57 @@ void TensorSerializer<Context>::Serialize(
     const string& name,
     BlobSerializerBase::SerializationAcceptor acceptor) {
   CHECK(blob.IsType<Tensor<Context>>());
+  SerializeChunks(blob.template Get<Tensor<Context>>(), name, acceptor, false);
+}
+
+template <class Context>
+void TensorSerializer<Context>::SerializeRaw(
+    const Blob& blob,
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor) {
+  CHECK(blob.IsType<Tensor<Context>>());
   const auto& tensor = blob.template Get<Tensor<Context>>();
+  SerializeChunks(tensor, name, acceptor, true);
+}
 
+template <class Context>
+string TensorSerializer<Context>::SerializeChunk(
+    const Tensor<Context>& tensor,
+    const string& name,
+    size_t chunkBegin,
+    int32_t chunkSize,
+    bool raw,
+    const string& compression) {
+  // Strings and the like have no raw representation.
+  if (raw && !tensor.meta().ctor()) {
+    return SerializeRaw(tensor, name, chunkBegin, chunkSize, compression);
+  }
+  BlobProto blob_proto;
+  blob_proto.set_name(name);
+  blob_proto.set_type(kTensorBlobType);
+  TensorProto& proto = *blob_proto.mutable_tensor();
+  if (!compression.empty() && !tensor.meta().ctor()) {
+    SerializeHeader(tensor, name, chunkBegin, &chunkSize, &proto);
+    proto.set_compression(compression);
+    proto.set_byte_data(Compress(tensor, chunkBegin, chunkSize, compression));
+    return blob_proto.SerializeAsString();
+  }
+  proto.set_name(name);
+  Serialize(
+      tensor,
+      name,
+      blob_proto.mutable_tensor(),
+      chunkBegin,
+      chunkSize);
+  return blob_proto.SerializeAsString();
+}
+
+template <class Context>
+void TensorSerializer<Context>::SerializeChunks(
+    const Tensor<Context>& tensor,
+    const string& name,
+    BlobSerializerBase::SerializationAcceptor acceptor,
+    bool raw) {
 #ifndef __ANDROID__
   std::vector<std::future<void>> futures;
 #endif
@@ -185,18 +330,10 @@ void TensorSerializer<Context>::Serialize(
   for (size_t chunkBegin = 0; chunkBegin < tensor.size();
        chunkBegin += FLAGS_caffe2_tensor_chunk_size) {
     auto task = [&](size_t chunkBegin) {
-      BlobProto blob_proto;
-      blob_proto.set_name(name);
-      blob_proto.set_type(kTensorBlobType);
-      TensorProto& proto = *blob_proto.mutable_tensor();
-      proto.set_name(name);
-      this->Serialize(
-          tensor,
+      acceptor(
           name,
-          blob_proto.mutable_tensor(),
-          chunkBegin,
-          FLAGS_caffe2_tensor_chunk_size);
-      acceptor(name, blob_proto.SerializeAsString());
+          this->SerializeChunk(
+              tensor, name, chunkBegin, FLAGS_caffe2_tensor_chunk_size, raw));
     };
 #ifndef __ANDROID__
     if (tensor.size() > FLAGS_caffe2_tensor_chunk_size) {
@@ -338,6 +475,101 @@ void TensorSerializer<Context>::Serialize(
   StoreDeviceDetail(input, &proto);
 }
 
+template <class Context>
+void TensorSerializer<Context>::SerializeHeader(
+    const Tensor<Context>& input, const string& name,
+    size_t chunkBegin, int32_t* chunkSize, TensorProto* header) {
+  CAFFE_ENFORCE(
+    chunkBegin < input.size(),
+    "Chunk begin is out of tensor: ",
+    chunkBegin,
+    ' ',
+    input.size());
+  CAFFE_ENFORCE(
+      !input.meta().ctor(),
+      "Tensor ",
+      name,
+      " of type ",
+      input.meta().name(),
+      " cannot be serialized raw.");
+  if (chunkBegin + *chunkSize > input.size()) {
+    *chunkSize = input.size() - chunkBegin;
+  }
+
+  header->set_name(name);
+  header->mutable_segment()->set_begin(chunkBegin);
+  header->mutable_segment()->set_end(chunkBegin + *chunkSize);
+  for (int i = 0; i < input.ndim(); ++i) {
+    header->add_dims(input.dim(i));
+  }
+  header->set_data_type(TypeMetaToDataType(input.meta()));
+  CAFFE_ENFORCE(
+      header->data_type() != TensorProto_DataType_UNDEFINED,
+      "TensorSerializer does not have a serialization implementation for ",
+      input.meta().name());
+  StoreDeviceDetail(input, header);
+}
+
+template <class Context>
+string TensorSerializer<Context>::Compress(
+    const Tensor<Context>& input, size_t chunkBegin, int32_t chunkSize,
+    const string& compression) {
+  const size_t itemsize = input.meta().itemsize();
+  const size_t nbytes = chunkSize * itemsize;
+  const char* data =
+      static_cast<const char*>(input.raw_data()) + chunkBegin * itemsize;
+  // The codecs compress from host memory.
+  string buffer;
+  if (!std::is_same<Context, CPUContext>::value) {
+    buffer.resize(nbytes);
+    context_.template CopyBytes<Context, CPUContext>(nbytes, data, &buffer[0]);
+    context_.FinishDeviceComputation();
+    data = buffer.data();
+  }
+  string compressed;
+  GetChunkCodec(compression).Compress(data, nbytes, itemsize, &compressed);
+  return compressed;
+}
+
+template <class Context>
+string TensorSerializer<Context>::SerializeRaw(
+    const Tensor<Context>& input, const string& name,
+    size_t chunkBegin, int32_t chunkSize, const string& compression) {
+  TensorProto header;
+  SerializeHeader(input, name, chunkBegin, &chunkSize, &header);
+  string compressed;
+  if (!compression.empty()) {
+    header.set_compression(compression);
+    compressed = Compress(input, chunkBegin, chunkSize, compression);
+  }
+  string serialized_header;
+  CAFFE_ENFORCE(header.SerializeToString(&serialized_header));
+
+  const size_t itemsize = input.meta().itemsize();
+  const size_t offset = detail::RawTensorDataOffset(serialized_header.size());
+  const uint64_t header_size = serialized_header.size();
+  const size_t nbytes =
+      compression.empty() ? chunkSize * itemsize : compressed.size();
+  string value(offset + nbytes, '\0');
+  char* dst = &value[0];
+  memcpy(dst, kRawTensorMagic, sizeof(kRawTensorMagic));
+  memcpy(dst + sizeof(kRawTensorMagic), &header_size, sizeof(header_size));
+  memcpy(
+      dst + sizeof(kRawTensorMagic) + sizeof(header_size),
+      serialized_header.data(),
+      serialized_header.size());
+  if (!compression.empty()) {
+    memcpy(dst + offset, compressed.data(), nbytes);
+  } else {
+    context_.template CopyBytes<Context, CPUContext>(
+        nbytes,
+        static_cast<const char*>(input.raw_data()) + chunkBegin * itemsize,
+        dst + offset);
+    context_.FinishDeviceComputation();
+  }
+  return value;
+}
+
 template <class Context>
 bool TensorDeserializer<Context>::Deserialize(
     const BlobProto& blob_proto, Blob* blob) {
@@ -349,36 +581,22 @@ bool TensorDeserializer<Context>::Deserialize(
 template <class Context>
 bool TensorDeserializer<Context>::Deserialize(
     const TensorProto& proto, Tensor<Context>* tensor) {
+  // Compressed data is held as the data of a raw chunk would be.
+  if (proto.has_compression()) {
+    return DeserializeRaw(
+        proto, proto.byte_data().data(), proto.byte_data().size(), tensor);
+  }
   // We create a local context for deserializing. Since Caffe2 contexts are
   // usually lightweighted, this should not involve too much overhead.
   Context context(proto.device_detail());
   context.SwitchToDevice();
-  vector<TIndex> dims;
-  for (const TIndex d : proto.dims()) {
-    dims.push_back(d);
-  }
-  tensor->Resize(dims);
-
+  const auto chunk = ChunkRange(proto, tensor);
   // Safety check for zero-sized tensors: no copy needed.
-  if (tensor->size() == 0) {
+  if (chunk.first == chunk.second) {
     return true;
   }
-
-  int64_t chunkBegin = 0;
-  auto chunkEnd = tensor->size();
-  if (proto.has_segment()) {
-    chunkBegin = proto.segment().begin();
-    chunkEnd = proto.segment().end();
-  }
-  CAFFE_ENFORCE(
-      0 <= chunkBegin && chunkBegin < chunkEnd && chunkEnd <= tensor->size(),
-      "Invalid chunk ",
-      chunkBegin,
-      ' ',
-      chunkEnd,
-      " with total tensor size ",
-      tensor->size());
-  auto chunkSize = chunkEnd - chunkBegin;
+  const auto chunkBegin = chunk.first;
+  const auto chunkSize = chunk.second - chunk.first;
 
   switch (proto.data_type()) {
     case TensorProto_DataType_FLOAT:
@@ -483,6 +701,98 @@ bool TensorDeserializer<Context>::Deserialize(
   return true;
 }
 
+template <class Context>
+bool TensorDeserializer<Context>::DeserializeRaw(
+    const BlobProto& header,
+    const char* data,
+    size_t nbytes,
+    Blob* blob) {
+  return DeserializeRaw(
+      header.tensor(), data, nbytes, blob->GetMutable<Tensor<Context>>());
+}
+
+template <class Context>
+bool TensorDeserializer<Context>::DeserializeRaw(
+    const TensorProto& header,
+    const char* data,
+    size_t nbytes,
+    Tensor<Context>* tensor) {
+  const TypeMeta meta = DataTypeToTypeMeta(header.data_type());
+  if (meta.ctor()) {
+    LOG(ERROR) << "Cannot deserialize raw data of type " << meta.name();
+    return false;
+  }
+  Context context(header.device_detail());
+  context.SwitchToDevice();
+  const auto chunk = ChunkRange(header, tensor);
+  // The type is set even if there is nothing to copy.
+  char* dst = static_cast<char*>(tensor->raw_mutable_data(meta));
+  const size_t chunkBytes = (chunk.second - chunk.first) * meta.itemsize();
+  if (header.has_compression()) {
+    // Decompresses straight into the tensor if it is in host memory.
+    string buffer;
+    char* decompressed = dst + chunk.first * meta.itemsize();
+    if (!std::is_same<Context, CPUContext>::value) {
+      buffer.resize(chunkBytes);
+      decompressed = &buffer[0];
+    }
+    if (!GetChunkCodec(header.compression())
+             .Decompress(
+                 data, nbytes, meta.itemsize(), decompressed, chunkBytes)) {
+      LOG(ERROR) << "Corrupted chunk compressed with "
+                 << header.compression();
+      return false;
+    }
+    if (!buffer.empty()) {
+      context.template CopyBytes<CPUContext, Context>(
+          chunkBytes, decompressed, dst + chunk.first * meta.itemsize());
+    }
+  } else if (nbytes != chunkBytes) {
+    LOG(ERROR) << "Incorrect raw data size " << nbytes << ", expected "
+               << chunkBytes;
+    return false;
+  } else if (chunkBytes > 0) {
+    context.template CopyBytes<CPUContext, Context>(
+        chunkBytes, data, dst + chunk.first * meta.itemsize());
+  }
+  context.FinishDeviceComputation();
+  return true;
+}
+
+template <class Context>
+std::pair<TIndex, TIndex> TensorDeserializer<Context>::ChunkRange(
+    const TensorProto& proto,
+    Tensor<Context>* tensor) {
+  vector<TIndex> dims;
+  for (const TIndex d : proto.dims()) {
+    dims.push_back(d);
+  }
+  // The other chunks of a tensor may be deserialized into it concurrently, see
+  // LoadOp, so a tensor that already has the dimensions is left untouched.
+  if (tensor->dims() != dims) {
+    tensor->Resize(dims);
+  }
+  if (tensor->size() == 0) {
+    return std::make_pair(0, 0);
+  }
+
+  int64_t chunkBegin = 0;
+  auto chunkEnd = tensor->size();
+  if (proto.has_segment()) {
+    chunkBegin = proto.segment().begin();
+    chunkEnd = proto.segment().end();
+  }
+  CAFFE_ENFORCE(
+      0 <= chunkBegin && chunkBegin < chunkEnd && chunkEnd <= tensor->size(),
+      "Invalid chunk ",
+      chunkBegin,
+      ' ',
+      chunkEnd,
+      " with total tensor size ",
+      tensor->size());
+  return std::make_pair(chunkBegin, chunkEnd);
+}
+
 }  // namespace caffe2
 
 #endif  // CAFFE2_CORE_BLOB_SERIALIZATION_H_
@@ -1,14 +1,22 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>  // NOLINT
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <thread>  // NOLINT
 
 #include "caffe2/core/blob.h"
+#include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/common.h"
 #include "caffe2/core/context.h"
 #include "caffe2/core/db.h"
+#include "caffe2/core/dirty_rows.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/types.h"
+#include "caffe2/core/worker_pool.h"
 #include "caffe2/core/workspace.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
@@ -16,6 +24,7 @@
 
 CAFFE2_DEFINE_int64(caffe2_test_big_tensor_size, 100000000, "");
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
+CAFFE2_DECLARE_int(caffe2_io_worker_pool_num_workers);
 
 namespace caffe2 {
 
@@ -308,12 +317,302 @@ TYPED_TEST(TensorCPUTest, NoLongerSharesAfterResize) {
   EXPECT_NE(old_pointer, tensor.mutable_data<TypeParam>());
 }
 
+TYPED_TEST(TensorCPUTest, TensorShareDataCopyOnWrite) {
+  TensorCPU tensor(vector<int>{2, 3, 5});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  TensorCPU other_tensor;
+  other_tensor.ShareDataCopyOnWrite(tensor);
+  EXPECT_EQ(other_tensor.dims(), tensor.dims());
+  EXPECT_EQ(other_tensor.data<TypeParam>(), ptr);
+  // Writing the copy materializes it, and leaves the source alone.
+  TypeParam* other_ptr = other_tensor.mutable_data<TypeParam>();
+  EXPECT_NE(other_ptr, ptr);
+  for (int i = 0; i < tensor.size(); ++i) {
+    EXPECT_EQ(other_ptr[i], i);
+    other_ptr[i] = 0;
+    EXPECT_EQ(tensor.data<TypeParam>()[i], i);
+  }
+  // The source is the only owner of its storage again, and writes in place.
+  EXPECT_EQ(tensor.mutable_data<TypeParam>(), ptr);
+}
+
+TYPED_TEST(TensorCPUTest, TensorShareDataCopyOnWriteFromSource) {
+  TensorCPU tensor(vector<int>{2, 3, 5});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  ptr[0] = 1;
+  TensorCPU other_tensor;
+  other_tensor.ShareDataCopyOnWrite(tensor);
+  other_tensor.Reshape(vector<TIndex>{30});
+  // Writing the source also leaves the copy alone.
+  EXPECT_NE(tensor.mutable_data<TypeParam>(), ptr);
+  tensor.mutable_data<TypeParam>()[0] = 2;
+  EXPECT_EQ(other_tensor.data<TypeParam>(), ptr);
+  EXPECT_EQ(other_tensor.data<TypeParam>()[0], 1);
+  // Uninitialized writes still copy the shared content, since in-place
+  // operators read it.
+  TensorCPU third_tensor;
+  third_tensor.ShareDataCopyOnWrite(other_tensor);
+  EXPECT_NE(third_tensor.mutable_data_uninitialized<TypeParam>(), ptr);
+  EXPECT_EQ(third_tensor.data<TypeParam>()[0], 1);
+  EXPECT_EQ(other_tensor.data<TypeParam>()[0], 1);
+  // Storage that is overwritten anyway is not copied.
+  third_tensor.ShareDataCopyOnWrite(other_tensor);
+  EXPECT_NE(third_tensor.mutable_data_overwrite<TypeParam>(), ptr);
+  EXPECT_EQ(other_tensor.data<TypeParam>()[0], 1);
+}
+
+TYPED_TEST(TensorCPUTest, TensorShareDataCopyOnWriteThroughAlias) {
+  TensorCPU tensor(vector<int>{2, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  ptr[0] = 1;
+  // An alias that shared the storage before the copy was taken.
+  TensorCPU alias(vector<int>{2, 3});
+  alias.ShareData(tensor);
+  TensorCPU other_tensor;
+  other_tensor.ShareDataCopyOnWrite(tensor);
+  // Writing through the alias writes the aliased tensor, not the copy.
+  alias.mutable_data<TypeParam>()[0] = 2;
+  EXPECT_EQ(alias.data<TypeParam>(), ptr);
+  EXPECT_EQ(tensor.data<TypeParam>()[0], 2);
+  EXPECT_EQ(other_tensor.data<TypeParam>()[0], 1);
+  // So do views.
+  TensorCPU view;
+  view.ShareDataStrided(tensor, vector<TIndex>{3}, vector<TIndex>{1}, 0);
+  tensor.mutable_data<TypeParam>()[0] = 3;
+  EXPECT_EQ(alias.data<TypeParam>()[0], 3);
+  EXPECT_EQ(view.data<TypeParam>()[0], 2);
+}
+
+TYPED_TEST(TensorCPUTest, TensorShareDataAfterCopyOnWrite) {
+  TensorCPU tensor(vector<int>{2, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  ptr[0] = 1;
+  TensorCPU other_tensor;
+  other_tensor.ShareDataCopyOnWrite(tensor);
+  TensorCPU unread_tensor;
+  unread_tensor.ShareDataCopyOnWrite(tensor);
+  // Aliasing a tensor that shares its storage copy-on-write still aliases
+  // it. The other tensors copy it when they write it first.
+  TensorCPU alias(vector<int>{2, 3});
+  alias.ShareData(tensor);
+  EXPECT_EQ(alias.data<TypeParam>(), ptr);
+  other_tensor.mutable_data<TypeParam>()[1] = 3;
+  EXPECT_NE(other_tensor.data<TypeParam>(), ptr);
+  alias.mutable_data<TypeParam>()[0] = 2;
+  EXPECT_EQ(alias.data<TypeParam>(), ptr);
+  EXPECT_EQ(tensor.data<TypeParam>(), ptr);
+  EXPECT_EQ(tensor.data<TypeParam>()[0], 2);
+  EXPECT_EQ(other_tensor.data<TypeParam>()[0], 1);
+  // Once the aliases wrote it, the others can no longer be read or aliased.
+  EXPECT_THROW(unread_tensor.data<TypeParam>(), EnforceNotMet);
+  TensorCPU other_alias(vector<int>{2, 3});
+  EXPECT_THROW(other_alias.ShareData(unread_tensor), EnforceNotMet);
+  // Overwriting them still works.
+  unread_tensor.mutable_data_overwrite<TypeParam>()[0] = 4;
+  EXPECT_NE(unread_tensor.data<TypeParam>(), ptr);
+  EXPECT_EQ(tensor.data<TypeParam>()[0], 2);
+}
+
+TYPED_TEST(TensorCPUTest, TensorContiguousView) {
+  TensorCPU tensor(vector<int>{4, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  // Rows 1 and 2 are contiguous, so the view shares the storage.
+  TensorCPU view;
+  view.ShareDataStrided(tensor, vector<TIndex>{2, 3}, vector<TIndex>{3, 1}, 3);
+  EXPECT_TRUE(view.IsContiguous());
+  EXPECT_EQ(view.size(), 6);
+  EXPECT_EQ(view.data<TypeParam>(), ptr + 3);
+  // Writing the view copies it.
+  view.mutable_data<TypeParam>()[0] = 0;
+  EXPECT_NE(view.data<TypeParam>(), ptr + 3);
+  EXPECT_EQ(view.data<TypeParam>()[1], 4);
+  EXPECT_EQ(tensor.data<TypeParam>()[3], 3);
+}
+
+TYPED_TEST(TensorCPUTest, TensorStridedView) {
+  TensorCPU tensor(vector<int>{2, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  // The transpose of the tensor.
+  TensorCPU view;
+  view.ShareDataStrided(tensor, vector<TIndex>{3, 2}, vector<TIndex>{1, 3}, 0);
+  EXPECT_FALSE(view.IsContiguous());
+  EXPECT_EQ(view.dims(), (vector<TIndex>{3, 2}));
+  // Writing the source does not change the view.
+  tensor.mutable_data<TypeParam>()[1] = 0;
+  // Reading the view makes it contiguous.
+  const TypeParam* data = view.data<TypeParam>();
+  EXPECT_TRUE(view.IsContiguous());
+  const vector<TypeParam> expected{0, 3, 1, 4, 2, 5};
+  for (int i = 0; i < view.size(); ++i) {
+    EXPECT_EQ(data[i], expected[i]);
+  }
+  // Views of a single column are strided too.
+  view.ShareDataStrided(tensor, vector<TIndex>{2}, vector<TIndex>{3}, 2);
+  EXPECT_FALSE(view.IsContiguous());
+  view.Reshape(vector<TIndex>{1, 2});
+  EXPECT_TRUE(view.IsContiguous());
+  EXPECT_EQ(view.data<TypeParam>()[1], 5);
+  // Overwriting a view does not copy it.
+  view.ShareDataStrided(tensor, vector<TIndex>{2}, vector<TIndex>{3}, 2);
+  view.mutable_data_overwrite<TypeParam>()[0] = 1;
+  EXPECT_TRUE(view.IsContiguous());
+  EXPECT_EQ(tensor.data<TypeParam>()[2], 2);
+}
+
+TYPED_TEST(TensorCPUTest, TensorStridedViewReusesStorage) {
+  TensorCPU tensor(vector<int>{2, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  TensorCPU view;
+  view.ShareDataStrided(tensor, vector<TIndex>{3, 2}, vector<TIndex>{1, 3}, 0);
+  const TypeParam* data = view.data<TypeParam>();
+  // Taking the view again, as an operator does on every run, makes the next
+  // copy in the storage of the previous one.
+  ptr[1] = 6;
+  view.ShareDataStrided(tensor, vector<TIndex>{3, 2}, vector<TIndex>{1, 3}, 0);
+  EXPECT_EQ(view.data<TypeParam>(), data);
+  const vector<TypeParam> expected{0, 3, 6, 4, 2, 5};
+  for (int i = 0; i < view.size(); ++i) {
+    EXPECT_EQ(view.data<TypeParam>()[i], expected[i]);
+  }
+  // Unless another tensor shares it.
+  TensorCPU copy;
+  copy.ShareDataCopyOnWrite(view);
+  ptr[1] = 1;
+  view.ShareDataStrided(tensor, vector<TIndex>{3, 2}, vector<TIndex>{1, 3}, 0);
+  EXPECT_NE(view.data<TypeParam>(), data);
+  EXPECT_EQ(view.data<TypeParam>()[2], 1);
+  EXPECT_EQ(copy.data<TypeParam>(), data);
+  EXPECT_EQ(copy.data<TypeParam>()[2], 6);
+}
+
+TYPED_TEST(TensorCPUTest, TensorAppend) {
+  TensorCPU tensor(vector<int>{2, 3});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  TensorCPU rows(vector<int>{1, 3});
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < rows.size(); ++j) {
+      rows.mutable_data<TypeParam>()[j] = tensor.size() + j;
+    }
+    tensor.Append(rows, 100);
+  }
+  // The appended rows are kept in chunks until the tensor is read.
+  EXPECT_FALSE(tensor.IsContiguous());
+  EXPECT_EQ(tensor.dims(), (vector<TIndex>{5, 3}));
+  const TypeParam* data = tensor.data<TypeParam>();
+  EXPECT_TRUE(tensor.IsContiguous());
+  EXPECT_NE(data, ptr);
+  for (int i = 0; i < tensor.size(); ++i) {
+    EXPECT_EQ(data[i], i);
+  }
+  // The compacted tensor has room for more rows.
+  tensor.Append(rows, 100);
+  EXPECT_TRUE(tensor.IsContiguous());
+  EXPECT_EQ(tensor.data<TypeParam>(), data);
+  EXPECT_EQ(tensor.data<TypeParam>()[15], 12);
+  EXPECT_THROW(tensor.Append(tensor, 100), EnforceNotMet);
+}
+
+TYPED_TEST(TensorCPUTest, TensorShareRows) {
+  TensorCPU tensor(vector<int>{2, 2});
+  TensorCPU rows(vector<int>{2, 2});
+  for (int i = 0; i < 3; ++i) {
+    TypeParam* ptr = i ? rows.mutable_data<TypeParam>()
+                       : tensor.mutable_data<TypeParam>();
+    for (int j = 0; j < 4; ++j) {
+      ptr[j] = 4 * i + j;
+    }
+    if (i) {
+      tensor.Append(rows, 100);
+    }
+  }
+  // Rows of a single chunk are shared without compacting the source.
+  TensorCPU batch;
+  batch.ShareRows(tensor, 2, 4);
+  EXPECT_FALSE(tensor.IsContiguous());
+  EXPECT_EQ(batch.dims(), (vector<TIndex>{2, 2}));
+  for (int i = 0; i < batch.size(); ++i) {
+    EXPECT_EQ(batch.data<TypeParam>()[i], 4 + i);
+  }
+  // Rows of several chunks are copied.
+  batch.ShareRows(tensor, 1, 5);
+  EXPECT_FALSE(tensor.IsContiguous());
+  for (int i = 0; i < batch.size(); ++i) {
+    EXPECT_EQ(batch.data<TypeParam>()[i], 2 + i);
+  }
+  // Rows of a contiguous tensor are shared until either is written.
+  const TypeParam* data = tensor.data<TypeParam>();
+  batch.ShareRows(tensor, 3, 6);
+  EXPECT_EQ(batch.data<TypeParam>(), data + 6);
+  batch.mutable_data<TypeParam>()[0] = 0;
+  EXPECT_EQ(tensor.data<TypeParam>()[6], 6);
+  EXPECT_THROW(batch.ShareRows(tensor, 5, 7), EnforceNotMet);
+}
+
+TYPED_TEST(TensorCPUTest, TensorAppendWhileShared) {
+  TensorCPU tensor(vector<int>{2, 2});
+  TensorCPU rows(vector<int>{1, 2});
+  TypeParam* ptr = tensor.mutable_data<TypeParam>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  // Compacting leaves room for as many rows again.
+  for (int i = 0; i < 2; ++i) {
+    rows.mutable_data<TypeParam>()[0] = tensor.size();
+    rows.mutable_data<TypeParam>()[1] = tensor.size() + 1;
+    tensor.Append(rows, 100);
+  }
+  const TypeParam* data = tensor.data<TypeParam>();
+  // Batches read from the tensor do not stop appends from filling that room.
+  TensorCPU batch;
+  batch.ShareRows(tensor, 2, 4);
+  TensorCPU copy;
+  copy.ShareDataCopyOnWrite(tensor);
+  for (int i = 0; i < 4; ++i) {
+    rows.mutable_data<TypeParam>()[0] = tensor.size();
+    rows.mutable_data<TypeParam>()[1] = tensor.size() + 1;
+    tensor.Append(rows, 100);
+    EXPECT_TRUE(tensor.IsContiguous());
+    EXPECT_EQ(tensor.data<TypeParam>(), data);
+    batch.ShareRows(tensor, 4 + i, 5 + i);
+    EXPECT_EQ(batch.data<TypeParam>(), data + 2 * (4 + i));
+  }
+  for (int i = 0; i < tensor.size(); ++i) {
+    EXPECT_EQ(tensor.data<TypeParam>()[i], i);
+  }
+  // The copy keeps its own size, and appending to it no longer fits in place.
+  EXPECT_EQ(copy.dims(), (vector<TIndex>{4, 2}));
+  rows.mutable_data<TypeParam>()[0] = 0;
+  copy.Append(rows, 100);
+  EXPECT_FALSE(copy.IsContiguous());
+  EXPECT_EQ(copy.data<TypeParam>()[8], 0);
+  EXPECT_EQ(tensor.data<TypeParam>()[8], 8);
+}
+
 TYPED_TEST(TensorCPUTest, KeepOnShrink) {
   FLAGS_caffe2_keep_on_shrink = true;
   vector<int> dims{2, 3, 5};
   TensorCPU tensor(dims);
   TypeParam* ptr = tensor.mutable_data<TypeParam>();
   EXPECT_TRUE(ptr != nullptr);
+  // Keeps the old memory alive, so that the allocator cannot hand it out
+  // again whatever the tests before this one freed.
+  TensorCPU old;
+  old.ShareDataCopyOnWrite(tensor);
   // Expanding - will reallocate
   tensor.Resize(3, 4, 6);
   TypeParam* larger_ptr = tensor.mutable_data<TypeParam>();
@@ -369,6 +668,107 @@ TEST(TensorTest, TensorNonFundamentalTypeCopy) {
   }
 }
 
+TEST(TensorTest, TensorNonFundamentalTypeCopyOnWrite) {
+  TensorCPU tensor(vector<int>{2, 3});
+  std::string* ptr = tensor.mutable_data<std::string>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = "filled";
+  }
+  TensorCPU other_tensor;
+  other_tensor.ShareDataCopyOnWrite(tensor);
+  std::string* other_ptr = other_tensor.mutable_data<std::string>();
+  EXPECT_NE(other_ptr, ptr);
+  for (int i = 0; i < other_tensor.size(); ++i) {
+    EXPECT_EQ(other_ptr[i], "filled");
+  }
+}
+
+namespace {
+
+template <typename T>
+void CheckStridedViewsLarge() {
+  // Larger than the blocks the transposes are copied in.
+  TensorCPU tensor(vector<int>{3, 70, 45});
+  T* ptr = tensor.mutable_data<T>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i % 101;
+  }
+  // The transposes of the last two axes, and of the first and last ones.
+  const vector<vector<TIndex>> dims{{3, 45, 70}, {45, 70, 3}, {45}};
+  const vector<vector<TIndex>> strides{{3150, 1, 45}, {1, 45, 3150}, {70}};
+  for (int v = 0; v < dims.size(); ++v) {
+    TensorCPU view;
+    view.ShareDataStrided(tensor, dims[v], strides[v], 0);
+    EXPECT_FALSE(view.IsContiguous());
+    const T* data = view.data<T>();
+    vector<TIndex> index(dims[v].size(), 0);
+    for (int i = 0; i < view.size(); ++i) {
+      TIndex offset = 0;
+      for (int axis = 0; axis < index.size(); ++axis) {
+        offset += index[axis] * strides[v][axis];
+      }
+      EXPECT_EQ(data[i], ptr[offset]);
+      for (int axis = index.size() - 1; axis >= 0; --axis) {
+        if (++index[axis] < dims[v][axis]) {
+          break;
+        }
+        index[axis] = 0;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(TensorTest, TensorStridedViewLarge) {
+  // One type of each item size that is copied with an integer type.
+  CheckStridedViewsLarge<char>();
+  CheckStridedViewsLarge<int16_t>();
+  CheckStridedViewsLarge<float>();
+  CheckStridedViewsLarge<double>();
+}
+
+TEST(TensorTest, TensorStridedViewReadByThreads) {
+  TensorCPU tensor(vector<int>{64, 64});
+  float* ptr = tensor.mutable_data<float>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    ptr[i] = i;
+  }
+  TensorCPU view;
+  view.ShareDataStrided(
+      tensor, vector<TIndex>{64, 64}, vector<TIndex>{1, 64}, 0);
+  std::vector<std::thread> threads;
+  std::vector<const float*> data(4);
+  for (int i = 0; i < data.size(); ++i) {
+    threads.emplace_back([&view, &data, i]() { data[i] = view.data<float>(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  // The view is made contiguous only once.
+  for (int i = 0; i < data.size(); ++i) {
+    EXPECT_EQ(data[i], data[0]);
+  }
+  EXPECT_EQ(data[0][1], 64);
+  EXPECT_EQ(data[0][64], 1);
+}
+
+TEST(TensorTest, TensorUninitializedAllocation) {
+  FLAGS_caffe2_cpu_allocator_debug_fill = true;
+  TensorCPU tensor(vector<int>{2, 3, 4});
+  const float* ptr = tensor.mutable_data_uninitialized<float>();
+  for (int i = 0; i < tensor.size(); ++i) {
+    EXPECT_TRUE(std::isnan(ptr[i]));
+  }
+  // The default path still zero-fills new storage.
+  TensorCPU zeroed(vector<int>{2, 3, 4});
+  ptr = zeroed.mutable_data<float>();
+  for (int i = 0; i < zeroed.size(); ++i) {
+    EXPECT_EQ(ptr[i], 0);
+  }
+  FLAGS_caffe2_cpu_allocator_debug_fill = false;
+}
+
 TEST(TensorTest, Tensor64BitDimension) {
   // Initialize a large tensor.
   TIndex large_number =
@@ -443,6 +843,57 @@ TEST_SERIALIZATION_WITH_TYPE(uint8_t, int32_data)
 TEST_SERIALIZATION_WITH_TYPE(uint16_t, int32_data)
 TEST_SERIALIZATION_WITH_TYPE(int64_t, int64_data)
 
+TEST(TensorTest, TensorRawSerialization) {
+  Blob blob;
+  TensorCPU* tensor = blob.GetMutable<TensorCPU>();
+  tensor->Resize(5, 3);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = i;
+  }
+  int old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_tensor_chunk_size = 4;
+  vector<string> chunks;
+  std::mutex mutex;
+  auto acceptor = [&](const std::string& key, const std::string& value) {
+    std::lock_guard<std::mutex> guard(mutex);
+    EXPECT_EQ(key, "test");
+    chunks.push_back(value);
+  };
+  TensorSerializer<CPUContext>().SerializeRaw(blob, "test", acceptor);
+  FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+  EXPECT_EQ(chunks.size(), 4);
+  Blob new_blob;
+  for (const auto& chunk : chunks) {
+    EXPECT_TRUE(IsRawTensor(chunk));
+    BlobProto header;
+    size_t offset = ParseRawTensorHeader(chunk, &header);
+    EXPECT_EQ(offset % 64, 0);
+    EXPECT_EQ(header.name(), "test");
+    EXPECT_EQ(header.tensor().float_data_size(), 0);
+    EXPECT_EQ(
+        chunk.size() - offset,
+        (header.tensor().segment().end() - header.tensor().segment().begin()) *
+            sizeof(float));
+    EXPECT_TRUE(new_blob.Deserialize(chunk));
+  }
+  const TensorCPU& new_tensor = new_blob.Get<TensorCPU>();
+  EXPECT_EQ(new_tensor.dims(), tensor->dims());
+  for (int i = 0; i < tensor->size(); ++i) {
+    EXPECT_EQ(new_tensor.data<float>()[i], i);
+  }
+  // Tensors without a raw representation are serialized as TensorProtos.
+  Blob string_blob;
+  TensorCPU* strings = string_blob.GetMutable<TensorCPU>();
+  strings->Resize(2);
+  strings->mutable_data<string>()[1] = "raw";
+  chunks.clear();
+  TensorSerializer<CPUContext>().SerializeRaw(string_blob, "test", acceptor);
+  EXPECT_EQ(chunks.size(), 1);
+  EXPECT_FALSE(IsRawTensor(chunks[0]));
+  EXPECT_TRUE(new_blob.Deserialize(chunks[0]));
+  EXPECT_EQ(new_blob.Get<TensorCPU>().data<string>()[1], "raw");
+}
+
 typedef double my_type;
 
 typedef std::vector<std::pair<string, string>> StringMap;
@@ -581,5 +1032,518 @@ TYPED_TEST(TypedTensorTest, BigTensorSerialization) {
   }
 }
 
+// A db that counts its writes and fails the transactions that overlap.
+class BlobTestSerialDB : public DB {
+ public:
+  BlobTestSerialDB(const string& source, Mode mode) : DB(source, mode) {}
+  void Close() override {}
+  std::unique_ptr<Cursor> NewCursor() override {
+    return nullptr;
+  }
+  std::unique_ptr<Transaction> NewTransaction() override {
+    return std::unique_ptr<Transaction>(new SerialTransaction());
+  }
+
+  static std::atomic<int> writes;
+  static std::atomic<int> overlaps;
+
+ private:
+  class SerialTransaction : public Transaction {
+   public:
+    SerialTransaction() {
+      if (active_.exchange(true)) {
+        ++overlaps;
+      }
+    }
+    ~SerialTransaction() {
+      active_ = false;
+    }
+    void Put(const string& key, const string& value) override {
+      // Leaves the other serialization threads time to write.
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      ++writes;
+    }
+    void Commit() override {}
+  };
+
+  static std::atomic<bool> active_;
+};
+
+std::atomic<int> BlobTestSerialDB::writes{0};
+std::atomic<int> BlobTestSerialDB::overlaps{0};
+std::atomic<bool> BlobTestSerialDB::active_{false};
+REGISTER_CAFFE2_DB(blob_test_serial_db, BlobTestSerialDB);
+
+TEST(TensorTest, SaveWritesOneValueAtATime) {
+  int old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_tensor_chunk_size = 10;
+  Workspace ws;
+  TensorCPU* tensor = ws.CreateBlob("tensor")->GetMutable<TensorCPU>();
+  tensor->Resize(500);
+  tensor->mutable_data<float>();
+  ws.CreateBlob("string")->GetMutable<string>()->assign("content");
+  auto save_op = CreateOperator(
+      CreateOperatorDef(
+          "Save",
+          "",
+          vector<string>{"tensor", "string"},
+          vector<string>{},
+          vector<Argument>{
+              MakeArgument<string>("db_type", "blob_test_serial_db"),
+              MakeArgument<string>("db", "unused"),
+              MakeArgument<bool>("absolute_path", true)}),
+      &ws);
+  ASSERT_TRUE(save_op != nullptr);
+  EXPECT_TRUE(save_op->Run());
+  EXPECT_EQ(BlobTestSerialDB::writes, 51);
+  EXPECT_EQ(BlobTestSerialDB::overlaps, 0);
+  FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+}
+
+TEST(TensorTest, SaveAndLoadChunks) {
+  int old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_tensor_chunk_size = 10;
+  string db_source = (string)std::tmpnam(nullptr);
+  for (int test = 0; test < 6; ++test) {
+    const int raw = test % 2;
+    const string compression =
+        vector<string>{"", "zlib", "shuffle_zlib"}[test / 2];
+    Workspace ws;
+    for (int i = 1; i < 4; ++i) {
+      TensorCPU* tensor =
+          ws.CreateBlob("blob" + caffe2::to_string(i))->GetMutable<TensorCPU>();
+      tensor->Resize(i * 15);
+      for (int j = 0; j < tensor->size(); ++j) {
+        tensor->mutable_data<int>()[j] = i * j;
+      }
+    }
+    ws.CreateBlob("string")->GetMutable<string>()->assign("content");
+    vector<string> names{"blob1", "blob2", "blob3", "string"};
+    vector<Argument> args{MakeArgument<string>("db_type", "minidb"),
+                          MakeArgument<string>("db", db_source),
+                          MakeArgument<bool>("absolute_path", true),
+                          MakeArgument<int>("raw", raw),
+                          MakeArgument<string>("compression", compression)};
+    auto save_op = CreateOperator(
+        CreateOperatorDef("Save", "", names, vector<string>{}, args), &ws);
+    ASSERT_TRUE(save_op != nullptr);
+    EXPECT_TRUE(save_op->Run());
+
+    Workspace load_ws;
+    auto load_op = CreateOperator(
+        CreateOperatorDef("Load", "", vector<string>{}, names, args),
+        &load_ws);
+    ASSERT_TRUE(load_op != nullptr);
+    EXPECT_TRUE(load_op->Run());
+    for (int i = 1; i < 4; ++i) {
+      const auto& tensor = load_ws.GetBlob("blob" + caffe2::to_string(i))
+                               ->Get<TensorCPU>();
+      EXPECT_EQ(tensor.size(), i * 15);
+      for (int j = 0; j < tensor.size(); ++j) {
+        EXPECT_EQ(tensor.data<int>()[j], i * j);
+      }
+    }
+    EXPECT_EQ(load_ws.GetBlob("string")->Get<string>(), "content");
+  }
+  std::remove(db_source.c_str());
+  FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+}
+
+TEST(TensorTest, LoadDuplicateChunks) {
+  string db_source = (string)std::tmpnam(nullptr);
+  TensorCPU tensor(vector<TIndex>{20});
+  for (int j = 0; j < tensor.size(); ++j) {
+    tensor.mutable_data<int>()[j] = j;
+  }
+  Blob string_blob;
+  string_blob.GetMutable<string>()->assign("content");
+  const string string_value = string_blob.Serialize("string");
+  TensorProto header;
+  EXPECT_TRUE(PeekTensorChunk(string_value, &header));
+  EXPECT_FALSE(header.has_segment());
+  for (int raw = 0; raw < 2; ++raw) {
+    const string first =
+        TensorSerializer<CPUContext>().SerializeChunk(
+            tensor, "tensor", 0, 10, raw, "");
+    const string second =
+        TensorSerializer<CPUContext>().SerializeChunk(
+            tensor, "tensor", 10, 10, raw, "");
+    EXPECT_TRUE(PeekTensorChunk(second, &header));
+    EXPECT_EQ(header.segment().begin(), 10);
+    EXPECT_EQ(header.segment().end(), 20);
+    EXPECT_EQ(header.dims_size(), 1);
+    EXPECT_EQ(header.dims(0), 20);
+    // The duplicates are found even if the first copy is being loaded, and
+    // the db is not read past the last blob.
+    const vector<vector<std::pair<string, string>>> dbs{
+        {{"tensor", first}, {"tensor", second}, {"string", string_value}},
+        {{"tensor", first}, {"string", string_value}, {"tensor", second},
+         {"tensor", first}},
+        {{"tensor", first}, {"tensor", first}, {"tensor", second},
+         {"string", string_value}},
+        {{"string", string_value}, {"string", string_value},
+         {"tensor", first}, {"tensor", second}}};
+    for (int i = 0; i < dbs.size(); ++i) {
+      {
+        std::unique_ptr<db::DB> out_db(
+            db::CreateDB("minidb", db_source, db::NEW));
+        for (const auto& entry : dbs[i]) {
+          std::unique_ptr<db::Transaction> transaction(
+              out_db->NewTransaction());
+          transaction->Put(entry.first, entry.second);
+          transaction->Commit();
+        }
+      }
+      Workspace load_ws;
+      auto load_op = CreateOperator(
+          CreateOperatorDef(
+              "Load",
+              "",
+              vector<string>{},
+              vector<string>{"tensor", "string"},
+              vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                               MakeArgument<string>("db", db_source),
+                               MakeArgument<bool>("absolute_path", true)}),
+          &load_ws);
+      ASSERT_TRUE(load_op != nullptr);
+      if (i < 2) {
+        EXPECT_TRUE(load_op->Run());
+        const auto& loaded = load_ws.GetBlob("tensor")->Get<TensorCPU>();
+        EXPECT_EQ(loaded.size(), 20);
+        for (int j = 0; j < loaded.size(); ++j) {
+          EXPECT_EQ(loaded.data<int>()[j], j);
+        }
+      } else {
+        EXPECT_THROW(load_op->Run(), EnforceNotMet);
+      }
+    }
+  }
+  std::remove(db_source.c_str());
+}
+
+TEST(TensorTest, SnapshotDeltas) {
+  int old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_tensor_chunk_size = 4;
+  string db_prefix = (string)std::tmpnam(nullptr) + "_";
+  Workspace ws;
+  TensorCPU* iter = ws.CreateBlob("iter")->GetMutable<TensorCPU>();
+  iter->Resize(1);
+  TensorCPU* param = ws.CreateBlob("param")->GetMutable<TensorCPU>();
+  param->Resize(10, 3);
+  for (int j = 0; j < param->size(); ++j) {
+    param->mutable_data<float>()[j] = j;
+  }
+  DirtyRows* dirty =
+      ws.CreateBlob(DirtyRowsBlobName("param"))->GetMutable<DirtyRows>();
+  ws.CreateBlob("string")->GetMutable<string>()->assign("content");
+  vector<string> names{"iter", "param", "string"};
+  auto snapshot_op = CreateOperator(
+      CreateOperatorDef(
+          "Snapshot",
+          "",
+          names,
+          vector<string>{},
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "%d"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("full_every", 3)}),
+      &ws);
+  ASSERT_TRUE(snapshot_op != nullptr);
+  // Snapshot 0 is full, 1 and 2 are deltas, 3 is full again.
+  for (int i = 0; i < 3; ++i) {
+    const int rows[] = {i, 9 - i, 5};
+    for (int row : rows) {
+      for (int j = 0; j < 3; ++j) {
+        param->mutable_data<float>()[row * 3 + j] += 100;
+      }
+    }
+    dirty->Mark(rows, 3, 10);
+    iter->mutable_data<int64_t>()[0] = i;
+    EXPECT_TRUE(snapshot_op->Run());
+  }
+
+  Workspace load_ws;
+  auto load_op = CreateOperator(
+      CreateOperatorDef(
+          "Load",
+          "",
+          vector<string>{},
+          names,
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "2"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("delta", 1)}),
+      &load_ws);
+  ASSERT_TRUE(load_op != nullptr);
+  EXPECT_TRUE(load_op->Run());
+  const auto& loaded = load_ws.GetBlob("param")->Get<TensorCPU>();
+  EXPECT_EQ(loaded.dims(), param->dims());
+  for (int j = 0; j < param->size(); ++j) {
+    EXPECT_EQ(loaded.data<float>()[j], param->data<float>()[j]);
+  }
+  EXPECT_EQ(load_ws.GetBlob("iter")->Get<TensorCPU>().data<int64_t>()[0], 2);
+  EXPECT_EQ(load_ws.GetBlob("string")->Get<string>(), "content");
+  for (int i = 0; i < 3; ++i) {
+    std::remove((db_prefix + caffe2::to_string(i)).c_str());
+  }
+  FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+}
+
+TEST(TensorTest, SnapshotFailureKeepsDirtyRows) {
+  for (int async = 0; async < 2; ++async) {
+    string db_prefix = (string)std::tmpnam(nullptr) + "_";
+    Workspace ws;
+    TensorCPU* iter = ws.CreateBlob("iter")->GetMutable<TensorCPU>();
+    iter->Resize(1);
+    TensorCPU* param = ws.CreateBlob("param")->GetMutable<TensorCPU>();
+    param->Resize(10, 3);
+    for (int j = 0; j < param->size(); ++j) {
+      param->mutable_data<float>()[j] = j;
+    }
+    DirtyRows* dirty =
+        ws.CreateBlob(DirtyRowsBlobName("param"))->GetMutable<DirtyRows>();
+    Blob* other = ws.CreateBlob("other");
+    vector<string> names{"iter", "param", "other"};
+    auto snapshot_op = CreateOperator(
+        CreateOperatorDef(
+            "Snapshot",
+            "",
+            names,
+            vector<string>{},
+            vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                             MakeArgument<string>("db", db_prefix + "%d"),
+                             MakeArgument<bool>("absolute_path", true),
+                             MakeArgument<int>("full_every", 3),
+                             MakeArgument<int>("async", async)}),
+        &ws);
+    ASSERT_TRUE(snapshot_op != nullptr);
+    // Snapshot 1 fails as it cannot serialize the other blob, so snapshot 2
+    // is a delta of snapshot 0 with the rows of both.
+    for (int i = 0; i < 3; ++i) {
+      if (i == 1) {
+        other->GetMutable<BlobTestFoo>();
+      } else {
+        other->GetMutable<string>()->assign("content");
+      }
+      const int row = 3 * i;
+      for (int j = 0; j < 3; ++j) {
+        param->mutable_data<float>()[row * 3 + j] += 100;
+      }
+      dirty->Mark(&row, 1, 10);
+      iter->mutable_data<int64_t>()[0] = i;
+      if (i == 1) {
+        EXPECT_THROW(snapshot_op->Run(), EnforceNotMet);
+      } else {
+        EXPECT_TRUE(snapshot_op->Run());
+      }
+    }
+    // Waits for snapshot 2 to be written.
+    snapshot_op.reset();
+
+    Workspace load_ws;
+    auto load_op = CreateOperator(
+        CreateOperatorDef(
+            "Load",
+            "",
+            vector<string>{},
+            names,
+            vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                             MakeArgument<string>("db", db_prefix + "2"),
+                             MakeArgument<bool>("absolute_path", true),
+                             MakeArgument<int>("delta", 1)}),
+        &load_ws);
+    ASSERT_TRUE(load_op != nullptr);
+    EXPECT_TRUE(load_op->Run());
+    const auto& loaded = load_ws.GetBlob("param")->Get<TensorCPU>();
+    EXPECT_EQ(loaded.dims(), param->dims());
+    for (int j = 0; j < param->size(); ++j) {
+      EXPECT_EQ(loaded.data<float>()[j], param->data<float>()[j]);
+    }
+    EXPECT_EQ(load_ws.GetBlob("iter")->Get<TensorCPU>().data<int64_t>()[0], 2);
+    for (int i = 0; i < 3; ++i) {
+      std::remove((db_prefix + caffe2::to_string(i)).c_str());
+    }
+  }
+}
+
+TEST(TensorTest, AsyncSnapshot) {
+  string db_prefix = (string)std::tmpnam(nullptr) + "_";
+  Workspace ws;
+  TensorCPU* iter = ws.CreateBlob("iter")->GetMutable<TensorCPU>();
+  iter->Resize(1);
+  TensorCPU* param = ws.CreateBlob("param")->GetMutable<TensorCPU>();
+  param->Resize(1000);
+  for (int j = 0; j < param->size(); ++j) {
+    param->mutable_data<float>()[j] = j;
+  }
+  ws.CreateBlob("string")->GetMutable<string>()->assign("content");
+  vector<string> names{"iter", "param", "string"};
+  auto snapshot_op = CreateOperator(
+      CreateOperatorDef(
+          "Snapshot",
+          "",
+          names,
+          vector<string>{"completed"},
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "%d"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("every", 2),
+                           MakeArgument<int>("async", 1)}),
+      &ws);
+  ASSERT_TRUE(snapshot_op != nullptr);
+  for (int i = 0; i < 3; ++i) {
+    iter->mutable_data<int64_t>()[0] = i;
+    EXPECT_TRUE(snapshot_op->Run());
+    // The snapshots being written keep the values the parameter had.
+    for (int j = 0; j < param->size(); ++j) {
+      param->mutable_data<float>()[j] += 1;
+    }
+  }
+  // Snapshot 2 waited for snapshot 0 to be written.
+  EXPECT_GE(ws.GetBlob("completed")->Get<TensorCPU>().data<int64_t>()[0], 0);
+  // Waits for snapshot 2 to be written.
+  snapshot_op.reset();
+
+  for (int i = 0; i < 3; i += 2) {
+    Workspace load_ws;
+    auto load_op = CreateOperator(
+        CreateOperatorDef(
+            "Load",
+            "",
+            vector<string>{},
+            names,
+            vector<Argument>{
+                MakeArgument<string>("db_type", "minidb"),
+                MakeArgument<string>("db", db_prefix + caffe2::to_string(i)),
+                MakeArgument<bool>("absolute_path", true)}),
+        &load_ws);
+    ASSERT_TRUE(load_op != nullptr);
+    EXPECT_TRUE(load_op->Run());
+    EXPECT_EQ(load_ws.GetBlob("iter")->Get<TensorCPU>().data<int64_t>()[0], i);
+    const auto& loaded = load_ws.GetBlob("param")->Get<TensorCPU>();
+    EXPECT_EQ(loaded.size(), param->size());
+    for (int j = 0; j < loaded.size(); ++j) {
+      EXPECT_EQ(loaded.data<float>()[j], j + i);
+    }
+    EXPECT_EQ(load_ws.GetBlob("string")->Get<string>(), "content");
+    std::remove((db_prefix + caffe2::to_string(i)).c_str());
+  }
+}
+
+TEST(TensorTest, AsyncDeltaSnapshotDoesNotCopyOnWrite) {
+  int old_chunk_size = FLAGS_caffe2_tensor_chunk_size;
+  FLAGS_caffe2_tensor_chunk_size = 4;
+  string db_prefix = (string)std::tmpnam(nullptr) + "_";
+  Workspace ws;
+  TensorCPU* iter = ws.CreateBlob("iter")->GetMutable<TensorCPU>();
+  iter->Resize(1);
+  TensorCPU* param = ws.CreateBlob("param")->GetMutable<TensorCPU>();
+  param->Resize(10, 3);
+  for (int j = 0; j < param->size(); ++j) {
+    param->mutable_data<float>()[j] = j;
+  }
+  DirtyRows* dirty =
+      ws.CreateBlob(DirtyRowsBlobName("param"))->GetMutable<DirtyRows>();
+  vector<string> names{"iter", "param"};
+  auto snapshot_op = CreateOperator(
+      CreateOperatorDef(
+          "Snapshot",
+          "",
+          names,
+          vector<string>{},
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "%d"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("full_every", 2),
+                           MakeArgument<int>("async", 1)}),
+      &ws);
+  ASSERT_TRUE(snapshot_op != nullptr);
+  // Snapshot 0 is full, 1 is a delta of row 6.
+  vector<float> saved;
+  for (int i = 0; i < 2; ++i) {
+    const int rows[] = {6};
+    for (int j = 0; j < 3; ++j) {
+      param->mutable_data<float>()[rows[0] * 3 + j] += 100;
+    }
+    dirty->Mark(rows, 1, 10);
+    iter->mutable_data<int64_t>()[0] = i;
+    EXPECT_TRUE(snapshot_op->Run());
+    saved.assign(param->data<float>(), param->data<float>() + param->size());
+    // The net writes the parameter in place while the snapshot is written.
+    const float* data = param->data<float>();
+    for (int j = 0; j < param->size(); ++j) {
+      param->mutable_data<float>()[j] += 1;
+    }
+    EXPECT_EQ(param->data<float>(), data);
+  }
+  // Waits for snapshot 1 to be written.
+  snapshot_op.reset();
+
+  Workspace load_ws;
+  auto load_op = CreateOperator(
+      CreateOperatorDef(
+          "Load",
+          "",
+          vector<string>{},
+          names,
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "1"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("delta", 1)}),
+      &load_ws);
+  ASSERT_TRUE(load_op != nullptr);
+  EXPECT_TRUE(load_op->Run());
+  const auto& loaded = load_ws.GetBlob("param")->Get<TensorCPU>();
+  ASSERT_EQ(loaded.size(), saved.size());
+  // The delta only has row 6 as of snapshot 1, the other rows are the ones
+  // of snapshot 0, which were one less.
+  for (int j = 0; j < loaded.size(); ++j) {
+    EXPECT_EQ(loaded.data<float>()[j], j / 3 == 6 ? saved[j] : saved[j] - 1);
+  }
+  for (int i = 0; i < 2; ++i) {
+    std::remove((db_prefix + caffe2::to_string(i)).c_str());
+  }
+  FLAGS_caffe2_tensor_chunk_size = old_chunk_size;
+}
+
+TEST(TensorTest, AsyncSnapshotWithBusyIOPool) {
+  // The threads of the I/O pool are all blocked until the snapshot is written.
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool written = false;
+  for (int i = 0; i < FLAGS_caffe2_io_worker_pool_num_workers; ++i) {
+    ScheduleIOTask([&]() {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return written; });
+    });
+  }
+  string db_prefix = (string)std::tmpnam(nullptr) + "_";
+  Workspace ws;
+  TensorCPU* iter = ws.CreateBlob("iter")->GetMutable<TensorCPU>();
+  iter->Resize(1);
+  iter->mutable_data<int64_t>()[0] = 0;
+  auto snapshot_op = CreateOperator(
+      CreateOperatorDef(
+          "Snapshot",
+          "",
+          vector<string>{"iter"},
+          vector<string>{},
+          vector<Argument>{MakeArgument<string>("db_type", "minidb"),
+                           MakeArgument<string>("db", db_prefix + "%d"),
+                           MakeArgument<bool>("absolute_path", true),
+                           MakeArgument<int>("async", 1)}),
+      &ws);
+  ASSERT_TRUE(snapshot_op != nullptr);
+  EXPECT_TRUE(snapshot_op->Run());
+  // Waits for the snapshot to be written.
+  snapshot_op.reset();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    written = true;
+  }
+  cv.notify_all();
+  std::remove((db_prefix + "0").c_str());
+}
+
 } // namespace
 } // namespace caffe2
@@ -0,0 +1,367 @@
+#include "caffe2/core/caching_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/mman.h>
+#endif
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_caching_cpu_allocator,
+    false,
+    "If true, GlobalInit() installs a CachingCPUAllocator as the CPU "
+    "allocator.");
+CAFFE2_DEFINE_int64(
+    caffe2_caching_cpu_allocator_max_cached_bytes,
+    1LL << 30,
+    "The default maximum number of bytes cached by a CachingCPUAllocator.");
+
+namespace caffe2 {
+
+namespace {
+
+// Every block starts with a header, padded to keep the data aligned.
+struct BlockHeader {
+  // The size class of the block, or -1 if it is not cached.
+  int32_t size_class;
+  bool huge_page;
+  // The size of the block, including the header.
+  size_t bytes;
+};
+constexpr size_t kHeaderSize = gCaffe2Alignment;
+static_assert(sizeof(BlockHeader) <= kHeaderSize, "Block header too large.");
+
+constexpr size_t kMinBlockSize = 64;
+constexpr size_t kMaxBlockSize = 256 << 20;
+constexpr size_t kHugePageSize = 2 << 20;
+// Blocks up to kMaxThreadCachedBlockSize are cached by the freeing thread, up
+// to kThreadCacheBytes per thread.
+constexpr size_t kMaxThreadCachedBlockSize = 256 << 10;
+constexpr size_t kThreadCacheBytes = 8 << 20;
+
+size_t RoundUp(size_t bytes, size_t multiple) {
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+// Four size classes per power of two. Classes of at least kHugePageSize are
+// rounded to whole huge pages.
+const std::vector<size_t>& SizeClasses() {
+  static const std::vector<size_t> classes = []() {
+    std::vector<size_t> classes;
+    for (size_t base = kMinBlockSize; base < kMaxBlockSize; base *= 2) {
+      for (size_t step = 0; step < 4; ++step) {
+        size_t bytes = base + step * base / 4;
+        if (bytes >= kHugePageSize) {
+          bytes = RoundUp(bytes, kHugePageSize);
+        }
+        if (classes.empty() || classes.back() < bytes) {
+          classes.push_back(bytes);
+        }
+      }
+    }
+    classes.push_back(kMaxBlockSize);
+    return classes;
+  }();
+  return classes;
+}
+
+int SizeClass(size_t bytes) {
+  const auto& classes = SizeClasses();
+  auto it = std::lower_bound(classes.begin(), classes.end(), bytes);
+  return it == classes.end() ? -1 : it - classes.begin();
+}
+
+BlockHeader* SystemAlloc(size_t bytes) {
+  void* data = nullptr;
+  bool huge_page = false;
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (bytes >= kHugePageSize) {
+    data = mmap(
+        nullptr,
+        RoundUp(bytes, kHugePageSize),
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    CAFFE_ENFORCE(data != MAP_FAILED, "Failed to map ", bytes, " bytes.");
+#ifdef MADV_HUGEPAGE
+    // Only a hint: the kernel may not support transparent huge pages.
+    madvise(data, RoundUp(bytes, kHugePageSize), MADV_HUGEPAGE);
+#endif
+    huge_page = true;
+  }
+#endif
+  if (!huge_page) {
+#ifdef __ANDROID__
+    data = memalign(gCaffe2Alignment, bytes);
+#else
+    CHECK_EQ(posix_memalign(&data, gCaffe2Alignment, bytes), 0);
+#endif
+    CAFFE_ENFORCE(data, "Failed to allocate ", bytes, " bytes.");
+  }
+  auto* header = static_cast<BlockHeader*>(data);
+  header->huge_page = huge_page;
+  header->bytes = bytes;
+  return header;
+}
+
+void SystemFree(BlockHeader* header) {
+#if defined(__linux__) && !defined(__ANDROID__)
+  if (header->huge_page) {
+    munmap(header, RoundUp(header->bytes, kHugePageSize));
+    return;
+  }
+#endif
+  free(header);
+}
+
+typedef std::vector<std::vector<BlockHeader*>> FreeLists;
+
+void FreeAll(FreeLists* free_lists) {
+  for (auto& free_list : *free_lists) {
+    for (auto* header : free_list) {
+      SystemFree(header);
+    }
+    free_list.clear();
+  }
+}
+
+}  // namespace
+
+struct CachingCPUAllocator::State {
+  explicit State(int64_t max_cached_bytes)
+      : max_cached_bytes(max_cached_bytes),
+        free_lists(SizeClasses().size()) {}
+  ~State() {
+    FreeAll(&free_lists);
+  }
+
+  const int64_t max_cached_bytes;
+  std::atomic<int64_t> live_bytes{0};
+  std::atomic<int64_t> cached_bytes{0};
+  std::atomic<int64_t> hits{0};
+  std::atomic<int64_t> misses{0};
+  // The free lists shared by all the threads.
+  std::mutex mutex;
+  FreeLists free_lists;
+};
+
+namespace {
+
+typedef CachingCPUAllocator::State State;
+
+// The free lists of a thread for one allocator. They keep the allocator state
+// alive, and give their blocks back to the shared free lists when the thread
+// exits.
+struct ThreadCache {
+  explicit ThreadCache(std::shared_ptr<State> state)
+      : state(std::move(state)), free_lists(SizeClasses().size()) {}
+  ~ThreadCache() {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    for (int i = 0; i < free_lists.size(); ++i) {
+      state->free_lists[i].insert(
+          state->free_lists[i].end(),
+          free_lists[i].begin(),
+          free_lists[i].end());
+    }
+  }
+
+  std::shared_ptr<State> state;
+  FreeLists free_lists;
+  size_t bytes = 0;
+};
+
+typedef std::unordered_map<const State*, std::unique_ptr<ThreadCache>>
+    ThreadCaches;
+
+// Plain thread locals, so that they can still be checked while the thread
+// locals with destructors are being destroyed.
+thread_local ThreadCaches* t_caches = nullptr;
+thread_local bool t_caches_destroyed = false;
+
+struct ThreadCachesHolder {
+  ~ThreadCachesHolder() {
+    t_caches_destroyed = true;
+    delete t_caches;
+    t_caches = nullptr;
+  }
+};
+
+// Returns the free lists of the calling thread, or nullptr if the thread is
+// exiting.
+ThreadCache* LocalCache(const std::shared_ptr<State>& state) {
+  if (!t_caches) {
+    if (t_caches_destroyed) {
+      return nullptr;
+    }
+    static thread_local ThreadCachesHolder holder;
+    (void)holder;
+    t_caches = new ThreadCaches();
+  }
+  auto& cache = (*t_caches)[state.get()];
+  if (!cache) {
+    cache.reset(new ThreadCache(state));
+  }
+  return cache.get();
+}
+
+}  // namespace
+
+CachingCPUAllocator::CachingCPUAllocator(int64_t max_cached_bytes)
+    : state_(std::make_shared<State>(max_cached_bytes)) {}
+
+CachingCPUAllocator::~CachingCPUAllocator() {
+  FreeCached();
+  if (t_caches) {
+    t_caches->erase(state_.get());
+  }
+}
+
+void* CachingCPUAllocator::New(size_t nbytes) {
+  bool zeroed = false;
+  void* data = Allocate(nbytes, &zeroed);
+  if (!zeroed) {
+    memset(data, 0, nbytes);
+  }
+  return data;
+}
+
+void* CachingCPUAllocator::NewUninitialized(size_t nbytes) {
+  bool zeroed = false;
+  void* data = Allocate(nbytes, &zeroed);
+  DebugFillUninitialized(data, nbytes);
+  return data;
+}
+
+void* CachingCPUAllocator::Allocate(size_t nbytes, bool* zeroed) {
+  const size_t bytes = nbytes + kHeaderSize;
+  const int size_class = SizeClass(bytes);
+  BlockHeader* header = nullptr;
+  if (size_class >= 0) {
+    const size_t class_bytes = SizeClasses()[size_class];
+    if (class_bytes <= kMaxThreadCachedBlockSize) {
+      ThreadCache* cache = LocalCache(state_);
+      if (cache && cache->free_lists[size_class].size()) {
+        header = cache->free_lists[size_class].back();
+        cache->free_lists[size_class].pop_back();
+        cache->bytes -= class_bytes;
+      }
+    }
+    if (!header) {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      auto& free_list = state_->free_lists[size_class];
+      if (free_list.size()) {
+        header = free_list.back();
+        free_list.pop_back();
+      }
+    }
+    if (header) {
+      state_->cached_bytes -= class_bytes;
+      ++state_->hits;
+    } else {
+      header = SystemAlloc(class_bytes);
+      ++state_->misses;
+      // Freshly mapped pages are zero-filled by the system.
+      *zeroed = header->huge_page;
+    }
+  } else {
+    header = SystemAlloc(bytes);
+    ++state_->misses;
+    *zeroed = header->huge_page;
+  }
+  header->size_class = size_class;
+  state_->live_bytes += header->bytes;
+  return reinterpret_cast<char*>(header) + kHeaderSize;
+}
+
+void CachingCPUAllocator::Delete(void* data) {
+  if (!data) {
+    return;
+  }
+  auto* header = reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(data) - kHeaderSize);
+  const size_t bytes = header->bytes;
+  state_->live_bytes -= bytes;
+  if (header->size_class < 0) {
+    SystemFree(header);
+    return;
+  }
+  if (state_->cached_bytes.fetch_add(bytes) + bytes >
+      state_->max_cached_bytes) {
+    state_->cached_bytes -= bytes;
+    SystemFree(header);
+    return;
+  }
+  if (bytes <= kMaxThreadCachedBlockSize) {
+    ThreadCache* cache = LocalCache(state_);
+    if (cache && cache->bytes + bytes <= kThreadCacheBytes) {
+      cache->free_lists[header->size_class].push_back(header);
+      cache->bytes += bytes;
+      return;
+    }
+  }
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  state_->free_lists[header->size_class].push_back(header);
+}
+
+CachingCPUAllocator::Stats CachingCPUAllocator::GetStats() const {
+  return Stats{state_->live_bytes,
+               state_->cached_bytes,
+               state_->hits,
+               state_->misses};
+}
+
+void CachingCPUAllocator::FreeCached() {
+  FreeLists free_lists(SizeClasses().size());
+  ThreadCache* cache = LocalCache(state_);
+  if (cache) {
+    free_lists.swap(cache->free_lists);
+    cache->free_lists.resize(free_lists.size());
+    cache->bytes = 0;
+  }
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    for (int i = 0; i < free_lists.size(); ++i) {
+      free_lists[i].insert(
+          free_lists[i].end(),
+          state_->free_lists[i].begin(),
+          state_->free_lists[i].end());
+      state_->free_lists[i].clear();
+    }
+  }
+  for (const auto& free_list : free_lists) {
+    for (auto* header : free_list) {
+      state_->cached_bytes -= header->bytes;
+    }
+  }
+  FreeAll(&free_lists);
+}
+
+namespace {
+
+bool Caffe2SetCachingCPUAllocator(int*, char***) {
+  // The blocks of the allocator it replaces have no header, so the caching
+  // allocator is only installed if that one has not handed out any.
+  if (FLAGS_caffe2_caching_cpu_allocator &&
+      ReplaceCPUAllocator(new CachingCPUAllocator())) {
+    VLOG(1) << "Using the caching CPU allocator.";
+  }
+  return true;
+}
+
+}  // namespace
+
+REGISTER_CAFFE2_INIT_FUNCTION(
+    Caffe2SetCachingCPUAllocator,
+    &Caffe2SetCachingCPUAllocator,
+    "Install the caching CPU allocator.");
+
+}  // namespace caffe2
@@ -0,0 +1,74 @@
+#ifndef CAFFE2_CORE_CACHING_ALLOCATOR_H_
+#define CAFFE2_CORE_CACHING_ALLOCATOR_H_
+
+#include <memory>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_bool(caffe2_caching_cpu_allocator);
+CAFFE2_DECLARE_int64(caffe2_caching_cpu_allocator_max_cached_bytes);
+
+namespace caffe2 {
+
+/**
+ * @brief A CPU allocator that caches the blocks it frees for later reuse.
+ *
+ * Requests are rounded up to a size class, with four classes per power of
+ * two. Freed blocks go to a free list of their size class instead of being
+ * returned to the system: small blocks to a free list of the freeing thread,
+ * which needs no locking, and larger ones, or small ones once the thread has
+ * cached enough of them, to free lists shared by all the threads. Blocks
+ * larger than the largest size class are never cached.
+ *
+ * Blocks of at least 2MB are mapped directly and marked for transparent huge
+ * pages where the system supports it. Like DefaultCPUAllocator, New()
+ * zero-fills the memory, including blocks taken from the free lists, and only
+ * NewUninitialized() leaves it as is.
+ *
+ * Once the cached bytes reach max_cached_bytes, freed blocks are returned to
+ * the system. As with any allocator, install it with SetCPUAllocator() before
+ * any tensor is allocated, since tensors free their memory through the
+ * allocator installed at that time. Setting --caffe2_caching_cpu_allocator
+ * does so in GlobalInit(), unless CPU memory was allocated before.
+ */
+class CachingCPUAllocator final : public CPUAllocator {
+ public:
+  struct Stats {
+    // The bytes of the blocks currently handed out.
+    int64_t live_bytes;
+    // The bytes of the blocks held in the free lists.
+    int64_t cached_bytes;
+    // The number of allocations served from, or missing, the free lists.
+    int64_t hits;
+    int64_t misses;
+  };
+
+  explicit CachingCPUAllocator(
+      int64_t max_cached_bytes =
+          FLAGS_caffe2_caching_cpu_allocator_max_cached_bytes);
+  ~CachingCPUAllocator();
+
+  void* New(size_t nbytes) override;
+  void* NewUninitialized(size_t nbytes) override;
+  void Delete(void* data) override;
+
+  Stats GetStats() const;
+  // Returns the blocks cached in the shared free lists and in the free lists
+  // of the calling thread to the system.
+  void FreeCached();
+
+  struct State;
+
+ private:
+  // Takes a block from the free lists, or from the system. Sets zeroed if the
+  // memory is known to be zero-filled.
+  void* Allocate(size_t nbytes, bool* zeroed);
+
+  std::shared_ptr<State> state_;
+  DISABLE_COPY_AND_ASSIGN(CachingCPUAllocator);
+};
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_CACHING_ALLOCATOR_H_
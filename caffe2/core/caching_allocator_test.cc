@@ -0,0 +1,141 @@
+#include <cstring>
+#include <thread>  // NOLINT
+
+#include "caffe2/core/caching_allocator.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+TEST(CachingCPUAllocatorTest, ReusesFreedBlocks) {
+  CachingCPUAllocator allocator;
+  void* data = allocator.New(1000);
+  ASSERT_TRUE(data != nullptr);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % gCaffe2Alignment, 0);
+  memset(data, 1, 1000);
+  auto stats = allocator.GetStats();
+  EXPECT_GE(stats.live_bytes, 1000);
+  EXPECT_EQ(stats.cached_bytes, 0);
+  EXPECT_EQ(stats.misses, 1);
+
+  allocator.Delete(data);
+  stats = allocator.GetStats();
+  EXPECT_EQ(stats.live_bytes, 0);
+  EXPECT_GE(stats.cached_bytes, 1000);
+  // Requests of the same size class get the cached block back.
+  EXPECT_EQ(allocator.New(1100), data);
+  stats = allocator.GetStats();
+  EXPECT_EQ(stats.cached_bytes, 0);
+  EXPECT_EQ(stats.hits, 1);
+  allocator.Delete(data);
+
+  allocator.FreeCached();
+  EXPECT_EQ(allocator.GetStats().cached_bytes, 0);
+  allocator.Delete(nullptr);
+}
+
+TEST(CachingCPUAllocatorTest, NewZeroFillsReusedBlocks) {
+  CachingCPUAllocator allocator;
+  for (const size_t nbytes : {size_t(1000), size_t(5 << 20)}) {
+    char* data = static_cast<char*>(allocator.New(nbytes));
+    for (size_t i = 0; i < nbytes; ++i) {
+      ASSERT_EQ(data[i], 0);
+    }
+    memset(data, 1, nbytes);
+    allocator.Delete(data);
+    ASSERT_EQ(allocator.New(nbytes), data);
+    for (size_t i = 0; i < nbytes; ++i) {
+      ASSERT_EQ(data[i], 0);
+    }
+    allocator.Delete(data);
+    // NewUninitialized() reuses the block too, without filling it.
+    EXPECT_EQ(allocator.NewUninitialized(nbytes), data);
+    allocator.Delete(data);
+  }
+}
+
+TEST(CachingCPUAllocatorTest, CPUContextNewZeroFills) {
+  SetCPUAllocator(new CachingCPUAllocator());
+  // Uninitialized allocations are filled with NaN, so that a block handed out
+  // as is after them cannot pass for zero-filled.
+  FLAGS_caffe2_cpu_allocator_debug_fill = true;
+  const size_t nbytes = 1000 * sizeof(float);
+  for (int i = 0; i < 2; ++i) {
+    float* data = static_cast<float*>(CPUContext::NewUninitialized(nbytes));
+    CPUContext::Delete(data);
+    data = static_cast<float*>(CPUContext::New(nbytes));
+    for (int j = 0; j < 1000; ++j) {
+      ASSERT_EQ(data[j], 0);
+      data[j] = j + 1;
+    }
+    CPUContext::Delete(data);
+  }
+  FLAGS_caffe2_cpu_allocator_debug_fill = false;
+  SetCPUAllocator(new DefaultCPUAllocator());
+}
+
+TEST(CachingCPUAllocatorTest, ReplacesOnlyUnusedAllocators) {
+  SetCPUAllocator(new DefaultCPUAllocator());
+  EXPECT_TRUE(ReplaceCPUAllocator(new DefaultCPUAllocator()));
+  // A block of the default allocator has no header to be deleted with.
+  void* data = CPUContext::New(16);
+  EXPECT_FALSE(ReplaceCPUAllocator(new CachingCPUAllocator()));
+  CPUContext::Delete(data);
+  // Only the first allocation is tracked, not the blocks still handed out.
+  EXPECT_FALSE(ReplaceCPUAllocator(new CachingCPUAllocator()));
+  SetCPUAllocator(new CachingCPUAllocator());
+  // The caching allocator does not track its blocks.
+  EXPECT_FALSE(ReplaceCPUAllocator(new DefaultCPUAllocator()));
+  SetCPUAllocator(new DefaultCPUAllocator());
+}
+
+TEST(CachingCPUAllocatorTest, LargeBlocks) {
+  CachingCPUAllocator allocator;
+  // Large enough to be mapped with huge pages.
+  const size_t nbytes = 5 << 20;
+  char* data = static_cast<char*>(allocator.New(nbytes));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(data) % gCaffe2Alignment, 0);
+  data[0] = 1;
+  data[nbytes - 1] = 1;
+  allocator.Delete(data);
+  EXPECT_EQ(allocator.New(nbytes), data);
+  allocator.Delete(data);
+
+  // Blocks larger than the largest size class are not cached.
+  void* huge = allocator.New(300 << 20);
+  allocator.Delete(huge);
+  EXPECT_EQ(allocator.GetStats().live_bytes, 0);
+  EXPECT_LT(allocator.GetStats().cached_bytes, 300 << 20);
+}
+
+TEST(CachingCPUAllocatorTest, RespectsMaxCachedBytes) {
+  CachingCPUAllocator allocator(4096);
+  void* small = allocator.New(1000);
+  void* large = allocator.New(8000);
+  allocator.Delete(large);
+  EXPECT_EQ(allocator.GetStats().cached_bytes, 0);
+  allocator.Delete(small);
+  EXPECT_GT(allocator.GetStats().cached_bytes, 0);
+  EXPECT_LE(allocator.GetStats().cached_bytes, 4096);
+}
+
+TEST(CachingCPUAllocatorTest, BlocksCrossThreads) {
+  CachingCPUAllocator allocator;
+  void* data = nullptr;
+  std::thread producer([&]() { data = allocator.New(64 << 10); });
+  producer.join();
+  allocator.Delete(data);
+  // Blocks freed by a thread are cached by that thread, and given back to the
+  // shared free lists when the thread exits.
+  std::thread consumer([&]() {
+    void* other = allocator.New(64 << 10);
+    EXPECT_NE(other, data);
+    allocator.Delete(other);
+  });
+  consumer.join();
+  void* reused = allocator.New(64 << 10);
+  EXPECT_EQ(reused, data);
+  allocator.Delete(reused);
+  EXPECT_EQ(allocator.GetStats().live_bytes, 0);
+}
+
+}  // namespace caffe2
@@ -0,0 +1,122 @@
+#include "caffe2/core/chunk_codec.h"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <map>
+#include <mutex>  // NOLINT
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+CAFFE_DEFINE_REGISTRY(ChunkCodecRegistry, ChunkCodec);
+
+const ChunkCodec& GetChunkCodec(const string& name) {
+  // Codecs are created once per name, as they are looked up for every chunk.
+  static std::mutex mutex;
+  static std::map<string, std::unique_ptr<ChunkCodec>> codecs;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& codec = codecs[name];
+  if (!codec) {
+    codec = ChunkCodecRegistry()->Create(name);
+    CAFFE_ENFORCE(codec, "Unknown chunk compression codec: ", name);
+  }
+  return *codec;
+}
+
+namespace {
+
+// Compresses with zlib at its fastest level, which already gets most of the
+// gain on tensor data.
+class ZlibCodec : public ChunkCodec {
+ public:
+  void Compress(const char* data, size_t nbytes, size_t itemsize, string* out)
+      const override {
+    const size_t begin = out->size();
+    uLongf size = compressBound(nbytes);
+    out->resize(begin + size);
+    const int status = compress2(
+        reinterpret_cast<Bytef*>(&(*out)[begin]),
+        &size,
+        reinterpret_cast<const Bytef*>(data),
+        nbytes,
+        Z_BEST_SPEED);
+    CAFFE_ENFORCE(status == Z_OK, "zlib compression failed: ", status);
+    out->resize(begin + size);
+  }
+
+  bool Decompress(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      char* dst,
+      size_t nbytes) const override {
+    uLongf dst_size = nbytes;
+    if (uncompress(
+            reinterpret_cast<Bytef*>(dst),
+            &dst_size,
+            reinterpret_cast<const Bytef*>(data),
+            size) != Z_OK) {
+      return false;
+    }
+    return dst_size == nbytes;
+  }
+};
+
+// Groups the k-th bytes of all the items together before compressing with
+// zlib. The high bytes of floats, such as their signs and exponents, are
+// mostly the same across a tensor and compress far better that way.
+class ShuffleZlibCodec : public ChunkCodec {
+ public:
+  void Compress(const char* data, size_t nbytes, size_t itemsize, string* out)
+      const override {
+    if (itemsize <= 1) {
+      zlib_.Compress(data, nbytes, itemsize, out);
+      return;
+    }
+    string shuffled(nbytes, '\0');
+    const size_t n = nbytes / itemsize;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < itemsize; ++k) {
+        shuffled[k * n + i] = data[i * itemsize + k];
+      }
+    }
+    // The bytes of a trailing partial item, if any, are left as they are.
+    memcpy(&shuffled[n * itemsize], data + n * itemsize, nbytes % itemsize);
+    zlib_.Compress(shuffled.data(), nbytes, itemsize, out);
+  }
+
+  bool Decompress(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      char* dst,
+      size_t nbytes) const override {
+    if (itemsize <= 1) {
+      return zlib_.Decompress(data, size, itemsize, dst, nbytes);
+    }
+    string shuffled(nbytes, '\0');
+    if (!zlib_.Decompress(data, size, itemsize, &shuffled[0], nbytes)) {
+      return false;
+    }
+    const size_t n = nbytes / itemsize;
+    for (size_t i = 0; i < n; ++i) {
+      for (size_t k = 0; k < itemsize; ++k) {
+        dst[i * itemsize + k] = shuffled[k * n + i];
+      }
+    }
+    memcpy(dst + n * itemsize, &shuffled[n * itemsize], nbytes % itemsize);
+    return true;
+  }
+
+ private:
+  ZlibCodec zlib_;
+};
+
+REGISTER_CHUNK_CODEC(zlib, ZlibCodec);
+REGISTER_CHUNK_CODEC(shuffle_zlib, ShuffleZlibCodec);
+
+}  // namespace
+
+}  // namespace caffe2
@@ -0,0 +1,50 @@
+#ifndef CAFFE2_CORE_CHUNK_CODEC_H_
+#define CAFFE2_CORE_CHUNK_CODEC_H_
+
+#include <memory>
+#include <string>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/registry.h"
+
+namespace caffe2 {
+
+/**
+ * @brief ChunkCodec compresses the data of the chunks of serialized tensors.
+ *
+ * The codecs are registered by name in the ChunkCodecRegistry, and the name of
+ * the codec of a chunk is saved along with it, see TensorSerializer. The data
+ * is an array of items of a fundamental type, which a codec may use to
+ * arrange it for compression. Codecs are stateless, so a single codec may be
+ * used from different threads.
+ */
+class ChunkCodec {
+ public:
+  virtual ~ChunkCodec() {}
+
+  // Appends the compressed nbytes of data, of items of itemsize bytes, to out.
+  virtual void Compress(
+      const char* data,
+      size_t nbytes,
+      size_t itemsize,
+      string* out) const = 0;
+  // Decompresses the size bytes of data into exactly nbytes at dst, and
+  // returns whether the data was a valid compressed chunk of that size.
+  virtual bool Decompress(
+      const char* data,
+      size_t size,
+      size_t itemsize,
+      char* dst,
+      size_t nbytes) const = 0;
+};
+
+CAFFE_DECLARE_REGISTRY(ChunkCodecRegistry, ChunkCodec);
+#define REGISTER_CHUNK_CODEC(name, ...) \
+  CAFFE_REGISTER_CLASS(ChunkCodecRegistry, name, __VA_ARGS__)
+
+// Returns the codec of the given name, which has to be registered.
+const ChunkCodec& GetChunkCodec(const string& name);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_CHUNK_CODEC_H_
@@ -0,0 +1,65 @@
+#include <string>
+#include <vector>
+
+#include "caffe2/core/chunk_codec.h"
+#include "caffe2/core/logging.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+class ChunkCodecTest : public ::testing::TestWithParam<const char*> {};
+
+TEST_P(ChunkCodecTest, RoundTrip) {
+  const ChunkCodec& codec = GetChunkCodec(GetParam());
+  std::vector<float> data(1000);
+  for (int i = 0; i < data.size(); ++i) {
+    data[i] = 0.001f * (i % 37);
+  }
+  const char* bytes = reinterpret_cast<const char*>(data.data());
+  // Also covers a trailing partial item.
+  for (const size_t nbytes : {size_t(0), sizeof(float) * 1000, size_t(4001)}) {
+    string compressed("prefix");
+    codec.Compress(bytes, nbytes, sizeof(float), &compressed);
+    EXPECT_EQ(compressed.substr(0, 6), "prefix");
+    if (nbytes > 0) {
+      EXPECT_LT(compressed.size() - 6, nbytes);
+    }
+    string decompressed(nbytes, '\0');
+    EXPECT_TRUE(codec.Decompress(
+        compressed.data() + 6,
+        compressed.size() - 6,
+        sizeof(float),
+        &decompressed[0],
+        nbytes));
+    EXPECT_EQ(decompressed, string(bytes, nbytes));
+  }
+}
+
+TEST_P(ChunkCodecTest, Corrupted) {
+  const ChunkCodec& codec = GetChunkCodec(GetParam());
+  const string data(100, 'a');
+  string compressed;
+  codec.Compress(data.data(), data.size(), 4, &compressed);
+  string decompressed(data.size(), '\0');
+  // Wrong size.
+  EXPECT_FALSE(codec.Decompress(
+      compressed.data(), compressed.size(), 4, &decompressed[0], 99));
+  // Truncated data.
+  EXPECT_FALSE(codec.Decompress(
+      compressed.data(), compressed.size() / 2, 4, &decompressed[0], 100));
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Codecs,
+    ChunkCodecTest,
+    ::testing::Values("zlib", "shuffle_zlib"));
+
+TEST(ChunkCodecTest, Unknown) {
+  EXPECT_THROW(GetChunkCodec("unknown"), EnforceNotMet);
+}
+
+}  // namespace
+
+}  // namespace caffe2
@@ -1,5 +1,13 @@
 #include "caffe2/core/context.h"
 
+#include "caffe2/core/init.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_allocator_debug_fill,
+    false,
+    "If set, CPU memory allocated without initialization is filled with a "
+    "pattern that reads as NaN, to catch reads of uninitialized memory.");
+
 namespace caffe2 {
 
 static std::unique_ptr<CPUAllocator> g_cpu_allocator(new DefaultCPUAllocator());
@@ -11,4 +19,95 @@ void SetCPUAllocator(CPUAllocator* alloc) {
   g_cpu_allocator.reset(alloc);
 }
 
+bool ReplaceCPUAllocator(CPUAllocator* alloc) {
+  std::unique_ptr<CPUAllocator> replacement(alloc);
+  if (g_cpu_allocator->HasAllocated()) {
+    LOG(WARNING) << "Keeping the current CPU allocator, since it may have "
+                 << "handed out blocks already.";
+    return false;
+  }
+  g_cpu_allocator = std::move(replacement);
+  return true;
+}
+
+constexpr size_t NUMACPUAllocator::kMinNUMABytes;
+
+void* NUMACPUAllocator::New(size_t nbytes) {
+  bool zeroed = false;
+  void* data = Allocate(nbytes, &zeroed);
+  if (!zeroed) {
+    memset(data, 0, nbytes);
+  }
+  return data;
+}
+
+void* NUMACPUAllocator::NewUninitialized(size_t nbytes) {
+  bool zeroed = false;
+  void* data = Allocate(nbytes, &zeroed);
+  DebugFillUninitialized(data, nbytes);
+  return data;
+}
+
+void NUMACPUAllocator::Delete(void* data) {
+  if (!data) {
+    return;
+  }
+  char* block = static_cast<char*>(data) - gCaffe2Alignment;
+  const size_t numa_bytes = *reinterpret_cast<size_t*>(block);
+  if (numa_bytes) {
+    NUMAFree(block, numa_bytes);
+  } else {
+    free(block);
+  }
+}
+
+// Every block starts with the size of its NUMA mapping, or 0 if it comes from
+// the heap, padded to keep the data aligned.
+void* NUMACPUAllocator::Allocate(size_t nbytes, bool* zeroed) {
+  if (!allocated_.load(std::memory_order_relaxed)) {
+    allocated_.store(true, std::memory_order_relaxed);
+  }
+  const size_t bytes = nbytes + gCaffe2Alignment;
+  void* block = nullptr;
+  size_t numa_bytes = 0;
+  const int numa_node_id = GetCurrentNUMANode();
+  if (numa_node_id >= 0 && bytes >= kMinNUMABytes) {
+    block = NUMAAlloc(bytes, numa_node_id);
+    if (block) {
+      numa_bytes = bytes;
+      *zeroed = true;
+    }
+  }
+  if (!block) {
+#ifdef __ANDROID__
+    block = memalign(gCaffe2Alignment, bytes);
+#else
+    CHECK_EQ(posix_memalign(&block, gCaffe2Alignment, bytes), 0);
+#endif
+  }
+  *static_cast<size_t*>(block) = numa_bytes;
+  return static_cast<char*>(block) + gCaffe2Alignment;
+}
+
+namespace {
+
+// Only replaces the default allocator, so that the caching CPU allocator wins
+// if both are asked for, and only if none of its blocks, which have no header,
+// is still handed out.
+bool Caffe2SetNUMACPUAllocator(int*, char***) {
+  if (IsNUMAEnabled() &&
+      dynamic_cast<DefaultCPUAllocator*>(GetCPUAllocator()) &&
+      ReplaceCPUAllocator(new NUMACPUAllocator())) {
+    VLOG(1) << "Using the NUMA CPU allocator.";
+  }
+  return true;
+}
+
+}  // namespace
+
+REGISTER_CAFFE2_INIT_FUNCTION(
+    Caffe2SetNUMACPUAllocator,
+    &Caffe2SetNUMACPUAllocator,
+    "Install the NUMA CPU allocator if NUMA is enabled.");
+
 }  // namespace caffe2
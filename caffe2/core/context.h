@@ -1,42 +1,111 @@
 #ifndef CAFFE2_CORE_CONTEXT_H_
 #define CAFFE2_CORE_CONTEXT_H_
 
+#include <atomic>
 #include <ctime>
 #include <cstdlib>
 #include <random>
 
+#include "caffe2/core/flags.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/profiler.h"
 #include "caffe2/core/typeid.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/math.h"
 
+CAFFE2_DECLARE_bool(caffe2_cpu_allocator_debug_fill);
+
 namespace caffe2 {
 
 // Use 32-byte alignment should be enough for computation up to AVX512.
 constexpr size_t gCaffe2Alignment = 32;
 
+// Fills memory that is handed out uninitialized with a pattern that reads as
+// NaN for floating point types if --caffe2_cpu_allocator_debug_fill is set, so
+// that reads of uninitialized memory show up in the results.
+inline void DebugFillUninitialized(void* data, size_t nbytes) {
+  if (FLAGS_caffe2_cpu_allocator_debug_fill) {
+    memset(data, 0xff, nbytes);
+  }
+}
+
 // A virtual allocator class to do memory allocation and deallocation.
 struct CPUAllocator {
   CPUAllocator() {}
   virtual ~CPUAllocator() {}
   virtual void* New(size_t nbytes) = 0;
+  // Allocates memory whose content is left unspecified, for callers that
+  // overwrite all of it. Allocators that zero-fill in New() should skip it
+  // here.
+  virtual void* NewUninitialized(size_t nbytes) {
+    return New(nbytes);
+  }
   virtual void Delete(void* data) = 0;
+  // Returns whether the allocator may have handed out blocks, which another
+  // allocator could not delete. Allocators that do not track it say so.
+  virtual bool HasAllocated() const {
+    return true;
+  }
 };
 
 struct DefaultCPUAllocator final : CPUAllocator {
   DefaultCPUAllocator() {}
   ~DefaultCPUAllocator() {}
   void* New(size_t nbytes) override {
+    void* data = Allocate(nbytes);
+    memset(data, 0, nbytes);
+    return data;
+  }
+  void* NewUninitialized(size_t nbytes) override {
+    void* data = Allocate(nbytes);
+    DebugFillUninitialized(data, nbytes);
+    return data;
+  }
+  void Delete(void* data) override { free(data); }
+  bool HasAllocated() const override {
+    return allocated_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void* Allocate(size_t nbytes) {
+    // Only the first allocation writes the flag, so that it is not contended.
+    if (!allocated_.load(std::memory_order_relaxed)) {
+      allocated_.store(true, std::memory_order_relaxed);
+    }
     void* data = nullptr;
 #ifdef __ANDROID__
     data = memalign(gCaffe2Alignment, nbytes);
 #else
     CHECK_EQ(posix_memalign(&data, gCaffe2Alignment, nbytes), 0);
 #endif
-    memset(data, 0, nbytes);
     return data;
   }
-  void Delete(void* data) override { free(data); }
+
+  std::atomic<bool> allocated_{false};
+};
+
+// The CPU allocator installed in place of DefaultCPUAllocator when NUMA is
+// enabled. Threads bound to a NUMA node with NUMABind() allocate blocks of at
+// least kMinNUMABytes with a mapping of their own on that node. Smaller blocks
+// come from the heap, where the node the thread prefers gets the pages it
+// touches first.
+struct NUMACPUAllocator final : CPUAllocator {
+  NUMACPUAllocator() {}
+  ~NUMACPUAllocator() {}
+  void* New(size_t nbytes) override;
+  void* NewUninitialized(size_t nbytes) override;
+  void Delete(void* data) override;
+  bool HasAllocated() const override {
+    return allocated_.load(std::memory_order_relaxed);
+  }
+
+  static constexpr size_t kMinNUMABytes = 1 << 20;
+
+ private:
+  void* Allocate(size_t nbytes, bool* zeroed);
+
+  std::atomic<bool> allocated_{false};
 };
 
 // Get the CPU Alloctor.
@@ -44,6 +113,11 @@ CPUAllocator* GetCPUAllocator();
 // Sets the CPU allocator to the given allocator: the caller gives away the
 // ownership of the pointer.
 void SetCPUAllocator(CPUAllocator* alloc);
+// Sets the CPU allocator to the given allocator from an init function, unless
+// the current allocator may have handed out blocks, which the given allocator
+// could not delete. Returns whether the allocator was set; the caller gives
+// away the ownership of the pointer either way.
+bool ReplaceCPUAllocator(CPUAllocator* alloc);
 
 /**
  * The CPU Context, representing the bare minimum of what a Context class in
@@ -67,6 +141,8 @@ void SetCPUAllocator(CPUAllocator* alloc);
  *     carries out a stream synchronization and spots potential errors for
  *     the cuda kernel calls.
  * - static void* New(size_t nbytes): allocates memory.
+ * - static void* NewUninitialized(size_t nbytes): allocates memory that the
+ *     caller fully overwrites, allowing the context to skip initializing it.
  * - static void Delete(void* data): deletes memory.
  * - template <class SrcContext, class DstContext> void CopyBytes(...): does
  *     cross context memory copy.
@@ -84,13 +160,19 @@ class CPUContext final {
   explicit CPUContext(const DeviceOption& option)
       : random_seed_(
             option.has_random_seed() ? option.random_seed()
-                                     : math::randomNumberSeed()) {
+                                     : math::randomNumberSeed()),
+        numa_node_id_(option.has_numa_node_id() ? option.numa_node_id() : -1) {
     CHECK_EQ(option.device_type(), CPU);
   }
 
   ~CPUContext() {}
 
-  inline void SwitchToDevice() {}
+  // Pins the calling thread to the NUMA node of the device option, if any.
+  inline void SwitchToDevice() {
+    if (numa_node_id_ >= 0) {
+      NUMABind(numa_node_id_);
+    }
+  }
   inline bool FinishDeviceComputation() { return true; }
 
   inline std::mt19937& RandGenerator() {
@@ -101,8 +183,17 @@ class CPUContext final {
   }
 
   inline static void* New(size_t nbytes) {
+    if (Profiler::IsEnabled()) {
+      Profiler::CountAllocation(nbytes);
+    }
     return GetCPUAllocator()->New(nbytes);
   }
+  inline static void* NewUninitialized(size_t nbytes) {
+    if (Profiler::IsEnabled()) {
+      Profiler::CountAllocation(nbytes);
+    }
+    return GetCPUAllocator()->NewUninitialized(nbytes);
+  }
   inline static void Delete(void* data) { GetCPUAllocator()->Delete(data); }
 
   // Two copy functions that deals with cross-device copies.
@@ -136,6 +227,7 @@ class CPUContext final {
   // TODO(jiayq): instead of hard-coding a generator, make it more flexible.
   int random_seed_{1701};
   std::unique_ptr<std::mt19937> random_generator_;
+  int numa_node_id_{-1};
 };
 
 template<>
@@ -144,6 +236,14 @@ inline void CPUContext::CopyBytes<CPUContext, CPUContext>(
   memcpy(dst, src, nbytes);
 }
 
+// Returns the device option of the memory at ptr, allocated by Context, which
+// a context has to be created from to work on that memory outside of an
+// operator, as tensors copying their shared storage do.
+template <class Context>
+inline DeviceOption GetDeviceOptionForPointer(const void* ptr) {
+  return DeviceOption();
+}
+
 }  // namespace caffe2
 
 #endif  // CAFFE2_CORE_CONTEXT_H_
@@ -172,6 +172,11 @@ class CUDAContext final {
 
   static void* New(size_t nbytes);
 
+  // GPU memory is never initialized on allocation.
+  inline static void* NewUninitialized(size_t nbytes) {
+    return New(nbytes);
+  }
+
   static void Delete(void* data);
 
   template <class SrcContext, class DstContext>
@@ -220,6 +225,14 @@ inline void CPUContext::CopyBytes<CPUContext, CUDAContext>(
   context.CopyBytes<CPUContext, CUDAContext>(nbytes, src, dst);
 }
 
+template <>
+inline DeviceOption GetDeviceOptionForPointer<CUDAContext>(const void* ptr) {
+  DeviceOption option;
+  option.set_device_type(CUDA);
+  option.set_cuda_gpu_id(GetGPUIDForPointer(ptr));
+  return option;
+}
+
 // For simplicity, we will typedef Tensor<CPUContext> to TensorCPU.
 typedef Tensor<CUDAContext> TensorCUDA;
 
@@ -0,0 +1,72 @@
+#include "caffe2/core/dirty_rows.h"
+
+namespace caffe2 {
+
+void DirtyRows::Resize(TIndex num_rows) {
+  // The number of rows of a parameter only changes if it is reshaped, which
+  // voids the rows marked so far: they are all kept dirty.
+  if (num_rows == num_rows_) {
+    return;
+  }
+  const bool all_dirty = num_rows_ > 0;
+  num_rows_ = num_rows;
+  words_.assign((num_rows + 63) / 64, all_dirty ? ~uint64_t(0) : 0);
+  if (all_dirty && num_rows % 64) {
+    words_.back() = (uint64_t(1) << (num_rows % 64)) - 1;
+  }
+}
+
+std::vector<std::pair<TIndex, TIndex>> DirtyRows::TakeRanges() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<std::pair<TIndex, TIndex>> ranges;
+  TIndex begin = -1;
+  for (TIndex w = 0; w < words_.size(); ++w) {
+    uint64_t word = words_[w];
+    words_[w] = 0;
+    // Skip the words that do not end or start a range.
+    if ((begin >= 0 && word == ~uint64_t(0)) || (begin < 0 && word == 0)) {
+      continue;
+    }
+    for (int bit = 0; bit < 64; ++bit) {
+      const bool dirty = (word >> bit) & 1;
+      const TIndex row = w * 64 + bit;
+      if (dirty && begin < 0) {
+        begin = row;
+      } else if (!dirty && begin >= 0) {
+        ranges.emplace_back(begin, row);
+        begin = -1;
+      }
+    }
+  }
+  if (begin >= 0) {
+    ranges.emplace_back(begin, num_rows_);
+  }
+  return ranges;
+}
+
+void DirtyRows::MarkRanges(
+    const std::vector<std::pair<TIndex, TIndex>>& ranges,
+    TIndex num_rows) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Resize(num_rows);
+  for (const auto& range : ranges) {
+    CAFFE_ENFORCE(
+        0 <= range.first && range.first <= range.second &&
+            range.second <= num_rows_,
+        "Dirty rows ",
+        range.first,
+        " to ",
+        range.second,
+        " out of range 0 to ",
+        num_rows_);
+    for (TIndex row = range.first; row < range.second; ++row) {
+      words_[row / 64] |= uint64_t(1) << (row % 64);
+    }
+  }
+}
+
+std::string DirtyRowsBlobName(const std::string& name) {
+  return name + "_dirty_rows";
+}
+
+}  // namespace caffe2
@@ -0,0 +1,77 @@
+#ifndef CAFFE2_CORE_DIRTY_ROWS_H_
+#define CAFFE2_CORE_DIRTY_ROWS_H_
+
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+/**
+ * @brief The rows of a tensor written since they were last taken.
+ *
+ * Sparse optimizers with the track_dirty_rows argument mark the rows of the
+ * parameters they update, and the Snapshot operator takes them to save only
+ * those rows in delta snapshots. The rows are the ones of the outer-most
+ * dimension of the parameter, of which num_rows() is recorded: a tensor that
+ * is updated along with the parameter, such as the history of an optimizer,
+ * has its items split into as many rows. A DirtyRows may be marked and taken
+ * from different threads.
+ */
+class DirtyRows {
+ public:
+  DirtyRows() {}
+
+  template <typename SIndex>
+  void Mark(const SIndex* rows, TIndex n, TIndex num_rows) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Resize(num_rows);
+    for (TIndex i = 0; i < n; ++i) {
+      const TIndex row = rows[i];
+      CAFFE_ENFORCE(
+          0 <= row && row < num_rows_,
+          "Dirty row ",
+          row,
+          " out of range 0 to ",
+          num_rows_);
+      words_[row / 64] |= uint64_t(1) << (row % 64);
+    }
+  }
+
+  // Returns the number of rows of the tensor the rows are marked for.
+  TIndex num_rows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return num_rows_;
+  }
+
+  // Returns the sorted, disjoint ranges [begin, end) of the rows marked since
+  // the last call, and clears them.
+  std::vector<std::pair<TIndex, TIndex>> TakeRanges();
+
+  // Marks the rows of ranges taken by TakeRanges() again, e.g. when they could
+  // not be saved.
+  void MarkRanges(
+      const std::vector<std::pair<TIndex, TIndex>>& ranges,
+      TIndex num_rows);
+
+ private:
+  void Resize(TIndex num_rows);
+
+  mutable std::mutex mutex_;
+  TIndex num_rows_ = 0;
+  std::vector<uint64_t> words_;
+
+  DISABLE_COPY_AND_ASSIGN(DirtyRows);
+};
+
+// The name of the blob holding the DirtyRows of the tensor of the given blob.
+std::string DirtyRowsBlobName(const std::string& name);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_DIRTY_ROWS_H_
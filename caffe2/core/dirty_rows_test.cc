@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "caffe2/core/dirty_rows.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+typedef std::vector<std::pair<TIndex, TIndex>> Ranges;
+
+TEST(DirtyRowsTest, TakeRanges) {
+  DirtyRows rows;
+  EXPECT_EQ(rows.num_rows(), 0);
+  EXPECT_EQ(rows.TakeRanges(), Ranges());
+  const int indices[] = {3, 1, 2, 70, 150, 64, 63, 2};
+  rows.Mark(indices, 8, 200);
+  EXPECT_EQ(rows.num_rows(), 200);
+  EXPECT_EQ(rows.TakeRanges(), (Ranges{{1, 4}, {63, 65}, {70, 71}, {150, 151}}));
+  // The rows are cleared once taken.
+  EXPECT_EQ(rows.TakeRanges(), Ranges());
+}
+
+TEST(DirtyRowsTest, RangesAcrossWords) {
+  DirtyRows rows;
+  std::vector<int64_t> indices;
+  for (int64_t i = 10; i < 190; ++i) {
+    indices.push_back(i);
+  }
+  indices.push_back(199);
+  rows.Mark(indices.data(), indices.size(), 200);
+  EXPECT_EQ(rows.TakeRanges(), (Ranges{{10, 190}, {199, 200}}));
+}
+
+TEST(DirtyRowsTest, ResizeMarksAllRows) {
+  DirtyRows rows;
+  const int index = 5;
+  rows.Mark(&index, 1, 10);
+  rows.TakeRanges();
+  rows.Mark(&index, 1, 70);
+  EXPECT_EQ(rows.num_rows(), 70);
+  EXPECT_EQ(rows.TakeRanges(), (Ranges{{0, 70}}));
+}
+
+TEST(DirtyRowsTest, MarkRanges) {
+  DirtyRows rows;
+  const int index = 100;
+  rows.Mark(&index, 1, 200);
+  auto ranges = rows.TakeRanges();
+  rows.Mark(&index, 1, 200);
+  const int other = 5;
+  rows.Mark(&other, 1, 200);
+  rows.MarkRanges(ranges, 200);
+  rows.MarkRanges(Ranges{{60, 70}}, 200);
+  EXPECT_EQ(rows.TakeRanges(), (Ranges{{5, 6}, {60, 70}, {100, 101}}));
+  EXPECT_THROW(rows.MarkRanges(Ranges{{190, 201}}, 200), EnforceNotMet);
+}
+
+TEST(DirtyRowsTest, OutOfRange) {
+  DirtyRows rows;
+  const int index = 10;
+  EXPECT_THROW(rows.Mark(&index, 1, 10), EnforceNotMet);
+}
+
+}  // namespace
+
+}  // namespace caffe2
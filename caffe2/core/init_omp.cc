@@ -9,6 +9,7 @@
 #endif // CAFFE2_USE_MKL
 
 #include "caffe2/core/init.h"
+#include "caffe2/core/numa.h"
 
 CAFFE2_DEFINE_int(
     caffe2_omp_num_threads, 0,
@@ -38,6 +39,12 @@ bool Caffe2SetOpenMPThreads(int*, char***) {
   }
   LOG(INFO) << "Caffe2 running with " << omp_get_max_threads()
             << " OMP threads";
+  // The OpenMP threads are spawned by the threads running the operators, and
+  // inherit the NUMA node they are pinned to, unless OpenMP binds them itself.
+  if (IsNUMAEnabled() && getenv("OMP_PROC_BIND")) {
+    LOG(WARNING) << "OMP_PROC_BIND is set: OpenMP threads may run on other "
+                 << "NUMA nodes than the operators spawning them.";
+  }
   return true;
 }
 REGISTER_CAFFE2_INIT_FUNCTION(Caffe2SetOpenMPThreads,
@@ -0,0 +1,170 @@
+#include "caffe2/core/mapped_tensors.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/types.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+namespace {
+
+// The file starts with the magic, then the size of the index as a uint64, and
+// the index, a serialized TensorProtos without data. The data of the first
+// tensor starts at the first page boundary after the index.
+constexpr char kMagic[8] = {'C', '2', 'M', 'M', 'A', 'P', '0', '1'};
+constexpr size_t kHeaderSize = sizeof(kMagic) + sizeof(uint64_t);
+constexpr size_t kDataAlignment = 4096;
+constexpr size_t kTensorAlignment = 64;
+
+size_t RoundUp(size_t bytes, size_t multiple) {
+  return (bytes + multiple - 1) / multiple * multiple;
+}
+
+size_t TensorBytes(const TensorProto& proto) {
+  size_t size = 1;
+  for (const auto dim : proto.dims()) {
+    size *= dim;
+  }
+  return size * DataTypeToTypeMeta(proto.data_type()).itemsize();
+}
+
+// Returns the offsets of the data of the tensors in the file, followed by the
+// size of the file.
+vector<size_t> DataOffsets(size_t index_size, const TensorProtos& index) {
+  vector<size_t> offsets;
+  size_t offset = RoundUp(kHeaderSize + index_size, kDataAlignment);
+  for (const auto& proto : index.protos()) {
+    offsets.push_back(offset);
+    offset = RoundUp(offset + TensorBytes(proto), kTensorAlignment);
+  }
+  offsets.push_back(offset);
+  return offsets;
+}
+
+}  // namespace
+
+void SaveMappableTensors(
+    const string& filename,
+    const vector<string>& names,
+    const vector<const TensorCPU*>& tensors) {
+  CAFFE_ENFORCE(names.size() == tensors.size());
+  TensorProtos index;
+  for (int i = 0; i < tensors.size(); ++i) {
+    const TensorCPU& tensor = *tensors[i];
+    CAFFE_ENFORCE(
+        tensor.meta().id() && !tensor.meta().ctor(),
+        "Tensor ",
+        names[i],
+        " of type ",
+        tensor.meta().name(),
+        " cannot be mapped.");
+    auto* proto = index.add_protos();
+    proto->set_name(names[i]);
+    for (const auto dim : tensor.dims()) {
+      proto->add_dims(dim);
+    }
+    proto->set_data_type(TypeMetaToDataType(tensor.meta()));
+    CAFFE_ENFORCE(
+        proto->data_type() != TensorProto::UNDEFINED,
+        "Tensor ",
+        names[i],
+        " of type ",
+        tensor.meta().name(),
+        " cannot be mapped.");
+  }
+  string serialized_index;
+  CAFFE_ENFORCE(index.SerializeToString(&serialized_index));
+  const vector<size_t> offsets =
+      DataOffsets(serialized_index.size(), index);
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  CAFFE_ENFORCE(out.good(), "Cannot open ", filename, " for writing.");
+  const uint64_t index_size = serialized_index.size();
+  out.write(kMagic, sizeof(kMagic));
+  out.write(reinterpret_cast<const char*>(&index_size), sizeof(index_size));
+  out.write(serialized_index.data(), serialized_index.size());
+  size_t written = kHeaderSize + serialized_index.size();
+  const vector<char> padding(kDataAlignment, 0);
+  for (int i = 0; i < tensors.size(); ++i) {
+    out.write(padding.data(), offsets[i] - written);
+    if (tensors[i]->size() > 0) {
+      out.write(
+          static_cast<const char*>(tensors[i]->raw_data()),
+          tensors[i]->nbytes());
+    }
+    written = offsets[i] + tensors[i]->nbytes();
+  }
+  out.write(padding.data(), offsets.back() - written);
+  CAFFE_ENFORCE(out.good(), "Failed to write ", filename);
+}
+
+MappedTensors::MappedTensors(const string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CAFFE_ENFORCE(fd >= 0, "Cannot open ", filename);
+  struct stat st;
+  CAFFE_ENFORCE(fstat(fd, &st) == 0, "Cannot stat ", filename);
+  const size_t file_size = st.st_size;
+  void* data = file_size >= kHeaderSize
+      ? mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+      : MAP_FAILED;
+  close(fd);
+  CAFFE_ENFORCE(data != MAP_FAILED, "Cannot map ", filename);
+  mapping_.reset(data, [file_size](void* ptr) { munmap(ptr, file_size); });
+
+  const char* bytes = static_cast<const char*>(data);
+  CAFFE_ENFORCE(
+      memcmp(bytes, kMagic, sizeof(kMagic)) == 0,
+      filename,
+      " was not written by SaveMappableTensors().");
+  uint64_t index_size;
+  memcpy(&index_size, bytes + sizeof(kMagic), sizeof(index_size));
+  CAFFE_ENFORCE(kHeaderSize + index_size <= file_size, "Truncated index.");
+  TensorProtos index;
+  CAFFE_ENFORCE(
+      index.ParseFromArray(bytes + kHeaderSize, index_size),
+      "Corrupted index in ",
+      filename);
+  const vector<size_t> offsets = DataOffsets(index_size, index);
+  CAFFE_ENFORCE(
+      offsets.back() <= file_size, filename, " is truncated.");
+  for (int i = 0; i < index.protos_size(); ++i) {
+    const auto& proto = index.protos(i);
+    entries_[proto.name()] = Entry{
+        vector<TIndex>(proto.dims().begin(), proto.dims().end()),
+        DataTypeToTypeMeta(proto.data_type()),
+        offsets[i]};
+  }
+}
+
+vector<string> MappedTensors::Names() const {
+  vector<string> names;
+  for (const auto& entry : entries_) {
+    names.push_back(entry.first);
+  }
+  return names;
+}
+
+void MappedTensors::ShareTensor(const string& name, TensorCPU* tensor) const {
+  auto it = entries_.find(name);
+  CAFFE_ENFORCE(it != entries_.end(), "Tensor ", name, " is not mapped.");
+  const Entry& entry = it->second;
+  tensor->Resize(entry.dims);
+  if (tensor->size() == 0) {
+    tensor->raw_mutable_data(entry.meta);
+    return;
+  }
+  tensor->ShareExternalPointer(
+      std::shared_ptr<void>(
+          mapping_, static_cast<char*>(mapping_.get()) + entry.offset),
+      entry.meta);
+}
+
+}  // namespace caffe2
@@ -0,0 +1,64 @@
+#ifndef CAFFE2_CORE_MAPPED_TENSORS_H_
+#define CAFFE2_CORE_MAPPED_TENSORS_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/tensor.h"
+
+namespace caffe2 {
+
+// The db_type with which the Load and Save operators read and write the files
+// of SaveMappableTensors() instead of a db.
+constexpr char kMappedTensorsDBType[] = "mmap";
+
+/**
+ * Saves CPU tensors of fundamental types to a file in a raw layout, which
+ * MappedTensors maps without parsing or copying the data. The file starts with
+ * an index of the names, shapes and types of the tensors, followed by their
+ * data, each aligned to a cache line. The data is stored in the byte order of
+ * the machine.
+ */
+void SaveMappableTensors(
+    const string& filename,
+    const vector<string>& names,
+    const vector<const TensorCPU*>& tensors);
+
+/**
+ * @brief A file written by SaveMappableTensors(), mapped in memory.
+ *
+ * Tensors sharing the mapped data keep the mapping alive. The file is mapped
+ * privately: all the processes mapping it share the same page cache copy of
+ * its pages until they write them, in which case they get their own copy of
+ * the pages they write and the file is left unchanged.
+ */
+class MappedTensors {
+ public:
+  explicit MappedTensors(const string& filename);
+
+  vector<string> Names() const;
+  bool Has(const string& name) const {
+    return entries_.count(name);
+  }
+  // Makes the tensor share the mapped data of the tensor of the given name.
+  void ShareTensor(const string& name, TensorCPU* tensor) const;
+
+ private:
+  struct Entry {
+    vector<TIndex> dims;
+    TypeMeta meta;
+    size_t offset;
+  };
+
+  std::shared_ptr<void> mapping_;
+  std::map<string, Entry> entries_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedTensors);
+};
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_MAPPED_TENSORS_H_
@@ -0,0 +1,108 @@
+#include <cstdio>
+#include <memory>
+
+#include "caffe2/core/mapped_tensors.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+void FillTensor(TensorCPU* tensor, const vector<TIndex>& dims) {
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    data[i] = i;
+  }
+}
+
+}  // namespace
+
+TEST(MappedTensorsTest, SaveAndMap) {
+  const string filename = std::tmpnam(nullptr);
+  TensorCPU weights;
+  FillTensor(&weights, {3, 5});
+  TensorCPU ids(vector<int>{7});
+  for (int i = 0; i < ids.size(); ++i) {
+    ids.mutable_data<int64_t>()[i] = -i;
+  }
+  TensorCPU empty(vector<int>{0, 4});
+  empty.mutable_data<double>();
+  SaveMappableTensors(
+      filename, {"weights", "ids", "empty"}, {&weights, &ids, &empty});
+
+  TensorCPU mapped_weights;
+  TensorCPU mapped_ids;
+  TensorCPU mapped_empty;
+  {
+    MappedTensors mapped(filename);
+    EXPECT_EQ(mapped.Names(), (vector<string>{"empty", "ids", "weights"}));
+    EXPECT_FALSE(mapped.Has("bias"));
+    mapped.ShareTensor("weights", &mapped_weights);
+    mapped.ShareTensor("ids", &mapped_ids);
+    mapped.ShareTensor("empty", &mapped_empty);
+    EXPECT_THROW(mapped.ShareTensor("bias", &mapped_weights), EnforceNotMet);
+  }
+  // The tensors keep the mapping alive.
+  EXPECT_EQ(mapped_weights.dims(), weights.dims());
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(mapped_weights.raw_data()) % 64, 0);
+  for (int i = 0; i < weights.size(); ++i) {
+    EXPECT_EQ(mapped_weights.data<float>()[i], i);
+  }
+  for (int i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(mapped_ids.data<int64_t>()[i], -i);
+  }
+  EXPECT_EQ(mapped_empty.dims(), empty.dims());
+  EXPECT_TRUE(mapped_empty.IsType<double>());
+
+  // Writing a mapped tensor does not change the file.
+  mapped_weights.mutable_data<float>()[0] = 42;
+  MappedTensors mapped(filename);
+  TensorCPU remapped_weights;
+  mapped.ShareTensor("weights", &remapped_weights);
+  EXPECT_EQ(remapped_weights.data<float>()[0], 0);
+  std::remove(filename.c_str());
+}
+
+TEST(MappedTensorsTest, LoadAndSaveOperators) {
+  const string filename = std::tmpnam(nullptr);
+  Workspace ws;
+  FillTensor(ws.CreateBlob("w")->GetMutable<TensorCPU>(), {4, 4});
+  FillTensor(ws.CreateBlob("b")->GetMutable<TensorCPU>(), {4});
+
+  OperatorDef save_def;
+  save_def.set_type("Save");
+  save_def.add_input("w");
+  save_def.add_input("b");
+  auto* arg = save_def.add_arg();
+  arg->set_name("db");
+  arg->set_s(filename);
+  arg = save_def.add_arg();
+  arg->set_name("db_type");
+  arg->set_s(kMappedTensorsDBType);
+  arg = save_def.add_arg();
+  arg->set_name("absolute_path");
+  arg->set_i(1);
+  EXPECT_TRUE(ws.RunOperatorOnce(save_def));
+
+  Workspace load_ws;
+  OperatorDef load_def(save_def);
+  load_def.set_type("Load");
+  load_def.clear_input();
+  load_def.add_output("b");
+  load_def.add_output("w");
+  EXPECT_TRUE(load_ws.RunOperatorOnce(load_def));
+  const auto& w = load_ws.GetBlob("w")->Get<TensorCPU>();
+  const auto& b = load_ws.GetBlob("b")->Get<TensorCPU>();
+  EXPECT_EQ(w.dims(), (vector<TIndex>{4, 4}));
+  EXPECT_EQ(b.dims(), vector<TIndex>{4});
+  EXPECT_EQ(w.data<float>()[15], 15);
+  EXPECT_EQ(b.data<float>()[3], 3);
+  std::remove(filename.c_str());
+}
+
+}  // namespace caffe2
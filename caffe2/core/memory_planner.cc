@@ -0,0 +1,280 @@
+#include "caffe2/core/memory_planner.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator_schema.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+struct BlobLifetime {
+  // The first operator accessing the blob, and whether it writes it.
+  int first_access = -1;
+  bool first_access_is_write = false;
+  // All the operators accessing the blob, in increasing order.
+  vector<int> accesses;
+  // The operators writing the blob, in increasing order.
+  vector<int> writers;
+  DeviceOption device;
+};
+
+struct SharedBlob {
+  string name;
+  DeviceOption device;
+  // The accesses to the blob currently occupying the shared blob.
+  vector<int> accesses;
+  vector<string> members;
+};
+
+bool SameDevice(const DeviceOption& lhs, const DeviceOption& rhs) {
+  return lhs.device_type() == rhs.device_type() &&
+      lhs.cuda_gpu_id() == rhs.cuda_gpu_id();
+}
+
+// The blobs whose names have to be kept: the external inputs and outputs and
+// the persistent blobs of the net.
+std::set<string> PinnedBlobs(const NetDef& net_def) {
+  ArgumentHelper arg_helper(net_def);
+  std::set<string> pinned(
+      net_def.external_input().begin(), net_def.external_input().end());
+  pinned.insert(
+      net_def.external_output().begin(), net_def.external_output().end());
+  for (const auto& blob :
+       arg_helper.GetRepeatedArgument<string>("persistent_blobs")) {
+    pinned.insert(blob);
+  }
+  return pinned;
+}
+
+std::map<string, BlobLifetime> ComputeLifetimes(const NetDef& net_def) {
+  std::map<string, BlobLifetime> lifetimes;
+  auto access = [&](const string& blob, int idx, bool is_write) {
+    auto& lifetime = lifetimes[blob];
+    if (lifetime.first_access < 0) {
+      lifetime.first_access = idx;
+      lifetime.first_access_is_write = is_write;
+      const auto& op = net_def.op(idx);
+      lifetime.device = op.has_device_option() ? op.device_option()
+                                               : net_def.device_option();
+    }
+    if (lifetime.accesses.empty() || lifetime.accesses.back() != idx) {
+      lifetime.accesses.push_back(idx);
+    }
+    if (is_write &&
+        (lifetime.writers.empty() || lifetime.writers.back() != idx)) {
+      lifetime.writers.push_back(idx);
+    }
+  };
+  for (int idx = 0; idx < net_def.op_size(); ++idx) {
+    const auto& op = net_def.op(idx);
+    for (const auto& input : op.input()) {
+      access(input, idx, false);
+    }
+    for (const auto& input : op.control_input()) {
+      access(input, idx, false);
+    }
+    for (const auto& output : op.output()) {
+      access(output, idx, true);
+    }
+  }
+  return lifetimes;
+}
+
+// Intermediate blobs carry no value from a run to the next one and are not
+// visible outside of the net, so they can be renamed.
+bool IsIntermediate(
+    const string& blob,
+    const BlobLifetime& lifetime,
+    const std::set<string>& pinned,
+    const Workspace& ws) {
+  return lifetime.first_access_is_write && !pinned.count(blob) &&
+      !ws.HasBlob(blob);
+}
+
+bool IsSequential(const NetDef& net_def) {
+  return !net_def.has_type() || net_def.type() == "simple" ||
+      net_def.type() == "compiled";
+}
+
+void RenameBlobs(const std::map<string, string>& renames, NetDef* net_def) {
+  auto rename = [&](string* blob) {
+    auto it = renames.find(*blob);
+    if (it != renames.end()) {
+      *blob = it->second;
+    }
+  };
+  for (auto& op : *net_def->mutable_op()) {
+    for (auto& input : *op.mutable_input()) {
+      rename(&input);
+    }
+    for (auto& input : *op.mutable_control_input()) {
+      rename(&input);
+    }
+    for (auto& output : *op.mutable_output()) {
+      rename(&output);
+    }
+  }
+}
+
+}  // namespace
+
+NetDef PlanBlobReuse(const NetDef& net_def, const Workspace& ws) {
+  const auto pinned = PinnedBlobs(net_def);
+  auto lifetimes = ComputeLifetimes(net_def);
+  // The candidate blobs, by increasing first access.
+  vector<string> candidates;
+  for (int idx = 0; idx < net_def.op_size(); ++idx) {
+    for (const auto& output : net_def.op(idx).output()) {
+      const auto& lifetime = lifetimes[output];
+      if (lifetime.first_access == idx &&
+          IsIntermediate(output, lifetime, pinned, ws) &&
+          std::find(candidates.begin(), candidates.end(), output) ==
+              candidates.end()) {
+        candidates.push_back(output);
+      }
+    }
+  }
+
+  const bool sequential = IsSequential(net_def);
+  const auto parents = internal::computeOperatorParents(net_def);
+  internal::AncestryChecker ancestry(parents);
+  auto finished_before = [&](const vector<int>& accesses, int idx) {
+    if (accesses.back() >= idx) {
+      return false;
+    }
+    return sequential ||
+        std::all_of(accesses.begin(), accesses.end(), [&](int access) {
+             return ancestry.IsAncestor(access, idx);
+           });
+  };
+
+  vector<SharedBlob> shared_blobs;
+  for (const auto& blob : candidates) {
+    const auto& lifetime = lifetimes[blob];
+    auto it = std::find_if(
+        shared_blobs.begin(), shared_blobs.end(), [&](const SharedBlob& shared) {
+          return SameDevice(shared.device, lifetime.device) &&
+              finished_before(shared.accesses, lifetime.first_access);
+        });
+    if (it == shared_blobs.end()) {
+      shared_blobs.push_back(
+          SharedBlob{blob + "_shared", lifetime.device, {}, {}});
+      it = shared_blobs.end() - 1;
+    }
+    it->accesses = lifetime.accesses;
+    it->members.push_back(blob);
+  }
+
+  std::map<string, string> renames;
+  for (const auto& shared : shared_blobs) {
+    if (shared.members.size() < 2) {
+      continue;
+    }
+    CAFFE_ENFORCE(
+        !lifetimes.count(shared.name) && !ws.HasBlob(shared.name),
+        "Blob ",
+        shared.name,
+        " already exists, cannot use it as a shared blob.");
+    for (const auto& member : shared.members) {
+      renames[member] = shared.name;
+    }
+  }
+  VLOG(1) << "Planned " << candidates.size() << " intermediate blobs of net "
+          << net_def.name() << " into " << shared_blobs.size() << " blobs.";
+
+  NetDef planned(net_def);
+  RenameBlobs(renames, &planned);
+  return planned;
+}
+
+NetDef PlanInplace(const NetDef& net_def, const Workspace& ws) {
+  const auto pinned = PinnedBlobs(net_def);
+  const auto lifetimes = ComputeLifetimes(net_def);
+  const bool sequential = IsSequential(net_def);
+  const auto parents = internal::computeOperatorParents(net_def);
+  internal::AncestryChecker ancestry(parents);
+
+  // The outputs written in place, mapped to the blob they are written to.
+  std::map<string, string> renames;
+  auto renamed = [&](const string& blob) {
+    auto it = renames.find(blob);
+    return it == renames.end() ? blob : it->second;
+  };
+  // The accesses to the blobs that outputs are written to, including the
+  // accesses to these outputs.
+  std::map<string, vector<int>> merged_accesses;
+  auto accesses = [&](const string& blob) -> vector<int>& {
+    auto it = merged_accesses.find(blob);
+    if (it == merged_accesses.end()) {
+      it = merged_accesses.emplace(blob, lifetimes.at(blob).accesses).first;
+    }
+    return it->second;
+  };
+
+  for (int idx = 0; idx < net_def.op_size(); ++idx) {
+    const auto& op = net_def.op(idx);
+    const OpSchema* schema = OpSchemaRegistry::Schema(op.type());
+    if (!schema) {
+      continue;
+    }
+    vector<string> inputs;
+    for (const auto& input : op.input()) {
+      inputs.push_back(renamed(input));
+    }
+    vector<string> outputs;
+    for (const auto& output : op.output()) {
+      outputs.push_back(renamed(output));
+    }
+    for (int out_idx = 0; out_idx < op.output_size(); ++out_idx) {
+      const string& output = op.output(out_idx);
+      const auto& output_lifetime = lifetimes.at(output);
+      if (output_lifetime.first_access != idx ||
+          output_lifetime.writers.size() != 1 ||
+          !IsIntermediate(output, output_lifetime, pinned, ws) ||
+          std::count(outputs.begin(), outputs.end(), output) != 1) {
+        continue;
+      }
+      for (int in_idx = 0; in_idx < inputs.size(); ++in_idx) {
+        const string& input = inputs[in_idx];
+        if (!schema->inplace_allowed(in_idx, out_idx) ||
+            std::count(inputs.begin(), inputs.end(), input) != 1 ||
+            std::count(outputs.begin(), outputs.end(), input) != 0 ||
+            !IsIntermediate(input, lifetimes.at(input), pinned, ws)) {
+          continue;
+        }
+        auto& input_accesses = accesses(input);
+        if (input_accesses.back() != idx ||
+            !(sequential ||
+              std::all_of(
+                  input_accesses.begin(),
+                  input_accesses.end() - 1,
+                  [&](int access) {
+                    return ancestry.IsAncestor(access, idx);
+                  }))) {
+          continue;
+        }
+        VLOG(1) << "Writing " << output << " in place of " << input
+                << " in operator " << idx << " of net " << net_def.name();
+        renames[output] = input;
+        outputs[out_idx] = input;
+        input_accesses.insert(
+            input_accesses.end(),
+            output_lifetime.accesses.begin() + 1,
+            output_lifetime.accesses.end());
+        break;
+      }
+    }
+  }
+
+  NetDef planned(net_def);
+  RenameBlobs(renames, &planned);
+  return planned;
+}
+
+}  // namespace caffe2
@@ -0,0 +1,63 @@
+#ifndef CAFFE2_CORE_MEMORY_PLANNER_H_
+#define CAFFE2_CORE_MEMORY_PLANNER_H_
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+/**
+ * @brief Plans the reuse of the intermediate blobs of a net.
+ *
+ * Returns a copy of net_def in which intermediate blobs with disjoint
+ * lifetimes are renamed to a common shared blob, named after the first of
+ * them with a "_shared" suffix, so that their tensors reuse the same memory.
+ * The lifetime of a blob spans from the first operator that writes it to the
+ * last operator that accesses it.
+ *
+ * For nets that run their operators in order (simple and compiled nets), two
+ * lifetimes are disjoint if the first one ends at an earlier operator than the
+ * one the second one starts at. For the other nets, all the operators that
+ * access the first blob also have to be ancestors of the first writer of the
+ * second blob in the dependency graph, so that the plan is safe whatever the
+ * order in which independent operators run.
+ *
+ * A blob is intermediate, and can be shared, if
+ * - its first access is a write, i.e. it carries no value from a run to the
+ *   next one,
+ * - it is neither an external input nor an external output of the net,
+ * - it is not listed in the "persistent_blobs" argument of the net,
+ * - it does not exist in the workspace yet.
+ * Only blobs first written on the same device are shared.
+ *
+ * CreateNet() applies the plan to nets with the argument plan_blob_reuse=1.
+ */
+NetDef PlanBlobReuse(const NetDef& net_def, const Workspace& ws);
+
+/**
+ * @brief Plans the in-place execution of the operators of a net.
+ *
+ * Returns a copy of net_def in which the outputs of operators are renamed to
+ * one of their inputs, when the schema of the operator allows the pair to be
+ * in place and the input is dead once the operator ran. Chains of such
+ * operators, e.g. Relu after FC, or Dropout and Scale, then all write to the
+ * same blob.
+ *
+ * An output is renamed to an input if
+ * - both are intermediate blobs, as defined by PlanBlobReuse(),
+ * - the operator is the only one to write the output, and its first access,
+ * - the operator is the last one to access the input, and, for nets that do
+ *   not run their operators in order, all the other operators accessing the
+ *   input are ancestors of the operator in the dependency graph,
+ * - the input is not passed twice to the operator, nor already one of its
+ *   outputs.
+ *
+ * CreateNet() applies the plan to nets with the argument plan_inplace=1,
+ * before PlanBlobReuse() if plan_blob_reuse=1 is also set.
+ */
+NetDef PlanInplace(const NetDef& net_def, const Workspace& ws);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_MEMORY_PLANNER_H_
@@ -0,0 +1,283 @@
+#include "caffe2/core/memory_planner.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+class MemoryPlannerTestDummyOp final : public OperatorBase {
+ public:
+  using OperatorBase::OperatorBase;
+  bool Run() override {
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(MemoryPlannerTestDummy, MemoryPlannerTestDummyOp);
+OPERATOR_SCHEMA(MemoryPlannerTestDummy)
+    .NumInputs(0, INT_MAX)
+    .NumOutputs(0, INT_MAX);
+
+// Like an activation: its only output may be written in place of its input.
+REGISTER_CPU_OPERATOR(MemoryPlannerTestInplace, MemoryPlannerTestDummyOp);
+OPERATOR_SCHEMA(MemoryPlannerTestInplace)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}});
+
+// A linear net in -> a -> b -> c -> out, where a and c can share a blob.
+const char kLinearNet[] = R"DOC(
+  name: "linear"
+  external_input: "in"
+  external_output: "out"
+  op {
+    input: "in"
+    output: "a"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "a"
+    output: "b"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "b"
+    output: "c"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "c"
+    output: "out"
+    type: "MemoryPlannerTestDummy"
+  }
+)DOC";
+
+// Two branches: in -> a -> b, and in -> c, joined into out. c is written
+// after a is dead in op order, but may run at the same time as a in a DAG.
+const char kBranchNet[] = R"DOC(
+  name: "branch"
+  external_input: "in"
+  external_output: "out"
+  op {
+    input: "in"
+    output: "a"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "a"
+    output: "b"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "in"
+    output: "c"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "b"
+    input: "c"
+    output: "out"
+    type: "MemoryPlannerTestDummy"
+  }
+)DOC";
+
+// in -> a -> b -> c -> out, where b and c can be written in place of a.
+const char kActivationNet[] = R"DOC(
+  name: "activations"
+  external_input: "in"
+  external_output: "out"
+  op {
+    input: "in"
+    output: "a"
+    type: "MemoryPlannerTestDummy"
+  }
+  op {
+    input: "a"
+    output: "b"
+    type: "MemoryPlannerTestInplace"
+  }
+  op {
+    input: "b"
+    output: "c"
+    type: "MemoryPlannerTestInplace"
+  }
+  op {
+    input: "c"
+    output: "out"
+    type: "MemoryPlannerTestDummy"
+  }
+)DOC";
+
+NetDef ParseNet(const char* net_string) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(net_string), &net_def));
+  return net_def;
+}
+
+vector<string> Outputs(const NetDef& net_def) {
+  vector<string> outputs;
+  for (const auto& op : net_def.op()) {
+    outputs.insert(outputs.end(), op.output().begin(), op.output().end());
+  }
+  return outputs;
+}
+
+}  // namespace
+
+TEST(MemoryPlannerTest, LinearNet) {
+  Workspace ws;
+  auto planned = PlanBlobReuse(ParseNet(kLinearNet), ws);
+  EXPECT_EQ(
+      Outputs(planned), (vector<string>{"a_shared", "b", "a_shared", "out"}));
+  EXPECT_EQ(planned.op(1).input(0), "a_shared");
+  EXPECT_EQ(planned.op(3).input(0), "a_shared");
+}
+
+TEST(MemoryPlannerTest, RespectsPinnedBlobs) {
+  Workspace ws;
+  auto net_def = ParseNet(kLinearNet);
+  ws.CreateBlob("c");
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a", "b", "c", "out"}));
+
+  Workspace other_ws;
+  *net_def.add_arg() = MakeArgument<vector<string>>(
+      "persistent_blobs", vector<string>{"a"});
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, other_ws)),
+      (vector<string>{"a", "b", "c", "out"}));
+}
+
+TEST(MemoryPlannerTest, BlobsReadBeforeWrittenAreNotShared) {
+  Workspace ws;
+  auto net_def = ParseNet(kLinearNet);
+  // c is now read before it is written, so it carries a value across runs.
+  net_def.mutable_op(0)->add_input("c");
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a", "b", "c", "out"}));
+}
+
+TEST(MemoryPlannerTest, DAGNetsRespectParallelBranches) {
+  Workspace ws;
+  auto net_def = ParseNet(kBranchNet);
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a_shared", "b", "a_shared", "out"}));
+  net_def.set_type("dag");
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a", "b", "c", "out"}));
+  // Once c depends on b, a is dead by the time c is written.
+  net_def.mutable_op(2)->add_control_input("b");
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a_shared", "b", "a_shared", "out"}));
+}
+
+TEST(MemoryPlannerTest, OnlySharesOnTheSameDevice) {
+  Workspace ws;
+  auto net_def = ParseNet(kLinearNet);
+  net_def.mutable_op(2)->mutable_device_option()->set_device_type(CUDA);
+  EXPECT_EQ(
+      Outputs(PlanBlobReuse(net_def, ws)),
+      (vector<string>{"a", "b", "c", "out"}));
+}
+
+TEST(MemoryPlannerTest, CreateNetAppliesPlan) {
+  Workspace ws;
+  ws.CreateBlob("in");
+  auto net_def = ParseNet(kLinearNet);
+  *net_def.add_arg() = MakeArgument<int>("plan_blob_reuse", 1);
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net != nullptr);
+  EXPECT_TRUE(net->Run());
+  EXPECT_TRUE(ws.HasBlob("a_shared"));
+  EXPECT_FALSE(ws.HasBlob("a"));
+  EXPECT_FALSE(ws.HasBlob("c"));
+  EXPECT_TRUE(ws.HasBlob("out"));
+}
+
+TEST(MemoryPlannerTest, InplaceChain) {
+  Workspace ws;
+  auto planned = PlanInplace(ParseNet(kActivationNet), ws);
+  EXPECT_EQ(Outputs(planned), (vector<string>{"a", "a", "a", "out"}));
+  EXPECT_EQ(planned.op(2).input(0), "a");
+  EXPECT_EQ(planned.op(3).input(0), "a");
+}
+
+TEST(MemoryPlannerTest, InplaceNeedsDeadInput) {
+  Workspace ws;
+  auto net_def = ParseNet(kActivationNet);
+  // a is still read after b is written.
+  net_def.mutable_op(3)->add_input("a");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)), (vector<string>{"a", "b", "b", "out"}));
+
+  // Neither external outputs nor blobs of the workspace are renamed.
+  net_def = ParseNet(kActivationNet);
+  net_def.add_external_output("c");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)), (vector<string>{"a", "a", "c", "out"}));
+  ws.CreateBlob("a");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)), (vector<string>{"a", "b", "c", "out"}));
+
+  // Nor is the output of an operator whose schema does not allow it.
+  Workspace other_ws;
+  net_def = ParseNet(kActivationNet);
+  net_def.mutable_op(1)->set_type("MemoryPlannerTestDummy");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, other_ws)),
+      (vector<string>{"a", "b", "b", "out"}));
+}
+
+TEST(MemoryPlannerTest, InplaceInDAGNets) {
+  Workspace ws;
+  auto net_def = ParseNet(kActivationNet);
+  // A reader of a that comes before b in op order but may run after it in a
+  // DAG.
+  OperatorDef reader;
+  reader.set_type("MemoryPlannerTestDummy");
+  reader.add_input("a");
+  reader.add_output("d");
+  net_def.mutable_op()->AddAllocated(new OperatorDef(reader));
+  net_def.mutable_op()->SwapElements(1, 4);
+  net_def.mutable_op()->SwapElements(2, 4);
+  net_def.mutable_op()->SwapElements(3, 4);
+  net_def.mutable_op(4)->add_input("d");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)),
+      (vector<string>{"a", "d", "a", "a", "out"}));
+  net_def.set_type("dag");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)),
+      (vector<string>{"a", "d", "b", "b", "out"}));
+  // Once b waits for d, a is dead by the time b is written.
+  net_def.mutable_op(2)->add_control_input("d");
+  EXPECT_EQ(
+      Outputs(PlanInplace(net_def, ws)),
+      (vector<string>{"a", "d", "a", "a", "out"}));
+}
+
+TEST(MemoryPlannerTest, CreateNetAppliesInplacePlan) {
+  Workspace ws;
+  ws.CreateBlob("in");
+  auto net_def = ParseNet(kActivationNet);
+  *net_def.add_arg() = MakeArgument<int>("plan_inplace", 1);
+  *net_def.add_arg() = MakeArgument<int>("plan_blob_reuse", 1);
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net != nullptr);
+  EXPECT_TRUE(net->Run());
+  EXPECT_TRUE(ws.HasBlob("a"));
+  EXPECT_FALSE(ws.HasBlob("b"));
+  EXPECT_FALSE(ws.HasBlob("c"));
+  EXPECT_TRUE(ws.HasBlob("out"));
+}
+
+}  // namespace caffe2
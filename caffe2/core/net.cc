@@ -1,9 +1,12 @@
 #include "caffe2/core/net.h"
 
 #include <set>
-#include <unordered_set>
 
+#include "caffe2/core/memory_planner.h"
+#include "caffe2/core/numa.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/profiler.h"
+#include "caffe2/core/shape_inference.h"
 #include "caffe2/core/timer.h"
 #include "caffe2/proto/caffe2.pb.h"
 
@@ -11,6 +14,16 @@ CAFFE2_DEFINE_bool(
     caffe2_disable_chaining,
     true,
     "Disable chaining logic (some latent multi-device issues).");
+CAFFE2_DEFINE_bool(
+    caffe2_disable_cpu_chaining,
+    false,
+    "Disable chaining logic also for nets whose operators all run on CPU, "
+    "which use chaining by default.");
+CAFFE2_DEFINE_bool(
+    caffe2_net_use_worker_pool,
+    false,
+    "If true, DAG nets run on the worker pool of their workspace by default "
+    "instead of spawning their own workers.");
 
 namespace caffe2 {
 
@@ -23,24 +36,6 @@ bool sameDevice(const OperatorDef& lhs, const OperatorDef& rhs) {
 }
 
 using OpIndex = int;
-using Ancestry = std::vector<std::unordered_set<OpIndex>>;
-Ancestry computeAncestors(
-    const std::vector<internal::OperatorNode>& ops) {
-  Ancestry ancestors;
-  ancestors.resize(ops.size());
-  for (auto i = 0; i < ops.size(); ++i) {
-    const auto& parents = ops[i].parents_;
-    for (const auto parent : parents) {
-      ancestors[i].insert(parent);
-      for (const auto parent_ancestor : ancestors[parent]) {
-        ancestors[i].insert(parent_ancestor);
-      }
-    }
-    VLOG(2) << "Ancestors of op: " << i << ", "
-            << std::vector<OpIndex>(ancestors[i].begin(), ancestors[i].end());
-  }
-  return ancestors;
-}
 
 DAGNetBase::ExecutionChains singleChains(
     const std::vector<internal::OperatorNode>& nodes) {
@@ -53,15 +48,19 @@ DAGNetBase::ExecutionChains singleChains(
 
 DAGNetBase::ExecutionChains computeChains(
     const std::vector<internal::OperatorNode>& nodes) {
-  const auto& ancestry = computeAncestors(nodes);
+  std::vector<std::vector<OpIndex>> parents;
+  for (const auto& node : nodes) {
+    parents.push_back(node.parents_);
+  }
+  internal::AncestryChecker ancestry(parents);
 
   // Now, we compute the set of execution chains An execution chain is
   // a linear set of nodes that can be executed on a single stream
   // (e.g. a chain of single input, single output operators)
   DAGNetBase::ExecutionChains chains;
-  std::unordered_set<OpIndex> seen_nodes;
+  std::vector<bool> seen_nodes(nodes.size(), false);
   for (auto i = 0; i < nodes.size(); ++i) {
-    if (seen_nodes.find(i) != seen_nodes.end()) {
+    if (seen_nodes[i]) {
       // We've already executed this operator.
       continue;
     }
@@ -73,38 +72,35 @@ DAGNetBase::ExecutionChains computeChains(
       const auto current = chain.back();
       const auto& children = nodes[current].children_;
 
-      // Find children for which this current node is the *single*
-      // direct ancestor. If there are more than one, then we can't
-      // chain.
-      std::vector<OpIndex> candidates;
-      for (const auto child : children) {
-        std::vector<OpIndex> direct_parents;
-        const auto& parents = nodes[child].parents_;
-        for (const auto parent : parents) {
-          if (std::all_of(
-                  parents.begin(), parents.end(), [&](OpIndex other_parent) {
-                    // If `other_parent` contains `parent` in it's
-                    // ancestors, we can ignore `parent`.
-                    return !ancestry.at(other_parent).count(parent);
-                  })) {
-            direct_parents.push_back(parent);
-          }
-        }
-        if (direct_parents.size() == 1 && direct_parents.front() == current) {
-          candidates.push_back(child);
-        }
+      // The children of a chain are only notified once the whole chain has
+      // finished, so we stop at any node with other children than the next
+      // node of the chain: they would otherwise wait for the rest of the
+      // chain for no reason.
+      if (children.size() != 1) {
+        break;
       }
 
-      if (candidates.size() != 1) {
+      // Operators with asynchronous completion run on their own, so that they
+      // do not keep a worker busy with the rest of a chain.
+      const auto candidate = children.front();
+      if (nodes[current].operator_->HasAsyncCompletion() ||
+          nodes[candidate].operator_->HasAsyncCompletion()) {
         break;
       }
 
-      const auto candidate = candidates.front();
-      const auto parent = chain.back();
+      // We can only chain the child if the current node is its *single*
+      // direct ancestor. This is the case iff all the other parents of the
+      // child are ancestors of the current node.
+      const auto& parents = nodes[candidate].parents_;
+      if (!std::all_of(parents.begin(), parents.end(), [&](OpIndex parent) {
+            return parent == current || ancestry.IsAncestor(parent, current);
+          })) {
+        break;
+      }
 
       if (!sameDevice(
               nodes[candidate].operator_->def(),
-              nodes[parent].operator_->def())) {
+              nodes[current].operator_->def())) {
         break;
       }
 
@@ -112,23 +108,13 @@ DAGNetBase::ExecutionChains computeChains(
     };
 
     for (const auto node : chain) {
-      CAFFE_ENFORCE(
-          seen_nodes.insert(node).second,
-          "Node ",
-          node,
-          " is already in the net.");
+      CAFFE_ENFORCE(!seen_nodes[node], "Node ", node, " is already in the net.");
+      seen_nodes[node] = true;
     }
     CAFFE_ENFORCE(
         chains.insert({i, chain}).second, "Chain ", i, " was already added.");
     VLOG(2) << "Added chain: " << chain;
   }
-  CAFFE_ENFORCE(
-      seen_nodes.size() == nodes.size(),
-      "Haven't seen all the nodes, expected number of nodes ",
-      nodes.size(),
-      ", but seen only ",
-      seen_nodes.size(),
-      ".");
   return chains;
 }
 
@@ -171,7 +157,74 @@ NetBase::NetBase(const NetDef& def, Workspace* /* unused */)
       "net.");
 }
 
+namespace {
+
+// Makes the operators pinned to a NUMA node read the replica of their node of
+// the blobs that the net only reads, if the workspace has one. Returns whether
+// any input was renamed.
+bool UseNUMAReplicas(NetDef* net_def, const Workspace& ws) {
+  std::set<string> written;
+  for (const auto& op : net_def->op()) {
+    written.insert(op.output().begin(), op.output().end());
+  }
+  bool renamed = false;
+  for (auto& op : *net_def->mutable_op()) {
+    const auto& option = op.has_device_option() ? op.device_option()
+                                                : net_def->device_option();
+    if (option.device_type() != CPU || !option.has_numa_node_id()) {
+      continue;
+    }
+    for (auto& input : *op.mutable_input()) {
+      const string replica = NUMAReplicaBlobName(input, option.numa_node_id());
+      if (!written.count(input) && ws.HasBlob(replica)) {
+        input = replica;
+        renamed = true;
+      }
+    }
+  }
+  return renamed;
+}
+
+// Returns a copy of planned_def with the arguments of net_def but the given
+// one, so that a planning pass is not applied again.
+NetDef WithoutArgument(
+    NetDef planned_def,
+    const NetDef& net_def,
+    const string& name) {
+  planned_def.clear_arg();
+  for (const auto& arg : net_def.arg()) {
+    if (arg.name() != name) {
+      *planned_def.add_arg() = arg;
+    }
+  }
+  return planned_def;
+}
+
+}  // namespace
+
 unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws) {
+  if (IsNUMAEnabled()) {
+    NetDef numa_def(net_def);
+    if (UseNUMAReplicas(&numa_def, *ws)) {
+      return CreateNet(numa_def, ws);
+    }
+  }
+  if (ArgumentHelper(net_def).GetSingleArgument<bool>("plan_inplace", false)) {
+    return CreateNet(
+        WithoutArgument(PlanInplace(net_def, *ws), net_def, "plan_inplace"),
+        ws);
+  }
+  if (ArgumentHelper(net_def).GetSingleArgument<bool>(
+          "plan_blob_reuse", false)) {
+    return CreateNet(
+        WithoutArgument(
+            PlanBlobReuse(net_def, *ws), net_def, "plan_blob_reuse"),
+        ws);
+  }
+  if (ArgumentHelper(net_def).GetSingleArgument<bool>(
+          "preallocate_outputs", false)) {
+    PreallocateOutputs(net_def, ws);
+  }
   // In default, we will return a simple network that just runs all operators
   // sequentially.
   if (!net_def.has_type()) {
@@ -314,32 +367,15 @@ vector<float> SimpleNet::TEST_Benchmark(
   return time_per_op;
 }
 
-DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
-    : NetBase(net_def, ws), operator_nodes_(net_def.op_size()) {
+namespace internal {
+
+vector<vector<int>> computeOperatorParents(const NetDef& net_def) {
+  vector<vector<int>> parents(net_def.op_size());
   // Blob creator allows us to track which operator created which blob.
   std::map<string, int> blob_creator;
   std::map<string, std::set<int> > blob_readers;
-  bool net_def_has_device_option = net_def.has_device_option();
-  // Initialize the operators
   for (int idx = 0; idx < net_def.op_size(); ++idx) {
     const OperatorDef& op_def = net_def.op(idx);
-    VLOG(1) << "Creating operator #" << idx << ": "
-            << op_def.name() << ":" << op_def.type();
-    if (!op_def.has_device_option() && net_def_has_device_option) {
-      OperatorDef temp_def(op_def);
-      temp_def.mutable_device_option()->CopyFrom(net_def.device_option());
-      operator_nodes_[idx].operator_ = CreateOperator(temp_def, ws);
-      CAFFE_ENFORCE(
-          operator_nodes_[idx].operator_ != nullptr,
-          "Cannot create operator for def: ",
-          ProtoDebugString(temp_def));
-    } else {
-      operator_nodes_[idx].operator_ = CreateOperator(op_def, ws);
-      CAFFE_ENFORCE(
-          operator_nodes_[idx].operator_ != nullptr,
-          "Cannot create operator for def: ",
-          ProtoDebugString(op_def));
-    }
     // Check the inputs, and set up parents if necessary. This addressese the
     // read after write case.
     auto checkInputs = [&](
@@ -352,8 +388,7 @@ DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
           int parent = blob_creator[input];
           VLOG(1) << "op dependency (RaW " << input << "): " << parent << "->"
                   << idx;
-          operator_nodes_[idx].parents_.push_back(parent);
-          operator_nodes_[parent].children_.push_back(idx);
+          parents[idx].push_back(parent);
         }
         // Add the current idx to the readers of this input.
         blob_readers[input].insert(idx);
@@ -370,16 +405,14 @@ DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
         int waw_parent = blob_creator[output];
         VLOG(1) << "op dependency (WaW " << output << "): "
                       << waw_parent << "->" << idx;
-        operator_nodes_[idx].parents_.push_back(waw_parent);
-        operator_nodes_[waw_parent].children_.push_back(idx);
+        parents[idx].push_back(waw_parent);
       }
       // This addresses the write after read case - we will assume that writes
       // should only occur after all previous reads are finished.
       for (const int war_parent : blob_readers[output]) {
         VLOG(1) << "op dependency (WaR " << output << "): "
                       << war_parent << "->" << idx;
-        operator_nodes_[idx].parents_.push_back(war_parent);
-        operator_nodes_[war_parent].children_.push_back(idx);
+        parents[idx].push_back(war_parent);
       }
       // Renew the creator of the output name.
       blob_creator[output] = idx;
@@ -391,39 +424,186 @@ DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
     }
   }
 
-  // Now, make sure that the parent list and the children list do not contain
-  // duplicated items.
-  for (int i = 0; i < operator_nodes_.size(); ++i) {
-    auto& node = operator_nodes_[i];
+  // Now, make sure that the parent lists do not contain duplicated items.
+  for (int i = 0; i < parents.size(); ++i) {
     // Sort, remove duplicates, and delete self dependency.
-    auto& p = node.parents_;
+    auto& p = parents[i];
     std::sort(p.begin(), p.end());
     p.erase(std::unique(p.begin(), p.end()), p.end());
     p.erase(std::remove(p.begin(), p.end(), i), p.end());
-    // Do the same for the children vector.
-    auto& c = node.children_;
-    std::sort(c.begin(), c.end());
-    c.erase(std::unique(c.begin(), c.end()), c.end());
-    c.erase(std::remove(c.begin(), c.end(), i), c.end());
   }
-
-  execution_chains_ =
-      (FLAGS_caffe2_disable_chaining ? singleChains(operator_nodes_)
-                                     : computeChains(operator_nodes_));
-
   // TODO: do we want to make sure that there are no loops in the
   // dependency graph?
+  return parents;
+}
+
+vector<OperatorNode> computeOperatorNodes(
+    const NetDef& net_def,
+    Workspace* ws) {
+  vector<OperatorNode> operator_nodes(net_def.op_size());
+  bool net_def_has_device_option = net_def.has_device_option();
+  // Initialize the operators
+  for (int idx = 0; idx < net_def.op_size(); ++idx) {
+    const OperatorDef& op_def = net_def.op(idx);
+    VLOG(1) << "Creating operator #" << idx << ": "
+            << op_def.name() << ":" << op_def.type();
+    if (!op_def.has_device_option() && net_def_has_device_option) {
+      OperatorDef temp_def(op_def);
+      temp_def.mutable_device_option()->CopyFrom(net_def.device_option());
+      operator_nodes[idx].operator_ = CreateOperator(temp_def, ws);
+      CAFFE_ENFORCE(
+          operator_nodes[idx].operator_ != nullptr,
+          "Cannot create operator for def: ",
+          ProtoDebugString(temp_def));
+    } else {
+      operator_nodes[idx].operator_ = CreateOperator(op_def, ws);
+      CAFFE_ENFORCE(
+          operator_nodes[idx].operator_ != nullptr,
+          "Cannot create operator for def: ",
+          ProtoDebugString(op_def));
+    }
+  }
+  // Parents are sorted, so the children lists come out sorted too.
+  auto parents = computeOperatorParents(net_def);
+  for (int idx = 0; idx < operator_nodes.size(); ++idx) {
+    for (const int parent : parents[idx]) {
+      operator_nodes[parent].children_.push_back(idx);
+    }
+    operator_nodes[idx].parents_ = std::move(parents[idx]);
+  }
+  return operator_nodes;
+}
+
+AncestryChecker::AncestryChecker(const vector<vector<int>>& parents)
+    : parents_(parents),
+      levels_(parents.size(), 0),
+      ancestors_((parents.size() + 63) / 64, 0) {
+  // Parents always come before their children in the net, so a forward pass
+  // is a topological traversal.
+  for (auto i = 0; i < parents_.size(); ++i) {
+    for (const auto parent : parents_[i]) {
+      CAFFE_ENFORCE(parent < i, "Operators are not in topological order.");
+      levels_[i] = std::max(levels_[i], levels_[parent] + 1);
+    }
+  }
+}
+
+bool AncestryChecker::IsAncestor(int ancestor, int node) {
+  if (levels_[ancestor] >= levels_[node]) {
+    return false;
+  }
+  if (node != node_ || levels_[ancestor] < min_level_) {
+    CollectAncestors(node, levels_[ancestor]);
+  }
+  return (ancestors_[ancestor / 64] >> (ancestor % 64)) & 1;
+}
+
+void AncestryChecker::CollectAncestors(int node, int min_level) {
+  for (const auto ancestor : ancestor_list_) {
+    ancestors_[ancestor / 64] = 0;
+  }
+  ancestor_list_.clear();
+  node_ = node;
+  min_level_ = min_level;
+  stack_.clear();
+  stack_.push_back(node);
+  while (!stack_.empty()) {
+    const auto current = stack_.back();
+    stack_.pop_back();
+    for (const auto parent : parents_[current]) {
+      uint64_t& word = ancestors_[parent / 64];
+      const uint64_t bit = uint64_t(1) << (parent % 64);
+      if (!(word & bit) && levels_[parent] >= min_level) {
+        word |= bit;
+        ancestor_list_.push_back(parent);
+        stack_.push_back(parent);
+      }
+    }
+  }
+}
+
+vector<int> computeInitialFrontier(const vector<OperatorNode>& nodes) {
+  vector<int> initial_frontier;
+  for (int idx = 0; idx < nodes.size(); ++idx) {
+    if (nodes[idx].parents_.size() == 0) {
+      initial_frontier.push_back(idx);
+    }
+  }
+  return initial_frontier;
+}
+
+} // namespace internal
+
+DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
+    : NetBase(net_def, ws),
+      operator_nodes_(internal::computeOperatorNodes(net_def, ws)) {
+  // The latent issues with chaining are multi-device ones, so nets that only
+  // run on CPU use chaining unless it is explicitly disabled.
+  const bool cpu_only = std::all_of(
+      operator_nodes_.begin(),
+      operator_nodes_.end(),
+      [](const internal::OperatorNode& node) {
+        return node.operator_->def().device_option().device_type() == CPU;
+      });
+  const bool use_chaining = cpu_only ? !FLAGS_caffe2_disable_cpu_chaining
+                                     : !FLAGS_caffe2_disable_chaining;
+  execution_chains_ =
+      (use_chaining ? computeChains(operator_nodes_)
+                    : singleChains(operator_nodes_));
 
   // Figure out the initial frontier - this is the one we will feed into the job
   // queue to start a run.
-  for (int idx = 0; idx < operator_nodes_.size(); ++idx) {
-    if (operator_nodes_[idx].parents_.size() == 0) {
-      initial_frontier_.push_back(idx);
+  initial_frontier_ = internal::computeInitialFrontier(operator_nodes_);
+
+  ArgumentHelper arg_helper(net_def);
+  const string scheduling =
+      arg_helper.GetSingleArgument<string>("scheduling", "fifo");
+  CAFFE_ENFORCE(
+      scheduling == "fifo" || scheduling == "critical_path",
+      "Unknown scheduling mode: ",
+      scheduling);
+  if (scheduling == "critical_path") {
+    critical_path_scheduling_ = true;
+    critical_path_use_timings_ =
+        arg_helper.GetSingleArgument<bool>("critical_path_use_timings", true);
+    op_costs_.assign(operator_nodes_.size(), 1.f);
+    chain_times_.assign(operator_nodes_.size(), 0.f);
+    ComputeChainPriorities();
+  }
+
+  if (net_def.device_option().has_numa_node_id()) {
+    numa_node_id_ = net_def.device_option().numa_node_id();
+  }
+
+  // Every operator with asynchronous completion gets a thread of its own to
+  // wait on, so that they can all wait at the same time without starving each
+  // other or the other nets.
+  int num_async_ops = 0;
+  for (const auto& node : operator_nodes_) {
+    num_async_ops += node.operator_->HasAsyncCompletion();
+  }
+  if (num_async_ops > 0) {
+    io_worker_pool_.reset(new WorkerPool(num_async_ops));
+    const auto client = io_worker_pool_->AddClient(0, num_async_ops);
+    for (auto& node : operator_nodes_) {
+      if (node.operator_->HasAsyncCompletion()) {
+        node.operator_->SetIOWorkerPool(io_worker_pool_.get(), client);
+      }
     }
   }
-  // Finally, start the workers.
+
+  // Finally, start the workers, or register with the worker pool.
   int num_workers = net_def.has_num_workers() ? net_def.num_workers() : 1;
   CAFFE_ENFORCE(num_workers > 0, "Must have a positive number of workers.");
+  if (arg_helper.GetSingleArgument<bool>(
+          "use_worker_pool", FLAGS_caffe2_net_use_worker_pool)) {
+    worker_pool_ = ws->GetWorkerPool();
+    const int priority = arg_helper.GetSingleArgument<int>("priority", 0);
+    VLOG(1) << "Using the worker pool with priority " << priority
+            << " and at most " << num_workers << " concurrent chains.";
+    worker_pool_client_ = worker_pool_->AddClient(priority, num_workers);
+    return;
+  }
   if (num_workers == 1) {
     LOG(WARNING) << "Number of workers is 1: this means that all operators "
                  << "will be executed sequentially. Did you forget to set "
@@ -436,6 +616,10 @@ DAGNetBase::DAGNetBase(const NetDef& net_def, Workspace* ws)
 }
 
 DAGNetBase::~DAGNetBase() {
+  if (worker_pool_) {
+    worker_pool_->RemoveClient(worker_pool_client_);
+    return;
+  }
   // Safely join all the workers before exiting.
   job_queue_.NoMoreJobs();
   VLOG(1) << "Joining workers.";
@@ -457,13 +641,28 @@ bool DAGNetBase::Run() {
   for (auto& node : operator_nodes_) {
     node.runtime_parent_count_ = node.parents_.size();
   }
+  // A net run by a worker of its pool, e.g. by an operator of another net,
+  // runs its own chains while it waits: the other workers may all be waiting
+  // for nets as well.
+  help_while_waiting_ = worker_pool_ && worker_pool_->IsWorkerThread();
   // Kickstart the job queue.
   for (auto& value : initial_frontier_) {
-    job_queue_.Push(value);
+    ScheduleChain(value);
   }
   std::unique_lock<std::mutex> mutex_lock(remaining_ops_mutex_);
   while (remaining_ops_ > 0) {
     VLOG(2) << "Remaining ops to run: " << remaining_ops_;
+    if (help_while_waiting_) {
+      // A chain scheduled after we looked for one wakes us up through the
+      // counter.
+      const uint64_t scheduled = chains_scheduled_;
+      mutex_lock.unlock();
+      const bool ran = worker_pool_->RunPendingTask(worker_pool_client_);
+      mutex_lock.lock();
+      if (ran || chains_scheduled_ != scheduled) {
+        continue;
+      }
+    }
     cv_.wait(mutex_lock);
   }
   VLOG(2) << "All ops finished running.";
@@ -476,11 +675,27 @@ bool DAGNetBase::Run() {
         op.operator_->def().type(),
         ") has some runtime parents left.");
   }
+  if (critical_path_scheduling_ && critical_path_use_timings_) {
+    // Update the op costs with the times measured in this run, spreading the
+    // time of a chain evenly over its ops.
+    const float kDecay = 0.5;
+    for (const auto& chain : execution_chains_) {
+      const float op_time = chain_times_[chain.first] / chain.second.size();
+      for (const auto idx : chain.second) {
+        op_costs_[idx] = run_count_ == 0
+            ? op_time
+            : kDecay * op_costs_[idx] + (1 - kDecay) * op_time;
+      }
+    }
+    ++run_count_;
+    ComputeChainPriorities();
+  }
   // If the above while loop finished, we know that the current run finished.
   return success_;
 }
 
 void DAGNetBase::WorkerFunction() {
+  NUMABind(numa_node_id_);
   // WorkerFunctions() is an infinite loop until there are no more jobs to run.
   while (true) {
     int idx = 0;
@@ -489,61 +704,131 @@ void DAGNetBase::WorkerFunction() {
     if (!job_queue_.Pop(&idx)) {
       return;
     }
-    VLOG(1) << "Running operator #" << idx << " "
-            << operator_nodes_[idx].operator_->def().name()
-            << "(" << operator_nodes_[idx].operator_->def().type() << ").";
-    CAFFE_ENFORCE(
-        execution_chains_.find(idx) != execution_chains_.end(),
-        "Can't find chain ",
-        idx,
-        ".");
-    const auto& chain = execution_chains_[idx];
-    bool this_success = RunAt(execution_chains_[idx]);
-    if (!this_success) {
-      LOG(ERROR) << "Operator chain failed: "
-                 << ProtoDebugString(operator_nodes_[idx].operator_->def());
-    }
+    ExecuteChain(idx);
+  }
+}
 
-    // Do book-keeping
-    for (const auto idx: chain) {
-      for (const auto child: operator_nodes_[idx].children_) {
-        const int count = --operator_nodes_[child].runtime_parent_count_;
-        CAFFE_ENFORCE(
-            count >= 0,
-            "Found runtime parent count smaller than zero for ",
-            "operator node ",
-            operator_nodes_[child].operator_->def().name(),
-            "(",
-            operator_nodes_[child].operator_->def().type(),
-            ").");
+void DAGNetBase::ScheduleChain(int idx) {
+  const float priority =
+      critical_path_scheduling_ ? chain_priorities_[idx] : 0.f;
+  if (worker_pool_) {
+    worker_pool_->Schedule(
+        worker_pool_client_, [this, idx]() { ExecuteChain(idx); }, priority);
+    if (help_while_waiting_) {
+      std::lock_guard<std::mutex> lock(remaining_ops_mutex_);
+      ++chains_scheduled_;
+      cv_.notify_one();
+    }
+  } else {
+    job_queue_.Push(idx, priority);
+  }
+}
 
-        if (count != 0) {
-          continue;
-        }
+void DAGNetBase::ComputeChainPriorities() {
+  // The longest path from an op to a sink, including the op itself. Since a
+  // parent always comes before its children in the net, we can compute it in
+  // a single backward pass.
+  vector<float> path_lengths(operator_nodes_.size(), 0.f);
+  for (int idx = operator_nodes_.size() - 1; idx >= 0; --idx) {
+    float longest_child_path = 0.f;
+    for (const auto child : operator_nodes_[idx].children_) {
+      longest_child_path = std::max(longest_child_path, path_lengths[child]);
+    }
+    path_lengths[idx] = op_costs_[idx] + longest_child_path;
+  }
+  // A chain is scheduled with the path length of its first op.
+  chain_priorities_ = path_lengths;
+  // The initial frontier is pushed all at once at the start of a run, so it
+  // needs to be in priority order too.
+  std::stable_sort(
+      initial_frontier_.begin(), initial_frontier_.end(), [&](int a, int b) {
+        return chain_priorities_[a] > chain_priorities_[b];
+      });
+}
 
-        if (std::find(chain.begin(), chain.end(), child) != chain.end()) {
-          // already executed
-          continue;
-        }
-        VLOG(2) << "Pushing operator #" << child << " to queue.";
-        job_queue_.Push(child);
+void DAGNetBase::ExecuteChain(int idx) {
+  VLOG(1) << "Running operator #" << idx << " "
+          << operator_nodes_[idx].operator_->def().name()
+          << "(" << operator_nodes_[idx].operator_->def().type() << ").";
+  CAFFE_ENFORCE(
+      execution_chains_.find(idx) != execution_chains_.end(),
+      "Can't find chain ",
+      idx,
+      ".");
+  const auto& chain = execution_chains_[idx];
+  auto* op = operator_nodes_[idx].operator_.get();
+  if (chain.size() == 1 && op->HasAsyncCompletion() &&
+      SupportsAsyncCompletion()) {
+    // The worker is free to run other chains while the operator completes.
+    VLOG(2) << "Operator #" << idx << " completes asynchronously.";
+    std::shared_ptr<Timer> timer =
+        critical_path_scheduling_ ? std::make_shared<Timer>() : nullptr;
+    op->RunWithCompletion([this, idx, timer](bool success) {
+      if (timer) {
+        chain_times_[idx] = timer->MilliSeconds();
       }
-    }
+      FinishChain(idx, success);
+    });
+    return;
+  }
+  // The chains are only timed for the critical path scheduling.
+  if (!critical_path_scheduling_) {
+    FinishChain(idx, RunAt(chain));
+    return;
+  }
+  Timer timer;
+  bool this_success = RunAt(chain);
+  chain_times_[idx] = timer.MilliSeconds();
+  FinishChain(idx, this_success);
+}
+
+void DAGNetBase::FinishChain(int idx, bool this_success) {
+  const auto& chain = execution_chains_[idx];
+  if (!this_success) {
+    LOG(ERROR) << "Operator chain failed: "
+               << ProtoDebugString(operator_nodes_[idx].operator_->def());
+  }
 
-    // Notify that the processed op is incremented by one.
-    {
-      std::unique_lock<std::mutex> mutex_lock(remaining_ops_mutex_);
-      remaining_ops_ -= chain.size();
-      success_ &= this_success;
+  // Do book-keeping
+  for (const auto idx : chain) {
+    for (const auto child : operator_nodes_[idx].children_) {
+      const int count = --operator_nodes_[child].runtime_parent_count_;
       CAFFE_ENFORCE(
-          remaining_ops_ >= 0,
-          "All the operations should be finished by now, still have ",
-          remaining_ops_,
-          " remaining.");
+          count >= 0,
+          "Found runtime parent count smaller than zero for ",
+          "operator node ",
+          operator_nodes_[child].operator_->def().name(),
+          "(",
+          operator_nodes_[child].operator_->def().type(),
+          ").");
+
+      if (count != 0) {
+        continue;
+      }
+
+      if (std::find(chain.begin(), chain.end(), child) != chain.end()) {
+        // already executed
+        continue;
+      }
+      VLOG(2) << "Pushing operator #" << child << " to queue.";
+      ScheduleChain(child);
     }
-    cv_.notify_one();
-    VLOG(2) << "Finished executing operator #" << idx;
   }
+
+  // Notify that the processed op is incremented by one.
+  VLOG(2) << "Finished executing operator #" << idx;
+  std::unique_lock<std::mutex> mutex_lock(remaining_ops_mutex_);
+  remaining_ops_ -= chain.size();
+  success_ &= this_success;
+  CAFFE_ENFORCE(
+      remaining_ops_ >= 0,
+      "All the operations should be finished by now, still have ",
+      remaining_ops_,
+      " remaining.");
+  // Notify with the lock held: when this is called from the completion
+  // callback of an operator, the net may be destroyed as soon as Run() sees
+  // that all ops finished, and nothing joins the thread we are running on.
+  cv_.notify_one();
 }
 
 vector<float> DAGNetBase::TEST_Benchmark(
@@ -576,11 +861,60 @@ vector<float> DAGNetBase::TEST_Benchmark(
                  << millis / main_runs
                  << ". Iters per second: " << 1000.0 * main_runs / millis;
 
-  if (run_individual) {
-    LOG(INFO) << "DAGNet does not do per-op benchmark. To do so, "
-                      "switch to a simple net type.";
+  if (!run_individual) {
+    return vector<float>{millis / main_runs};
+  }
+  vector<float> time_per_op(operator_nodes_.size(), 0);
+  // Unlike SimpleNet, we cannot run the operators one by one without
+  // changing what we measure, so we profile the operators while the net
+  // runs as usual.
+  std::unordered_map<const void*, int> op_index;
+  for (int idx = 0; idx < operator_nodes_.size(); ++idx) {
+    op_index[operator_nodes_[idx].operator_.get()] = idx;
+  }
+  const bool profiler_was_enabled = Profiler::IsEnabled();
+  const int64_t start_us = Profiler::NowMicros();
+  Profiler::Enable();
+  for (int i = 0; i < main_runs; ++i) {
+    CAFFE_ENFORCE(Run(), "Profiled run ", i, " has failed.");
+  }
+  auto events = Profiler::Events();
+  if (!profiler_was_enabled) {
+    // The events are only kept for a profiling session started by the
+    // caller.
+    Profiler::Disable();
+    Profiler::ClearSince(start_us);
+  }
+  CaffeMap<string, float> time_per_op_type;
+  for (const auto& event : events) {
+    auto it = op_index.find(event.op);
+    if (it == op_index.end() || event.start_us < start_us) {
+      continue;
+    }
+    const float spent = (event.end_us - event.start_us) / 1000.f;
+    time_per_op[it->second] += spent;
+    time_per_op_type[event.type] += spent;
+  }
+  for (int idx = 0; idx < operator_nodes_.size(); ++idx) {
+    const auto& def = operator_nodes_[idx].operator_->def();
+    const string& print_name =
+        (def.name().size()
+             ? def.name()
+             : (def.output_size() ? def.output(0) : "NO_OUTPUT"));
+    LOG(INFO) << "Operator #" << idx << " (" << print_name << ", "
+              << def.type() << ") " << time_per_op[idx] / main_runs
+              << " ms/iter";
+  }
+  LOG(INFO) << "Time per operator type:";
+  for (const auto& item : time_per_op_type) {
+    LOG(INFO) << std::setw(15) << std::setfill(' ')
+              << item.second / main_runs << " " << item.first;
   }
-  return vector<float>{millis / main_runs};
+  for (int i = 0; i < time_per_op.size(); ++i) {
+    time_per_op[i] /= main_runs;
+  }
+  time_per_op.insert(time_per_op.begin(), millis / main_runs);
+  return time_per_op;
 }
 
 class DAGNet : public DAGNetBase {
@@ -4,6 +4,7 @@
 #include <atomic>
 #include <climits>
 #include <cstddef>
+#include <cstdint>
 #include <thread>  // NOLINT
 #include <typeinfo>
 #include <vector>
@@ -13,6 +14,7 @@
 #include "caffe2/core/common.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/registry.h"
+#include "caffe2/core/worker_pool.h"
 #include "caffe2/core/workspace.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/simple_queue.h"
@@ -87,6 +89,10 @@ class SimpleNet final : public NetBase {
       const int main_runs,
       const bool run_individual) override;
 
+  inline const vector<unique_ptr<OperatorBase> >& operators() const {
+    return operators_;
+  }
+
  protected:
   vector<unique_ptr<OperatorBase> > operators_;
 
@@ -100,6 +106,50 @@ struct OperatorNode {
   vector<int> parents_;
   std::atomic<int> runtime_parent_count_;
 };
+
+// Computes the parents of every operator of the net in the dependency graph
+// (read after write, write after write and write after read). The parent
+// lists are sorted and free of duplicates, and parents always come before
+// their children.
+vector<vector<int>> computeOperatorParents(const NetDef& net_def);
+
+// Creates the operators of the net and computes the dependency graph between
+// them with computeOperatorParents().
+vector<OperatorNode> computeOperatorNodes(
+    const NetDef& net_def,
+    Workspace* ws);
+
+// Answers "is a an ancestor of b" queries on the dependency graph without
+// materializing the ancestor sets, which would be quadratic in memory for
+// large nets. Every node gets a topological level (the length of the longest
+// path from a source), and the ancestors of b are collected in a bitset by
+// walking its parents backwards, pruning every node whose level is lower than
+// the level of a, since such a node cannot have a as an ancestor. The bitset
+// of the last node queried is kept, so the queries of the ancestry of the
+// same node with other nodes of the same or higher levels only test a bit.
+class AncestryChecker {
+ public:
+  // parents[i] are the parents of node i, which all have to be smaller than i.
+  explicit AncestryChecker(const vector<vector<int>>& parents);
+  bool IsAncestor(int ancestor, int node);
+
+ private:
+  // Collects the ancestors of node whose level is at least min_level.
+  void CollectAncestors(int node, int min_level);
+
+  const vector<vector<int>>& parents_;
+  vector<int> levels_;
+  // The ancestors of node_ whose level is at least min_level_, as a bitset
+  // and as a list, which is used to clear the bitset.
+  int node_ = -1;
+  int min_level_ = 0;
+  vector<uint64_t> ancestors_;
+  vector<int> ancestor_list_;
+  vector<int> stack_;
+};
+
+// Returns the indices of the nodes that have no parents.
+vector<int> computeInitialFrontier(const vector<OperatorNode>& nodes);
 }
 
 class DAGNetBase : public NetBase {
@@ -109,9 +159,8 @@ class DAGNetBase : public NetBase {
   ~DAGNetBase();
   bool Run() override;
   // WorkerFunction() is a function wrapper to allow us to run worker threads.
-  // It checks out one ready-to-run operator from the job queue, runs it,
-  // notifies all its children, and for any children that is ready, enqueues
-  // it to the job queue.
+  // It checks out one ready-to-run operator from the job queue and executes
+  // it with ExecuteChain().
   virtual void WorkerFunction();
   vector<float> TEST_Benchmark(
       const int warmup_runs,
@@ -124,16 +173,64 @@ class DAGNetBase : public NetBase {
 
  protected:
   virtual bool RunAt(const std::vector<int>& chain) = 0;
+  // Runs the chain starting at idx, and finishes it with FinishChain(). If the
+  // chain is a single operator with asynchronous completion, the chain is
+  // finished by the completion callback of the operator instead.
+  void ExecuteChain(int idx);
+  // Notifies all the children of the chain starting at idx, and schedules any
+  // children that became ready.
+  void FinishChain(int idx, bool success);
+  // Whether operators with asynchronous completion may run through
+  // RunWithCompletion() instead of RunAt().
+  virtual bool SupportsAsyncCompletion() const {
+    return true;
+  }
+  // Schedules the chain starting at idx, either on the job queue of the own
+  // workers, or on the worker pool of the workspace.
+  void ScheduleChain(int idx);
+  // Computes the priority of every chain as the length of the longest path
+  // from the chain to a sink of the graph, weighted by op_costs_.
+  void ComputeChainPriorities();
+
   vector<internal::OperatorNode> operator_nodes_;
   ExecutionChains execution_chains_;
   vector<int> initial_frontier_;
-  SimpleQueue<int> job_queue_;
+  SimplePriorityQueue<int> job_queue_;
+  // With the net argument scheduling="critical_path", ready chains are
+  // dispatched by decreasing priority instead of in FIFO order. The cost of
+  // each op starts as a static unit estimate, and is replaced by the running
+  // average of the measured op times unless the net argument
+  // "critical_path_use_timings" is false.
+  bool critical_path_scheduling_ = false;
+  bool critical_path_use_timings_ = true;
+  vector<float> op_costs_;
+  vector<float> chain_priorities_;
+  vector<float> chain_times_;
+  int run_count_ = 0;
   std::vector<std::thread> workers_;
+  // The NUMA node of the device option of the net, that the own workers are
+  // pinned to, or -1. The operators pin the threads of the worker pool.
+  int numa_node_id_ = -1;
+  // If the net runs on the worker pool of the workspace (net argument
+  // "use_worker_pool"), it does not have its own workers. The pool runs at
+  // most num_workers chains of this net at the same time, and prefers nets
+  // with a higher "priority" argument.
+  WorkerPool* worker_pool_ = nullptr;
+  WorkerPool::ClientId worker_pool_client_ = -1;
+  // Set while the net is run by a worker of the pool, which then runs chains
+  // of the net itself while it waits, see Run(). chains_scheduled_ counts the
+  // chains scheduled meanwhile, under remaining_ops_mutex_.
+  bool help_while_waiting_ = false;
+  uint64_t chains_scheduled_ = 0;
   int remaining_ops_;
   bool success_;
   std::mutex remaining_ops_mutex_;
   std::condition_variable cv_;
   std::mutex run_in_progress_;
+  // The threads the operators with asynchronous completion wait on, one per
+  // operator. Declared last, so that the completion callbacks returned before
+  // the rest of the net is destroyed.
+  std::unique_ptr<WorkerPool> io_worker_pool_;
 
   DISABLE_COPY_AND_ASSIGN(DAGNetBase);
 };
@@ -0,0 +1,103 @@
+#include "caffe2/core/net.h"
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A sequential net for very small nets that run at high rates, e.g. in
+// online serving, where the per-operator overhead of SimpleNet matters.
+//
+// The schedule is resolved once at construction into a flat array of operator
+// pointers and run functions, and Run() does nothing else than walking the
+// array. For operators that derive from Operator<CPUContext>, the run function
+// calls RunOnDevice() directly: SwitchToDevice() and FinishDeviceComputation()
+// are no-ops on CPU, unless the operator is pinned to a NUMA node, and so is
+// the arena scope if the workspace has no arena. Other operators go through
+// Run(). Nothing is logged unless an operator fails. The input and output blobs
+// of the operators are already resolved when the operators are created, so no
+// blob lookup happens at run time either.
+class CompiledNet final : public NetBase {
+ public:
+  CompiledNet(const NetDef& net_def, Workspace* ws)
+      : NetBase(net_def, ws), simple_net_(SimpleNetDef(net_def), ws) {
+    for (const auto& op : simple_net_.operators()) {
+      Step step;
+      step.op = op.get();
+      const auto& device_option = op->def().device_option();
+      if (dynamic_cast<Operator<CPUContext>*>(op.get()) &&
+          device_option.device_type() == CPU &&
+          !device_option.has_numa_node_id() && !op->arena()) {
+        step.run = &RunCPUOperator;
+      } else {
+        step.run = &RunOperator;
+      }
+      steps_.push_back(step);
+    }
+    VLOG(1) << "Compiled net with " << steps_.size() << " operators.";
+  }
+
+  bool Run() override {
+    const Step* step = steps_.data();
+    const Step* const end = step + steps_.size();
+    try {
+      for (; step != end; ++step) {
+        if (!step->run(step->op)) {
+          LOG(ERROR) << "Operator failed: " << ProtoDebugString(step->op->def());
+          return false;
+        }
+      }
+    } catch (EnforceNotMet& err) {
+      if (step->run == &RunCPUOperator) {
+        // Operator<Context>::Run() would have added this.
+        err.AppendMessage(
+            "Error from operator " + ProtoDebugString(step->op->def()));
+      }
+      throw;
+    }
+    return true;
+  }
+
+  vector<float> TEST_Benchmark(
+      const int warmup_runs,
+      const int main_runs,
+      const bool run_individual) override {
+    return simple_net_.TEST_Benchmark(warmup_runs, main_runs, run_individual);
+  }
+
+ private:
+  struct Step {
+    OperatorBase* op;
+    bool (*run)(OperatorBase*);
+  };
+
+  static NetDef SimpleNetDef(const NetDef& net_def) {
+    NetDef simple_def(net_def);
+    simple_def.clear_type();
+    return simple_def;
+  }
+
+  static bool RunOperator(OperatorBase* op) {
+    return op->Run();
+  }
+
+  static bool RunCPUOperator(OperatorBase* op) {
+    ProfiledOperatorScope<OperatorBase> profiled(op);
+    return static_cast<Operator<CPUContext>*>(op)->RunOnDevice();
+  }
+
+  // Owns the operators, and runs the benchmarks.
+  SimpleNet simple_net_;
+  vector<Step> steps_;
+
+  DISABLE_COPY_AND_ASSIGN(CompiledNet);
+};
+
+REGISTER_NET(compiled, CompiledNet);
+
+}  // namespace
+
+}  // namespace caffe2
@@ -0,0 +1,341 @@
+#include "caffe2/core/net.h"
+
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <set>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/simple_queue.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A DAG net whose Run() calls can overlap, so that several iterations of the
+// net are in flight at the same time, at most "max_in_flight" of them (a net
+// argument, 2 by default).
+//
+// Each in-flight iteration runs on its own slot: a copy of the operators in
+// which the per-iteration blobs of the net are renamed, so that iterations
+// do not overwrite each other's results. A blob is per-iteration if the net
+// writes it before reading it, and it is not an external input. Of those,
+// - the outputs, i.e. the external outputs and the blobs no operator reads,
+//   are renamed in every slot. When Run() returns, the outputs of its
+//   iteration are moved to the original names, where they stay until the
+//   Run() of the next iteration returns. Iterations return in order.
+// - the other ones, the intermediate results, are renamed in the slots other
+//   than slot 0, and should not be fetched by the callers.
+// All the other blobs, e.g. parameters, queues and counters, are shared
+// between the iterations.
+//
+// On top of the dependencies inside an iteration, an operator of iteration
+// k+1 waits for
+// - the same operator of iteration k, so that stateful operators such as
+//   readers see the iterations in order, and
+// - every operator of iteration k that accesses a shared blob it writes, or
+//   that writes a shared blob it accesses.
+// The throughput of the net is then bounded by its slowest operator rather
+// than by the length of the whole net. Iterations finish in the order in
+// which they started.
+class PipelinedDAGNet final : public NetBase {
+ public:
+  PipelinedDAGNet(const NetDef& net_def, Workspace* ws)
+      : NetBase(net_def, ws), num_ops_(net_def.op_size()) {
+    ArgumentHelper arg_helper(net_def);
+    const int num_slots =
+        arg_helper.GetSingleArgument<int>("max_in_flight", 2);
+    CAFFE_ENFORCE(num_slots > 0, "max_in_flight must be positive.");
+
+    std::set<string> outputs;
+    const std::set<string> private_blobs =
+        ComputePrivateBlobs(net_def, &outputs);
+    published_.resize(num_slots);
+    for (int slot = 0; slot < num_slots; ++slot) {
+      NetDef slot_def(net_def);
+      for (auto& op : *slot_def.mutable_op()) {
+        auto rename = [&](string* blob) {
+          if (private_blobs.count(*blob) &&
+              (slot > 0 || outputs.count(*blob))) {
+            *blob = *blob + "_pipeline_slot_" + caffe2::to_string(slot);
+          }
+        };
+        for (auto& input : *op.mutable_input()) {
+          rename(&input);
+        }
+        for (auto& input : *op.mutable_control_input()) {
+          rename(&input);
+        }
+        for (auto& output : *op.mutable_output()) {
+          rename(&output);
+        }
+      }
+      slots_.emplace_back(internal::computeOperatorNodes(slot_def, ws));
+      for (const auto& output : outputs) {
+        published_[slot].emplace_back(
+            ws->CreateBlob(
+                output + "_pipeline_slot_" + caffe2::to_string(slot)),
+            ws->CreateBlob(output));
+      }
+    }
+    iterations_.resize(num_slots);
+    ComputeCrossIterationDependencies(net_def, private_blobs);
+
+    int num_workers = net_def.has_num_workers() ? net_def.num_workers() : 1;
+    CAFFE_ENFORCE(num_workers > 0, "Must have a positive number of workers.");
+    for (int i = 0; i < num_workers; ++i) {
+      VLOG(1) << "Start worker #" << i;
+      workers_.push_back(std::thread(&PipelinedDAGNet::WorkerFunction, this));
+    }
+  }
+
+  ~PipelinedDAGNet() {
+    job_queue_.NoMoreJobs();
+    VLOG(1) << "Joining workers.";
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  bool Run() override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const int64_t id = next_ticket_++;
+    const int slot = id % iterations_.size();
+    auto& iteration = iterations_[slot];
+    // Iterations start in the order of their tickets, and wait for the
+    // previous user of their slot to be collected.
+    cv_.wait(lock, [&] {
+      return started_iterations_ == id && iteration.collected;
+    });
+    VLOG(1) << "Running pipelined net iteration " << id << " on slot "
+            << slot << ".";
+    StartIteration(id);
+    ++started_iterations_;
+    cv_.notify_all();
+    if (num_ops_ == 0) {
+      FinishIteration(slot);
+    }
+    // Iterations are collected in order, so that the outputs are always the
+    // ones of the last collected iteration.
+    cv_.wait(lock, [&] {
+      return iteration.finished && collected_iterations_ == id;
+    });
+    VLOG(2) << "Iteration " << id << " finished running.";
+    for (const auto& blobs : published_[slot]) {
+      blobs.first->swap(*blobs.second);
+    }
+    const bool success = iteration.success;
+    iteration.collected = true;
+    ++collected_iterations_;
+    cv_.notify_all();
+    return success;
+  }
+
+ private:
+  struct Iteration {
+    int64_t id = -1;
+    vector<int> pending_parents;
+    vector<bool> done;
+    int remaining_ops = 0;
+    bool success = true;
+    bool finished = false;
+    // Whether Run() picked up the result, i.e. the slot can be reused.
+    bool collected = true;
+  };
+
+  // Returns the per-iteration blobs, and sets outputs to the ones that are
+  // outputs of the net.
+  static std::set<string> ComputePrivateBlobs(
+      const NetDef& net_def,
+      std::set<string>* outputs) {
+    std::set<string> shared(
+        net_def.external_input().begin(), net_def.external_input().end());
+    std::set<string> written;
+    std::set<string> read;
+    for (const auto& op : net_def.op()) {
+      for (const auto& input : op.input()) {
+        if (!written.count(input)) {
+          shared.insert(input);
+        }
+        read.insert(input);
+      }
+      for (const auto& input : op.control_input()) {
+        if (!written.count(input)) {
+          shared.insert(input);
+        }
+        read.insert(input);
+      }
+      written.insert(op.output().begin(), op.output().end());
+    }
+    const std::set<string> external_outputs(
+        net_def.external_output().begin(), net_def.external_output().end());
+    std::set<string> private_blobs;
+    for (const auto& blob : written) {
+      if (shared.count(blob)) {
+        continue;
+      }
+      private_blobs.insert(blob);
+      if (external_outputs.count(blob) || !read.count(blob)) {
+        outputs->insert(blob);
+      }
+    }
+    return private_blobs;
+  }
+
+  void ComputeCrossIterationDependencies(
+      const NetDef& net_def,
+      const std::set<string>& private_blobs) {
+    std::map<string, std::set<int>> writers;
+    std::map<string, std::set<int>> accessors;
+    for (int idx = 0; idx < num_ops_; ++idx) {
+      const auto& op = net_def.op(idx);
+      for (const auto& input : op.input()) {
+        accessors[input].insert(idx);
+      }
+      for (const auto& input : op.control_input()) {
+        accessors[input].insert(idx);
+      }
+      for (const auto& output : op.output()) {
+        accessors[output].insert(idx);
+        writers[output].insert(idx);
+      }
+    }
+    cross_parents_.resize(num_ops_);
+    cross_children_.resize(num_ops_);
+    auto add_edge = [&](int parent, int child) {
+      cross_parents_[child].push_back(parent);
+      cross_children_[parent].push_back(child);
+    };
+    for (int idx = 0; idx < num_ops_; ++idx) {
+      add_edge(idx, idx);
+    }
+    for (const auto& blob_writers : writers) {
+      if (private_blobs.count(blob_writers.first)) {
+        continue;
+      }
+      for (const int writer : blob_writers.second) {
+        for (const int accessor : accessors[blob_writers.first]) {
+          add_edge(writer, accessor);
+          add_edge(accessor, writer);
+        }
+      }
+    }
+    for (int idx = 0; idx < num_ops_; ++idx) {
+      for (auto* edges : {&cross_parents_[idx], &cross_children_[idx]}) {
+        std::sort(edges->begin(), edges->end());
+        edges->erase(std::unique(edges->begin(), edges->end()), edges->end());
+      }
+    }
+  }
+
+  // Sets up the iteration id and pushes its ready operators. Must be called
+  // with mutex_ held, after iteration id - 1 was started.
+  void StartIteration(int64_t id) {
+    const int slot = id % iterations_.size();
+    const int prev_slot = (id + iterations_.size() - 1) % iterations_.size();
+    auto& iteration = iterations_[slot];
+    const auto& prev = iterations_[prev_slot];
+    const bool prev_in_flight = id > 0 && !prev.finished && prev.id == id - 1;
+    iteration.id = id;
+    iteration.remaining_ops = num_ops_;
+    iteration.success = true;
+    iteration.finished = false;
+    iteration.collected = false;
+    iteration.done.assign(num_ops_, false);
+    iteration.pending_parents.resize(num_ops_);
+    for (int idx = 0; idx < num_ops_; ++idx) {
+      int pending = slots_[slot][idx].parents_.size();
+      if (prev_in_flight) {
+        for (const int parent : cross_parents_[idx]) {
+          pending += !prev.done[parent];
+        }
+      }
+      iteration.pending_parents[idx] = pending;
+    }
+    for (int idx = 0; idx < num_ops_; ++idx) {
+      if (iteration.pending_parents[idx] == 0) {
+        job_queue_.Push(slot * num_ops_ + idx);
+      }
+    }
+  }
+
+  // Must be called with mutex_ held.
+  void FinishIteration(int slot) {
+    iterations_[slot].finished = true;
+    cv_.notify_all();
+  }
+
+  void WorkerFunction() {
+    int job;
+    while (job_queue_.Pop(&job)) {
+      const int slot = job / num_ops_;
+      const int idx = job % num_ops_;
+      auto& op = slots_[slot][idx].operator_;
+      VLOG(1) << "Running operator #" << idx << " " << op->def().name() << "("
+              << op->def().type() << ") on slot " << slot << ".";
+      bool success = false;
+      try {
+        success = op->Run();
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Operator threw: " << e.what();
+      } catch (...) {
+        LOG(ERROR) << "Operator threw an unknown exception.";
+      }
+      if (!success) {
+        LOG(ERROR) << "Operator failed: " << ProtoDebugString(op->def());
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& iteration = iterations_[slot];
+      iteration.done[idx] = true;
+      iteration.success &= success;
+      for (const int child : slots_[slot][idx].children_) {
+        if (--iteration.pending_parents[child] == 0) {
+          job_queue_.Push(slot * num_ops_ + child);
+        }
+      }
+      // Notify the next iteration if it was already started.
+      if (started_iterations_ > iteration.id + 1) {
+        const int next_slot = (slot + 1) % iterations_.size();
+        auto& next = iterations_[next_slot];
+        for (const int child : cross_children_[idx]) {
+          if (--next.pending_parents[child] == 0) {
+            job_queue_.Push(next_slot * num_ops_ + child);
+          }
+        }
+      }
+      if (--iteration.remaining_ops == 0) {
+        FinishIteration(slot);
+      }
+    }
+  }
+
+  const int num_ops_;
+  // The operators of each slot.
+  vector<vector<internal::OperatorNode>> slots_;
+  // The dependencies between an iteration and the next one, by op index.
+  vector<vector<int>> cross_parents_;
+  vector<vector<int>> cross_children_;
+  // The state of the iteration running on each slot.
+  vector<Iteration> iterations_;
+  // The outputs of each slot, with the blobs they are moved to when their
+  // iteration is collected.
+  vector<vector<std::pair<Blob*, Blob*>>> published_;
+  int64_t next_ticket_ = 0;
+  int64_t started_iterations_ = 0;
+  int64_t collected_iterations_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // A job is an operator index, offset by slot * num_ops_.
+  SimpleQueue<int> job_queue_;
+  std::vector<std::thread> workers_;
+
+  DISABLE_COPY_AND_ASSIGN(PipelinedDAGNet);
+};
+
+REGISTER_NET(dag_pipelined, PipelinedDAGNet);
+
+}  // namespace
+
+}  // namespace caffe2
@@ -0,0 +1,259 @@
+#include "caffe2/core/net.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <mutex>  // NOLINT
+
+#include "caffe2/core/operator.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/work_stealing_deque.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A DAG net that schedules operators with per-worker work stealing deques
+// instead of the single mutex-protected job queue of DAGNetBase.
+//
+// When a worker finishes an operator, it runs one of the children that just
+// became ready itself, without going through any queue, and pushes the other
+// ready children to the bottom of its own deque. Idle workers steal from the
+// top of the other workers' deques, and after a few failed attempts sleep
+// until an operator is pushed or the run is over. The only locks taken are
+// one to wake up the workers at the start of a run, one to wake up the idle
+// workers, which is only taken when some are asleep, and one to wake up the
+// caller of Run() when the last operator finishes; the number of remaining
+// operators is tracked with an atomic counter. An operator that throws fails
+// the run like one that returns false.
+class DAGWSNet final : public NetBase {
+ public:
+  DAGWSNet(const NetDef& net_def, Workspace* ws)
+      : NetBase(net_def, ws),
+        operator_nodes_(internal::computeOperatorNodes(net_def, ws)),
+        initial_frontier_(internal::computeInitialFrontier(operator_nodes_)) {
+    int num_workers = net_def.has_num_workers() ? net_def.num_workers() : 1;
+    CAFFE_ENFORCE(num_workers > 0, "Must have a positive number of workers.");
+    for (int i = 0; i < num_workers; ++i) {
+      deques_.emplace_back(
+          new WorkStealingDeque<int>(std::max<size_t>(
+              operator_nodes_.size(), 1)));
+    }
+    for (int i = 0; i < num_workers; ++i) {
+      VLOG(1) << "Start worker #" << i;
+      workers_.push_back(std::thread(&DAGWSNet::WorkerFunction, this, i));
+    }
+  }
+
+  ~DAGWSNet() {
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex_);
+      stop_ = true;
+    }
+    worker_cv_.notify_all();
+    VLOG(1) << "Joining workers.";
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  bool Run() override {
+    std::unique_lock<std::mutex> run_lock(run_in_progress_);
+    VLOG(1) << "Running work stealing DAG net.";
+    if (operator_nodes_.empty()) {
+      return true;
+    }
+    for (auto& node : operator_nodes_) {
+      node.runtime_parent_count_ = node.parents_.size();
+    }
+    success_ = true;
+    remaining_ops_ = operator_nodes_.size();
+    next_initial_ = 0;
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex_);
+      ++run_epoch_;
+    }
+    worker_cv_.notify_all();
+
+    std::unique_lock<std::mutex> done_lock(done_mutex_);
+    done_cv_.wait(done_lock, [this] { return remaining_ops_ == 0; });
+    VLOG(2) << "All ops finished running.";
+    return success_;
+  }
+
+ private:
+  void WorkerFunction(int worker_id) {
+    int seen_epoch = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(worker_mutex_);
+        worker_cv_.wait(
+            lock, [&] { return stop_ || run_epoch_ != seen_epoch; });
+        if (stop_) {
+          return;
+        }
+        seen_epoch = run_epoch_;
+      }
+      RunUntilDone(worker_id);
+    }
+  }
+
+  // Executes operators until all the operators of the current run finished.
+  void RunUntilDone(int worker_id) {
+    auto& own_deque = *deques_[worker_id];
+    const int num_workers = deques_.size();
+    int failed_steals = 0;
+    while (remaining_ops_ > 0) {
+      int idx = -1;
+      int initial = initial_frontier_.size();
+      if (next_initial_ < initial_frontier_.size()) {
+        initial = next_initial_++;
+      }
+      if (initial < initial_frontier_.size()) {
+        idx = initial_frontier_[initial];
+      } else if (!own_deque.Pop(&idx)) {
+        bool stolen = false;
+        for (int i = 1; i < num_workers && !stolen; ++i) {
+          stolen = deques_[(worker_id + i) % num_workers]->Steal(&idx);
+        }
+        if (!stolen) {
+          if (++failed_steals < kStealsBeforeSleeping) {
+            std::this_thread::yield();
+          } else {
+            failed_steals = 0;
+            SleepUntilWork();
+          }
+          continue;
+        }
+      }
+      failed_steals = 0;
+      RunChainFrom(idx, &own_deque);
+    }
+  }
+
+  bool HasWork() const {
+    if (remaining_ops_ == 0 || next_initial_ < initial_frontier_.size()) {
+      return true;
+    }
+    for (const auto& deque : deques_) {
+      if (deque->SizeApprox() > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Waits until there may be an operator to run, or the run is over.
+  // Announcing the sleep before checking for work, while the workers that
+  // push an operator check for sleepers after pushing it, makes sure that
+  // one of the two sees the other.
+  void SleepUntilWork() {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    ++sleeping_workers_;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!HasWork()) {
+      idle_cv_.wait(lock);
+    }
+    --sleeping_workers_;
+  }
+
+  void WakeSleepingWorkers() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping_workers_ > 0) {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      idle_cv_.notify_all();
+    }
+  }
+
+  // Runs the operator idx, and keeps running one of its ready children
+  // directly until it reaches an operator that does not make any child ready.
+  void RunChainFrom(int idx, WorkStealingDeque<int>* own_deque) {
+    while (idx >= 0) {
+      auto& node = operator_nodes_[idx];
+      VLOG(1) << "Running operator #" << idx << " "
+              << node.operator_->def().name() << "("
+              << node.operator_->def().type() << ").";
+      bool success = false;
+      try {
+        success = node.operator_->Run();
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Operator threw: " << e.what();
+      } catch (...) {
+        LOG(ERROR) << "Operator threw an unknown exception.";
+      }
+      if (!success) {
+        LOG(ERROR) << "Operator failed: "
+                   << ProtoDebugString(node.operator_->def());
+        success_ = false;
+      }
+      int next = -1;
+      bool pushed = false;
+      for (const auto child : node.children_) {
+        const int count = --operator_nodes_[child].runtime_parent_count_;
+        CAFFE_ENFORCE(
+            count >= 0,
+            "Found runtime parent count smaller than zero for ",
+            "operator node ",
+            operator_nodes_[child].operator_->def().name(),
+            "(",
+            operator_nodes_[child].operator_->def().type(),
+            ").");
+        if (count != 0) {
+          continue;
+        }
+        if (next < 0) {
+          next = child;
+        } else {
+          CAFFE_ENFORCE(own_deque->Push(child), "Worker deque is full.");
+          pushed = true;
+        }
+      }
+      if (--remaining_ops_ == 0) {
+        // Take the lock so that the notification cannot get lost between
+        // the predicate check and the wait in Run().
+        {
+          std::lock_guard<std::mutex> lock(done_mutex_);
+          done_cv_.notify_one();
+        }
+        WakeSleepingWorkers();
+      } else if (pushed) {
+        WakeSleepingWorkers();
+      }
+      idx = next;
+    }
+  }
+
+  vector<internal::OperatorNode> operator_nodes_;
+  const vector<int> initial_frontier_;
+  vector<std::unique_ptr<WorkStealingDeque<int>>> deques_;
+  std::vector<std::thread> workers_;
+
+  std::atomic<int> remaining_ops_{0};
+  std::atomic<int> next_initial_{0};
+  std::atomic<bool> success_{true};
+
+  // The number of failed attempts to steal an operator after which an idle
+  // worker goes to sleep.
+  static constexpr int kStealsBeforeSleeping = 64;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_cv_;
+  std::atomic<int> sleeping_workers_{0};
+
+  std::mutex worker_mutex_;
+  std::condition_variable worker_cv_;
+  int run_epoch_{0};
+  bool stop_{false};
+
+  std::mutex done_mutex_;
+  std::condition_variable done_cv_;
+  std::mutex run_in_progress_;
+
+  DISABLE_COPY_AND_ASSIGN(DAGWSNet);
+};
+
+REGISTER_NET(dag_ws, DAGWSNet);
+
+}  // namespace
+
+}  // namespace caffe2
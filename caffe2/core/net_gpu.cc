@@ -177,6 +177,12 @@ class AsyncDAGNet : public DAGNetBase {
     }
   }
 
+  // Operators are launched on the stream of their chain, and events are
+  // recorded in RunAt(), so every chain has to go through it.
+  bool SupportsAsyncCompletion() const override {
+    return false;
+  }
+
   bool RunAt(const std::vector<int>& chain) override {
     CAFFE_ENFORCE(!chain.empty(), "Chain should not be empty.");
     const auto source_idx = chain.front();
@@ -1,4 +1,9 @@
+#include <algorithm>
+#include <thread>  // NOLINT
+
+#include "caffe2/core/arena.h"
 #include "caffe2/core/net.h"
+#include "caffe2/core/numa.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/scope_guard.h"
 #include "google/protobuf/text_format.h"
@@ -26,6 +31,36 @@ REGISTER_CUDA_OPERATOR(NetTestDummy, NetTestDummyOp);
 
 OPERATOR_SCHEMA(NetTestDummy).NumInputs(0, INT_MAX).NumOutputs(0, INT_MAX);
 
+// A CPU op that increments its integer output, and fails if asked to.
+class NetTestCountOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+  bool RunOnDevice() override {
+    ++*OperatorBase::Output<int>(0);
+    return !OperatorBase::GetSingleArgument<bool>("fail", false);
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestCount, NetTestCountOp);
+
+OPERATOR_SCHEMA(NetTestCount).NumInputs(0, INT_MAX).NumOutputs(1);
+
+// A CPU op that records the NUMA node of its thread, and allocates a tensor.
+class NetTestNUMANodeOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+  bool RunOnDevice() override {
+    *OperatorBase::Output<int>(0) = GetCurrentNUMANode();
+    Output(1)->Resize(16);
+    Output(1)->mutable_data<float>();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(NetTestNUMANode, NetTestNUMANodeOp);
+
+OPERATOR_SCHEMA(NetTestNUMANode).NumInputs(0).NumOutputs(2);
+
 const char kExampleNetDefString[] =
 "  name: \"example\""
 "  op {"
@@ -260,4 +295,199 @@ TEST(NetTest, ChainingForForkJoin) {
   checkChaining(spec, {{0, {0}}, {1, {1}}, {2, {2, 3}}});
 }
 
+TEST(NetTest, ChainingStopsAtFork) {
+  // "hidden" also feeds "out2", which must not wait for "out1" to be
+  // computed, so op 1 and op 2 are not chained.
+  const auto spec = R"DOC(
+        name: "example"
+        type: "dag"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "other"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out1"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          input: "other"
+          output: "out2"
+          type: "NetTestDummy"
+        }
+)DOC";
+  checkChaining(spec, {{0, {0}}, {1, {1}}, {2, {2}}, {3, {3}}});
+}
+
+TEST(NetTest, AncestryChecker) {
+  // A random DAG, checked against its transitive closure.
+  const int n = 200;
+  vector<vector<int>> parents(n);
+  vector<vector<bool>> ancestors(n, vector<bool>(n, false));
+  unsigned seed = 1;
+  for (int i = 1; i < n; ++i) {
+    for (int k = 0; k < 2; ++k) {
+      seed = seed * 1103515245 + 12345;
+      const int parent = i - 1 - (seed >> 16) % std::min(i, 10);
+      if (std::find(parents[i].begin(), parents[i].end(), parent) ==
+          parents[i].end()) {
+        parents[i].push_back(parent);
+      }
+    }
+    for (const auto parent : parents[i]) {
+      ancestors[i][parent] = true;
+      for (int j = 0; j < n; ++j) {
+        if (ancestors[parent][j]) {
+          ancestors[i][j] = true;
+        }
+      }
+    }
+  }
+  internal::AncestryChecker checker(parents);
+  for (int node = 0; node < n; ++node) {
+    // The queries of each node go from the highest levels to the lowest
+    // ones, and back.
+    for (int ancestor = n - 1; ancestor >= 0; --ancestor) {
+      EXPECT_EQ(checker.IsAncestor(ancestor, node), ancestors[node][ancestor]);
+    }
+    for (int ancestor = 0; ancestor < n; ++ancestor) {
+      EXPECT_EQ(checker.IsAncestor(ancestor, node), ancestors[node][ancestor]);
+    }
+  }
+}
+
+std::unique_ptr<NetBase> createNetWithDefaultFlags(
+    Workspace* ws,
+    const char* spec) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(spec, &net_def));
+  return CreateNet(net_def, ws);
+}
+
+TEST(NetTest, ChainingByDefaultForCPUNets) {
+  const auto cpu_spec = R"DOC(
+        name: "example"
+        type: "dag"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out"
+          type: "NetTestDummy"
+        }
+)DOC";
+  const auto cuda_spec = R"DOC(
+        name: "example"
+        type: "dag"
+        external_input: "in"
+        device_option {
+          device_type: CUDA
+        }
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out"
+          type: "NetTestDummy"
+        }
+)DOC";
+  Workspace ws;
+  ws.CreateBlob("in");
+  auto cpu_net = createNetWithDefaultFlags(&ws, cpu_spec);
+  EXPECT_TRUE(
+      dynamic_cast<DAGNetBase*>(cpu_net.get())->TEST_execution_chains() ==
+      DAGNetBase::ExecutionChains({{0, {0, 1}}}));
+  auto cuda_net = createNetWithDefaultFlags(&ws, cuda_spec);
+  EXPECT_TRUE(
+      dynamic_cast<DAGNetBase*>(cuda_net.get())->TEST_execution_chains() ==
+      DAGNetBase::ExecutionChains({{0, {0}}, {1, {1}}}));
+}
+
+TEST(NetTest, CompiledNet) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      R"DOC(
+        type: "compiled"
+        op {
+          output: "count"
+          type: "NetTestCount"
+        }
+        op {
+          input: "count"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          output: "count"
+          type: "NetTestCount"
+        }
+      )DOC",
+      &net_def));
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net != nullptr);
+  EXPECT_TRUE(net->Run());
+  EXPECT_TRUE(net->Run());
+  EXPECT_EQ(ws.GetBlob("count")->Get<int>(), 4);
+
+  // A failing operator stops the run.
+  auto* arg = net_def.mutable_op(0)->add_arg();
+  arg->set_name("fail");
+  arg->set_i(1);
+  Workspace fail_ws;
+  net = CreateNet(net_def, &fail_ws);
+  EXPECT_FALSE(net->Run());
+  EXPECT_EQ(fail_ws.GetBlob("count")->Get<int>(), 1);
+}
+
+TEST(NetTest, CompiledNetSwitchesToDevice) {
+  NetDef net_def;
+  net_def.set_type("compiled");
+  net_def.mutable_device_option()->set_numa_node_id(0);
+  auto* op = net_def.add_op();
+  op->set_type("NetTestNUMANode");
+  op->add_output("node");
+  op->add_output("tensor");
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net != nullptr);
+  auto old = FLAGS_caffe2_cpu_numa_enabled;
+  FLAGS_caffe2_cpu_numa_enabled = true;
+  // On a thread of its own, since the thread stays bound to the node.
+  std::thread thread([&]() { EXPECT_TRUE(net->Run()); });
+  thread.join();
+  FLAGS_caffe2_cpu_numa_enabled = old;
+  EXPECT_EQ(ws.GetBlob("node")->Get<int>(), IsNUMAEnabled() ? 0 : -1);
+}
+
+TEST(NetTest, CompiledNetUsesArena) {
+  NetDef net_def;
+  net_def.set_type("compiled");
+  auto* op = net_def.add_op();
+  op->set_type("NetTestNUMANode");
+  op->add_output("node");
+  op->add_output("tensor");
+  Workspace ws;
+  ws.EnableArena();
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net != nullptr);
+  EXPECT_TRUE(net->Run());
+  EXPECT_EQ(ws.GetArena()->allocated_bytes(), 16 * sizeof(float));
+}
+
 } // namespace caffe2
@@ -0,0 +1,120 @@
+#include "caffe2/core/numa.h"
+
+#ifdef CAFFE2_USE_NUMA
+#include <numa.h>
+#include <numaif.h>
+#include <unistd.h>
+#endif  // CAFFE2_USE_NUMA
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_numa_enabled,
+    false,
+    "Use NUMA whenever possible: pin the threads running CPU operators with a "
+    "numa_node_id in their device option to that node, and allocate their "
+    "memory there.");
+
+namespace caffe2 {
+
+namespace {
+thread_local int t_numa_node_id = -1;
+}  // namespace
+
+std::string NUMAReplicaBlobName(const std::string& name, int numa_node_id) {
+  return name + "_numa_" + caffe2::to_string(numa_node_id);
+}
+
+#ifdef CAFFE2_USE_NUMA
+
+bool IsNUMAEnabled() {
+  return FLAGS_caffe2_cpu_numa_enabled && numa_available() >= 0;
+}
+
+int GetNumNUMANodes() {
+  return IsNUMAEnabled() ? numa_num_configured_nodes() : 1;
+}
+
+void NUMABind(int numa_node_id) {
+  if (numa_node_id < 0 || numa_node_id == t_numa_node_id ||
+      !IsNUMAEnabled()) {
+    return;
+  }
+  CAFFE_ENFORCE(
+      numa_node_id <= numa_max_node(),
+      "NUMA node id ",
+      numa_node_id,
+      " is out of range, the largest node id is ",
+      numa_max_node());
+  CAFFE_ENFORCE(
+      numa_run_on_node(numa_node_id) == 0,
+      "Failed to run on NUMA node ",
+      numa_node_id);
+  numa_set_preferred(numa_node_id);
+  t_numa_node_id = numa_node_id;
+}
+
+int GetCurrentNUMANode() {
+  return t_numa_node_id;
+}
+
+int GetNUMANode(const void* ptr) {
+  if (!IsNUMAEnabled()) {
+    return -1;
+  }
+  int numa_node = -1;
+  if (get_mempolicy(
+          &numa_node,
+          nullptr,
+          0,
+          const_cast<void*>(ptr),
+          MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+    return -1;
+  }
+  return numa_node;
+}
+
+void* NUMAAlloc(size_t nbytes, int numa_node_id) {
+  if (numa_node_id < 0 || !IsNUMAEnabled()) {
+    return nullptr;
+  }
+  void* ptr = numa_alloc_onnode(nbytes, numa_node_id);
+  CAFFE_ENFORCE(
+      ptr, "Failed to allocate ", nbytes, " bytes on NUMA node ", numa_node_id);
+  return ptr;
+}
+
+void NUMAFree(void* ptr, size_t nbytes) {
+  numa_free(ptr, nbytes);
+}
+
+#else  // CAFFE2_USE_NUMA
+
+bool IsNUMAEnabled() {
+  return false;
+}
+
+int GetNumNUMANodes() {
+  return 1;
+}
+
+void NUMABind(int /*numa_node_id*/) {}
+
+int GetCurrentNUMANode() {
+  return t_numa_node_id;
+}
+
+int GetNUMANode(const void* /*ptr*/) {
+  return -1;
+}
+
+void* NUMAAlloc(size_t /*nbytes*/, int /*numa_node_id*/) {
+  return nullptr;
+}
+
+void NUMAFree(void* /*ptr*/, size_t /*nbytes*/) {}
+
+#endif  // CAFFE2_USE_NUMA
+
+}  // namespace caffe2
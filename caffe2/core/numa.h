@@ -0,0 +1,42 @@
+#ifndef CAFFE2_CORE_NUMA_H_
+#define CAFFE2_CORE_NUMA_H_
+
+#include <cstddef>
+#include <string>
+
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_numa_enabled);
+
+namespace caffe2 {
+
+// Whether NUMA support is compiled in (CAFFE2_USE_NUMA), enabled with
+// --caffe2_cpu_numa_enabled and available on the machine. If not, all the
+// functions below are no-ops and the machine is treated as a single node.
+bool IsNUMAEnabled();
+
+int GetNumNUMANodes();
+
+// Pins the calling thread to the CPUs of the given node, and makes the memory
+// it touches first prefer that node. A negative node id does nothing.
+void NUMABind(int numa_node_id);
+
+// Returns the node the calling thread was bound to with NUMABind(), or -1.
+int GetCurrentNUMANode();
+
+// Returns the node of the memory page holding ptr, or -1 if unknown.
+int GetNUMANode(const void* ptr);
+
+// Allocates nbytes of zero-filled, page aligned memory with a mapping of
+// their own that is bound to the given node, or returns nullptr if NUMA is not
+// enabled. Free it with NUMAFree() and the same size.
+void* NUMAAlloc(size_t nbytes, int numa_node_id);
+void NUMAFree(void* ptr, size_t nbytes);
+
+// The name of the replica of a blob on the given node, as created by
+// Workspace::ReplicateBlobPerNUMANode().
+std::string NUMAReplicaBlobName(const std::string& name, int numa_node_id);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_NUMA_H_
@@ -0,0 +1,119 @@
+#include <thread>  // NOLINT
+
+#include "caffe2/core/net.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+class NUMATest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    numa_enabled_ = FLAGS_caffe2_cpu_numa_enabled;
+  }
+  void TearDown() override {
+    FLAGS_caffe2_cpu_numa_enabled = numa_enabled_;
+  }
+
+  bool numa_enabled_;
+};
+
+void FillTensor(Workspace* ws, const string& name, float value) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(4);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < 4; ++i) {
+    data[i] = value;
+  }
+}
+
+}  // namespace
+
+TEST_F(NUMATest, ReplicaBlobName) {
+  EXPECT_EQ(NUMAReplicaBlobName("fc_w", 0), "fc_w_numa_0");
+  EXPECT_EQ(NUMAReplicaBlobName("fc_w", 3), "fc_w_numa_3");
+}
+
+TEST_F(NUMATest, DisabledIsNoop) {
+  FLAGS_caffe2_cpu_numa_enabled = false;
+  EXPECT_FALSE(IsNUMAEnabled());
+  EXPECT_EQ(GetNumNUMANodes(), 1);
+  std::thread thread([]() {
+    NUMABind(0);
+    EXPECT_EQ(GetCurrentNUMANode(), -1);
+  });
+  thread.join();
+
+  Workspace ws;
+  FillTensor(&ws, "w", 1.f);
+  EXPECT_EQ(ws.ReplicateBlobPerNUMANode("w"), 0);
+  EXPECT_FALSE(ws.HasBlob(NUMAReplicaBlobName("w", 0)));
+}
+
+TEST_F(NUMATest, NetsReadTheReplicaOfTheirNode) {
+  FLAGS_caffe2_cpu_numa_enabled = true;
+  if (!IsNUMAEnabled()) {
+    return;
+  }
+  Workspace ws;
+  FillTensor(&ws, "w", 1.f);
+  EXPECT_EQ(ws.ReplicateBlobPerNUMANode("w"), GetNumNUMANodes());
+  const auto& replica =
+      ws.GetBlob(NUMAReplicaBlobName("w", 0))->Get<TensorCPU>();
+  EXPECT_EQ(replica.size(), 4);
+  EXPECT_EQ(replica.data<float>()[3], 1.f);
+  // Tell the replica apart from the original blob.
+  FillTensor(&ws, NUMAReplicaBlobName("w", 0), 2.f);
+
+  NetDef net_def;
+  net_def.set_name("numa");
+  net_def.mutable_device_option()->set_numa_node_id(0);
+  auto* op = net_def.add_op();
+  op->set_type("Relu");
+  op->add_input("w");
+  op->add_output("y");
+  // The net writes to w_out, so it does not read a replica of it.
+  op = net_def.add_op();
+  op->set_type("Relu");
+  op->add_input("y");
+  op->add_output("w_out");
+  FillTensor(&ws, "y", 0.f);
+  ws.ReplicateBlobPerNUMANode("y");
+
+  std::thread thread([&]() {
+    EXPECT_TRUE(ws.RunNetOnce(net_def));
+    EXPECT_EQ(GetCurrentNUMANode(), 0);
+  });
+  thread.join();
+  EXPECT_EQ(ws.GetBlob("y")->Get<TensorCPU>().data<float>()[0], 2.f);
+  EXPECT_EQ(ws.GetBlob("w_out")->Get<TensorCPU>().data<float>()[0], 2.f);
+  // Memory allocated by a bound thread is on its node.
+  EXPECT_EQ(GetNUMANode(ws.GetBlob("y")->Get<TensorCPU>().raw_data()), 0);
+}
+
+TEST_F(NUMATest, BoundThreadsAllocateOnTheirNode) {
+  FLAGS_caffe2_cpu_numa_enabled = true;
+  if (!IsNUMAEnabled()) {
+    return;
+  }
+  SetCPUAllocator(new NUMACPUAllocator());
+  std::thread thread([]() {
+    NUMABind(0);
+    for (const int size : {1 << 10, 1 << 20}) {
+      TensorCPU tensor(vector<int>{size});
+      const float* data = tensor.mutable_data<float>();
+      EXPECT_EQ(GetNUMANode(data), 0);
+      EXPECT_EQ(data[size - 1], 0);
+    }
+  });
+  thread.join();
+  EXPECT_TRUE(GetCPUAllocator()->HasAllocated());
+  SetCPUAllocator(new DefaultCPUAllocator());
+}
+
+}  // namespace caffe2
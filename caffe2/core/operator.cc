@@ -5,6 +5,7 @@
 
 #include "caffe2/core/net.h"
 #include "caffe2/core/operator_gradient.h"
+#include "caffe2/core/worker_pool.h"
 #include "caffe2/core/workspace.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
@@ -13,7 +14,9 @@ namespace caffe2 {
 
 // TODO(Yangqing): move all the checks to a less fatal check mechanism.
 OperatorBase::OperatorBase(const OperatorDef& operator_def, Workspace* ws)
-    : operator_def_(operator_def), arg_helper_(operator_def_) {
+    : operator_def_(operator_def),
+      arg_helper_(operator_def_),
+      arena_(ws->GetArena()) {
   for (const string& input_str : operator_def_.input()) {
     auto* blob = ws->GetBlob(input_str);
     CAFFE_ENFORCE(blob != nullptr,
@@ -21,10 +24,42 @@ OperatorBase::OperatorBase(const OperatorDef& operator_def, Workspace* ws)
     inputs_.push_back(blob);
   }
   for (const string& output_str : operator_def_.output()) {
+    // Tensors allocated from the arena of a workspace cannot be written to
+    // blobs that outlive it.
+    CAFFE_ENFORCE(
+        !arena_ || ws->HasLocalBlob(output_str) || !ws->HasBlob(output_str),
+        "Operators of a workspace with an arena cannot write to blob ",
+        output_str,
+        " of the shared workspace.");
     outputs_.push_back(CHECK_NOTNULL(ws->CreateBlob(output_str)));
   }
 }
 
+void RunOnIOWorkerPool(
+    OperatorBase* op,
+    OperatorBase::CompletionCallback done) {
+  auto task = [op, done]() {
+    bool success = false;
+    try {
+      success = op->Run();
+    } catch (const std::exception& err) {
+      // There is nobody to rethrow to on the I/O worker pool, so we report
+      // the operator as failed instead.
+      LOG(ERROR) << "Exception from asynchronous operator "
+                 << ProtoDebugString(op->def()) << ": " << err.what();
+    } catch (...) {
+      LOG(ERROR) << "Unknown exception from asynchronous operator "
+                 << ProtoDebugString(op->def());
+    }
+    done(success);
+  };
+  if (op->io_worker_pool()) {
+    op->io_worker_pool()->Schedule(op->io_worker_pool_client(), task);
+  } else {
+    ScheduleIOTask(task);
+  }
+}
+
 namespace {
 unique_ptr<OperatorBase> TryCreateOperator(
     const string& key, const OperatorDef& operator_def, Workspace* ws) {
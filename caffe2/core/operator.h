@@ -3,6 +3,7 @@
 
 #include <climits>
 #include <cstddef>
+#include <functional>
 #include <typeinfo>
 #include <vector>
 
@@ -77,18 +78,56 @@ class OperatorBase {
   }
   virtual bool RunAsync() { return Run(); }
 
+  // Asynchronous completion, for operators that spend most of their time
+  // waiting, e.g. on a queue or on the network. If HasAsyncCompletion() is
+  // true, RunWithCompletion() may return before the operator finished, and
+  // calls done with the result of the operator, possibly from another thread,
+  // once it did. Executors that support it, such as DAGNet, then do not keep a
+  // worker thread blocked on the operator. Run() still has to block until the
+  // operator finished, for the executors that do not.
+  typedef std::function<void(bool)> CompletionCallback;
+  virtual bool HasAsyncCompletion() const {
+    return false;
+  }
+  virtual void RunWithCompletion(CompletionCallback done) {
+    done(Run());
+  }
+  // The worker pool RunOnIOWorkerPool() runs the operator on. Executors that
+  // run operators through RunWithCompletion() give each of them a thread of
+  // their own, so that any number of operators can wait at the same time, e.g.
+  // for a queue that another of them feeds. Without one, the operator uses the
+  // process-wide pool of ScheduleIOTask().
+  void SetIOWorkerPool(WorkerPool* pool, WorkerPool::ClientId client) {
+    io_worker_pool_ = pool;
+    io_worker_pool_client_ = client;
+  }
+  inline WorkerPool* io_worker_pool() const {
+    return io_worker_pool_;
+  }
+  inline WorkerPool::ClientId io_worker_pool_client() const {
+    return io_worker_pool_client_;
+  }
+
   inline const OperatorDef& def() const {
     return operator_def_;
   }
   inline const ArgumentHelper& arg_helper() const {
     return arg_helper_;
   }
+  // The arena of the workspace of the operator, if any, which the CPU tensors
+  // it allocates while running come from.
+  inline Arena* arena() const {
+    return arena_;
+  }
 
  private:
   OperatorDef operator_def_;
   ArgumentHelper arg_helper_;
   vector<const Blob*> inputs_;
   vector<Blob*> outputs_;
+  Arena* arena_;
+  WorkerPool* io_worker_pool_ = nullptr;
+  WorkerPool::ClientId io_worker_pool_client_ = -1;
 
   DISABLE_COPY_AND_ASSIGN(OperatorBase);
 };
@@ -149,6 +188,8 @@ class Operator : public OperatorBase {
   // the actual computation with RunOnDevice(). You should implement RunOnDevice
   // instead of Run().
   bool Run() final {
+    ProfiledOperatorScope<OperatorBase> profiled(this);
+    ArenaScope arena_scope(arena());
     try {
       context_.SwitchToDevice();
       bool started = RunOnDevice();
@@ -168,6 +209,8 @@ class Operator : public OperatorBase {
   }
 
   bool RunAsync() final {
+    ProfiledOperatorScope<OperatorBase> profiled(this);
+    ArenaScope arena_scope(arena());
     try {
       context_.SwitchToDevice();
       return RunOnDevice();
@@ -183,6 +226,13 @@ class Operator : public OperatorBase {
   Context context_;
 };
 
+// Runs the blocking Run() of the operator on its I/O worker pool, or on the
+// process-wide one if it has none, and calls done with its result. Operators
+// whose Run() waits on I/O can implement RunWithCompletion() with it.
+void RunOnIOWorkerPool(
+    OperatorBase* op,
+    OperatorBase::CompletionCallback done);
+
 #define USE_OPERATOR_BASE_FUNCTIONS                                 \
   /* using override */ using OperatorBase::HasArgument;             \
   /* using override */ using OperatorBase::GetSingleArgument;       \
@@ -168,6 +168,7 @@ OpSchema& OpSchema::EnforceOneToOneInplace() {
 OpSchema& OpSchema::TensorInferenceFunction(
     TensorInferenceFunctionType function) {
   tensor_inference_function_ = function;
+  has_tensor_inference_function_ = true;
   return *this;
 }
 
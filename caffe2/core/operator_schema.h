@@ -127,6 +127,14 @@ class OpSchema {
   OpSchema& EnforceInplace(std::function<bool(int, int)> inplace);
   OpSchema& EnforceInplace(set<std::pair<int, int>> inplace);
   OpSchema& EnforceOneToOneInplace();
+  /**
+   * @brief Returns whether output out_idx may be written in place of input
+   * in_idx, whether in-place is allowed or enforced.
+   */
+  inline bool inplace_allowed(int in_idx, int out_idx) const {
+    return inplace_allowed_(in_idx, out_idx) ||
+        inplace_enforced_(in_idx, out_idx);
+  }
 
   // Functions to deal with type and shape inference. Basically, this registers
   // a function that takes in an OperatorDef and a series of input type and
@@ -145,6 +153,13 @@ class OpSchema {
    * the input.
    */
   OpSchema& IdenticalTypeAndShape();
+  /**
+   * @brief Returns whether a tensor inference function was registered. If
+   * not, InferTensor() returns outputs with nothing set.
+   */
+  inline bool has_tensor_inference_function() const {
+    return has_tensor_inference_function_;
+  }
   /**
    * @brief A function to allow one to infer the type and shape from the op
    * schema.
@@ -205,6 +220,7 @@ class OpSchema {
       = [](int, int) { return false; };
   std::function<bool(int, int)> inplace_enforced_
       = [](int, int) { return false; };
+  bool has_tensor_inference_function_ = false;
   TensorInferenceFunctionType tensor_inference_function_ =
       [](const OperatorDef& def, const vector<TensorProto>&) {
         // In default, return a vector of TensorProto that has nothing set.
@@ -258,6 +274,20 @@ class OpSchemaRegistry {
   static CaffeMap<string, OpSchema>& map();
 };
 
+// Helper function for creating the type and shape of a tensor, as consumed
+// and produced by the tensor inference functions.
+template <typename T_I = int>
+inline TensorProto CreateTensorShape(
+    const vector<T_I>& dims,
+    TensorProto::DataType dt) {
+  TensorProto tp;
+  for (const auto d : dims) {
+    tp.add_dims(d);
+  }
+  tp.set_data_type(dt);
+  return tp;
+}
+
 }  // namespace caffe2
 
 #define OPERATOR_SCHEMA(name)                                                 \
@@ -4,9 +4,12 @@
 
 #include "caffe2/core/net.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/utils/proto_utils.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 
+CAFFE2_DECLARE_int(caffe2_worker_pool_num_workers);
+
 namespace caffe2 {
 
 using std::clock_t;
@@ -19,7 +22,7 @@ const int kTimeThreshold = 20;
 // We allow arbitrary inputs and at most one output so that we can
 // test scaffolding of networks. If the output is 1, it will be filled with
 // vector<clock_t> with two elements: start time and end time.
-class SleepOp final : public Operator<CPUContext> {
+class SleepOp : public Operator<CPUContext> {
  public:
   SleepOp(const OperatorDef& operator_def, Workspace* ws)
       : Operator<CPUContext>(operator_def, ws),
@@ -47,9 +50,60 @@ class SleepOp final : public Operator<CPUContext> {
 
 OPERATOR_SCHEMA(Sleep).NumInputs(0, INT_MAX).NumOutputs(0, 1);
 
+// AsyncSleepOp sleeps like SleepOp, but on the I/O worker pool, so it behaves
+// like an operator waiting for I/O.
+class AsyncSleepOp final : public SleepOp {
+ public:
+  using SleepOp::SleepOp;
+
+  bool HasAsyncCompletion() const override {
+    return true;
+  }
+  void RunWithCompletion(CompletionCallback done) override {
+    RunOnIOWorkerPool(this, std::move(done));
+  }
+};
+
+OPERATOR_SCHEMA(AsyncSleep).NumInputs(0, INT_MAX).NumOutputs(0, 1);
+
+// ParallelNetTestThrowOp throws instead of running.
+class ParallelNetTestThrowOp final : public OperatorBase {
+ public:
+  using OperatorBase::OperatorBase;
+
+  bool Run() override {
+    CAFFE_THROW("ParallelNetTestThrow always throws.");
+  }
+};
+
+OPERATOR_SCHEMA(ParallelNetTestThrow).NumInputs(0, INT_MAX).NumOutputs(0, 1);
+
+// ParallelNetTestRunNetOp runs the net of the workspace named by its "net"
+// argument.
+class ParallelNetTestRunNetOp final : public OperatorBase {
+ public:
+  ParallelNetTestRunNetOp(const OperatorDef& operator_def, Workspace* ws)
+      : OperatorBase(operator_def, ws),
+        ws_(ws),
+        net_(OperatorBase::GetSingleArgument<string>("net", "")) {}
+
+  bool Run() override {
+    return ws_->RunNet(net_);
+  }
+
+ private:
+  Workspace* ws_;
+  string net_;
+};
+
+OPERATOR_SCHEMA(ParallelNetTestRunNet).NumInputs(0, INT_MAX).NumOutputs(0, 1);
+
 namespace {
 REGISTER_CPU_OPERATOR(Sleep, SleepOp);
 REGISTER_CUDA_OPERATOR(Sleep, SleepOp);
+REGISTER_CPU_OPERATOR(AsyncSleep, AsyncSleepOp);
+REGISTER_CPU_OPERATOR(ParallelNetTestThrow, ParallelNetTestThrowOp);
+REGISTER_CPU_OPERATOR(ParallelNetTestRunNet, ParallelNetTestRunNetOp);
 }  // namespace
 
 const char kSleepNetDefString[] =
@@ -111,6 +165,63 @@ TEST(DAGNetTest, TestDAGNetTiming) {
   EXPECT_NEAR(ms, 200, kTimeThreshold);
 }
 
+TEST(DAGNetTest, TestDAGNetTimingOnWorkerPool) {
+  auto old = FLAGS_caffe2_worker_pool_num_workers;
+  FLAGS_caffe2_worker_pool_num_workers = 4;
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kSleepNetDefString), &net_def));
+  *net_def.add_arg() = MakeArgument<int>("use_worker_pool", 1);
+  Workspace ws;
+  // Two nets share the four threads of the pool, each using at most two.
+  unique_ptr<NetBase> net1(CreateNet(net_def, &ws));
+  unique_ptr<NetBase> net2(CreateNet(net_def, &ws));
+  FLAGS_caffe2_worker_pool_num_workers = old;
+  EXPECT_EQ(ws.GetWorkerPool()->num_workers(), 4);
+  auto start_time = std::chrono::system_clock::now();
+  std::thread other([&]() { CHECK(net2->Run()); });
+  CHECK(net1->Run());
+  other.join();
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now() - start_time);
+  EXPECT_NEAR(duration.count(), 200, kTimeThreshold);
+}
+
+TEST(DAGNetTest, TestNestedDAGNetsOnWorkerPool) {
+  auto old = FLAGS_caffe2_worker_pool_num_workers;
+  FLAGS_caffe2_worker_pool_num_workers = 2;
+  NetDef inner_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kSleepNetDefString), &inner_def));
+  *inner_def.add_arg() = MakeArgument<int>("use_worker_pool", 1);
+  Workspace ws;
+  NetDef outer_def;
+  outer_def.set_name("outer");
+  outer_def.set_type("dag");
+  outer_def.set_num_workers(2);
+  *outer_def.add_arg() = MakeArgument<int>("use_worker_pool", 1);
+  for (int i = 0; i < 2; ++i) {
+    inner_def.set_name("inner" + caffe2::to_string(i));
+    ASSERT_TRUE(ws.CreateNet(inner_def) != nullptr);
+    auto* op = outer_def.add_op();
+    op->set_type("ParallelNetTestRunNet");
+    op->add_output("ran" + caffe2::to_string(i));
+    *op->add_arg() = MakeArgument<string>("net", inner_def.name());
+  }
+  ASSERT_TRUE(ws.CreateNet(outer_def) != nullptr);
+  FLAGS_caffe2_worker_pool_num_workers = old;
+  // The outer net holds both workers of the pool while the inner nets run, so
+  // each worker runs the chains of its inner net itself. A worker done with
+  // its inner net may still help with the other one, so the nets finish
+  // between the time of one of them and of both in sequence.
+  auto start_time = std::chrono::system_clock::now();
+  EXPECT_TRUE(ws.RunNet("outer"));
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now() - start_time);
+  EXPECT_GE(duration.count(), 350 - kTimeThreshold);
+  EXPECT_LT(duration.count(), 700);
+}
+
 // For sanity check, we also test the sequential time - it should take 0.35
 // seconds instead since everything has to be sequential.
 TEST(SimpleNetTest, TestSimpleNetTiming) {
@@ -118,6 +229,76 @@ TEST(SimpleNetTest, TestSimpleNetTiming) {
   EXPECT_NEAR(ms, 350, kTimeThreshold);
 }
 
+// This network has three independent operators, and the last one has a child.
+// With two workers and FIFO scheduling, sleep3 only starts after sleep1 and
+// sleep2 have finished, so the net takes 300ms. Critical path scheduling
+// starts sleep3 first since it is on the longest path, which takes 200ms.
+const char kSleepNetDefStringCriticalPath[] = R"DOC(
+  name: "sleepnet"
+  type: "dag"
+  num_workers: 2
+  op {
+    output: "sleep1"
+    name: "sleep1"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    output: "sleep2"
+    name: "sleep2"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    output: "sleep3"
+    name: "sleep3"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    input: "sleep3"
+    output: "sleep4"
+    name: "sleep4"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+)DOC";
+
+TEST(DAGNetTest, TestDAGNetTimingFIFO) {
+  int ms = RunNetAndGetDuration(
+      string(kSleepNetDefStringCriticalPath), "dag");
+  EXPECT_NEAR(ms, 300, kTimeThreshold);
+}
+
+TEST(DAGNetTest, TestDAGNetTimingCriticalPath) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kSleepNetDefStringCriticalPath), &net_def));
+  *net_def.add_arg() = MakeArgument<string>("scheduling", "critical_path");
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  // Run a few times so that the measured op times are used as well.
+  for (int i = 0; i < 3; ++i) {
+    auto start_time = std::chrono::system_clock::now();
+    CHECK(net->Run());
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now() - start_time);
+    EXPECT_NEAR(duration.count(), 200, kTimeThreshold);
+  }
+}
+
 // This network has two operators reading the same blob at the same time. This
 // should not change anything and the DAG should still make sleep2 and sleep3
 // run in parallel.
@@ -155,6 +336,17 @@ const char kSleepNetDefStringReadAfterRead[] =
 "    }"
 "  }";
 
+TEST(DAGWSNetTest, TestDAGWSNetTiming) {
+  int ms = RunNetAndGetDuration(string(kSleepNetDefString), "dag_ws");
+  EXPECT_NEAR(ms, 200, kTimeThreshold);
+}
+
+TEST(DAGWSNetTest, TestDAGWSNetTimingReadAfterRead) {
+  int ms = RunNetAndGetDuration(
+      string(kSleepNetDefStringReadAfterRead), "dag_ws");
+  EXPECT_NEAR(ms, 250, kTimeThreshold);
+}
+
 TEST(DAGNetTest, TestDAGNetTimingReadAfterRead) {
   int ms = RunNetAndGetDuration(string(kSleepNetDefStringReadAfterRead), "dag");
   EXPECT_NEAR(ms, 250, kTimeThreshold);
@@ -209,6 +401,12 @@ TEST(DAGNetTest, TestDAGNetTimingWriteAfterWrite) {
   EXPECT_NEAR(ms, 350, kTimeThreshold);
 }
 
+TEST(DAGWSNetTest, TestDAGWSNetTimingWriteAfterWrite) {
+  int ms = RunNetAndGetDuration(
+      string(kSleepNetDefStringWriteAfterWrite), "dag_ws");
+  EXPECT_NEAR(ms, 350, kTimeThreshold);
+}
+
 TEST(SimpleNetTest, TestSimpleNetTimingWriteAfterWrite) {
   int ms = RunNetAndGetDuration(
       string(kSleepNetDefStringWriteAfterWrite), "simple");
@@ -307,10 +505,391 @@ TEST(DAGNetTest, TestDAGNetTimingControlDependency) {
   EXPECT_NEAR(ms, 350, kTimeThreshold);
 }
 
+TEST(DAGWSNetTest, TestDAGWSNetTimingControlDependency) {
+  int ms = RunNetAndGetDuration(
+      string(kSleepNetDefStringControlDependency), "dag_ws");
+  EXPECT_NEAR(ms, 350, kTimeThreshold);
+}
+
+TEST(DAGWSNetTest, TestDAGWSNetOperatorThrows) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      R"DOC(
+        name: "thrownet"
+        type: "dag_ws"
+        num_workers: 2
+        op {
+          output: "sleep1"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 20
+          }
+        }
+        op {
+          input: "sleep1"
+          output: "throw"
+          type: "ParallelNetTestThrow"
+        }
+        op {
+          input: "throw"
+          output: "sleep2"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 10
+          }
+        }
+      )DOC",
+      &net_def));
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net.get() != nullptr);
+  // The run fails instead of losing the worker, and the net can run again.
+  EXPECT_FALSE(net->Run());
+  EXPECT_FALSE(net->Run());
+  EXPECT_TRUE(ws.GetBlob("sleep2") != nullptr);
+}
+
+TEST(DAGWSNetTest, TestDAGWSNetIdleWorkersSleep) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      R"DOC(
+        name: "sleepnet"
+        type: "dag_ws"
+        num_workers: 4
+        op {
+          output: "sleep1"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 200
+          }
+        }
+      )DOC",
+      &net_def));
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net.get() != nullptr);
+  // The CPU time of the process: the workers without an operator to run do
+  // not spin while the only operator sleeps.
+  clock_t start = clock();
+  EXPECT_TRUE(net->Run());
+  const int cpu_ms = (clock() - start) * 1000 / CLOCKS_PER_SEC;
+  EXPECT_LT(cpu_ms, 100);
+}
+
 TEST(SimpleNetTest, TestSimpleNetTimingControlDependency) {
   int ms = RunNetAndGetDuration(
       string(kSleepNetDefStringControlDependency), "simple");
   EXPECT_NEAR(ms, 350, kTimeThreshold);
 }
 
+// A linear net of three stages. A single run takes 300ms, but with
+// pipelining, the stages of consecutive runs overlap.
+const char kSleepNetDefStringPipeline[] = R"DOC(
+  name: "sleepnet"
+  type: "dag_pipelined"
+  num_workers: 3
+  arg {
+    name: "max_in_flight"
+    i: 3
+  }
+  op {
+    output: "stage1"
+    name: "stage1"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    input: "stage1"
+    output: "stage2"
+    name: "stage2"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    input: "stage2"
+    output: "stage3"
+    name: "stage3"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+)DOC";
+
+TEST(PipelinedDAGNetTest, TestPipelinedDAGNetTiming) {
+  int ms = RunNetAndGetDuration(string(kSleepNetDefString), "dag_pipelined");
+  EXPECT_NEAR(ms, 200, kTimeThreshold);
+}
+
+TEST(PipelinedDAGNetTest, TestPipelinedDAGNetOverlappingRuns) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kSleepNetDefStringPipeline), &net_def));
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  auto start_time = std::chrono::system_clock::now();
+  std::vector<std::thread> runners;
+  for (int i = 0; i < 3; ++i) {
+    runners.emplace_back([&]() { CHECK(net->Run()); });
+  }
+  for (auto& runner : runners) {
+    runner.join();
+  }
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now() - start_time);
+  // Each run starts one stage after the previous one, instead of 900ms for
+  // three sequential runs.
+  EXPECT_NEAR(duration.count(), 500, kTimeThreshold);
+  // The per-iteration blobs of the other slots have their own copies.
+  EXPECT_TRUE(ws.HasBlob("stage2"));
+  EXPECT_TRUE(ws.HasBlob("stage2_pipeline_slot_1"));
+  EXPECT_TRUE(ws.HasBlob("stage2_pipeline_slot_2"));
+  // So do the outputs in every slot, which are moved to their own name when
+  // their run returns.
+  EXPECT_TRUE(ws.HasBlob("stage3_pipeline_slot_0"));
+  EXPECT_TRUE(ws.GetBlob("stage3")->IsType<vector<clock_t>>());
+}
+
+TEST(PipelinedDAGNetTest, TestPipelinedDAGNetOperatorThrows) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      R"DOC(
+        name: "thrownet"
+        type: "dag_pipelined"
+        num_workers: 2
+        op {
+          output: "sleep1"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 20
+          }
+        }
+        op {
+          input: "sleep1"
+          output: "throw"
+          type: "ParallelNetTestThrow"
+        }
+        op {
+          input: "throw"
+          output: "sleep2"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 10
+          }
+        }
+      )DOC",
+      &net_def));
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net.get() != nullptr);
+  // The iteration fails instead of losing the worker, its dependents still
+  // run, and the slots can be used again.
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(net->Run());
+  }
+  EXPECT_TRUE(ws.GetBlob("sleep2") != nullptr);
+}
+
+TEST(PipelinedDAGNetTest, TestPipelinedDAGNetSharedOutput) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kSleepNetDefStringPipeline), &net_def));
+  // stage3 is declared as an output, so each run still writes its own copy.
+  // stage1 becomes a control input of the op writing it, i.e. it is read
+  // before it is written and is shared too. stage1 of the next run then has
+  // to wait for stage3 of the previous run, which reads it.
+  net_def.add_external_output("stage3");
+  net_def.mutable_op(2)->add_input("stage1");
+  net_def.mutable_op(0)->add_control_input("stage1");
+  Workspace ws;
+  ws.CreateBlob("stage1");
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  auto start_time = std::chrono::system_clock::now();
+  std::thread other([&]() { CHECK(net->Run()); });
+  CHECK(net->Run());
+  other.join();
+  auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now() - start_time);
+  EXPECT_NEAR(duration.count(), 600, kTimeThreshold);
+  EXPECT_FALSE(ws.HasBlob("stage1_pipeline_slot_1"));
+  EXPECT_TRUE(ws.HasBlob("stage2_pipeline_slot_1"));
+  EXPECT_TRUE(ws.HasBlob("stage3_pipeline_slot_1"));
+}
+
+TEST(PipelinedDAGNetTest, TestPipelinedDAGNetOutputsOfEachRun) {
+  // Each run copies the iteration counter to its outputs, and then sleeps.
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      R"DOC(
+        type: "dag_pipelined"
+        num_workers: 3
+        external_output: "iter"
+        op {
+          input: "ITER"
+          output: "ITER"
+          type: "Iter"
+        }
+        op {
+          input: "ITER"
+          output: "iter"
+          type: "Copy"
+        }
+        op {
+          input: "ITER"
+          output: "undeclared"
+          type: "Copy"
+        }
+        op {
+          input: "iter"
+          output: "done"
+          type: "Sleep"
+          arg {
+            name: "ms"
+            i: 100
+          }
+        }
+      )DOC",
+      &net_def));
+  Workspace ws;
+  auto* counter = ws.CreateBlob("ITER")->GetMutable<TensorCPU>();
+  counter->Resize(1);
+  counter->mutable_data<int64_t>()[0] = 0;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  auto fetch = [&](const string& name) {
+    return ws.GetBlob(name)->Get<TensorCPU>().data<int64_t>()[0];
+  };
+  // The outputs of runs made one after the other are the ones of the last
+  // run, whichever slot it ran on, even for outputs that are not declared.
+  for (int i = 1; i <= 3; ++i) {
+    CHECK(net->Run());
+    EXPECT_EQ(fetch("iter"), i);
+    EXPECT_EQ(fetch("undeclared"), i);
+  }
+  // The next run writes its outputs while the previous one still runs, but
+  // they only replace the outputs of the previous run when it returns, 100ms
+  // after the previous one.
+  std::thread other([&]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CHECK(net->Run());
+  });
+  CHECK(net->Run());
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(fetch("iter"), 4);
+  other.join();
+  EXPECT_EQ(fetch("iter"), 5);
+}
+
+// Two operators that wait on I/O and one compute operator, all independent.
+// With a single worker, the net takes 300ms if the worker blocks on every
+// operator, but the I/O operators complete asynchronously, so the worker can
+// run the compute operator in the meantime.
+const char kSleepNetDefStringAsync[] = R"DOC(
+  name: "sleepnet"
+  type: "dag"
+  num_workers: 1
+  op {
+    output: "io1"
+    name: "io1"
+    type: "AsyncSleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    output: "io2"
+    name: "io2"
+    type: "AsyncSleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    output: "compute"
+    name: "compute"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+  op {
+    input: "io1"
+    input: "io2"
+    input: "compute"
+    output: "sink"
+    name: "sink"
+    type: "Sleep"
+    arg {
+      name: "ms"
+      i: 100
+    }
+  }
+)DOC";
+
+TEST(DAGNetTest, TestDAGNetTimingAsyncCompletion) {
+  int ms = RunNetAndGetDuration(string(kSleepNetDefStringAsync), "dag");
+  EXPECT_NEAR(ms, 200, kTimeThreshold);
+}
+
+TEST(SimpleNetTest, TestSimpleNetTimingAsyncCompletion) {
+  int ms = RunNetAndGetDuration(string(kSleepNetDefStringAsync), "simple");
+  EXPECT_NEAR(ms, 400, kTimeThreshold);
+}
+
+TEST(DAGNetTest, TestDAGNetManyBlockedDequeues) {
+  // More dequeues than the process-wide I/O worker pool has threads wait on
+  // the queue before the enqueues that feed them start.
+  const int kNumDequeues = 12;
+  Workspace ws;
+  OperatorDef create_def;
+  create_def.set_type("CreateBlobsQueue");
+  create_def.add_output("queue");
+  *create_def.add_arg() = MakeArgument<int>("capacity", 1);
+  ASSERT_TRUE(ws.RunOperatorOnce(create_def));
+
+  NetDef net_def;
+  net_def.set_type("dag");
+  net_def.set_num_workers(1);
+  for (int i = 0; i < kNumDequeues; ++i) {
+    auto* op = net_def.add_op();
+    op->set_type("DequeueBlobs");
+    op->add_input("queue");
+    op->add_output("out" + caffe2::to_string(i));
+  }
+  auto* wait = net_def.add_op();
+  wait->set_type("Sleep");
+  wait->add_output("fed");
+  *wait->add_arg() = MakeArgument<int>("ms", 50);
+  for (int i = 0; i < kNumDequeues; ++i) {
+    const string in = "in" + caffe2::to_string(i);
+    ws.CreateBlob(in)->GetMutable<int>();
+    auto* op = net_def.add_op();
+    op->set_type("EnqueueBlobs");
+    op->add_input("queue");
+    op->add_input(in);
+    op->add_output(in);
+    op->add_control_input("fed");
+  }
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net.get() != nullptr);
+  EXPECT_TRUE(net->Run());
+  for (int i = 0; i < kNumDequeues; ++i) {
+    EXPECT_TRUE(ws.GetBlob("out" + caffe2::to_string(i))->IsType<int>());
+  }
+}
+
 }  // namespace caffe2
@@ -1,32 +1,26 @@
 #include "caffe2/core/predictor.h"
 
+#include <algorithm>
+
 namespace caffe2 {
 
 namespace {
 
-void enforceIsTensor(Workspace* ws, const std::string& name) {
-  auto blob = ws->GetBlob(name);
-  CAFFE_ENFORCE(blob, "Blob does not exist: ", name);
+void enforceIsTensor(const Blob* blob, const std::string& name) {
   CAFFE_ENFORCE(
       blob->template IsType<TensorCPU>(), "Blob is not a CPU Tensor: ", name);
 }
 
-void shareInputTensor(
-    Workspace* ws,
-    const std::string& name,
-    TensorCPU* input) {
-  enforceIsTensor(ws, name);
-  auto* blob = ws->GetBlob(name);
-  CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
+void shareInputTensor(Blob* blob, const std::string& name, TensorCPU* input) {
+  enforceIsTensor(blob, name);
   auto* tensor = blob->template GetMutable<TensorCPU>();
-  tensor->ResizeLike(*input);
-  tensor->ShareData(*input);
+  // Nets writing to their inputs get a copy instead of clobbering the caller's
+  // tensors.
+  tensor->ShareDataCopyOnWrite(*input);
 }
 
-TensorCPU* extractOutputTensor(Workspace* ws, const std::string& name) {
-  enforceIsTensor(ws, name);
-  auto* blob = ws->GetBlob(name);
-  CAFFE_ENFORCE(blob, "Blob: ", name, " does not exist");
+TensorCPU* extractOutputTensor(Blob* blob, const std::string& name) {
+  enforceIsTensor(blob, name);
   return blob->template GetMutable<TensorCPU>();
 }
 }
@@ -34,20 +28,38 @@ TensorCPU* extractOutputTensor(Workspace* ws, const std::string& name) {
 Predictor::Predictor(const NetDef& init_net, const NetDef& run_net)
     : run_net_(run_net) {
   CAFFE_ENFORCE(ws_.RunNetOnce(init_net));
-  CAFFE_ENFORCE(ws_.CreateNet(run_net));
+  net_ = ws_.CreateNet(run_net);
+  CAFFE_ENFORCE(net_);
+  for (const auto& name : run_net_.external_input()) {
+    inputs_.push_back(ws_.CreateBlob(name));
+  }
+  for (const auto& name : run_net_.external_output()) {
+    outputs_.push_back(ws_.CreateBlob(name));
+  }
 }
 
 void Predictor::run(const TensorVector& inputs, TensorVector* outputs) {
-  CAFFE_ENFORCE(inputs.size() <= run_net_.external_input_size());
+  CAFFE_ENFORCE(inputs.size() <= inputs_.size());
   for (auto i = 0; i < inputs.size(); ++i) {
-    shareInputTensor(&ws_, run_net_.external_input(i), inputs[i]);
+    shareInputTensor(inputs_[i], run_net_.external_input(i), inputs[i]);
   }
 
-  CAFFE_ENFORCE(ws_.RunNet(run_net_.name()));
+  CAFFE_ENFORCE(net_->Run());
 
-  outputs->resize(run_net_.external_output_size());
+  outputs->resize(outputs_.size());
   for (auto i = 0; i < outputs->size(); ++i) {
-    (*outputs)[i] = extractOutputTensor(&ws_, run_net_.external_output(i));
+    (*outputs)[i] =
+        extractOutputTensor(outputs_[i], run_net_.external_output(i));
+  }
+
+  // Drops the workspace's reference to the storage of the inputs, so that
+  // the caller can write them in place again. The blobs keep their tensors
+  // for the next run.
+  for (auto i = 0; i < inputs.size(); ++i) {
+    if (std::find(outputs_.begin(), outputs_.end(), inputs_[i]) ==
+        outputs_.end()) {
+      inputs_[i]->GetMutable<TensorCPU>()->FreeMemory();
+    }
   }
 }
 }
@@ -34,5 +34,9 @@ class Predictor {
  private:
   NetDef run_net_;
   Workspace ws_;
+  // Looked up once, so that run() does no lookups by name.
+  NetBase* net_;
+  std::vector<Blob*> inputs_;
+  std::vector<Blob*> outputs_;
 };
 }
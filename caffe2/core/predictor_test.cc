@@ -118,4 +118,28 @@ TEST_F(PredictorTest, SimpleBatchSized) {
   EXPECT_TRUE(output.front()->dim(1) == 10);
   EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
 }
+
+TEST_F(PredictorTest, InputsNotSharedAfterRun) {
+  auto inputData = randomTensor({1, 4}, ctx_.get());
+  auto* input = inputData->template GetMutable<TensorCPU>();
+  const float* data = input->data<float>();
+  Predictor::TensorVector output;
+  p_->run({input}, &output);
+  // The workspace no longer shares the storage of the input, so writing it
+  // does not copy it.
+  EXPECT_EQ(input->mutable_data<float>(), data);
+  const TensorCPU* tensor = &p_->ws()->GetBlob("data")->Get<TensorCPU>();
+  const float first = output.front()->data<float>()[4];
+  // The predictor still runs with other inputs.
+  auto otherData = randomTensor({1, 4}, ctx_.get());
+  auto* other = otherData->template GetMutable<TensorCPU>();
+  const float* otherPtr = other->data<float>();
+  p_->run({other}, &output);
+  EXPECT_EQ(output.size(), 1);
+  EXPECT_EQ(output.front()->dim(1), 10);
+  EXPECT_NE(output.front()->data<float>()[4], first);
+  EXPECT_EQ(other->mutable_data<float>(), otherPtr);
+  // The input blob keeps its tensor across runs.
+  EXPECT_EQ(&p_->ws()->GetBlob("data")->Get<TensorCPU>(), tensor);
+}
 }
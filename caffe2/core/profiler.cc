@@ -0,0 +1,163 @@
+#include "caffe2/core/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <sstream>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+std::atomic<bool> Profiler::enabled_{false};
+thread_local int64_t Profiler::thread_bytes_allocated_ = 0;
+
+namespace {
+
+struct ThreadEvents {
+  int thread_id;
+  // Only contended while the events are collected.
+  std::mutex mutex;
+  std::vector<ProfileEvent> events;
+};
+
+// The event buffers of all the threads that ever recorded an event. Buffers
+// are kept after their thread exits, so that its events can still be dumped.
+struct ThreadEventsRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadEvents>> buffers;
+};
+
+ThreadEventsRegistry& EventsRegistry() {
+  static ThreadEventsRegistry* registry = new ThreadEventsRegistry();
+  return *registry;
+}
+
+ThreadEvents& LocalEvents() {
+  static thread_local std::shared_ptr<ThreadEvents> local;
+  if (!local) {
+    local = std::make_shared<ThreadEvents>();
+    auto& registry = EventsRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    local->thread_id = registry.buffers.size();
+    registry.buffers.push_back(local);
+  }
+  return *local;
+}
+
+void AppendJSONString(const std::string& str, std::ostream* out) {
+  *out << '"';
+  for (const char c : str) {
+    switch (c) {
+      case '"':
+        *out << "\\\"";
+        break;
+      case '\\':
+        *out << "\\\\";
+        break;
+      case '\n':
+        *out << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          *out << ' ';
+        } else {
+          *out << c;
+        }
+    }
+  }
+  *out << '"';
+}
+
+}  // namespace
+
+void Profiler::Enable() {
+  enabled_ = true;
+}
+
+void Profiler::Disable() {
+  enabled_ = false;
+}
+
+void Profiler::Clear() {
+  auto& registry = EventsRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    buffer->events.clear();
+  }
+}
+
+void Profiler::ClearSince(int64_t start_us) {
+  auto& registry = EventsRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    auto& events = buffer->events;
+    events.erase(
+        std::remove_if(
+            events.begin(),
+            events.end(),
+            [start_us](const ProfileEvent& event) {
+              return event.start_us >= start_us;
+            }),
+        events.end());
+  }
+}
+
+std::vector<ProfileEvent> Profiler::Events() {
+  std::vector<ProfileEvent> events;
+  auto& registry = EventsRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+    events.insert(events.end(), buffer->events.begin(), buffer->events.end());
+  }
+  return events;
+}
+
+std::string Profiler::ChromeTrace() {
+  std::ostringstream out;
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& event : Events()) {
+    if (!first) {
+      out << ",";
+    }
+    first = false;
+    out << "\n{\"name\":";
+    AppendJSONString(event.name.size() ? event.name : event.type, &out);
+    out << ",\"cat\":\"operator\",\"ph\":\"X\",\"ts\":" << event.start_us
+        << ",\"dur\":" << event.end_us - event.start_us
+        << ",\"pid\":0,\"tid\":" << event.thread_id << ",\"args\":{\"type\":";
+    AppendJSONString(event.type, &out);
+    out << ",\"bytes_allocated\":" << event.bytes_allocated << "}}";
+  }
+  out << "\n]}\n";
+  return out.str();
+}
+
+void Profiler::DumpChromeTrace(const std::string& filename) {
+  std::ofstream out(filename);
+  CAFFE_ENFORCE(out.good(), "Cannot open ", filename, " for writing.");
+  out << ChromeTrace();
+  CAFFE_ENFORCE(out.good(), "Failed to write the trace to ", filename);
+  LOG(INFO) << "Wrote the profiler trace to " << filename;
+}
+
+int64_t Profiler::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Profiler::Record(ProfileEvent event) {
+  auto& local = LocalEvents();
+  event.thread_id = local.thread_id;
+  std::lock_guard<std::mutex> lock(local.mutex);
+  local.events.push_back(std::move(event));
+}
+
+}  // namespace caffe2
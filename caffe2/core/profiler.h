@@ -0,0 +1,113 @@
+#ifndef CAFFE2_CORE_PROFILER_H_
+#define CAFFE2_CORE_PROFILER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace caffe2 {
+
+/**
+ * @brief A single profiled operator run.
+ *
+ * Times are in microseconds since an arbitrary, process-wide epoch, and the
+ * thread id is a small integer assigned to each thread the first time it
+ * records an event.
+ */
+struct ProfileEvent {
+  std::string name;
+  std::string type;
+  // Identifies the operator instance, e.g. to aggregate the events of a net.
+  const void* op;
+  int64_t start_us;
+  int64_t end_us;
+  int thread_id;
+  // The number of bytes allocated with CPUContext::New by the thread while
+  // running the operator.
+  int64_t bytes_allocated;
+};
+
+/**
+ * @brief A process-wide, low-overhead operator profiler.
+ *
+ * When enabled, every operator run through Operator<Context>::Run() or
+ * RunAsync(), whichever net runs it, records a ProfileEvent. Each thread
+ * appends to its own event buffer, so recording does not contend between
+ * threads. When disabled, which is the default, the cost of the hook is a
+ * single relaxed atomic load per operator.
+ *
+ * The events can be dumped in the Chrome trace event format and inspected in
+ * chrome://tracing, which shows what every worker thread was doing over time.
+ */
+class Profiler {
+ public:
+  static inline bool IsEnabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+  static void Enable();
+  static void Disable();
+  // Drops all the events recorded so far.
+  static void Clear();
+  // Drops the events that started at or after start_us, e.g. the ones of a
+  // profiling session that is over.
+  static void ClearSince(int64_t start_us);
+  // Returns all the events recorded so far, by thread, then by end time.
+  static std::vector<ProfileEvent> Events();
+  // Returns the recorded events as a Chrome trace JSON string.
+  static std::string ChromeTrace();
+  // Writes the Chrome trace JSON to the given file.
+  static void DumpChromeTrace(const std::string& filename);
+
+  static int64_t NowMicros();
+  static void Record(ProfileEvent event);
+  // Called by the allocator, only while profiling is enabled.
+  static inline void CountAllocation(size_t nbytes) {
+    thread_bytes_allocated_ += nbytes;
+  }
+  static inline int64_t ThreadBytesAllocated() {
+    return thread_bytes_allocated_;
+  }
+
+ private:
+  static std::atomic<bool> enabled_;
+  static thread_local int64_t thread_bytes_allocated_;
+};
+
+/**
+ * @brief Records a ProfileEvent for the lifetime of the object, if the
+ * profiler was enabled when the object was created.
+ */
+template <class Op>
+class ProfiledOperatorScope {
+ public:
+  explicit ProfiledOperatorScope(const Op* op)
+      : op_(Profiler::IsEnabled() ? op : nullptr) {
+    if (op_) {
+      start_us_ = Profiler::NowMicros();
+      start_bytes_ = Profiler::ThreadBytesAllocated();
+    }
+  }
+  ~ProfiledOperatorScope() {
+    if (op_) {
+      Profiler::Record(ProfileEvent{op_->def().name(),
+                                    op_->def().type(),
+                                    op_,
+                                    start_us_,
+                                    Profiler::NowMicros(),
+                                    0,
+                                    Profiler::ThreadBytesAllocated() -
+                                        start_bytes_});
+    }
+  }
+
+ private:
+  const Op* op_;
+  int64_t start_us_ = 0;
+  int64_t start_bytes_ = 0;
+};
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_PROFILER_H_
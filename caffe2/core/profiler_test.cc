@@ -0,0 +1,126 @@
+#include <string>
+#include <thread>  // NOLINT
+
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/profiler.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Fills its output with 256 floats.
+class ProfilerTestOp final : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+  bool RunOnDevice() override {
+    auto* output = Output(0);
+    output->Resize(256);
+    output->mutable_data<float>();
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(ProfilerTest, ProfilerTestOp);
+OPERATOR_SCHEMA(ProfilerTest).NumInputs(0, INT_MAX).NumOutputs(1);
+
+const char kProfilerTestNet[] = R"DOC(
+  name: "profiled"
+  op {
+    output: "a"
+    name: "first"
+    type: "ProfilerTest"
+  }
+  op {
+    input: "a"
+    output: "b"
+    name: "second"
+    type: "ProfilerTest"
+  }
+)DOC";
+
+unique_ptr<NetBase> CreateProfilerTestNet(Workspace* ws, const string& type) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(kProfilerTestNet), &net_def));
+  net_def.set_type(type);
+  return CreateNet(net_def, ws);
+}
+
+}  // namespace
+
+TEST(ProfilerTest, RecordsOperatorsOnlyWhenEnabled) {
+  Workspace ws;
+  auto net = CreateProfilerTestNet(&ws, "simple");
+  Profiler::Clear();
+  EXPECT_TRUE(net->Run());
+  EXPECT_EQ(Profiler::Events().size(), 0);
+
+  Workspace profiled_ws;
+  net = CreateProfilerTestNet(&profiled_ws, "dag");
+  Profiler::Enable();
+  EXPECT_TRUE(net->Run());
+  Profiler::Disable();
+  EXPECT_TRUE(net->Run());
+  auto events = Profiler::Events();
+  ASSERT_EQ(events.size(), 2);
+  for (const auto& event : events) {
+    EXPECT_EQ(event.type, "ProfilerTest");
+    EXPECT_LE(event.start_us, event.end_us);
+    // Each op allocates its output on the first run.
+    EXPECT_EQ(event.bytes_allocated, 256 * sizeof(float));
+  }
+  EXPECT_EQ(events[0].name, "first");
+  EXPECT_EQ(events[1].name, "second");
+  EXPECT_LE(events[0].end_us, events[1].start_us);
+
+  const string trace = Profiler::ChromeTrace();
+  EXPECT_NE(trace.find("\"traceEvents\""), string::npos);
+  EXPECT_NE(trace.find("\"name\":\"first\""), string::npos);
+  EXPECT_NE(trace.find("\"bytes_allocated\":1024"), string::npos);
+  Profiler::Clear();
+  EXPECT_EQ(Profiler::Events().size(), 0);
+}
+
+TEST(ProfilerTest, EventsOfExitedThreadsAreKept) {
+  Profiler::Clear();
+  Workspace ws;
+  auto net = CreateProfilerTestNet(&ws, "simple");
+  Profiler::Enable();
+  std::thread runner([&]() { EXPECT_TRUE(net->Run()); });
+  runner.join();
+  Profiler::Disable();
+  EXPECT_EQ(Profiler::Events().size(), 2);
+  Profiler::Clear();
+}
+
+TEST(ProfilerTest, DAGNetBenchmarkPerOperator) {
+  Profiler::Clear();
+  Workspace ws;
+  auto net = CreateProfilerTestNet(&ws, "dag");
+  // Without run_individual, only the time of the whole net is returned.
+  EXPECT_EQ(net->TEST_Benchmark(1, 3, false).size(), 1);
+  auto times = net->TEST_Benchmark(1, 3, true);
+  ASSERT_EQ(times.size(), 3);
+  for (const auto time : times) {
+    EXPECT_GE(time, 0);
+  }
+  // The events of the benchmark are dropped with the profiler it enabled.
+  EXPECT_FALSE(Profiler::IsEnabled());
+  EXPECT_EQ(Profiler::Events().size(), 0);
+  // They are kept for a profiling session of the caller.
+  Profiler::Enable();
+  EXPECT_TRUE(net->Run());
+  net->TEST_Benchmark(0, 3, true);
+  EXPECT_TRUE(Profiler::IsEnabled());
+  Profiler::Disable();
+  // The run, then the 3 timed and the 3 profiled runs of the benchmark.
+  EXPECT_EQ(Profiler::Events().size(), 2 * 7);
+  Profiler::ClearSince(Profiler::NowMicros());
+  EXPECT_EQ(Profiler::Events().size(), 2 * 7);
+  Profiler::Clear();
+}
+
+}  // namespace caffe2
@@ -0,0 +1,133 @@
+#include "caffe2/core/shape_inference.h"
+
+#include <functional>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator_schema.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/types.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+typedef std::function<
+    void(const OperatorDef&, const string&, const TensorProto&)>
+    OutputCallback;
+
+// Runs the inference over the operators of the net, updating shapes and
+// calling on_output for each output whose type and shape is inferred.
+void InferShapes(
+    const NetDef& net_def,
+    CaffeMap<string, TensorProto>* shapes,
+    const OutputCallback& on_output) {
+  for (const auto& op : net_def.op()) {
+    vector<TensorProto> inferred;
+    const OpSchema* schema = OpSchemaRegistry::Schema(op.type());
+    bool known = schema && schema->has_tensor_inference_function();
+    vector<TensorProto> in;
+    for (const auto& input : op.input()) {
+      auto it = shapes->find(input);
+      if (!known || it == shapes->end()) {
+        known = false;
+        break;
+      }
+      in.push_back(it->second);
+    }
+    if (known) {
+      try {
+        inferred = schema->InferTensor(op, in);
+      } catch (const EnforceNotMet& err) {
+        VLOG(1) << "Cannot infer the outputs of " << ProtoDebugString(op)
+                << ": " << err.msg();
+      }
+      known = inferred.size() == op.output_size();
+    }
+    for (int i = 0; i < op.output_size(); ++i) {
+      if (known) {
+        (*shapes)[op.output(i)] = inferred[i];
+        if (on_output) {
+          on_output(op, op.output(i), inferred[i]);
+        }
+      } else {
+        shapes->erase(op.output(i));
+      }
+    }
+  }
+}
+
+size_t NumBytes(const TensorProto& shape) {
+  size_t size = DataTypeToTypeMeta(shape.data_type()).itemsize();
+  for (const auto d : shape.dims()) {
+    size *= d;
+  }
+  return size;
+}
+
+}  // namespace
+
+CaffeMap<string, TensorProto> InferBlobShapes(
+    const NetDef& net_def,
+    const CaffeMap<string, TensorProto>& input_shapes) {
+  CaffeMap<string, TensorProto> shapes(input_shapes);
+  InferShapes(net_def, &shapes, nullptr);
+  return shapes;
+}
+
+CaffeMap<string, TensorProto> WorkspaceBlobShapes(const Workspace& ws) {
+  CaffeMap<string, TensorProto> shapes;
+  for (const auto& name : ws.Blobs()) {
+    const Blob* blob = ws.GetBlob(name);
+    if (!blob->IsType<TensorCPU>()) {
+      continue;
+    }
+    const auto& tensor = blob->Get<TensorCPU>();
+    const auto data_type = TypeMetaToDataType(tensor.meta());
+    if (data_type == TensorProto::UNDEFINED) {
+      continue;
+    }
+    shapes[name] = CreateTensorShape(tensor.dims(), data_type);
+  }
+  return shapes;
+}
+
+size_t PreallocateOutputs(const NetDef& net_def, Workspace* ws) {
+  // The largest type and shape inferred for each output of a CPU operator.
+  CaffeMap<string, TensorProto> largest;
+  auto shapes = WorkspaceBlobShapes(*ws);
+  InferShapes(
+      net_def,
+      &shapes,
+      [&](const OperatorDef& op, const string& output, const TensorProto& shape) {
+        const auto& device = op.has_device_option() ? op.device_option()
+                                                    : net_def.device_option();
+        if (device.device_type() != CPU ||
+            shape.data_type() == TensorProto::UNDEFINED) {
+          return;
+        }
+        auto it = largest.find(output);
+        if (it == largest.end() || NumBytes(it->second) < NumBytes(shape)) {
+          largest[output] = shape;
+        }
+      });
+
+  size_t allocated = 0;
+  for (const auto& it : largest) {
+    // CreateBlob() returns the existing blob, if any.
+    Blob* blob = ws->CreateBlob(it.first);
+    if (blob->meta().id() != 0) {
+      continue;
+    }
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    tensor->Resize(
+        vector<TIndex>(it.second.dims().begin(), it.second.dims().end()));
+    tensor->raw_mutable_data(DataTypeToTypeMeta(it.second.data_type()));
+    allocated += tensor->nbytes();
+  }
+  VLOG(1) << "Preallocated " << largest.size() << " outputs of net "
+          << net_def.name() << " (" << allocated << " bytes).";
+  return allocated;
+}
+
+}  // namespace caffe2
@@ -0,0 +1,46 @@
+#ifndef CAFFE2_CORE_SHAPE_INFERENCE_H_
+#define CAFFE2_CORE_SHAPE_INFERENCE_H_
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+/**
+ * @brief Infers the type and shape of the blobs of a net.
+ *
+ * Starting from the given input shapes, runs the tensor inference function of
+ * the schema of each operator, in order. The outputs of an operator are only
+ * inferred if the types and shapes of all its inputs are known and its schema
+ * has a tensor inference function; otherwise they become unknown. The result
+ * maps each known blob to the last type and shape inferred for it, as a
+ * TensorProto with no data set.
+ */
+CaffeMap<string, TensorProto> InferBlobShapes(
+    const NetDef& net_def,
+    const CaffeMap<string, TensorProto>& input_shapes);
+
+/**
+ * @brief Returns the type and shape of the CPU tensors in the workspace that
+ * already have a data type.
+ */
+CaffeMap<string, TensorProto> WorkspaceBlobShapes(const Workspace& ws);
+
+/**
+ * @brief Allocates the outputs of the CPU operators of a net ahead of its
+ * first run.
+ *
+ * The shapes are inferred from the CPU tensors already present in the
+ * workspace. A blob written by several operators, e.g. after PlanBlobReuse(),
+ * is allocated with the largest inferred size, so that the operators resizing
+ * it afterwards reuse the allocation. Blobs that already hold a value are left
+ * untouched. Returns the number of bytes allocated.
+ *
+ * CreateNet() calls this for nets with the argument preallocate_outputs=1.
+ */
+size_t PreallocateOutputs(const NetDef& net_def, Workspace* ws);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_SHAPE_INFERENCE_H_
@@ -0,0 +1,208 @@
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/shape_inference.h"
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A small convolutional network covering the core operators.
+const char kConvNet[] = R"DOC(
+  name: "convnet"
+  external_input: "data"
+  external_input: "conv_w"
+  external_input: "conv_b"
+  external_input: "bn_scale"
+  external_input: "bn_bias"
+  external_input: "bn_mean"
+  external_input: "bn_var"
+  external_input: "fc_w"
+  external_input: "fc_b"
+  external_output: "prob"
+  op {
+    input: "data"
+    input: "conv_w"
+    input: "conv_b"
+    output: "conv"
+    type: "Conv"
+    arg { name: "kernel" i: 3 }
+    arg { name: "pad" i: 1 }
+  }
+  op {
+    input: "conv"
+    input: "bn_scale"
+    input: "bn_bias"
+    input: "bn_mean"
+    input: "bn_var"
+    output: "bn"
+    type: "SpatialBN"
+    arg { name: "is_test" i: 1 }
+  }
+  op {
+    input: "bn"
+    output: "bn"
+    type: "Relu"
+  }
+  op {
+    input: "bn"
+    output: "pool"
+    type: "MaxPool"
+    arg { name: "kernel" i: 2 }
+    arg { name: "stride" i: 2 }
+  }
+  op {
+    input: "bn"
+    output: "avg_pool"
+    type: "AveragePool"
+    arg { name: "kernel" i: 2 }
+    arg { name: "stride" i: 2 }
+  }
+  op {
+    input: "pool"
+    input: "avg_pool"
+    output: "concat"
+    output: "split_info"
+    type: "Concat"
+    arg { name: "order" s: "NCHW" }
+  }
+  op {
+    input: "concat"
+    input: "concat"
+    output: "sum"
+    type: "Add"
+  }
+  op {
+    input: "sum"
+    input: "concat"
+    output: "less"
+    type: "LT"
+  }
+  op {
+    input: "sum"
+    input: "fc_w"
+    input: "fc_b"
+    output: "fc"
+    type: "FC"
+  }
+  op {
+    input: "fc"
+    output: "prob"
+    type: "Softmax"
+  }
+)DOC";
+
+NetDef ParseNet(const char* net_string) {
+  NetDef net_def;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      string(net_string), &net_def));
+  return net_def;
+}
+
+void AddInput(const string& name, const vector<TIndex>& dims, Workspace* ws) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    data[i] = (i % 7) * 0.1f;
+  }
+}
+
+void AddConvNetInputs(Workspace* ws) {
+  AddInput("data", {2, 3, 8, 8}, ws);
+  AddInput("conv_w", {4, 3, 3, 3}, ws);
+  AddInput("conv_b", {4}, ws);
+  for (const char* name : {"bn_scale", "bn_bias", "bn_mean", "bn_var"}) {
+    AddInput(name, {4}, ws);
+  }
+  AddInput("fc_w", {10, 8 * 4 * 4}, ws);
+  AddInput("fc_b", {10}, ws);
+}
+
+vector<TIndex> Dims(const TensorProto& shape) {
+  return vector<TIndex>(shape.dims().begin(), shape.dims().end());
+}
+
+}  // namespace
+
+TEST(ShapeInferenceTest, CoreOperators) {
+  Workspace ws;
+  AddConvNetInputs(&ws);
+  auto net_def = ParseNet(kConvNet);
+  auto shapes = InferBlobShapes(net_def, WorkspaceBlobShapes(ws));
+  EXPECT_EQ(Dims(shapes["conv"]), (vector<TIndex>{2, 4, 8, 8}));
+  EXPECT_EQ(Dims(shapes["bn"]), (vector<TIndex>{2, 4, 8, 8}));
+  EXPECT_EQ(Dims(shapes["pool"]), (vector<TIndex>{2, 4, 4, 4}));
+  EXPECT_EQ(Dims(shapes["concat"]), (vector<TIndex>{2, 8, 4, 4}));
+  EXPECT_EQ(Dims(shapes["split_info"]), (vector<TIndex>{2}));
+  EXPECT_EQ(shapes["split_info"].data_type(), TensorProto::INT32);
+  EXPECT_EQ(shapes["less"].data_type(), TensorProto::BOOL);
+  EXPECT_EQ(Dims(shapes["fc"]), (vector<TIndex>{2, 10}));
+  EXPECT_EQ(Dims(shapes["prob"]), (vector<TIndex>{2, 10}));
+
+  // The inferred shapes match the ones of an actual run.
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net != nullptr);
+  EXPECT_TRUE(net->Run());
+  for (const auto& it : shapes) {
+    const auto& tensor = ws.GetBlob(it.first)->Get<TensorCPU>();
+    EXPECT_EQ(tensor.dims(), Dims(it.second)) << it.first;
+    EXPECT_EQ(TypeMetaToDataType(tensor.meta()), it.second.data_type())
+        << it.first;
+  }
+}
+
+TEST(ShapeInferenceTest, UnknownInputsMakeOutputsUnknown) {
+  Workspace ws;
+  AddConvNetInputs(&ws);
+  auto net_def = ParseNet(kConvNet);
+  auto input_shapes = WorkspaceBlobShapes(ws);
+  input_shapes.erase("fc_w");
+  auto shapes = InferBlobShapes(net_def, input_shapes);
+  EXPECT_TRUE(shapes.count("concat"));
+  EXPECT_FALSE(shapes.count("fc"));
+  EXPECT_FALSE(shapes.count("prob"));
+}
+
+TEST(ShapeInferenceTest, PreallocatesOutputs) {
+  Workspace ws;
+  AddConvNetInputs(&ws);
+  auto net_def = ParseNet(kConvNet);
+  *net_def.add_arg() = MakeArgument<int>("preallocate_outputs", 1);
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net != nullptr);
+  const auto& prob = ws.GetBlob("prob")->Get<TensorCPU>();
+  EXPECT_EQ(prob.dims(), (vector<TIndex>{2, 10}));
+  const void* prob_data = prob.raw_data();
+  const void* conv_data = ws.GetBlob("conv")->Get<TensorCPU>().raw_data();
+  EXPECT_TRUE(net->Run());
+  // The operators write to the preallocated memory.
+  EXPECT_EQ(ws.GetBlob("prob")->Get<TensorCPU>().raw_data(), prob_data);
+  EXPECT_EQ(ws.GetBlob("conv")->Get<TensorCPU>().raw_data(), conv_data);
+}
+
+TEST(ShapeInferenceTest, PreallocatesSharedBlobsWithTheLargestSize) {
+  Workspace ws;
+  AddConvNetInputs(&ws);
+  auto net_def = ParseNet(kConvNet);
+  *net_def.add_arg() = MakeArgument<int>("plan_blob_reuse", 1);
+  *net_def.add_arg() = MakeArgument<int>("preallocate_outputs", 1);
+  auto net = CreateNet(net_def, &ws);
+  ASSERT_TRUE(net != nullptr);
+  // conv, pool and sum share a blob, as do avg_pool, less and fc.
+  ASSERT_TRUE(ws.HasBlob("conv_shared"));
+  EXPECT_FALSE(ws.HasBlob("sum"));
+  EXPECT_EQ(
+      ws.GetBlob("conv_shared")->Get<TensorCPU>().dims(),
+      (vector<TIndex>{2, 4, 8, 8}));
+  ASSERT_TRUE(ws.HasBlob("avg_pool_shared"));
+  EXPECT_FALSE(ws.HasBlob("less"));
+  EXPECT_FALSE(ws.HasBlob("fc"));
+  const auto& shared = ws.GetBlob("avg_pool_shared")->Get<TensorCPU>();
+  EXPECT_EQ(shared.dims(), (vector<TIndex>{2, 4, 4, 4}));
+  EXPECT_TRUE(shared.IsType<float>());
+  EXPECT_TRUE(net->Run());
+}
+
+}  // namespace caffe2
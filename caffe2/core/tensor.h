@@ -1,13 +1,18 @@
 #ifndef CAFFE2_CORE_TENSOR_H_
 #define CAFFE2_CORE_TENSOR_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <mutex>  // NOLINT
 #include <sstream>
 #include <typeinfo>
 #include <type_traits>
 #include <vector>
 
+#include "caffe2/core/arena.h"
 #include "caffe2/core/common.h"
 #include "caffe2/core/flags.h"
 #include "caffe2/core/context.h"
@@ -39,7 +44,9 @@ inline vector<TIndex> ToVectorTIndex(const std::vector<int>& src) {
  * The Tensor class is essentially a wrapper around a device-specific memory
  * (the device is specified by the Context template argument), and deals with
  * the allocation and de-allocation of such memory. We make a simplified
- * assumption that the memory is always contiguous.
+ * assumption that the memory is always contiguous: the only exceptions are the
+ * strided views created by ShareDataStrided() and the rows added by Append(),
+ * which are made contiguous before their data is accessed.
  */
 template <class Context>
 class Tensor {
@@ -121,6 +128,7 @@ class Tensor {
     if ((void*)&src == (void*)this) {
       return;
     }
+    DiscardView();
     meta_ = src.meta();
     Resize(src.dims());
     if (size() > 0) {
@@ -155,11 +163,12 @@ class Tensor {
    * The underlying data may be reallocated in order to accommodate the new
    * elements, in which case this tensors' capacity is grown at a factor of
    * growthPct. This ensures that Extend runs on an amortized O(1) time
-   * complexity.
+   * complexity. Append() avoids copying the existing data when it grows.
    */
   template <class ContextForCopy>
   void Extend(TIndex num, int growthPct, ContextForCopy* context) {
     CHECK_GE(dims_.size(), 1);
+    ClearView();
     auto oldSize = size_;
     auto newDims = dims_;
     newDims[0] += num;
@@ -173,6 +182,7 @@ class Tensor {
       auto newCapacity = dims_;
       newCapacity[0] = std::max(newDims[0], dims_[0] * (growthPct + 100) / 100);
       auto oldData = std::move(data_);
+      storage_.reset();
       Resize(newCapacity);
       auto* newData = raw_mutable_data(meta_);
       context->template CopyItems<ContextForCopy, ContextForCopy>(
@@ -182,17 +192,104 @@ class Tensor {
     size_ = newSize;
   }
 
+  /**
+   * @brief Appends the rows of another tensor to the outer-most dimension of
+   * this tensor.
+   *
+   * Unlike Extend(), outgrowing the capacity of the tensor does not copy its
+   * rows: the new rows go to a separate chunk, sized at a factor of growthPct
+   * of the tensor so that the following appends fill it. The chunks are
+   * compacted into a storage with the same room for growth the first time the
+   * data of the tensor is accessed, so a tensor that is appended to many times
+   * between reads copies its rows once per read rather than once per growth.
+   * ShareRows() reads the rows of a single chunk without compacting them.
+   * Chunked appends are only supported on CPU.
+   */
+  void Append(const Tensor& src, int growthPct) {
+    CAFFE_ENFORCE(
+        (std::is_same<Context, CPUContext>::value),
+        "Chunked appends are only supported on CPU.");
+    CAFFE_ENFORCE(&src != this, "Cannot append a tensor to itself.");
+    CAFFE_ENFORCE(src.ndim() >= 1, "Appended tensor must be at least 1D");
+    if (size_ <= 0 && !view_) {
+      CopyFrom(src);
+      return;
+    }
+    CAFFE_ENFORCE(
+        src.ndim() == ndim(),
+        "Cannot append a tensor of ",
+        src.ndim(),
+        " dimensions to one of ",
+        ndim());
+    for (int i = 1; i < dims_.size(); ++i) {
+      CAFFE_ENFORCE(
+          src.dims_[i] == dims_[i], "Mismatched dimension ", i, " in Append");
+    }
+    CAFFE_ENFORCE(
+        src.meta_ == meta_,
+        "Cannot append a tensor of ",
+        src.meta_.name(),
+        " to one of ",
+        meta_.name());
+    const TIndex rows = src.dims_[0];
+    if (rows == 0) {
+      return;
+    }
+    const char* src_data = static_cast<const char*>(src.raw_data());
+    const TIndex row_size = src.size_ / rows;
+    if (view_ && view_->chunks.empty()) {
+      ClearView();
+    }
+    if (!view_) {
+      if (data_ && nbytes() + src.nbytes() <= capacity_ &&
+          ClaimCapacity(src.nbytes())) {
+        CopyItemsOnCPU(
+            meta_, src.size_, src_data, static_cast<char*>(data_.get()) +
+                nbytes());
+        dims_[0] += rows;
+        size_ += src.size_;
+        return;
+      }
+      view_ = std::make_shared<Layout>();
+      view_->base_rows = dims_[0];
+      view_->growth_pct = growthPct;
+    }
+    auto& chunks = view_->chunks;
+    if (chunks.empty() ||
+        chunks.back().capacity - chunks.back().rows < rows) {
+      const TIndex capacity = std::max(rows, dims_[0] * growthPct / 100);
+      chunks.push_back(Chunk{NewStorage(meta_, capacity * row_size, true),
+                             std::make_shared<StorageState>(),
+                             0,
+                             capacity});
+    }
+    Chunk& chunk = chunks.back();
+    CopyItemsOnCPU(
+        meta_,
+        src.size_,
+        src_data,
+        static_cast<char*>(chunk.data.get()) +
+            chunk.rows * row_size * meta_.itemsize());
+    chunk.rows += rows;
+    dims_[0] += rows;
+    size_ += src.size_;
+  }
+
   /**
    * @brief Shrinks the outer-most dimension to given size, keeping the data.
    *
    * This method guarantees that no re-allocations are carried out, which means
    * that the extra capacity after the end of the shurnk tensor is maintained.
+   * Rows added by Append() are compacted first, though.
    */
   void Shrink(TIndex outer_dim) {
     CAFFE_ENFORCE(dims_.size() >= 1, "Tensor must be at least 1D");
     CAFFE_ENFORCE(
         outer_dim <= dims_[0],
         "New outer dimension must be smaller than current.");
+    if (view_ && !view_->chunks.empty()) {
+      ClearView();
+    }
     dims_[0] = outer_dim;
     size_ = std::accumulate(
         dims_.begin(), dims_.end(), 1, std::multiplies<TIndex>());
@@ -213,13 +310,16 @@ class Tensor {
    */
   template <typename... Ts>
   void Resize(Ts... dim_source) {
+    if (view_) {
+      ResizeView(dim_source...);
+      return;
+    }
     bool size_changed = SetDims(dim_source...);
     // If needed, we will free the data. the next mutable_data() call
     // will create the data storage.
     if (size_changed && (capacity_ < size_ * meta_.itemsize() ||
                          !FLAGS_caffe2_keep_on_shrink)) {
-      data_.reset();
-      capacity_ = 0;
+      SetStorage(nullptr, 0);
     }
   }
 
@@ -240,6 +340,7 @@ class Tensor {
    * This requires the total size of the tensor to remains constant.
    */
   inline void Reshape(const vector<TIndex>& dims) {
+    ClearView();
     TIndex new_size = 1;
     for (auto d : dims) {
       CHECK_GE(d, 0);
@@ -261,6 +362,16 @@ class Tensor {
     Reshape(ToVectorTIndex(dims));
   }
 
+  /**
+   * Releases the storage of the tensor, or its reference to the storage it
+   * shares, while keeping its type and shape. The next mutable access
+   * allocates new storage.
+   */
+  void FreeMemory() {
+    view_.reset();
+    SetStorage(nullptr, 0);
+  }
+
   /**
    * A utility function to print the debug string for the tensor. Note that this
    * is very slow since it involves quite some string operations, so do not use
@@ -288,6 +399,12 @@ class Tensor {
    * sharing the same underlying storage.
    *
    * The source tensor should already have its data allocated.
+   *
+   * The two tensors alias each other, and write the storage in place: the
+   * copies and views taken from either tensor afterwards do not share it.
+   * The other tensors the source still shares its storage copy-on-write with
+   * copy it the next time they write it, but can no longer be read once the
+   * aliases wrote it first. A source that is such a tensor cannot be shared.
    */
   void ShareData(const Tensor& src) {
     meta_ = src.meta();
@@ -297,9 +414,173 @@ class Tensor {
     // in which case ShareData() doesn't make much sense since we don't really
     // know what to share yet.
     CHECK(src.data_.get()) << "Source tensor has no content yet.";
+    src.EnsureReadable();
+    if (src.storage_) {
+      const void* alias_id = nullptr;
+      CAFFE_ENFORCE(
+          src.storage_->alias_id.compare_exchange_strong(
+              alias_id, src.alias_id_, std::memory_order_acq_rel) ||
+              alias_id == src.alias_id_,
+          "Cannot alias a tensor whose storage is aliased by other tensors.");
+      // The first write through the aliases goes through the slow path while
+      // other tensors may still hold the storage copy-on-write, so that they
+      // know it was overwritten.
+      if (!src.IsSharedCopyOnWrite()) {
+        src.storage_->copy_on_write.store(false, std::memory_order_release);
+      }
+    }
     // Finally, do sharing.
+    view_.reset();
+    data_ = src.data_;
+    storage_ = src.storage_;
+    capacity_ = src.capacity_;
+    alias_id_ = src.alias_id_;
+  }
+
+  /**
+   * @brief Shares the data and the shape of another tensor until either of
+   * them is written.
+   *
+   * Unlike ShareData(), the two tensors do not alias each other: the first
+   * mutable access to either of them while the storage is still shared with
+   * the other one materializes a private copy of it, which only
+   * mutable_data_overwrite() skips. This makes copying a tensor O(1) when the
+   * copy is only read. Storage aliased with ShareData() is copied right away
+   * instead, since its aliases write it in place, unless they wrote it since
+   * the source took it, which is an error.
+   *
+   * Copy-on-write relies on the reference count of the storage, so a tensor
+   * must not be written while another thread shares its storage, unless that
+   * thread only reads its own tensor, as the asynchronous Snapshot operator
+   * does.
+   */
+  void ShareDataCopyOnWrite(const Tensor& src) {
+    if (&src == this) {
+      return;
+    }
+    src.EnsureReadable();
+    view_.reset();
+    meta_ = src.meta_;
+    dims_ = src.dims_;
+    size_ = src.size_;
     data_ = src.data_;
     capacity_ = src.capacity_;
+    ShareCopyOnWrite(src.storage_);
+  }
+
+  /**
+   * @brief Makes this tensor a view of a part of another tensor, without
+   * copying it.
+   *
+   * The element (i_0, ..., i_n) of the view of the given dims is the element
+   * offset + i_0 * strides[0] + ... + i_n * strides[n] of the contiguous
+   * source tensor. Views whose elements are contiguous simply share the
+   * storage of the source at that offset, on any device. Other views keep
+   * their strides, which is only supported on CPU: they are made contiguous
+   * the first time their data is accessed, through data(), raw_data() or the
+   * mutable accessors, so that they can be passed to any operator.
+   * IsContiguous() tells whether that copy is still pending.
+   *
+   * As with ShareDataCopyOnWrite(), the view and the source do not alias
+   * each other: writing either of them while they still share the storage
+   * copies it first. A source that is itself a strided view is made
+   * contiguous first.
+   */
+  void ShareDataStrided(
+      const Tensor& src,
+      const vector<TIndex>& dims,
+      const vector<TIndex>& strides,
+      TIndex offset) {
+    CAFFE_ENFORCE(
+        dims.size() == strides.size(),
+        "A view needs one stride per dimension.");
+    src.EnsureReadable();
+    TIndex size = 1;
+    TIndex last = offset;
+    for (int i = 0; i < dims.size(); ++i) {
+      CAFFE_ENFORCE(dims[i] >= 0 && strides[i] >= 0);
+      size *= dims[i];
+      last += (dims[i] - 1) * strides[i];
+    }
+    CAFFE_ENFORCE(
+        size == 0 || (offset >= 0 && last < src.size_),
+        "The view exceeds the source tensor.");
+    CAFFE_ENFORCE(
+        size == 0 || src.data_.get(), "Source tensor has no content yet.");
+    // Reads everything from src first, since it may be this tensor.
+    std::shared_ptr<void> storage = src.data_;
+    std::shared_ptr<StorageState> state = src.storage_;
+    const TypeMeta meta = src.meta_;
+    const bool contiguous = IsContiguous(dims, strides);
+    // The contiguous copy of a strided view goes to the storage the tensor
+    // holds, such as the copy of the view an operator made in its previous
+    // run, if nothing else shares it.
+    std::shared_ptr<void> buffer;
+    size_t buffer_capacity = 0;
+    if (!contiguous && IsContiguous() && data_.use_count() == 1 &&
+        meta_ == meta && !meta.ctor() && capacity_ >= size * meta.itemsize()) {
+      buffer = std::move(data_);
+      buffer_capacity = capacity_;
+    }
+    meta_ = meta;
+    dims_ = dims;
+    size_ = size;
+    data_ = std::shared_ptr<void>(
+        storage,
+        static_cast<char*>(storage.get()) +
+            (size ? offset * meta.itemsize() : 0));
+    capacity_ = nbytes();
+    view_.reset();
+    if (!contiguous) {
+      CAFFE_ENFORCE(
+          (std::is_same<Context, CPUContext>::value),
+          "Strided views are only supported on CPU.");
+      view_ = std::make_shared<Layout>();
+      view_->strides = strides;
+      view_->buffer = std::move(buffer);
+      view_->buffer_capacity = buffer_capacity;
+    }
+    ShareCopyOnWrite(state);
+  }
+
+  /**
+   * @brief Makes this tensor share the rows [begin, end) of the outer-most
+   * dimension of another tensor.
+   *
+   * This is the contiguous view of ShareDataStrided(), except that the rows
+   * added to the source by Append() are shared without compacting the source,
+   * as long as they are all in the same chunk. Rows spanning several chunks
+   * are copied.
+   */
+  void ShareRows(const Tensor& src, TIndex begin, TIndex end) {
+    CAFFE_ENFORCE(&src != this, "A tensor cannot share its own rows.");
+    CAFFE_ENFORCE(src.ndim() >= 1, "Source tensor must be at least 1D");
+    CAFFE_ENFORCE(
+        begin >= 0 && begin <= end && end <= src.dims_[0],
+        "Rows [",
+        begin,
+        ", ",
+        end,
+        ") exceed the source tensor.");
+    vector<TIndex> dims = src.dims_;
+    dims[0] = end - begin;
+    if (src.view_ && ShareChunkRows(src, dims, begin)) {
+      return;
+    }
+    vector<TIndex> strides(dims.size(), 1);
+    for (int i = static_cast<int>(dims.size()) - 2; i >= 0; --i) {
+      strides[i] = strides[i + 1] * dims[i + 1];
+    }
+    ShareDataStrided(src, dims, strides, begin * strides[0]);
+  }
+
+  /**
+   * Returns false if the tensor is a strided view that has not been made
+   * contiguous yet, or has rows added by Append() that have not been compacted
+   * yet. See ShareDataStrided().
+   */
+  inline bool IsContiguous() const {
+    return !view_ || view_->contiguous.load(std::memory_order_acquire);
   }
 
   /**
@@ -315,14 +596,34 @@ class Tensor {
     meta_ = TypeMeta::Make<T>();
     CHECK(size_ > 0)
         << "To share data with a raw pointer, you need to set shape first.";
-    data_.reset(src, [](void*)->void {});
+    view_.reset();
     // Sets capacity. If not specified, we will implicitly assume that
     // the capacity is the current size.
-    if (capacity) {
-      capacity_ = capacity;
-    } else {
-      capacity_ = nbytes();
-    }
+    SetStorage(
+        std::shared_ptr<void>(src, [](void*) -> void {}),
+        capacity ? capacity : nbytes());
+  }
+
+  /**
+   * @brief Shares the data with external storage that the tensor keeps alive.
+   *
+   * This is similar to ShareExternalPointer(T*), except that the type is given
+   * at runtime, and that the tensor holds a reference to the storage, for
+   * instance to keep a memory mapping alive for as long as a tensor uses it.
+   */
+  void ShareExternalPointer(
+      std::shared_ptr<void> src,
+      const TypeMeta& meta,
+      size_t capacity = 0) {
+    CAFFE_ENFORCE(
+        !meta.ctor(),
+        "Only fundamental types can share external storage, not ",
+        meta.name());
+    meta_ = meta;
+    CHECK(size_ > 0)
+        << "To share data with a raw pointer, you need to set shape first.";
+    view_.reset();
+    SetStorage(std::move(src), capacity ? capacity : nbytes());
   }
 
   /**
@@ -330,6 +631,7 @@ class Tensor {
    * or raw_mutable_data() must have been called prior to this function call.
    */
   inline const void* raw_data() const {
+    EnsureReadable();
     CAFFE_ENFORCE(data_.get() || size_ == 0);
     return data_.get();
   }
@@ -342,6 +644,7 @@ class Tensor {
    */
   template <typename T>
   inline const T* data() const {
+    EnsureReadable();
     CAFFE_ENFORCE(
         data_.get() || size_ == 0,
         "The tensor is uninitialized. You probably need to call ",
@@ -367,38 +670,28 @@ class Tensor {
    * and a new storage will be created.
    */
   inline void* raw_mutable_data(const TypeMeta& meta) {
-    // For 0-size tensors it's fine to return any pointer (including nullptr)
-    if (meta_ == meta && (data_.get() || size_ == 0)) {
-      return data_.get();
-    } else {
-      meta_ = meta;
-      CHECK_GE(size_, 0)
-          << "Tensor is not initialized. You probably need to call Resize() "
-          << "before calling mutable_data()";
-      if (size_ == 0) {
-        return data_.get();
-      }
-      if (meta.ctor()) {
-        // For types that need placement new, we will call it, as well as
-        // making sure that when the data is freed, it calls the right
-        // destruction procedure.
-        auto size = size_;
-        auto dtor = meta_.dtor();
-        data_.reset(
-            static_cast<void*>(Context::New(size_ * meta_.itemsize())),
-            [size, dtor](void* ptr) -> void {
-                dtor(ptr, size);
-                Context::Delete(ptr);
-            });
-        meta_.ctor()(data_.get(), size_);
-      } else {
-        // For fundamental type, new and delete is easier.
-        data_.reset(static_cast<void*>(Context::New(size_ * meta_.itemsize())),
-                    Context::Delete);
-      }
-      capacity_ = size_ * meta_.itemsize();
-      return data_.get();
-    }
+    return raw_mutable_data(meta, Access::kInitialize);
+  }
+
+  /**
+   * Same as raw_mutable_data(meta), except that newly created storage of
+   * fundamental types is not initialized. Use it when the caller overwrites
+   * the whole tensor, to save the bandwidth of zero-filling it. The content of
+   * storage shared copy-on-write or of a strided view is still copied, since
+   * an in-place caller may read it after this call.
+   */
+  inline void* raw_mutable_data_uninitialized(const TypeMeta& meta) {
+    return raw_mutable_data(meta, Access::kUninitialized);
+  }
+
+  /**
+   * Same as raw_mutable_data_uninitialized(meta), except that the content of
+   * storage shared copy-on-write or of a strided view is dropped instead of
+   * copied. Only use it when the caller overwrites the whole tensor without
+   * reading it, which rules out operators running in place.
+   */
+  inline void* raw_mutable_data_overwrite(const TypeMeta& meta) {
+    return raw_mutable_data(meta, Access::kOverwrite);
   }
 
   /**
@@ -425,13 +718,553 @@ class Tensor {
    */
   template <typename T>
   inline T* mutable_data() {
-    if ((size_ == 0 || data_.get()) && IsType<T>()) {
+    if ((size_ == 0 || data_.get()) && IsType<T>() && !view_ &&
+        !IsSharedCopyOnWrite()) {
       return static_cast<T*>(data_.get());
     }
     return static_cast<T*>(raw_mutable_data(TypeMeta::Make<T>()));
   }
 
+  /**
+   * Same as mutable_data<T>(), except that newly created storage of
+   * fundamental types is not initialized. See
+   * raw_mutable_data_uninitialized().
+   */
+  template <typename T>
+  inline T* mutable_data_uninitialized() {
+    if ((size_ == 0 || data_.get()) && IsType<T>() && !view_ &&
+        !IsSharedCopyOnWrite()) {
+      return static_cast<T*>(data_.get());
+    }
+    return static_cast<T*>(raw_mutable_data_uninitialized(TypeMeta::Make<T>()));
+  }
+
+  /**
+   * Same as mutable_data_uninitialized<T>(), except that shared content is
+   * dropped instead of copied. See raw_mutable_data_overwrite().
+   */
+  template <typename T>
+  inline T* mutable_data_overwrite() {
+    if ((size_ == 0 || data_.get()) && IsType<T>() && !view_ &&
+        !IsSharedCopyOnWrite()) {
+      return static_cast<T*>(data_.get());
+    }
+    return static_cast<T*>(raw_mutable_data_overwrite(TypeMeta::Make<T>()));
+  }
+
+ private:
+  // What the mutable accessors do with the content of the tensor.
+  enum class Access {
+    // New storage is zero-filled, shared content is copied.
+    kInitialize,
+    // New storage is not initialized, shared content is copied.
+    kUninitialized,
+    // New storage is not initialized, shared content is dropped.
+    kOverwrite,
+  };
 
+  inline void* raw_mutable_data(const TypeMeta& meta, Access access) {
+    if (view_) {
+      // The content of a tensor that is not contiguous only needs to be copied
+      // if it is kept.
+      if (access == Access::kOverwrite || !(meta_ == meta)) {
+        DiscardView();
+      } else {
+        ClearView();
+      }
+    }
+    // For 0-size tensors it's fine to return any pointer (including nullptr)
+    if (meta_ == meta && (data_.get() || size_ == 0)) {
+      if (IsSharedCopyOnWrite()) {
+        if (storage_->alias_id.load(std::memory_order_acquire) == alias_id_) {
+          // The tensors still sharing the storage copy-on-write can no longer
+          // read it.
+          storage_->overwritten.store(true, std::memory_order_release);
+        } else {
+          if (access != Access::kOverwrite) {
+            CheckNotOverwritten();
+          }
+          DetachCopyOnWrite(access != Access::kOverwrite);
+        }
+      }
+      return data_.get();
+    } else {
+      meta_ = meta;
+      CHECK_GE(size_, 0)
+          << "Tensor is not initialized. You probably need to call Resize() "
+          << "before calling mutable_data()";
+      if (size_ == 0) {
+        return data_.get();
+      }
+      SetStorage(
+          NewStorage(meta_, size_, access != Access::kInitialize),
+          size_ * meta_.itemsize());
+      return data_.get();
+    }
+  }
+
+  static std::shared_ptr<void>
+  NewStorage(const TypeMeta& meta, TIndex size, bool uninitialized) {
+    Arena* arena = CurrentArena<Context>();
+    if (arena) {
+      return NewArenaStorage(arena, meta, size, uninitialized);
+    }
+    if (meta.ctor()) {
+      // For types that need placement new, we will call it, as well as
+      // making sure that when the data is freed, it calls the right
+      // destruction procedure.
+      auto dtor = meta.dtor();
+      std::shared_ptr<void> data(
+          static_cast<void*>(Context::New(size * meta.itemsize())),
+          [size, dtor](void* ptr) -> void {
+              dtor(ptr, size);
+              Context::Delete(ptr);
+          });
+      meta.ctor()(data.get(), size);
+      return data;
+    }
+    // For fundamental type, new and delete is easier.
+    const size_t nbytes = size * meta.itemsize();
+    return std::shared_ptr<void>(
+        uninitialized ? Context::NewUninitialized(nbytes)
+                      : Context::New(nbytes),
+        Context::Delete);
+  }
+
+  // The memory of the storage is freed with the arena, only the destructors
+  // of the items are called when the storage is released.
+  static std::shared_ptr<void> NewArenaStorage(
+      Arena* arena,
+      const TypeMeta& meta,
+      TIndex size,
+      bool uninitialized) {
+    const size_t nbytes = size * meta.itemsize();
+    void* data = arena->Allocate(nbytes);
+    if (meta.ctor()) {
+      auto dtor = meta.dtor();
+      meta.ctor()(data, size);
+      return std::shared_ptr<void>(
+          data, [size, dtor](void* ptr) -> void { dtor(ptr, size); });
+    }
+    if (!uninitialized) {
+      memset(data, 0, nbytes);
+    }
+    return std::shared_ptr<void>(data, [](void*) -> void {});
+  }
+
+  // The state of a storage, shared by all the tensors holding it.
+  struct StorageState {
+    // Set once the storage is shared by ShareDataCopyOnWrite() or a view:
+    // the tensors holding it then copy it before writing it. ShareData()
+    // clears it, unless other tensors still hold the storage.
+    std::atomic<bool> copy_on_write{false};
+    // Set once the storage is shared by ShareData(), to the alias_id_ of the
+    // aliases: it is then never shared copy-on-write again.
+    std::atomic<const void*> alias_id{nullptr};
+    // Set once the aliases wrote the storage while other tensors may still
+    // have held it copy-on-write, which can then no longer read it.
+    std::atomic<bool> overwritten{false};
+    // The end of the bytes of the storage that any of the tensors holding it
+    // may read. Append() claims the bytes after it to write in place.
+    std::atomic<size_t> used_bytes{0};
+  };
+
+  // Rows added by Append() after the capacity of the tensor.
+  struct Chunk {
+    std::shared_ptr<void> data;
+    std::shared_ptr<StorageState> state;
+    TIndex rows;
+    TIndex capacity;
+  };
+
+  // The state of a tensor that is not contiguous yet: either a strided view
+  // created by ShareDataStrided(), or the base_rows rows of data_ followed by
+  // the chunks of Append(). Besides Append(), it is only changed to make the
+  // tensor contiguous, which readers on several threads may do at the same
+  // time.
+  struct Layout {
+    vector<TIndex> strides;
+    // The private storage the contiguous copy of a strided view is made in,
+    // if the tensor had one to reuse.
+    std::shared_ptr<void> buffer;
+    size_t buffer_capacity = 0;
+    vector<Chunk> chunks;
+    TIndex base_rows = 0;
+    int growth_pct = 0;
+    std::mutex mutex;
+    std::atomic<bool> contiguous{false};
+  };
+
+  static bool IsContiguous(
+      const vector<TIndex>& dims,
+      const vector<TIndex>& strides) {
+    TIndex expected = 1;
+    for (int i = dims.size() - 1; i >= 0; --i) {
+      if (dims[i] == 0) {
+        return true;
+      }
+      if (dims[i] != 1 && strides[i] != expected) {
+        return false;
+      }
+      expected *= dims[i];
+    }
+    return true;
+  }
+
+  // Throws if the aliases of the storage, which the tensor holds
+  // copy-on-write, wrote it since the tensor took it.
+  inline void CheckNotOverwritten() const {
+    CAFFE_ENFORCE(
+        !storage_ || !storage_->overwritten.load(std::memory_order_acquire) ||
+            storage_->alias_id.load(std::memory_order_relaxed) == alias_id_,
+        "The tensor shared its storage copy-on-write with a tensor that was "
+        "aliased by ShareData(), and the aliases wrote it since.");
+  }
+
+  inline void EnsureContiguous() const {
+    if (view_ && !view_->contiguous.load(std::memory_order_acquire)) {
+      MakeContiguous();
+    }
+  }
+
+  inline void EnsureReadable() const {
+    CheckNotOverwritten();
+    EnsureContiguous();
+  }
+
+  // Replaces the storage of a strided view or of appended chunks with a
+  // contiguous copy.
+  void MakeContiguous() const {
+    std::lock_guard<std::mutex> lock(view_->mutex);
+    if (view_->contiguous.load(std::memory_order_relaxed)) {
+      return;
+    }
+    // Reading a tensor of a shared workspace from an operator of a workspace
+    // with an arena must not leave it with memory of the arena.
+    ArenaScope no_arena(nullptr);
+    if (!view_->chunks.empty()) {
+      CompactChunks();
+    } else {
+      std::shared_ptr<void> data = std::move(view_->buffer);
+      size_t capacity = view_->buffer_capacity;
+      if (!data) {
+        data = NewStorage(meta_, size_, true);
+        capacity = nbytes();
+      }
+      char* dst = static_cast<char*>(data.get());
+      CopyStrided(
+          meta_,
+          dims_,
+          view_->strides,
+          0,
+          static_cast<const char*>(data_.get()),
+          &dst);
+      SetStorage(data, capacity);
+    }
+    view_->contiguous.store(true, std::memory_order_release);
+  }
+
+  // Copies the rows of data_ and of the chunks to a storage that leaves the
+  // same room for growth as Append() does.
+  void CompactChunks() const {
+    const TIndex row_size = size_ / dims_[0];
+    const size_t row_bytes = row_size * meta_.itemsize();
+    const TIndex capacity = dims_[0] * (100 + view_->growth_pct) / 100;
+    std::shared_ptr<void> data = NewStorage(meta_, capacity * row_size, true);
+    char* dst = static_cast<char*>(data.get());
+    CopyItemsOnCPU(meta_, view_->base_rows * row_size, data_.get(), dst);
+    dst += view_->base_rows * row_bytes;
+    for (const auto& chunk : view_->chunks) {
+      CopyItemsOnCPU(meta_, chunk.rows * row_size, chunk.data.get(), dst);
+      dst += chunk.rows * row_bytes;
+    }
+    view_->chunks.clear();
+    SetStorage(data, capacity * row_bytes);
+  }
+
+  // Shares the rows of a source with appended chunks that are not compacted
+  // yet, or copies them if they span several chunks. Returns false if the
+  // source is contiguous.
+  bool ShareChunkRows(
+      const Tensor& src,
+      const vector<TIndex>& dims,
+      TIndex begin) {
+    src.CheckNotOverwritten();
+    const Layout& layout = *src.view_;
+    std::lock_guard<std::mutex> lock(src.view_->mutex);
+    if (layout.chunks.empty() ||
+        layout.contiguous.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    const TIndex row_size = src.size_ / src.dims_[0];
+    const size_t row_bytes = row_size * src.meta_.itemsize();
+    const TIndex end = begin + dims[0];
+    // The rows of data_ come first, then those of each chunk.
+    TIndex start = 0;
+    for (int i = -1; i < static_cast<int>(layout.chunks.size()); ++i) {
+      const auto& storage = i < 0 ? src.data_ : layout.chunks[i].data;
+      const auto& state = i < 0 ? src.storage_ : layout.chunks[i].state;
+      const TIndex rows = i < 0 ? layout.base_rows : layout.chunks[i].rows;
+      if (begin >= start && end <= start + rows) {
+        meta_ = src.meta_;
+        dims_ = dims;
+        size_ = dims[0] * row_size;
+        data_ = std::shared_ptr<void>(
+            storage,
+            static_cast<char*>(storage.get()) + (begin - start) * row_bytes);
+        capacity_ = nbytes();
+        view_.reset();
+        ShareCopyOnWrite(state);
+        return true;
+      }
+      start += rows;
+    }
+    Resize(dims);
+    char* dst = static_cast<char*>(raw_mutable_data_uninitialized(src.meta_));
+    start = 0;
+    for (int i = -1; i < static_cast<int>(layout.chunks.size()); ++i) {
+      const auto& storage = i < 0 ? src.data_ : layout.chunks[i].data;
+      const TIndex rows = i < 0 ? layout.base_rows : layout.chunks[i].rows;
+      const TIndex first = std::max(begin, start);
+      const TIndex last = std::min(end, start + rows);
+      if (first < last) {
+        CopyItemsOnCPU(
+            meta_,
+            (last - first) * row_size,
+            static_cast<const char*>(storage.get()) + (first - start) * row_bytes,
+            dst);
+        dst += (last - first) * row_bytes;
+      }
+      start += rows;
+    }
+    return true;
+  }
+
+  static void CopyItemsOnCPU(
+      const TypeMeta& meta,
+      TIndex n,
+      const void* src,
+      void* dst) {
+    if (n == 0) {
+      return;
+    }
+    if (meta.copy()) {
+      meta.copy()(src, dst, n);
+    } else {
+      memcpy(dst, src, n * meta.itemsize());
+    }
+  }
+
+  // Copies the items of a strided view on CPU, from the given axis on.
+  static void CopyStrided(
+      const TypeMeta& meta,
+      const vector<TIndex>& dims,
+      const vector<TIndex>& strides,
+      int axis,
+      const char* src,
+      char** dst) {
+    const size_t itemsize = meta.itemsize();
+    const int last = static_cast<int>(dims.size()) - 1;
+    if (axis == last && strides[axis] == 1) {
+      CopyItemsOnCPU(meta, dims[axis], src, *dst);
+      *dst += dims[axis] * itemsize;
+      return;
+    }
+    // The last two axes of a view whose last axis is strided, such as a
+    // transpose, are copied item by item with their type's size.
+    if (axis >= last - 1 && strides[last] != 1 && !meta.copy()) {
+      const TIndex rows = axis < last ? dims[axis] : 1;
+      const TIndex row_stride = axis < last ? strides[axis] : 0;
+      if (CopyStridedItems(
+              itemsize, rows, dims[last], row_stride, strides[last], src,
+              *dst)) {
+        *dst += rows * dims[last] * itemsize;
+        return;
+      }
+    }
+    for (TIndex i = 0; i < dims[axis]; ++i) {
+      const char* item = src + i * strides[axis] * itemsize;
+      if (axis < dims.size() - 1) {
+        CopyStrided(meta, dims, strides, axis + 1, item, dst);
+      } else {
+        CopyItemsOnCPU(meta, 1, item, *dst);
+        *dst += itemsize;
+      }
+    }
+  }
+
+  // Copies rows x cols items of the given size from a strided source to a
+  // contiguous destination. Returns false for sizes not handled.
+  static bool CopyStridedItems(
+      size_t itemsize,
+      TIndex rows,
+      TIndex cols,
+      TIndex row_stride,
+      TIndex col_stride,
+      const char* src,
+      char* dst) {
+    switch (itemsize) {
+      case 1:
+        CopyStridedBlocks(rows, cols, row_stride, col_stride,
+            reinterpret_cast<const uint8_t*>(src),
+            reinterpret_cast<uint8_t*>(dst));
+        return true;
+      case 2:
+        CopyStridedBlocks(rows, cols, row_stride, col_stride,
+            reinterpret_cast<const uint16_t*>(src),
+            reinterpret_cast<uint16_t*>(dst));
+        return true;
+      case 4:
+        CopyStridedBlocks(rows, cols, row_stride, col_stride,
+            reinterpret_cast<const uint32_t*>(src),
+            reinterpret_cast<uint32_t*>(dst));
+        return true;
+      case 8:
+        CopyStridedBlocks(rows, cols, row_stride, col_stride,
+            reinterpret_cast<const uint64_t*>(src),
+            reinterpret_cast<uint64_t*>(dst));
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Copies in square blocks, so that the cache lines of a transpose read for
+  // a row of a block are still cached for the next rows.
+  template <typename T>
+  static void CopyStridedBlocks(
+      TIndex rows,
+      TIndex cols,
+      TIndex row_stride,
+      TIndex col_stride,
+      const T* src,
+      T* dst) {
+    constexpr TIndex kBlock = 32;
+    for (TIndex row_begin = 0; row_begin < rows; row_begin += kBlock) {
+      const TIndex row_end = std::min(rows, row_begin + kBlock);
+      for (TIndex col_begin = 0; col_begin < cols; col_begin += kBlock) {
+        const TIndex col_end = std::min(cols, col_begin + kBlock);
+        for (TIndex row = row_begin; row < row_end; ++row) {
+          const T* in = src + row * row_stride;
+          T* out = dst + row * cols;
+          for (TIndex col = col_begin; col < col_end; ++col) {
+            out[col] = in[col * col_stride];
+          }
+        }
+      }
+    }
+  }
+
+  // Makes a strided view or appended chunks contiguous before the tensor gets
+  // changed, and turns it into a plain tensor.
+  void ClearView() {
+    if (view_) {
+      EnsureReadable();
+      view_.reset();
+    }
+  }
+
+  // Turns a strided view or appended chunks into a plain tensor without
+  // copying them, if the content is not needed.
+  void DiscardView() {
+    if (!IsContiguous()) {
+      if (view_->buffer && view_->buffer_capacity >= nbytes()) {
+        SetStorage(std::move(view_->buffer), view_->buffer_capacity);
+      } else {
+        SetStorage(nullptr, 0);
+      }
+    }
+    view_.reset();
+  }
+
+  template <typename... Ts>
+  void ResizeView(Ts... dim_source) {
+    if (IsContiguous()) {
+      view_.reset();
+      Resize(dim_source...);
+      return;
+    }
+    vector<TIndex> old_dims = dims_;
+    if (SetDims(dim_source...)) {
+      // The content does not survive a change of size.
+      DiscardView();
+    } else if (dims_ != old_dims) {
+      std::swap(dims_, old_dims);
+      ClearView();
+      dims_ = old_dims;
+    }
+  }
+
+  // Makes the given storage the private storage of the tensor.
+  void SetStorage(std::shared_ptr<void> data, size_t capacity) const {
+    data_ = std::move(data);
+    capacity_ = capacity;
+    alias_id_ = this;
+    if (data_) {
+      storage_ = std::make_shared<StorageState>();
+      storage_->used_bytes.store(nbytes(), std::memory_order_relaxed);
+    } else {
+      storage_.reset();
+    }
+  }
+
+  // Shares the state of the storage data_ now points to, marking it
+  // copy-on-write. Storage aliased by ShareData() is copied right away
+  // instead, since its aliases would write it under the tensor. The source
+  // must have been checked by EnsureReadable().
+  void ShareCopyOnWrite(const std::shared_ptr<StorageState>& state) {
+    storage_ = state;
+    alias_id_ = this;
+    if (!storage_) {
+      return;
+    }
+    if (!storage_->alias_id.load(std::memory_order_acquire)) {
+      storage_->copy_on_write.store(true, std::memory_order_release);
+      return;
+    }
+    EnsureContiguous();
+    if (storage_ == state && size_ > 0) {
+      DetachCopyOnWrite(true);
+    }
+  }
+
+  inline bool IsSharedCopyOnWrite() const {
+    return storage_ &&
+        storage_->copy_on_write.load(std::memory_order_acquire) &&
+        size_ > 0 && data_.use_count() > 1;
+  }
+
+  // Reserves the given number of bytes of free capacity after the data of the
+  // tensor for Append(). The tensors sharing the storage copy-on-write only
+  // read it up to their own size, so the free capacity is only taken from
+  // them if no other tensor claimed it first.
+  bool ClaimCapacity(size_t nbytes_to_append) {
+    const size_t end = nbytes();
+    if (!IsSharedCopyOnWrite()) {
+      if (storage_) {
+        storage_->used_bytes.store(end + nbytes_to_append);
+      }
+      return true;
+    }
+    size_t expected = end;
+    return storage_->used_bytes.compare_exchange_strong(
+        expected, end + nbytes_to_append);
+  }
+
+  // Replaces the storage shared by ShareDataCopyOnWrite() with a private copy,
+  // copied on the device of the shared storage.
+  void DetachCopyOnWrite(bool copy) {
+    std::shared_ptr<void> shared = std::move(data_);
+    storage_.reset();
+    void* data = raw_mutable_data(meta_, Access::kUninitialized);
+    if (copy) {
+      Context context(GetDeviceOptionForPointer<Context>(shared.get()));
+      context.template CopyItems<Context, Context>(
+          meta_, size_, shared.get(), data);
+    }
+  }
+
+ public:
   /**
    * Returns the number of dimensions of the data.
    */
@@ -533,8 +1366,18 @@ class Tensor {
   vector<TIndex> dims_;
   TIndex size_ = -1;
   TypeMeta meta_;
-  std::shared_ptr<void> data_;
-  size_t capacity_ = 0;
+  // Mutable, since tensors are made contiguous by const accessors.
+  mutable std::shared_ptr<void> data_;
+  mutable size_t capacity_ = 0;
+  // The state of the storage of data_, shared by the tensors holding it, see
+  // StorageState.
+  mutable std::shared_ptr<StorageState> storage_;
+  // Identifies the tensors aliased by ShareData(), which write their storage
+  // in place, among those holding it.
+  mutable const void* alias_id_ = nullptr;
+  // Only set for strided views and appended chunks, see ShareDataStrided()
+  // and Append().
+  std::shared_ptr<Layout> view_;
   // In case of chunk load we store how much data was already loaded
 
  private:
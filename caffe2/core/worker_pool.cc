@@ -0,0 +1,217 @@
+#include "caffe2/core/worker_pool.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_io_worker_pool_num_workers,
+    8,
+    "The number of threads of the pool that runs I/O bound tasks, e.g. "
+    "operators with asynchronous completion.");
+
+namespace caffe2 {
+
+namespace {
+// The pool the current thread is a worker of, if any.
+thread_local const WorkerPool* t_worker_pool = nullptr;
+}  // namespace
+
+WorkerPool::WorkerPool(int num_workers) {
+  CAFFE_ENFORCE(num_workers > 0, "Must have a positive number of workers.");
+  for (int i = 0; i < num_workers; ++i) {
+    VLOG(1) << "Start pool worker #" << i;
+    workers_.push_back(std::thread(&WorkerPool::WorkerFunction, this));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  VLOG(1) << "Joining pool workers.";
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+WorkerPool::ClientId WorkerPool::AddClient(int priority, int max_concurrency) {
+  CAFFE_ENFORCE(max_concurrency > 0, "Must have a positive concurrency cap.");
+  std::lock_guard<std::mutex> lock(mutex_);
+  const ClientId id = next_client_id_++;
+  clients_[id] =
+      Client{priority, max_concurrency, 0, std::priority_queue<PendingTask>()};
+  // Insert the client after all the clients with the same or higher priority.
+  auto it = std::find_if(
+      schedule_order_.begin(), schedule_order_.end(), [&](ClientId other) {
+        return clients_[other].priority < priority;
+      });
+  schedule_order_.insert(it, id);
+  return id;
+}
+
+void WorkerPool::RemoveClient(ClientId client) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  CAFFE_ENFORCE(clients_.count(client), "Unknown client ", client);
+  CAFFE_ENFORCE(
+      clients_[client].tasks.empty(),
+      "Removing a client that still has pending tasks.");
+  // The last task of the client may still be wrapping up, e.g. if it is the
+  // one that notified the owner of the client that all its work is done.
+  client_idle_cv_.wait(lock, [&] { return clients_[client].running == 0; });
+  clients_.erase(client);
+  schedule_order_.erase(
+      std::remove(schedule_order_.begin(), schedule_order_.end(), client),
+      schedule_order_.end());
+}
+
+void WorkerPool::Schedule(ClientId client, Task task, float task_priority) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(clients_.count(client), "Unknown client ", client);
+    clients_[client].tasks.push(
+        PendingTask{task_priority, next_sequence_++, std::move(task)});
+  }
+  cv_.notify_one();
+}
+
+bool WorkerPool::RunPendingTask(ClientId client) {
+  Task task;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(clients_.count(client), "Unknown client ", client);
+    auto& state = clients_[client];
+    if (state.tasks.empty()) {
+      return false;
+    }
+    task = state.tasks.top().task;
+    state.tasks.pop();
+    ++state.running;
+  }
+  task();
+  task = nullptr;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--clients_[client].running == 0) {
+    client_idle_cv_.notify_all();
+  }
+  return true;
+}
+
+bool WorkerPool::IsWorkerThread() const {
+  return t_worker_pool == this;
+}
+
+bool WorkerPool::PickTask(ClientId* client, Task* task) {
+  for (int i = 0; i < schedule_order_.size(); ++i) {
+    const ClientId id = schedule_order_[i];
+    auto& state = clients_[id];
+    if (state.tasks.empty() || state.running >= state.max_concurrency) {
+      continue;
+    }
+    *client = id;
+    // std::priority_queue only gives const access to its top element, so the
+    // task is copied out. DAG nets schedule small lambdas, which std::function
+    // stores without allocating.
+    *task = state.tasks.top().task;
+    state.tasks.pop();
+    ++state.running;
+    // Move the client behind the other clients of the same priority, so that
+    // they get served in a round robin fashion.
+    int j = i;
+    while (j + 1 < schedule_order_.size() &&
+           clients_[schedule_order_[j + 1]].priority == state.priority) {
+      std::swap(schedule_order_[j], schedule_order_[j + 1]);
+      ++j;
+    }
+    return true;
+  }
+  return false;
+}
+
+void WorkerPool::WorkerFunction() {
+  t_worker_pool = this;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    ClientId client;
+    Task task;
+    if (!PickTask(&client, &task)) {
+      if (stop_) {
+        return;
+      }
+      cv_.wait(lock);
+      continue;
+    }
+    lock.unlock();
+    task();
+    task = nullptr;
+    lock.lock();
+    if (--clients_[client].running == 0) {
+      client_idle_cv_.notify_all();
+    }
+  }
+}
+
+TaskGroup::TaskGroup(WorkerPool* pool, int max_concurrency, int max_pending)
+    : pool_(pool),
+      client_(pool->AddClient(0, max_concurrency)),
+      max_pending_(max_pending) {
+  CAFFE_ENFORCE(max_pending > 0, "Must allow pending tasks.");
+}
+
+TaskGroup::~TaskGroup() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_ == 0; });
+  }
+  pool_->RemoveClient(client_);
+}
+
+void TaskGroup::Schedule(WorkerPool::Task task) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return pending_ < max_pending_; });
+    ++pending_;
+  }
+  pool_->Schedule(client_, [this, task]() {
+    std::exception_ptr exception;
+    try {
+      task();
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (exception && !exception_) {
+      exception_ = exception;
+    }
+    --pending_;
+    cv_.notify_all();
+  });
+}
+
+void TaskGroup::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this] { return pending_ == 0; });
+  if (exception_) {
+    std::exception_ptr exception = exception_;
+    exception_ = nullptr;
+    std::rethrow_exception(exception);
+  }
+}
+
+void ScheduleIOTask(WorkerPool::Task task) {
+  struct IOWorkerPool {
+    IOWorkerPool()
+        : pool(FLAGS_caffe2_io_worker_pool_num_workers),
+          client(pool.AddClient(0, FLAGS_caffe2_io_worker_pool_num_workers)) {}
+    WorkerPool pool;
+    WorkerPool::ClientId client;
+  };
+  // Intentionally leaked: its tasks may block forever, e.g. on a queue that
+  // is never closed, and must not prevent the process from exiting.
+  static IOWorkerPool* io_pool = new IOWorkerPool();
+  io_pool->pool.Schedule(io_pool->client, std::move(task));
+}
+
+}  // namespace caffe2
@@ -0,0 +1,157 @@
+#ifndef CAFFE2_CORE_WORKER_POOL_H_
+#define CAFFE2_CORE_WORKER_POOL_H_
+
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>  // NOLINT
+#include <queue>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "caffe2/core/common.h"
+
+namespace caffe2 {
+
+/**
+ * @brief A pool of worker threads that is shared by several clients.
+ *
+ * Instead of every DAG net keeping its own set of mostly idle threads, the
+ * nets of a Workspace register themselves as clients of a single WorkerPool
+ * and schedule their operators onto it. Each client has
+ * - a priority: whenever a worker becomes free, it picks the next task of the
+ *   client with the highest priority that has pending tasks. Tasks are never
+ *   interrupted, so a higher priority client takes over at the granularity of
+ *   a task (usually an operator or a chain of operators).
+ * - a concurrency cap: at most max_concurrency tasks of a client run at the
+ *   same time, so one net cannot occupy the whole pool.
+ * Clients with the same priority are served in a round robin fashion.
+ */
+class WorkerPool {
+ public:
+  typedef int ClientId;
+  typedef std::function<void()> Task;
+
+  explicit WorkerPool(int num_workers);
+  ~WorkerPool();
+
+  /**
+   * Registers a client with the given priority and concurrency cap, and
+   * returns its id. Larger values mean higher priority.
+   */
+  ClientId AddClient(int priority, int max_concurrency);
+  /**
+   * Unregisters a client. The caller must make sure that the client has no
+   * pending tasks and does not schedule any more tasks. Waits for the tasks
+   * of the client that are still running to return.
+   */
+  void RemoveClient(ClientId client);
+  /**
+   * Schedules a task to be run by the pool on behalf of the client. This can
+   * be called from any thread, including the pool's worker threads. The tasks
+   * of a client are run by decreasing task priority, and in the order they
+   * were scheduled for equal task priorities.
+   */
+  void Schedule(ClientId client, Task task, float task_priority = 0);
+  /**
+   * Runs the next pending task of the client on the calling thread, even if
+   * the client is at its concurrency cap, and returns whether there was one.
+   * A worker of the pool that waits for the tasks of a client, e.g. for a net
+   * run by an operator of another net, helps with them this way instead of
+   * holding its thread idle, since all the other workers may be waiting too.
+   */
+  bool RunPendingTask(ClientId client);
+  /**
+   * Returns whether the calling thread is one of the workers of the pool.
+   */
+  bool IsWorkerThread() const;
+
+  inline int num_workers() const { return workers_.size(); }
+
+ private:
+  struct PendingTask {
+    float priority;
+    uint64_t sequence;
+    Task task;
+    // std::priority_queue pops the largest entry first.
+    bool operator<(const PendingTask& other) const {
+      if (priority != other.priority) {
+        return priority < other.priority;
+      }
+      return sequence > other.sequence;
+    }
+  };
+
+  struct Client {
+    int priority;
+    int max_concurrency;
+    int running;
+    std::priority_queue<PendingTask> tasks;
+  };
+
+  void WorkerFunction();
+  // Picks the next task to run. Must be called with mutex_ held. Returns false
+  // if no client can run a task right now.
+  bool PickTask(ClientId* client, Task* task);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::condition_variable client_idle_cv_;
+  std::map<ClientId, Client> clients_;
+  // The client ids in the order they should be served: by decreasing
+  // priority, then by the last time they were served.
+  std::vector<ClientId> schedule_order_;
+  ClientId next_client_id_ = 0;
+  uint64_t next_sequence_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+
+  DISABLE_COPY_AND_ASSIGN(WorkerPool);
+};
+
+/**
+ * @brief A batch of tasks run by a WorkerPool, which can be waited for.
+ *
+ * The group registers its own client with the pool, so at most
+ * max_concurrency of its tasks run at the same time, and Schedule() blocks
+ * while max_pending of its tasks are scheduled and not done yet, which bounds
+ * the memory the caller holds for them. Wait() rethrows the first exception
+ * thrown by a task; the other tasks still run.
+ */
+class TaskGroup {
+ public:
+  TaskGroup(WorkerPool* pool, int max_concurrency, int max_pending);
+  // Waits for the scheduled tasks, ignoring their exceptions.
+  ~TaskGroup();
+
+  void Schedule(WorkerPool::Task task);
+  void Wait();
+
+ private:
+  WorkerPool* pool_;
+  WorkerPool::ClientId client_;
+  int max_pending_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int pending_ = 0;
+  std::exception_ptr exception_;
+
+  DISABLE_COPY_AND_ASSIGN(TaskGroup);
+};
+
+/**
+ * Schedules a task on a process-wide pool of threads reserved for work that
+ * mostly waits on I/O, such as operators blocking on a queue, so that it does
+ * not occupy the workers of a net. The pool has
+ * --caffe2_io_worker_pool_num_workers threads and is created on first use.
+ * Since its tasks may wait for each other, it only serves operators that run
+ * outside of a DAG net: the DAG nets give their operators threads of their
+ * own.
+ */
+void ScheduleIOTask(WorkerPool::Task task);
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_CORE_WORKER_POOL_H_
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <mutex>  // NOLINT
+#include <stdexcept>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "caffe2/core/worker_pool.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A simple one-shot latch to block pool workers from within a test.
+class Latch {
+ public:
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return released_; });
+  }
+  void Release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      released_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool released_ = false;
+};
+
+}  // namespace
+
+TEST(WorkerPoolTest, RunsAllTasks) {
+  WorkerPool pool(4);
+  EXPECT_EQ(pool.num_workers(), 4);
+  auto client = pool.AddClient(0, 4);
+  std::atomic<int> counter{0};
+  Latch done;
+  const int kNumTasks = 1000;
+  for (int i = 0; i < kNumTasks; ++i) {
+    pool.Schedule(client, [&]() {
+      if (++counter == kNumTasks) {
+        done.Release();
+      }
+    });
+  }
+  done.Wait();
+  pool.RemoveClient(client);
+  EXPECT_EQ(counter, kNumTasks);
+}
+
+TEST(WorkerPoolTest, HigherPriorityFirst) {
+  WorkerPool pool(1);
+  auto low = pool.AddClient(0, 1);
+  auto high = pool.AddClient(1, 1);
+  Latch blocker_started;
+  Latch blocker;
+  Latch done;
+  std::mutex order_mutex;
+  std::vector<int> order;
+  auto record = [&](int value) {
+    return [&, value]() {
+      std::lock_guard<std::mutex> lock(order_mutex);
+      order.push_back(value);
+      if (order.size() == 4) {
+        done.Release();
+      }
+    };
+  };
+  // Keep the only worker busy while the tasks are scheduled.
+  pool.Schedule(low, [&]() {
+    blocker_started.Release();
+    blocker.Wait();
+  });
+  blocker_started.Wait();
+  pool.Schedule(low, record(0));
+  pool.Schedule(high, record(1));
+  pool.Schedule(low, record(2));
+  pool.Schedule(high, record(3));
+  blocker.Release();
+  done.Wait();
+  pool.RemoveClient(low);
+  pool.RemoveClient(high);
+  EXPECT_EQ(order, (std::vector<int>{1, 3, 0, 2}));
+}
+
+TEST(WorkerPoolTest, ConcurrencyCap) {
+  WorkerPool pool(4);
+  auto client = pool.AddClient(0, 2);
+  std::atomic<int> running{0};
+  std::atomic<int> max_running{0};
+  std::atomic<int> finished{0};
+  Latch done;
+  const int kNumTasks = 16;
+  for (int i = 0; i < kNumTasks; ++i) {
+    pool.Schedule(client, [&]() {
+      int now = ++running;
+      int expected = max_running;
+      while (now > expected &&
+             !max_running.compare_exchange_weak(expected, now)) {
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      --running;
+      if (++finished == kNumTasks) {
+        done.Release();
+      }
+    });
+  }
+  done.Wait();
+  pool.RemoveClient(client);
+  EXPECT_LE(max_running, 2);
+}
+
+TEST(WorkerPoolTest, TaskGroup) {
+  WorkerPool pool(4);
+  TaskGroup tasks(&pool, 4, 3);
+  Latch blocker;
+  std::atomic<int> scheduled{0};
+  std::atomic<int> finished{0};
+  const int kNumTasks = 16;
+  std::thread scheduler([&]() {
+    for (int i = 0; i < kNumTasks; ++i) {
+      tasks.Schedule([&, i]() {
+        blocker.Wait();
+        ++finished;
+        if (i == 5) {
+          throw std::runtime_error("task failed");
+        }
+      });
+      ++scheduled;
+    }
+  });
+  // Schedule() blocks while 3 tasks are pending.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(scheduled, 3);
+  blocker.Release();
+  scheduler.join();
+  EXPECT_THROW(tasks.Wait(), std::runtime_error);
+  EXPECT_EQ(finished, kNumTasks);
+  // The exception is only rethrown once.
+  tasks.Wait();
+}
+
+}  // namespace caffe2
@@ -1,14 +1,22 @@
 #include "caffe2/core/workspace.h"
 
 #include <algorithm>
+#include <cstring>
 #include <ctime>
 
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/net.h"
+#include "caffe2/core/numa.h"
 #include "caffe2/core/timer.h"
 #include "caffe2/proto/caffe2.pb.h"
 
+CAFFE2_DEFINE_int(
+    caffe2_worker_pool_num_workers,
+    0,
+    "Number of threads of the worker pool shared by the nets of a workspace. "
+    "If 0, the number of hardware threads is used.");
+
 namespace caffe2 {
 
 namespace {
@@ -53,6 +61,7 @@ vector<string> Workspace::Blobs() const {
   for (auto& entry : blob_map_) {
     names.push_back(entry.first);
   }
+  std::sort(names.begin(), names.end());
   if (shared_) {
     vector<string> shared_blobs = shared_->Blobs();
     names.insert(names.end(), shared_blobs.begin(), shared_blobs.end());
@@ -60,30 +69,42 @@ vector<string> Workspace::Blobs() const {
   return names;
 }
 
+void Workspace::EnableArena(size_t chunk_bytes) {
+  CAFFE_ENFORCE(!arena_, "The workspace already has an arena.");
+  CAFFE_ENFORCE(
+      blob_map_.empty() && net_map_.empty(),
+      "The arena has to be enabled before blobs or nets are created.");
+  arena_.reset(new Arena(chunk_bytes));
+}
+
+const Blob* Workspace::FindBlob(const string& name) const {
+  for (const Workspace* ws = this; ws; ws = ws->shared_) {
+    auto it = ws->blob_map_.find(name);
+    if (it != ws->blob_map_.end()) {
+      return it->second.get();
+    }
+  }
+  return nullptr;
+}
+
 Blob* Workspace::CreateBlob(const string& name) {
-  if (HasBlob(name)) {
+  const Blob* blob = FindBlob(name);
+  if (blob) {
     VLOG(1) << "Blob " << name << " already exists. Skipping.";
-  } else {
-    VLOG(1) << "Creating blob " << name;
-    blob_map_[name] = unique_ptr<Blob>(new Blob());
+    return const_cast<Blob*>(blob);
   }
-  return GetBlob(name);
+  VLOG(1) << "Creating blob " << name;
+  auto& created = blob_map_[name];
+  created.reset(new Blob());
+  return created.get();
 }
 
 const Blob* Workspace::GetBlob(const string& name) const {
-  if (blob_map_.count(name)) {
-    return blob_map_.at(name).get();
-  } else if (shared_ && shared_->HasBlob(name)) {
-    return shared_->GetBlob(name);
-  } else {
+  const Blob* blob = FindBlob(name);
+  if (!blob) {
     LOG(WARNING) << "Blob " << name << " not in the workspace.";
-    // TODO(Yangqing): do we want to always print out the list of blobs here?
-    // LOG(WARNING) << "Current blobs:";
-    // for (const auto& entry : blob_map_) {
-    //   LOG(WARNING) << entry.first;
-    // }
-    return nullptr;
   }
+  return blob;
 }
 
 Blob* Workspace::GetBlob(const string& name) {
@@ -91,6 +112,36 @@ Blob* Workspace::GetBlob(const string& name) {
       static_cast<const Workspace*>(this)->GetBlob(name));
 }
 
+int Workspace::ReplicateBlobPerNUMANode(const string& name) {
+  if (!IsNUMAEnabled()) {
+    return 0;
+  }
+  const Blob* blob = GetBlob(name);
+  CAFFE_ENFORCE(blob, "Blob ", name, " does not exist.");
+  CAFFE_ENFORCE(
+      blob->IsType<TensorCPU>(), "Blob ", name, " is not a CPU tensor.");
+  const auto& tensor = blob->Get<TensorCPU>();
+  const int num_nodes = GetNumNUMANodes();
+  for (int node = 0; node < num_nodes; ++node) {
+    auto* replica =
+        CreateBlob(NUMAReplicaBlobName(name, node))->GetMutable<TensorCPU>();
+    replica->ResizeLike(tensor);
+    const size_t nbytes = tensor.nbytes();
+    void* data = nbytes && !tensor.meta().ctor() ? NUMAAlloc(nbytes, node)
+                                                 : nullptr;
+    if (!data) {
+      replica->CopyFrom(tensor);
+      continue;
+    }
+    replica->ShareExternalPointer(
+        std::shared_ptr<void>(
+            data, [nbytes](void* ptr) { NUMAFree(ptr, nbytes); }),
+        tensor.meta());
+    memcpy(data, tensor.raw_data(), nbytes);
+  }
+  return num_nodes;
+}
+
 NetBase* Workspace::CreateNet(const NetDef& net_def) {
   CAFFE_ENFORCE(net_def.has_name(), "Net definition should have a name.");
   if (net_map_.count(net_def.name()) > 0) {
@@ -135,6 +186,21 @@ bool Workspace::RunNet(const string& name) {
   return net_map_[name]->Run();
 }
 
+WorkerPool* Workspace::GetWorkerPool() {
+  if (shared_) {
+    return shared_->GetWorkerPool();
+  }
+  std::call_once(worker_pool_created_, [this]() {
+    int num_workers = FLAGS_caffe2_worker_pool_num_workers;
+    if (num_workers <= 0) {
+      num_workers = std::max<int>(std::thread::hardware_concurrency(), 1);
+    }
+    LOG(INFO) << "Creating worker pool with " << num_workers << " workers.";
+    worker_pool_.reset(new WorkerPool(num_workers));
+  });
+  return worker_pool_.get();
+}
+
 bool Workspace::RunOperatorOnce(const OperatorDef& op_def) {
   std::unique_ptr<OperatorBase> op(CreateOperator(op_def, this));
   if (op.get() == nullptr) {
@@ -3,13 +3,17 @@
 
 #include <climits>
 #include <cstddef>
+#include <mutex>  // NOLINT
 #include <typeinfo>
+#include <unordered_map>
 #include <vector>
 
+#include "caffe2/core/arena.h"
 #include "caffe2/core/blob.h"
 #include "caffe2/core/common.h"
 #include "caffe2/core/registry.h"
 #include "caffe2/core/net.h"
+#include "caffe2/core/worker_pool.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/signal_handler.h"
 
@@ -34,7 +38,9 @@ struct StopOnSignal {
 class Workspace {
  public:
   typedef std::function<bool(int)> ShouldContinue;
-  typedef CaffeMap<string, unique_ptr<Blob> > BlobMap;
+  // Blobs are looked up by name far more often than they are listed, so they
+  // are kept in a hash table. Blobs() sorts the names.
+  typedef std::unordered_map<string, unique_ptr<Blob> > BlobMap;
   typedef CaffeMap<string, unique_ptr<NetBase> > NetMap;
   /**
    * Initializes an empty workspace.
@@ -67,6 +73,30 @@ class Workspace {
       : root_folder_(root_folder), shared_(shared) {}
   ~Workspace() {}
 
+  /**
+   * Makes the operators of this workspace allocate their CPU tensors from an
+   * arena owned by the workspace, which frees them all at once when the
+   * workspace is destroyed. This is meant for short-lived child workspaces,
+   * such as one per inference request, and has to be called before any blob
+   * or net is created. Operators of such a workspace cannot write the blobs
+   * of the shared workspace, and tensors of the workspace must not be shared
+   * with tensors that outlive it.
+   */
+  void EnableArena(size_t chunk_bytes = FLAGS_caffe2_arena_chunk_bytes);
+  /**
+   * Returns the arena of the workspace, or nullptr if it has none.
+   */
+  Arena* GetArena() const {
+    return arena_.get();
+  }
+  /**
+   * Checks if a blob with the given name is present in this workspace itself,
+   * as opposed to its shared workspace.
+   */
+  inline bool HasLocalBlob(const string& name) const {
+    return blob_map_.count(name);
+  }
+
   /**
    * Return a list of blob names. This may be a bit slow since it will involve
    * creation of multiple temp variables. For best performance, simply use
@@ -82,7 +112,7 @@ class Workspace {
    * Checks if a blob with the given name is present in the current workspace.
    */
   inline bool HasBlob(const string& name) const {
-    return (blob_map_.count(name) || (shared_ && shared_->HasBlob(name)));
+    return FindBlob(name) != nullptr;
   }
   /**
    * Creates a blob of the given name. The pointer to the blob is returned, but
@@ -93,6 +123,11 @@ class Workspace {
   /**
    * Gets the blob with the given name as a const pointer. If the blob does not
    * exist, a nullptr is returned.
+   *
+   * Blobs are never removed from a workspace, so the pointer stays valid for
+   * the lifetime of the workspace that owns the blob. Code that runs often,
+   * such as operators, should look its blobs up once and keep the pointers
+   * rather than look them up by name on every run.
    */
   const Blob* GetBlob(const string& name) const;
   /**
@@ -100,6 +135,15 @@ class Workspace {
    * not exist, a nullptr is returned.
    */
   Blob* GetBlob(const string& name);
+  /**
+   * Copies the CPU tensor in the given blob to one blob per NUMA node, named
+   * with NUMAReplicaBlobName(), and allocates each copy on its node. Nets whose
+   * device option has a numa_node_id then read the replica of their node
+   * instead of the original blob, as long as they do not write to it, so this
+   * is meant for read-only parameters. Returns the number of replicas, which
+   * is 0 if NUMA is not enabled.
+   */
+  int ReplicateBlobPerNUMANode(const string& name);
 
   // CreateNet creates a network in the current workspace. It can then
   // be referred to by RunNet().
@@ -137,6 +181,13 @@ class Workspace {
     return names;
   }
 
+  /**
+   * Returns the worker pool shared by the nets of this workspace, creating it
+   * on first use with caffe2_worker_pool_num_workers threads. A workspace
+   * created with a shared workspace uses the pool of the shared workspace.
+   */
+  WorkerPool* GetWorkerPool();
+
   /**
    * Runs a plan that has multiple nets and execution steps.
    */
@@ -152,12 +203,21 @@ class Workspace {
   bool RunNetOnce(const NetDef& net_def);
 
  protected:
+  // Returns the blob of the given name in this workspace or, failing that, in
+  // its chain of shared workspaces, or nullptr if there is none.
+  const Blob* FindBlob(const string& name) const;
+
   bool ExecuteStepRecursive(
       const ExecutionStep& execution,
       ShouldContinue externalShouldContinue);
 
  private:
+  // The arena is declared first so that it outlives the tensors using it.
+  unique_ptr<Arena> arena_;
   BlobMap blob_map_;
+  // The worker pool is declared before the nets so that it outlives them.
+  std::once_flag worker_pool_created_;
+  unique_ptr<WorkerPool> worker_pool_;
   NetMap net_map_;
   string root_folder_ = ".";
   Workspace* shared_ = nullptr;
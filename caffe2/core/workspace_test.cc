@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include "caffe2/core/operator.h"
@@ -8,6 +9,20 @@ namespace caffe2 {
 
 class WorkspaceTestFoo {};
 
+// Fills its output with 16 floats, allocated while running.
+class WorkspaceTestFill : public Operator<CPUContext> {
+ public:
+  using Operator<CPUContext>::Operator;
+  bool RunOnDevice() override {
+    Output(0)->Resize(16);
+    Output(0)->mutable_data<float>()[15] = 1;
+    return true;
+  }
+};
+
+OPERATOR_SCHEMA(WorkspaceTestFill).NumInputs(0).NumOutputs(1);
+REGISTER_CPU_OPERATOR(WorkspaceTestFill, WorkspaceTestFill);
+
 TEST(WorkspaceTest, BlobAccess) {
   Workspace ws;
 
@@ -70,6 +85,62 @@ TEST(WorkspaceTest, Sharing) {
   }
 }
 
+TEST(WorkspaceTest, BlobPointersAreStable) {
+  Workspace grandparent;
+  Workspace parent(&grandparent);
+  Workspace child(&parent);
+  Blob* a = grandparent.CreateBlob("a");
+  Blob* b = child.CreateBlob("b");
+  // Growing the tables does not move the blobs.
+  for (int i = 0; i < 1000; ++i) {
+    grandparent.CreateBlob("blob_" + caffe2::to_string(i));
+    child.CreateBlob("child_blob_" + caffe2::to_string(i));
+  }
+  EXPECT_EQ(child.GetBlob("a"), a);
+  EXPECT_EQ(child.CreateBlob("a"), a);
+  EXPECT_EQ(child.GetBlob("b"), b);
+  EXPECT_EQ(child.GetBlob("blob_7"), grandparent.GetBlob("blob_7"));
+  EXPECT_FALSE(parent.HasBlob("child_blob_7"));
+  EXPECT_FALSE(parent.HasBlob("b"));
+
+  // The names of the blobs of each workspace are listed in order.
+  const vector<string> blobs = parent.Blobs();
+  EXPECT_EQ(blobs.size(), 1001);
+  EXPECT_TRUE(std::is_sorted(blobs.begin(), blobs.end()));
+}
+
+TEST(WorkspaceTest, Arena) {
+  Workspace parent;
+  parent.CreateBlob("param");
+  Workspace child(&parent);
+  child.EnableArena();
+  EXPECT_NE(child.GetArena(), nullptr);
+  EXPECT_THROW(child.EnableArena(), EnforceNotMet);
+
+  OperatorDef op_def;
+  op_def.set_type("WorkspaceTestFill");
+  op_def.add_output("out");
+  EXPECT_TRUE(child.RunOperatorOnce(op_def));
+  const auto& out = child.GetBlob("out")->Get<TensorCPU>();
+  EXPECT_EQ(out.data<float>()[15], 1);
+  EXPECT_EQ(out.data<float>()[0], 0);
+  EXPECT_EQ(child.GetArena()->allocated_bytes(), 16 * sizeof(float));
+  EXPECT_FALSE(parent.HasBlob("out"));
+
+  // Tensors allocated outside of the operators do not use the arena.
+  child.CreateBlob("in")->GetMutable<TensorCPU>()->Resize(16);
+  child.GetBlob("in")->GetMutable<TensorCPU>()->mutable_data<float>();
+  EXPECT_EQ(child.GetArena()->allocated_bytes(), 16 * sizeof(float));
+
+  // Operators cannot write blobs of the parent, which outlive the arena.
+  op_def.set_output(0, "param");
+  EXPECT_THROW(child.RunOperatorOnce(op_def), EnforceNotMet);
+
+  Workspace late;
+  late.CreateBlob("blob");
+  EXPECT_THROW(late.EnableArena(), EnforceNotMet);
+}
+
 }  // namespace caffe2
 
 
@@ -2,6 +2,27 @@
 
 namespace caffe2 {
 namespace {
+
+vector<TensorProto> TensorInferenceForConcat(
+    const OperatorDef& def,
+    const vector<TensorProto>& in) {
+  ArgumentHelper helper(def);
+  const int axis = helper.HasArgument("axis")
+      ? helper.GetSingleArgument<int>("axis", -1)
+      : GetDimFromOrderString(helper.GetSingleArgument<string>("order", ""));
+  CAFFE_ENFORCE(axis >= 0);
+  CAFFE_ENFORCE(axis < in[0].dims_size());
+  vector<TIndex> dims(in[0].dims().begin(), in[0].dims().end());
+  for (int i = 1; i < in.size(); ++i) {
+    CAFFE_ENFORCE(in[i].dims_size() == in[0].dims_size());
+    dims[axis] += in[i].dims(axis);
+  }
+  return vector<TensorProto>{
+      CreateTensorShape(dims, in[0].data_type()),
+      CreateTensorShape(
+          vector<int>{static_cast<int>(in.size())}, TensorProto::INT32)};
+}
+
 REGISTER_CPU_OPERATOR(Split, SplitOp<CPUContext>);
 REGISTER_CPU_OPERATOR(Concat, ConcatOp<CPUContext>);
 OPERATOR_SCHEMA(Split)
@@ -15,6 +36,7 @@ OPERATOR_SCHEMA(Concat)
     .NumOutputs(2)
     .Arg("axis", "Which axis to concat on")
     .Arg("order", "Either NHWC or HCWH, will concat on C axis")
+    .TensorInferenceFunction(TensorInferenceForConcat)
     .SetDoc("Concatenate a list of tensors into a single tensor.");
 
 // Backward compatibility names.
@@ -27,6 +49,7 @@ OPERATOR_SCHEMA(DepthSplit)
 OPERATOR_SCHEMA(DepthConcat)
     .NumInputs(1, INT_MAX)
     .NumOutputs(2)
+    .TensorInferenceFunction(TensorInferenceForConcat)
     .SetDoc("Backward compatible operator name for Concat.");
 
 class GetSplitGradient : public GradientMakerBase {
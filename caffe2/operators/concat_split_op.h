@@ -123,6 +123,24 @@ bool SplitOp<Context>::RunOnDevice() {
   for (int i = axis_ + 1; i < input.ndim(); ++i) {
     after *= input.dim32(i);
   }
+  // The outputs are views of the input, which are only copied if they are
+  // not contiguous and get read. Strided views are only supported on CPU, so
+  // other devices copy unless the split is along the outer dimensions.
+  if (std::is_same<Context, CPUContext>::value || before == 1) {
+    vector<TIndex> strides(input.ndim());
+    TIndex stride = 1;
+    for (int i = input.ndim() - 1; i >= 0; --i) {
+      strides[i] = stride;
+      stride *= input.dim(i);
+    }
+    TIndex offset = 0;
+    for (int i = 0; i < OutputSize(); ++i) {
+      output_dims[axis_] = axis_data[i];
+      Output(i)->ShareDataStrided(input, output_dims, strides, offset);
+      offset += axis_data[i] * after;
+    }
+    return true;
+  }
   for (int i = 0; i < OutputSize(); ++i) {
     auto* output = Output(i);
     output_dims[axis_] = axis_data[i];
@@ -130,7 +148,7 @@ bool SplitOp<Context>::RunOnDevice() {
     math::CopyMatrix<Context>(
         input.itemsize(), before, axis_data[i] * after,
         static_cast<const char*>(input.raw_data()) + input_offset,
-        input.dim32(axis_) * after, output->raw_mutable_data(input.meta()),
+        input.dim32(axis_) * after, output->raw_mutable_data_uninitialized(input.meta()),
         axis_data[i] * after, &context_);
     input_offset += axis_data[i] * after * input.itemsize();
   }
@@ -193,7 +211,7 @@ bool ConcatOp<Context>::RunOnDevice() {
     math::CopyMatrix<Context>(
         input.itemsize(), before, input.dim32(axis_) * after, input.raw_data(),
         input.dim32(axis_) * after,
-        static_cast<char*>(output->raw_mutable_data(input.meta()))
+        static_cast<char*>(output->raw_mutable_data_uninitialized(input.meta()))
             + output_offset,
         output_channels * after, &context_);
     output_offset += input.dim32(axis_) * after * input.itemsize();
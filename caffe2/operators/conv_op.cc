@@ -9,6 +9,7 @@ REGISTER_CPU_OPERATOR(ConvGradient, ConvGradientOp<float, CPUContext>);
 OPERATOR_SCHEMA(Conv)
   .NumInputs(3)
   .NumOutputs(1)
+  .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForConv)
   .SetDoc(R"DOC(
 The convolution operator consumes an input vector, the filter blob and the bias
 blob and computes the output. Note that other parameters, such as the stride and
@@ -46,8 +46,9 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
         bias_multiplier_.template mutable_data<T>(), &context_);
   }
   const T* Xdata = X.template data<T>();
-  T* col_buffer_data = col_buffer_.template mutable_data<T>();
-  T* Ydata = Y->template mutable_data<T>();
+  T* col_buffer_data =
+      col_buffer_.template mutable_data_uninitialized<T>();
+  T* Ydata = Y->template mutable_data_uninitialized<T>();
   // Im2col, followed by gemm.
   for (int image_id = 0; image_id < N; ++image_id) {
     math::Im2col<T, Context, StorageOrder::NCHW>(
@@ -112,7 +113,7 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNHWC() {
   // The col buffer is stored in HWC order as well - kernel_dim, and the height
   // and width.
   const T* Xdata = X.template data<T>();
-  T* Ydata = Y->template mutable_data<T>();
+  T* Ydata = Y->template mutable_data_uninitialized<T>();
   if (bias_multiplier_.size() != output_image_size) {
     // If the helper bias multiplier is not M, reshape and fill it with one.
     bias_multiplier_.Resize(vector<TIndex>(1, output_image_size));
@@ -149,7 +150,8 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNHWC() {
     }
     col_buffer_.Resize(vector<TIndex>{
         Y->dim32(1), Y->dim32(2), kernel_h_, kernel_w_, C});
-    T* col_buffer_data = col_buffer_.template mutable_data<T>();
+    T* col_buffer_data =
+        col_buffer_.template mutable_data_uninitialized<T>();
     // Im2col, followed by gemm.
     for (int image_id = 0; image_id < N; ++image_id) {
       math::Im2col<T, Context, StorageOrder::NHWC>(
@@ -224,7 +226,8 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
   const T* Xdata = X.template data<T>();
   const T* filter_data = filter.template data<T>();
   const T* dYdata = dY.template data<T>();
-  T* col_buffer_data = col_buffer_.template mutable_data<T>();
+  T* col_buffer_data =
+      col_buffer_.template mutable_data_uninitialized<T>();
   T* dfilter_data = dfilter->template mutable_data<T>();
   T* dbias_data = dbias->template mutable_data<T>();
   // Pre-setting the gradients to zero.
@@ -335,7 +338,8 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNHWC() {
   const T* Xdata = X.template data<T>();
   const T* const filter_data = filter.template data<T>();
   const T* const dYdata = dY.template data<T>();
-  T* col_buffer_data = col_buffer_.template mutable_data<T>();
+  T* col_buffer_data =
+      col_buffer_.template mutable_data_uninitialized<T>();
   T* dfilter_data = dfilter->template mutable_data<T>();
   T* dbias_data = dbias->template mutable_data<T>();
   // Pre-setting the gradients to zero.
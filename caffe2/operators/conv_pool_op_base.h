@@ -146,6 +146,86 @@ class ConvPoolOpBase : public Operator<Context> {
     }
   }
 
+  // Infers the output of a conv or pool operator from its input, reading the
+  // arguments the same way as the constructor. The output channel is given
+  // since it may not be identical to the input channels.
+  static vector<TensorProto> TensorInferenceForSchema(
+      const OperatorDef& def,
+      const vector<TensorProto>& in,
+      int output_channel) {
+    ArgumentHelper helper(def);
+    CAFFE_ENFORCE(in[0].dims_size() == 4);
+    const int pad = helper.GetSingleArgument<int>("pad", 0);
+    int pad_t = helper.GetSingleArgument<int>("pad_t", pad);
+    int pad_l = helper.GetSingleArgument<int>("pad_l", pad);
+    int pad_b = helper.GetSingleArgument<int>("pad_b", pad);
+    int pad_r = helper.GetSingleArgument<int>("pad_r", pad);
+    const auto legacy_pad = static_cast<LegacyPadding>(
+        helper.GetSingleArgument<int>("legacy_pad", LegacyPadding::NOTSET));
+    const int kernel = helper.GetSingleArgument<int>("kernel", 0);
+    const int kernel_h = helper.GetSingleArgument<int>("kernel_h", kernel);
+    const int kernel_w = helper.GetSingleArgument<int>("kernel_w", kernel);
+    const int dilation = helper.GetSingleArgument<int>("dilation", 1);
+    const int dilation_h = helper.GetSingleArgument<int>("dilation_h", dilation);
+    const int dilation_w = helper.GetSingleArgument<int>("dilation_w", dilation);
+    const int stride = helper.GetSingleArgument<int>("stride", 1);
+    const int stride_h = helper.GetSingleArgument<int>("stride_h", stride);
+    const int stride_w = helper.GetSingleArgument<int>("stride_w", stride);
+    const StorageOrder order = StringToStorageOrder(
+        helper.GetSingleArgument<string>("order", "NCHW"));
+    const bool channel_first = (order == StorageOrder::NCHW);
+    const int N = in[0].dims(0);
+    const int H = in[0].dims(channel_first ? 2 : 1);
+    const int W = in[0].dims(channel_first ? 3 : 2);
+
+    int output_height = 0, output_width = 0;
+    ComputeSizeAndPad(
+        H,
+        stride_h,
+        kernel_h,
+        dilation_h,
+        legacy_pad,
+        &pad_t,
+        &pad_b,
+        &output_height,
+        def);
+    ComputeSizeAndPad(
+        W,
+        stride_w,
+        kernel_w,
+        dilation_w,
+        legacy_pad,
+        &pad_l,
+        &pad_r,
+        &output_width,
+        def);
+    vector<int> dims;
+    if (channel_first) {
+      dims = {N, output_channel, output_height, output_width};
+    } else {
+      dims = {N, output_height, output_width, output_channel};
+    }
+    return vector<TensorProto>{CreateTensorShape(dims, in[0].data_type())};
+  }
+
+  static vector<TensorProto> TensorInferenceForConv(
+      const OperatorDef& def,
+      const vector<TensorProto>& in) {
+    CAFFE_ENFORCE(in[1].dims_size() >= 1);
+    return TensorInferenceForSchema(def, in, in[1].dims(0));
+  }
+
+  static vector<TensorProto> TensorInferenceForPool(
+      const OperatorDef& def,
+      const vector<TensorProto>& in) {
+    ArgumentHelper helper(def);
+    const StorageOrder order = StringToStorageOrder(
+        helper.GetSingleArgument<string>("order", "NCHW"));
+    CAFFE_ENFORCE(in[0].dims_size() == 4);
+    return TensorInferenceForSchema(
+        def, in, in[0].dims(order == StorageOrder::NCHW ? 1 : 3));
+  }
+
   bool RunOnDevice() override {
     CAFFE_ENFORCE(kernel_h_ > 0);
     CAFFE_ENFORCE(kernel_w_ > 0);
@@ -205,8 +285,30 @@ class ConvPoolOpBase : public Operator<Context> {
       int* pad_head,
       int* pad_tail,
       int* out_size) {
+    ComputeSizeAndPad(
+        in_size,
+        stride,
+        kernel,
+        dilation,
+        legacy_pad_,
+        pad_head,
+        pad_tail,
+        out_size,
+        def());
+  }
+
+  static inline void ComputeSizeAndPad(
+      const int in_size,
+      const int stride,
+      const int kernel,
+      const int dilation,
+      const LegacyPadding legacy_pad,
+      int* pad_head,
+      int* pad_tail,
+      int* out_size,
+      const OperatorDef& def) {
     const int dkernel = dilation * (kernel - 1) + 1;
-    switch (legacy_pad_) {
+    switch (legacy_pad) {
       case LegacyPadding::NOTSET:
         // We will just use the direct padding head and tail values, but we
         // will verify that they are non-negative.
@@ -270,7 +372,7 @@ class ConvPoolOpBase : public Operator<Context> {
                  "results. We are keeping this behavior for backward compatibility"
                  ", but you are strongly recommended to move away from it. The "
                  "operator that generates this warning is: "
-              << ProtoDebugString(def());
+              << ProtoDebugString(def);
         }
         *pad_tail = *pad_head + stride * (*out_size - standard_out_size);
         break;
@@ -315,25 +315,12 @@ class ReadNextBatchOp : public Operator<CPUContext> {
       cursor->it.advance(lengths, cursor->offsets, sizes, limits, batchSize_);
     }
     // gather data
-    std::vector<TIndex> outDim;
     for (int i = 0; i < cursor->it.fields().size(); ++i) {
       auto lengthIdx = cursor->it.fields()[i].lengthFieldId + 1;
       auto size = sizes[lengthIdx];
       auto offset = offsets[lengthIdx];
-      auto& in = Input(i + 1);
-      auto innerSize = in.size_from_dim(1);
-      outDim = in.dims();
-      outDim[0] = size;
-      auto* out = Output(i);
-      out->Resize(outDim);
-      if (out->size() == 0) {
-        continue;
-      }
-      void* src =
-          (char*)in.raw_data() + offset * innerSize * in.meta().itemsize();
-      void* dst = out->raw_mutable_data(in.meta());
-      context_.template CopyItems<CPUContext, CPUContext>(
-          in.meta(), out->size(), src, dst);
+      // The batch shares the rows of the dataset until either is written.
+      Output(i)->ShareRows(Input(i + 1), offset, offset + size);
     }
     return true;
   }
@@ -573,11 +560,7 @@ class AppendOp final : public Operator<Context> {
     for (int i = 1; i < a.ndim(); ++i) {
       CAFFE_ENFORCE(a.dims()[i] == b.dims()[i]);
     }
-    auto oldSize = c->size();
-    c->Extend(b.dims()[0], kDatasetGrowthPct, &context_);
-    auto* dst = (char*)c->raw_mutable_data() + oldSize * b.meta().itemsize();
-    context_.template CopyItems<Context, Context>(
-        b.meta(), b.size(), b.raw_data(), dst);
+    c->Append(b, kDatasetGrowthPct);
     return true;
   }
 };
@@ -624,11 +607,7 @@ class AtomicAppendOp final : public Operator<Context> {
         c->CopyFrom(b);
         continue;
       }
-      auto oldSize = c->size();
-      c->Extend(b.dims()[0], kDatasetGrowthPct, &context_);
-      auto* dst = (char*)c->raw_mutable_data() + oldSize * b.meta().itemsize();
-      context_.template CopyItems<Context, Context>(
-          b.meta(), b.size(), b.raw_data(), dst);
+      c->Append(b, kDatasetGrowthPct);
     }
     return true;
   }
@@ -738,6 +717,9 @@ Input(0) is a blob pointing to a TreeCursor, and
 [Input(1),... Input(num_fields)] a list of tensors containing the data for
 each field of the dataset.
 
+The batch shares the storage of the dataset fields instead of copying it,
+until either of them is written.
+
 ReadNextBatch is thread safe.
 )DOC")
     .Input(0, "cursor", "A blob containing a pointer to the cursor.")
@@ -836,9 +818,10 @@ OPERATOR_SCHEMA(Append)
     .SetDoc(R"DOC(
 Append input 2 to the end of input 1.
 Input 1 must be the same as output, that is, it is required to be in-place.
-Input 1 may have to be re-allocated in order for accommodate to the new size.
-Currently, an exponential growth ratio is used in order to ensure amortized
-constant time complexity.
+Rows that do not fit the capacity of input 1 are kept in separate chunks,
+grown at an exponential ratio, and only copied into a contiguous storage the
+next time input 1 is read, which ReadNextBatch does not need for the rows of
+a single chunk.
 All except the outer-most dimension must be the same between input 1 and 2.
 )DOC")
     .Input(0, "dataset", "The tensor to be appended to.")
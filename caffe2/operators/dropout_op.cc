@@ -68,6 +68,14 @@ OPERATOR_SCHEMA(Dropout)
     .NumInputs(1)
     .NumOutputs(2)
     .AllowInplace({{0, 0}})
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorProto>& in) {
+      vector<TensorProto> out(def.output_size(), in[0]);
+      if (out.size() > 1) {
+        out[1].set_data_type(TensorProto::BOOL);
+      }
+      return out;
+    })
     .SetDoc(R"DOC(
 Dropout takes one input data (Tensor<float>) and produces two Tensor outputs,
 output (Tensor<float>) and mask (Tensor<bool>). Depending on whether it is in
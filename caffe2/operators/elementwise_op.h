@@ -45,11 +45,11 @@ class UnaryElementwiseWithArgsOp : public Operator<Context> {
     auto* output = Output(0);
     output->ResizeLike(input);
     using R = typename TypeMap::template type<T>;
-    functor_(
-        input.size(),
-        input.template data<T>(),
-        output->template mutable_data<R>(),
-        &context_);
+    // Shared output content only has to be kept when the op runs in place.
+    R* output_data = &input == output
+        ? output->template mutable_data_uninitialized<R>()
+        : output->template mutable_data_overwrite<R>();
+    functor_(input.size(), input.template data<T>(), output_data, &context_);
     return true;
   }
 
@@ -159,8 +159,9 @@ class BinaryElementwiseOp : public Operator<Context> {
     C->ResizeLike(A);
     const T* Adata = A.template data<T>();
     const T* Bdata = B.template data<T>();
-    auto* Cdata =
-        C->template mutable_data<typename TypeMap::template type<T>>();
+    using R = typename TypeMap::template type<T>;
+    R* Cdata = &A == C || &B == C ? C->template mutable_data_uninitialized<R>()
+                                  : C->template mutable_data_overwrite<R>();
     if (!enable_broadcast_) {
       CAFFE_ENFORCE(
           A.dims() == B.dims(),
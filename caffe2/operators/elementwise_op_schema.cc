@@ -23,6 +23,22 @@ For example, the following tensor shapes are supported (with broadcast=1):
 Argument `broadcast=1` needs to be passed to enable broadcasting.
 )DOC";
 
+// The output of the binary ops has the shape of A, since B is broadcasted to
+// A if necessary.
+vector<TensorProto> ElementwiseOpShapeInference(
+    const OperatorDef& /*def*/,
+    const vector<TensorProto>& in) {
+  return vector<TensorProto>{in[0]};
+}
+
+vector<TensorProto> ElementwiseBoolOpShapeInference(
+    const OperatorDef& /*def*/,
+    const vector<TensorProto>& in) {
+  vector<TensorProto> out{in[0]};
+  out[0].set_data_type(TensorProto::BOOL);
+  return out;
+}
+
 std::function<void(OpSchema&)> MathDocGenerator(const char* name) {
   return [=](OpSchema& schema) {
     string doc = R"DOC(
@@ -52,21 +68,25 @@ OPERATOR_SCHEMA(Add)
     .NumInputs(2)
     .NumOutputs(1)
     .AllowInplace({{0, 0}, {1, 0}})
+    .TensorInferenceFunction(ElementwiseOpShapeInference)
     .FillUsing(MathDocGenerator("addition"));
 OPERATOR_SCHEMA(Sub)
     .NumInputs(2)
     .NumOutputs(1)
     .AllowInplace({{0, 0}, {1, 0}})
+    .TensorInferenceFunction(ElementwiseOpShapeInference)
     .FillUsing(MathDocGenerator("subtraction"));
 OPERATOR_SCHEMA(Mul)
     .NumInputs(2)
     .NumOutputs(1)
     .AllowInplace({{0, 0}, {1, 0}})
+    .TensorInferenceFunction(ElementwiseOpShapeInference)
     .FillUsing(MathDocGenerator("multiplication"));
 OPERATOR_SCHEMA(Div)
     .NumInputs(2)
     .NumOutputs(1)
     .AllowInplace({{0, 0}})
+    .TensorInferenceFunction(ElementwiseOpShapeInference)
     .FillUsing(MathDocGenerator("division"));
 OPERATOR_SCHEMA(DivGradient).NumInputs(3).NumOutputs(2).AllowInplace({{0, 0}});
 
@@ -189,9 +209,12 @@ Performs element-wise comparison `{name}` (with limited broadcast support).
   };
 }
 
-#define CAFFE2_SCHEMA_FOR_BINARY_COMPARISON_OP(name, symbol)  \
-  OPERATOR_SCHEMA(name).NumInputs(2).NumOutputs(1).FillUsing( \
-      ComparisonDocGenerator(symbol));                        \
+#define CAFFE2_SCHEMA_FOR_BINARY_COMPARISON_OP(name, symbol)       \
+  OPERATOR_SCHEMA(name)                                            \
+      .NumInputs(2)                                                \
+      .NumOutputs(1)                                               \
+      .TensorInferenceFunction(ElementwiseBoolOpShapeInference)    \
+      .FillUsing(ComparisonDocGenerator(symbol));                  \
   SHOULD_NOT_DO_GRADIENT(name)
 
 CAFFE2_SCHEMA_FOR_BINARY_COMPARISON_OP(LT, "<");
@@ -223,9 +246,12 @@ Both input operands should be of type `bool`.
   };
 }
 
-#define CAFFE2_SCHEMA_FOR_BINARY_LOGICAL_OP(name, symbol)     \
-  OPERATOR_SCHEMA(name).NumInputs(2).NumOutputs(1).FillUsing( \
-      LogicalDocGenerator(symbol));                           \
+#define CAFFE2_SCHEMA_FOR_BINARY_LOGICAL_OP(name, symbol)          \
+  OPERATOR_SCHEMA(name)                                            \
+      .NumInputs(2)                                                \
+      .NumOutputs(1)                                               \
+      .TensorInferenceFunction(ElementwiseBoolOpShapeInference)    \
+      .FillUsing(LogicalDocGenerator(symbol));                     \
   SHOULD_NOT_DO_GRADIENT(name)
 
 CAFFE2_SCHEMA_FOR_BINARY_LOGICAL_OP(Or, "or");
@@ -235,6 +261,7 @@ CAFFE2_SCHEMA_FOR_BINARY_LOGICAL_OP(Xor, "xor");
 OPERATOR_SCHEMA(Not)
     .NumInputs(1)
     .NumOutputs(1)
+    .IdenticalTypeAndShape()
     .SetDoc(R"DOC(Performs element-wise negation.)DOC")
     .Input(0, "X", "Input tensor of type `bool`.")
     .Output(0, "Y", "Output tensor of type `bool`.");
@@ -9,6 +9,20 @@ REGISTER_CPU_OPERATOR(FCGradient, FullyConnectedGradientOp<float, CPUContext>);
 OPERATOR_SCHEMA(FC)
   .NumInputs(3)
   .NumOutputs(1)
+  .TensorInferenceFunction([](const OperatorDef& def,
+                              const vector<TensorProto>& in) {
+    ArgumentHelper helper(def);
+    int axis = helper.GetSingleArgument<int32_t>("axis", 1);
+    const int ndim = in[0].dims_size();
+    CAFFE_ENFORCE(axis >= -ndim && axis < ndim, "Invalid axis: ", axis);
+    if (axis < 0) {
+      axis += ndim;
+    }
+    CAFFE_ENFORCE(in[1].dims_size() >= 1);
+    vector<TIndex> dims(in[0].dims().begin(), in[0].dims().begin() + axis);
+    dims.push_back(in[1].dims(0));
+    return vector<TensorProto>{CreateTensorShape(dims, in[0].data_type())};
+  })
   .SetDoc(R"DOC(
 Computes the result of passing an input vector X into a fully connected
 layer with 2D weight matrix W and 1D bias vector b.
@@ -67,7 +67,7 @@ class FullyConnectedOp final : public Operator<Context> {
     // W * x
     math::Gemm<T, Context, Engine>(
         CblasNoTrans, CblasTrans, M, N, K, 1, X.template data<T>(),
-        W.template data<T>(), 0, Y->template mutable_data<T>(),
+        W.template data<T>(), 0, Y->template mutable_data_uninitialized<T>(),
         &context_);
     // Add bias term
     if (bias_multiplier_.size() != M) {
@@ -123,7 +123,7 @@ class FullyConnectedGradientOp : public Operator<Context> {
     math::Gemm<T, Context, Engine>(
         CblasTrans, CblasNoTrans, N, K, M, 1,
         dY.template data<T>(), X.template data<T>(),
-        0, dW->template mutable_data<T>(),
+        0, dW->template mutable_data_uninitialized<T>(),
         &context_);
     if (bias_multiplier_.size() != M) {
       // If the helper bias multiplier is not M, reshape and fill it
@@ -138,7 +138,7 @@ class FullyConnectedGradientOp : public Operator<Context> {
     math::Gemv<T, Context>(
         CblasTrans, M, N, 1, dY.template data<T>(),
         bias_multiplier_.template data<T>(), 0,
-        db->template mutable_data<T>(),
+        db->template mutable_data_uninitialized<T>(),
         &context_);
 
     // Compute dX
@@ -148,7 +148,7 @@ class FullyConnectedGradientOp : public Operator<Context> {
       math::Gemm<T, Context, Engine>(
           CblasNoTrans, CblasNoTrans, M, K, N, 1,
           dY.template data<T>(), W.template data<T>(),
-          0, dX->template mutable_data<T>(),
+          0, dX->template mutable_data_uninitialized<T>(),
           &context_);
     }
     return true;
@@ -25,6 +25,23 @@ entries with the outputs.
 If an input is passed, then it is assumed that that input blob is a
 DBReader to load from, and we ignore the db and db_type arguments.
 
+With db_type "mmap", the db is a file written by the Save operator with the
+same db_type, which is mapped in memory: the outputs are CPU tensors that share
+the mapped data, without parsing or copying it. All the processes loading the
+same file share a single copy of it in the page cache, as long as they do not
+write to the tensors.
+
+Tensors saved with the raw argument of the Save operator are loaded with a
+single copy of the data of each chunk. The values are deserialized by a pool
+of --caffe2_serialization_num_workers threads while the db is read, and the
+chunks of a tensor are deserialized concurrently, which includes decompressing
+the chunks saved with the compression argument of the Save operator.
+
+With the delta argument, the db may be a delta snapshot written by the Snapshot
+operator: the full snapshot it is based on is loaded first, then the rows of
+each delta snapshot are written into the loaded tensors, from the oldest to the
+newest one.
+
 )DOC")
     .Arg(
         "absolute_path",
@@ -36,27 +53,68 @@ DBReader to load from, and we ignore the db and db_type arguments.
         "keep_device",
         "(int, default 0) if nonzero, the blobs are loaded into the device that "
         "is specified in the serialized BlobProto. Otherwise, the device will be "
-        "set as the one that the Load operator is being run under.");
+        "set as the one that the Load operator is being run under.")
+    .Arg(
+        "delta",
+        "(int, default 0) if set, follow the chain of delta snapshots that "
+        "ends at the db down to its full snapshot.");
 
 OPERATOR_SCHEMA(Save).NumInputs(1, INT_MAX).NumOutputs(0)
 .SetDoc(R"DOC(
 The Save operator saves a set of blobs to a db. It takes [1, infinity) number
 of inputs and has no output. The contents of the inputs are written into the
 db specified by the arguments.
+
+With db_type "mmap", the inputs must be CPU tensors of fundamental types, and
+are written to a single file in a raw layout that the Load operator maps in
+memory.
+
+Otherwise, the chunks of the tensors are serialized by a pool of
+--caffe2_serialization_num_workers threads, each of which writes the chunks it
+serialized to the db while the others keep serializing. With the compression
+argument, the data of each chunk of the tensors of fundamental types is
+compressed by the thread that serializes it.
 )DOC")
 .Arg("absolute_path",
      "(int, default 0) if set, use the db path directly and do not prepend "
      "the current root folder of the workspace.")
 .Arg("db", "(string) the path to the db to load.")
-.Arg("db_type", "(string) the type of the db.");
+.Arg("db_type", "(string) the type of the db.")
+.Arg("raw",
+     "(int, default 0) if set, tensors of fundamental types are saved as a "
+     "small header followed by their raw data instead of a TensorProto, "
+     "which avoids converting and copying the data item by item.")
+.Arg("compression",
+     "(string, default \"\") the codec the data of the chunks of the tensors "
+     "is compressed with: \"zlib\", or \"shuffle_zlib\" which groups the "
+     "bytes of the items by their position first, and usually compresses "
+     "floats better.");
 
-OPERATOR_SCHEMA(Snapshot).NumInputs(1, INT_MAX).NumOutputs(0)
+OPERATOR_SCHEMA(Snapshot).NumInputs(1, INT_MAX).NumOutputs(0, 1)
 .SetDoc(R"DOC(
 The Snapshot operator is similar to the Save operator, but allows one to save
 to db every few iterations, with a db name that is appended with the iteration
 count. It takes [1, infinity) number of inputs and has no output. The first
 input has to be a TensorCPU of type int and has size 1 (i.e. the iteration
 counter). This is determined whether we need to do snapshotting.
+
+Only every full_every-th snapshot, starting with the first one, saves the
+inputs in full. The others are delta snapshots of the previous snapshot: the
+tensors of the inputs that have a DirtyRows blob named "<input>_dirty_rows",
+such as the parameters of the sparse optimizers run with track_dirty_rows, only
+have the rows written since the previous snapshot saved. They are loaded with
+the delta argument of the Load operator.
+
+With the async argument, the operator copies the inputs and returns, and the
+snapshot is written by a background thread. The CPU tensors are copied in
+chunks by the serialization pool, and only the items the snapshot saves are: a
+delta snapshot copies the rows written since the previous snapshot. The net
+pays for that copy when the operator runs, and writes its tensors afterwards
+without copying them. Other tensors are shared copy-on-write, so the first
+write of one of them before the snapshot is written copies all of it. A
+snapshot waits for the previous one to be written, and a failed snapshot makes
+the next one fail. The optional output is a TensorCPU holding the iteration of
+the last snapshot written, or -1, as of the last run of the operator.
 )DOC")
 .Arg("absolute_path",
      "(int, default 0) if set, use the db path directly and do not prepend "
@@ -66,7 +124,15 @@ counter). This is determined whether we need to do snapshotting.
            "\"/home/lonestarr/checkpoint_%08d.db\"")
 .Arg("db_type", "(string) the type of the db.")
 .Arg("every", "(int, default 1) the snapshotting is carried out when "
-              "(iter mod every) is zero.");
+              "(iter mod every) is zero.")
+.Arg("raw", "(int, default 0) if set, tensors are saved in the raw format, "
+            "see the Save operator.")
+.Arg("compression", "(string, default \"\") the codec tensors are compressed "
+                    "with, see the Save operator.")
+.Arg("full_every", "(int, default 1) the number of snapshots between two "
+                   "full snapshots, the others being delta snapshots.")
+.Arg("async", "(int, default 0) if set, the snapshots are written in the "
+              "background.");
 
 NO_GRADIENT(Load);
 SHOULD_NOT_DO_GRADIENT(Save);
@@ -1,13 +1,26 @@
 #ifndef CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 #define CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 
+#include <algorithm>
+#include <condition_variable>  // NOLINT
 #include <cstdio>
+#include <cstring>
+#include <exception>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>  // NOLINT
 #include <unordered_set>
 
+#include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/context.h"
 #include "caffe2/core/db.h"
+#include "caffe2/core/dirty_rows.h"
+#include "caffe2/core/mapped_tensors.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/worker_pool.h"
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/proto_utils.h"
 #include "caffe2/core/logging.h"
@@ -18,6 +31,9 @@ using db::Cursor;
 using db::DB;
 using db::Transaction;
 
+// The key of the SnapshotManifestProto of a delta snapshot.
+constexpr char kSnapshotManifestKey[] = "__snapshot_manifest__";
+
 template <class Context>
 class LoadOp final : public Operator<Context> {
  public:
@@ -28,7 +44,8 @@ class LoadOp final : public Operator<Context> {
             "absolute_path", false)),
         db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
         db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")),
-        keep_device_(OperatorBase::GetSingleArgument<int>("keep_device", 0)) {
+        keep_device_(OperatorBase::GetSingleArgument<int>("keep_device", 0)),
+        delta_(OperatorBase::GetSingleArgument<int>("delta", 0)) {
     if (InputSize() == 0) {
       CHECK_GT(db_name_.size(), 0) << "Must specify a db name.";
       CHECK_GT(db_type_.size(), 0) << "Must specify a db type.";
@@ -46,6 +63,12 @@ class LoadOp final : public Operator<Context> {
     if (InputSize() == 1) {
       const db::DBReader& reader = OperatorBase::Input<db::DBReader>(0);
       extractFrom(reader.cursor(), outputs);
+    } else if (db_type_ == kMappedTensorsDBType) {
+      mapFrom(
+          absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_),
+          outputs);
+    } else if (delta_) {
+      replayFrom(db_name_, outputs);
     } else {
       string full_db_name =
           absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
@@ -59,46 +82,200 @@ class LoadOp final : public Operator<Context> {
   }
 
  private:
-  void extractFrom(Cursor* cursor, const vector<Blob*>& outputs) {
+  // Loads the full snapshot the delta snapshot in db_name is based on, then
+  // applies the deltas from the oldest to the newest one.
+  void replayFrom(const string& db_name, const vector<Blob*>& outputs) {
+    vector<std::pair<string, std::set<string>>> chain;
+    string name = db_name;
+    while (true) {
+      string full_db_name =
+          absolute_path_ ? name : (ws_->RootFolder() + "/" + name);
+      std::unique_ptr<DB> in_db(caffe2::db::CreateDB(
+          db_type_, full_db_name, caffe2::db::READ));
+      CAFFE_ENFORCE(in_db.get(), "Cannot open db: ", name);
+      std::unique_ptr<Cursor> cursor(in_db->NewCursor());
+      // The manifest is written before the blobs, so it is the first key of
+      // the dbs that keep the order of the writes, and the sorted ones can
+      // seek to it.
+      if (cursor->SupportsSeek()) {
+        cursor->Seek(kSnapshotManifestKey);
+      }
+      SnapshotManifestProto manifest;
+      if (cursor->Valid() && cursor->key() == kSnapshotManifestKey) {
+        CAFFE_ENFORCE(manifest.ParseFromString(cursor->value()));
+      }
+      chain.emplace_back(
+          full_db_name,
+          std::set<string>(
+              manifest.delta_blobs().begin(), manifest.delta_blobs().end()));
+      if (!manifest.has_base_db()) {
+        break;
+      }
+      name = manifest.base_db();
+    }
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      VLOG(1) << "Loading snapshot " << it->first;
+      std::unique_ptr<DB> in_db(caffe2::db::CreateDB(
+          db_type_, it->first, caffe2::db::READ));
+      CAFFE_ENFORCE(in_db.get(), "Cannot open db: ", it->first);
+      std::unique_ptr<Cursor> cursor(in_db->NewCursor());
+      extractFrom(cursor.get(), outputs, it->second);
+    }
+  }
+
+  // The outputs share the data of the mapped file, so mapping is only
+  // possible on CPU.
+  void mapFrom(const string& filename, const vector<Blob*>& outputs) {
+    CAFFE_ENFORCE(
+        (std::is_same<Context, CPUContext>::value),
+        "Only CPU tensors can be loaded with db_type ",
+        kMappedTensorsDBType);
+    MappedTensors mapped(filename);
+    for (int i = 0; i < outputs.size(); ++i) {
+      outputs[i]->Reset();
+      mapped.ShareTensor(def().output(i), outputs[i]->GetMutable<TensorCPU>());
+    }
+  }
+
+  // The chunks of the delta blobs are written into the tensors already in
+  // the outputs instead of replacing them.
+  void extractFrom(
+      Cursor* cursor,
+      const vector<Blob*>& outputs,
+      const std::set<string>& deltaBlobs = std::set<string>()) {
     CHECK(cursor);
 
+    // The values are deserialized by the serialization pool while the cursor
+    // is read. The first value of a blob resets and allocates it under the
+    // lock of the blob, then the other chunks of a tensor are deserialized
+    // into their part of it concurrently.
+    struct BlobState {
+      std::mutex mutex;
+      bool allocated = false;
+    };
+    std::unique_ptr<BlobState[]> blobStates(new BlobState[outputs.size()]);
+    for (const string& name : deltaBlobs) {
+      auto output = output_indices_.find(name);
+      if (output != output_indices_.end()) {
+        CAFFE_ENFORCE(
+            outputs[output->second]->template IsType<Tensor<Context>>(),
+            "Delta blob ",
+            name,
+            " is not loaded from its base snapshot.");
+      }
+    }
     // We are tracking sizes of already read tensor parts while reading data
     // chunks. This way we can make sure that all chunks were loaded in the end.
     // This is a map from output index to current size of the blob
     std::map<int, size_t> blobSizes;
     std::unordered_set<string> loaded;
+    std::mutex loadedMutex;
+    // The number of items of each output scheduled so far, or -1 once all of
+    // them are. Completion is tracked on the cursor thread, as the values
+    // scheduled before may still be deserialized.
+    vector<int64_t> scheduled(outputs.size(), 0);
+    int numScheduled = 0;
+    WorkerPool* pool = SerializationWorkerPool();
+    TaskGroup tasks(pool, pool->num_workers(), 2 * pool->num_workers());
     for (; cursor->Valid(); cursor->Next()) {
       const string& key = cursor->key();
       if (!output_indices_.count(key)) {
         VLOG(1) << "Key " << key << " not used. Skipping.";
-      } else {
+        continue;
+      }
+      const bool delta = deltaBlobs.count(key);
+      auto value = std::make_shared<string>(cursor->value());
+      auto blobIndex = output_indices_[key];
+      // Delta blobs are never done, as any number of their chunks is saved.
+      if (!delta) {
+        auto& blobScheduled = scheduled[blobIndex];
         CAFFE_ENFORCE(
-            loaded.count(key) == 0,
+            blobScheduled >= 0,
             "Multiple copies of blob ",
             key,
             " found in the db.");
-
+        TensorProto header;
+        // The values that cannot be parsed fail to be deserialized.
+        if (PeekTensorChunk(*value, &header) && header.has_segment()) {
+          int64_t tensorSize = 1;
+          for (const auto dim : header.dims()) {
+            tensorSize *= dim;
+          }
+          blobScheduled +=
+              header.segment().end() - header.segment().begin();
+          if (blobScheduled >= tensorSize) {
+            blobScheduled = -1;
+          }
+        } else {
+          // Other values hold the whole blob.
+          CAFFE_ENFORCE(
+              blobScheduled == 0,
+              "Multiple copies of blob ",
+              key,
+              " found in the db.");
+          blobScheduled = -1;
+        }
+        if (blobScheduled < 0) {
+          ++numScheduled;
+        }
+      }
+      tasks.Schedule([&, key, value, blobIndex, delta]() {
         VLOG(2) << "Deserializing blob " << key;
         BlobProto proto;
-        CHECK(proto.ParseFromString(cursor->value()));
+        // Raw tensor chunks only have their header parsed into the proto.
+        size_t rawOffset = 0;
+        if (IsRawTensor(*value)) {
+          rawOffset = ParseRawTensorHeader(*value, &proto);
+        } else {
+          CHECK(proto.ParseFromString(*value));
+        }
         if (!keep_device_) {
           // If we are not keeping the device as the one specified in the
           // proto, we will set the current device.
           SetCurrentDevice(&proto);
         }
-        auto blobIndex = output_indices_[key];
         Blob* blob = outputs.at(blobIndex);
-        auto blobSize = blobSizes.insert({blobIndex, 0});
-        if (blobSize.second) {
-          // We reset the blob so that any existing content is destroyed. This
-          // is to guaranee correct device placement: if we are deserializing
-          // into a TensorCUDA, without explicit Reset we might be loading data
-          // into an existing TensorCUDA that has pre-allocated memory on a
-          // different GPU.
-          blob->Reset();
+        auto deserialize = [&]() {
+          if (rawOffset) {
+            CHECK(blob->DeserializeRaw(
+                proto, value->data() + rawOffset, value->size() - rawOffset));
+          } else {
+            CHECK(blob->Deserialize(proto));
+          }
+        };
+        if (delta) {
+          const auto& tensor = blob->Get<Tensor<Context>>();
+          CAFFE_ENFORCE(
+              proto.has_tensor() &&
+                  vector<TIndex>(
+                      proto.tensor().dims().begin(),
+                      proto.tensor().dims().end()) == tensor.dims(),
+              "Delta of blob ",
+              key,
+              " does not match the shape of its base.");
+          deserialize();
+          return;
+        }
+        {
+          BlobState& state = blobStates[blobIndex];
+          std::unique_lock<std::mutex> lock(state.mutex);
+          if (!state.allocated) {
+            // We reset the blob so that any existing content is destroyed.
+            // This is to guaranee correct device placement: if we are
+            // deserializing into a TensorCUDA, without explicit Reset we might
+            // be loading data into an existing TensorCUDA that has
+            // pre-allocated memory on a different GPU.
+            blob->Reset();
+            deserialize();
+            state.allocated = true;
+          } else {
+            lock.unlock();
+            deserialize();
+          }
         }
-        CHECK(blob->Deserialize(proto));
 
+        std::lock_guard<std::mutex> lock(loadedMutex);
+        auto& blobSize = blobSizes[blobIndex];
         if (!blob->IsType<Tensor<Context>>()) {
           // Deal with non-tensors: we don't support chunking so we're done.
           loaded.insert(key);
@@ -107,20 +284,25 @@ class LoadOp final : public Operator<Context> {
           CAFFE_ENFORCE(proto.has_tensor());
           auto tensorSize = blob->Get<Tensor<Context>>().size();
           if (proto.tensor().has_segment()) {
-            blobSize.first->second += proto.tensor().segment().end() -
+            blobSize += proto.tensor().segment().end() -
                 proto.tensor().segment().begin();
           } else {
-            CHECK(blobSize.first->second == 0);
-            blobSize.first->second = tensorSize;
+            CHECK(blobSize == 0);
+            blobSize = tensorSize;
           }
-          if (blobSize.first->second >= tensorSize) {
+          if (blobSize >= tensorSize) {
             loaded.insert(key);
           }
         }
-
-        if (loaded.size() >= OutputSize()) {
-          break;
-        }
+      });
+      if (deltaBlobs.empty() && numScheduled >= OutputSize()) {
+        break;
+      }
+    }
+    tasks.Wait();
+    for (const string& name : deltaBlobs) {
+      if (output_indices_.count(name)) {
+        loaded.insert(name);
       }
     }
 
@@ -146,6 +328,7 @@ class LoadOp final : public Operator<Context> {
   string db_name_;
   string db_type_;
   bool keep_device_;
+  bool delta_;
   std::map<string, int> output_indices_;
 };
 
@@ -159,30 +342,123 @@ class SaveOp final : public Operator<Context> {
         absolute_path_(
             OperatorBase::GetSingleArgument<int>("absolute_path", false)),
         db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
-        db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")) {
+        db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")),
+        raw_(OperatorBase::GetSingleArgument<int>("raw", 0)),
+        compression_(
+            OperatorBase::GetSingleArgument<string>("compression", "")) {
     CHECK_GT(db_name_.size(), 0) << "Must specify a db name.";
     CHECK_GT(db_type_.size(), 0) << "Must specify a db type.";
+    if (!compression_.empty()) {
+      // Fails early on unknown codecs.
+      GetChunkCodec(compression_);
+    }
+  }
+
+  // The ranges [begin, end) of the items of a tensor to save.
+  typedef vector<std::pair<TIndex, TIndex>> ItemRanges;
+
+  /**
+   * Makes the next run write a delta snapshot of the base snapshot in the db
+   * base_db: only the given items of the tensors of the given inputs are
+   * saved, and a SnapshotManifestProto is saved under kSnapshotManifestKey.
+   */
+  void SetDelta(const string& base_db, std::map<string, ItemRanges> items) {
+    delta_base_db_ = base_db;
+    delta_items_ = std::move(items);
   }
 
   bool RunOnDevice() override {
+    return Save(OperatorBase::Inputs());
+  }
+
+  /**
+   * Saves the given blobs under the names of the inputs of the operator, which
+   * lets SnapshotOp save copies of its inputs from another thread.
+   */
+  bool Save(const vector<const Blob*>& inputs) {
     string full_db_name =
         absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
+    if (db_type_ == kMappedTensorsDBType) {
+      CAFFE_ENFORCE(
+          delta_base_db_.empty(),
+          "Delta snapshots cannot be saved with db_type ",
+          kMappedTensorsDBType);
+      CAFFE_ENFORCE(
+          compression_.empty(),
+          "Tensors cannot be compressed with db_type ",
+          kMappedTensorsDBType);
+      vector<const TensorCPU*> tensors;
+      for (const Blob* input : inputs) {
+        CAFFE_ENFORCE(
+            input->IsType<TensorCPU>(),
+            "Only CPU tensors can be saved with db_type ",
+            kMappedTensorsDBType);
+        tensors.push_back(&input->Get<TensorCPU>());
+      }
+      SaveMappableTensors(
+          full_db_name,
+          vector<string>(def().input().begin(), def().input().end()),
+          tensors);
+      return true;
+    }
     std::unique_ptr<DB> out_db(caffe2::db::CreateDB(
         db_type_, full_db_name, caffe2::db::NEW));
     CAFFE_ENFORCE(out_db.get(),
         "Cannot open db for writing: ", full_db_name);
 
-    const vector<const Blob*>& inputs = OperatorBase::Inputs();
+    // The chunks of the tensors are serialized by the serialization pool, and
+    // written by the task that serialized them while the others keep
+    // serializing. Not every db supports concurrent transactions, so the
+    // writes are serialized.
+    std::mutex writeMutex;
     BlobSerializerBase::SerializationAcceptor acceptor = [&](
         const std::string& blobName, const std::string& data) {
-      // transaction should take care of locking
+      std::lock_guard<std::mutex> lock(writeMutex);
       std::unique_ptr<Transaction> transaction(out_db->NewTransaction());
       transaction->Put(blobName, data);
       transaction->Commit();
     };
+    WorkerPool* pool = SerializationWorkerPool();
+    TaskGroup tasks(
+        pool, pool->num_workers(), std::numeric_limits<int>::max());
+    // The manifest is written before any blob for LoadOp to find it first.
+    if (!delta_base_db_.empty()) {
+      SnapshotManifestProto manifest;
+      manifest.set_base_db(delta_base_db_);
+      for (const auto& items : delta_items_) {
+        manifest.add_delta_blobs(items.first);
+      }
+      acceptor(kSnapshotManifestKey, manifest.SerializeAsString());
+    }
     for (int i = 0; i < inputs.size(); ++i) {
-      inputs[i]->Serialize(def().input(i), acceptor);
+      const string& name = def().input(i);
+      const Blob* input = inputs[i];
+      auto delta = delta_items_.find(name);
+      if (delta == delta_items_.end() &&
+          (!input->IsType<Tensor<Context>>() ||
+           input->Get<Tensor<Context>>().size() == 0)) {
+        tasks.Schedule([&, name, input]() { input->Serialize(name, acceptor); });
+        continue;
+      }
+      const auto& tensor = input->Get<Tensor<Context>>();
+      const ItemRanges items = delta == delta_items_.end()
+          ? ItemRanges{std::make_pair(0, tensor.size())}
+          : delta->second;
+      for (const auto& range : items) {
+        for (TIndex chunkBegin = range.first; chunkBegin < range.second;
+             chunkBegin += FLAGS_caffe2_tensor_chunk_size) {
+          const int32_t chunkSize = std::min<TIndex>(
+              FLAGS_caffe2_tensor_chunk_size, range.second - chunkBegin);
+          tasks.Schedule([&, name, chunkBegin, chunkSize]() {
+            acceptor(
+                name,
+                TensorSerializer<Context>().SerializeChunk(
+                    tensor, name, chunkBegin, chunkSize, raw_, compression_));
+          });
+        }
+      }
     }
+    tasks.Wait();
     return true;
   }
 
@@ -191,6 +467,10 @@ class SaveOp final : public Operator<Context> {
   bool absolute_path_;
   string db_name_;
   string db_type_;
+  bool raw_;
+  string compression_;
+  string delta_base_db_;
+  std::map<string, ItemRanges> delta_items_;
 };
 
 template <typename ... Ts>
@@ -224,40 +504,275 @@ string FormatString(const string& pattern, Ts... values) {
 template <class Context>
 class SnapshotOp final : public Operator<Context> {
  public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
   SnapshotOp(const OperatorDef& operator_def, Workspace* ws)
       : Operator<Context>(operator_def, ws),
         db_pattern_(OperatorBase::GetSingleArgument<string>("db", "")),
         every_(OperatorBase::GetSingleArgument<int>("every", 1)),
+        full_every_(OperatorBase::GetSingleArgument<int>("full_every", 1)),
+        async_(OperatorBase::GetSingleArgument<int>("async", 0)),
         ws_(ws), save_op_def_(operator_def) {
     CHECK_GT(db_pattern_.size(), 0)
         << "Must specify a snapshot file pattern.";
     CHECK_GT(every_, 0) << "Snapshot interval should be positive.";
+    CHECK_GT(full_every_, 0) << "Full snapshot interval should be positive.";
     if (every_ == 1) {
       // Just issue a warning, but it's totally legal so we don't do anything.
       LOG(WARNING) << "It seems that we are snapshotting every iteration. "
                    << "Is that intended?";
     }
     save_op_def_.set_type("Save");
+    save_op_def_.clear_output();
+  }
+
+  ~SnapshotOp() {
+    // The snapshot being written refers to the operator.
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (exception_) {
+      LOG(ERROR) << "The last snapshot of " << db_pattern_ << " failed.";
+    }
   }
 
   bool RunOnDevice() override {
     int64_t iter =
         OperatorBase::Input<TensorCPU>(0).template data<int64_t>()[0];
     if (iter % every_ == 0) {
-      GetMutableArgument("db", true, &save_op_def_)->set_s(
-          FormatString(db_pattern_, iter));
-      SaveOp<Context> sub_op(save_op_def_, ws_);
-      return sub_op.Run();
-    } else {
-      return true;
+      if (async_) {
+        // The previous snapshot decides which db the delta is based on.
+        WaitForSnapshot();
+      }
+      const string db_name = FormatString(db_pattern_, iter);
+      GetMutableArgument("db", true, &save_op_def_)->set_s(db_name);
+      std::shared_ptr<SaveOp<Context>> sub_op(
+          new SaveOp<Context>(save_op_def_, ws_));
+      // The rows written since the last snapshot are taken even for a full
+      // snapshot, so that the next delta only has the ones written after it.
+      // They are marked again if the snapshot fails, and there is no delta
+      // until a snapshot is written.
+      const bool full =
+          snapshots_++ % full_every_ == 0 || last_db_name_.empty();
+      vector<TakenRows> taken;
+      std::map<string, typename SaveOp<Context>::ItemRanges> items;
+      for (int i = 0; i < InputSize(); ++i) {
+        const string& name = def().input(i);
+        Blob* dirty = ws_->GetBlob(DirtyRowsBlobName(name));
+        if (!dirty || !dirty->IsType<DirtyRows>()) {
+          continue;
+        }
+        DirtyRows* rows = dirty->GetMutable<DirtyRows>();
+        const TIndex num_rows = rows->num_rows();
+        taken.push_back(TakenRows{rows, num_rows, rows->TakeRanges()});
+        if (full || num_rows == 0) {
+          continue;
+        }
+        const auto& tensor = Input(i);
+        if (tensor.size() % num_rows != 0) {
+          MarkAgain(taken);
+          CAFFE_THROW(
+              "Blob ",
+              name,
+              " cannot be split into its ",
+              num_rows,
+              " dirty rows.");
+        }
+        const TIndex inner = tensor.size() / num_rows;
+        auto& blob_items = items[name];
+        for (const auto& range : taken.back().ranges) {
+          blob_items.emplace_back(range.first * inner, range.second * inner);
+        }
+      }
+      if (!full) {
+        sub_op->SetDelta(last_db_name_, items);
+      }
+      if (!async_) {
+        bool saved = false;
+        try {
+          saved = sub_op->Run();
+        } catch (...) {
+          MarkAgain(taken);
+          throw;
+        }
+        if (!saved) {
+          MarkAgain(taken);
+          return false;
+        }
+        last_db_name_ = db_name;
+        return true;
+      }
+      SaveAsync(sub_op, iter, db_name, items, std::move(taken));
+    }
+    if (async_ && OutputSize() > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto* completed = OperatorBase::Output<TensorCPU>(0);
+      completed->Resize(1);
+      completed->template mutable_data<int64_t>()[0] = completed_iter_;
     }
+    return true;
   }
 
  private:
+  // The rows a snapshot took from the DirtyRows of an input.
+  struct TakenRows {
+    DirtyRows* rows;
+    TIndex num_rows;
+    vector<std::pair<TIndex, TIndex>> ranges;
+  };
+
+  static void MarkAgain(const vector<TakenRows>& taken) {
+    for (const auto& rows : taken) {
+      rows.rows->MarkRanges(rows.ranges, rows.num_rows);
+    }
+  }
+
+  // Waits for the snapshot written in the background, and rethrows its
+  // exception if it failed.
+  void WaitForSnapshot() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !pending_; });
+    if (exception_) {
+      std::exception_ptr exception = exception_;
+      exception_ = nullptr;
+      std::rethrow_exception(exception);
+    }
+  }
+
+  // Copies the items of the inputs the snapshot saves, then saves them on a
+  // thread of the operator. The I/O pool is not used, as the blocking
+  // operators of the net may hold all of its threads while they wait for the
+  // net to go on.
+  void SaveAsync(
+      std::shared_ptr<SaveOp<Context>> sub_op,
+      int64_t iter,
+      const string& db_name,
+      const std::map<string, typename SaveOp<Context>::ItemRanges>& items,
+      vector<TakenRows> taken) {
+    auto blobs = std::make_shared<vector<std::unique_ptr<Blob>>>();
+    try {
+      // The CPU tensors are copied in the chunks the snapshot is saved in by
+      // the serialization pool before the operator returns, so that the net
+      // does not copy them when it writes them next.
+      WorkerPool* pool = SerializationWorkerPool();
+      TaskGroup tasks(
+          pool, pool->num_workers(), std::numeric_limits<int>::max());
+      for (int i = 0; i < InputSize(); ++i) {
+        const Blob& input = *OperatorBase::Inputs()[i];
+        blobs->emplace_back(new Blob());
+        Blob* blob = blobs->back().get();
+        if (input.IsType<TensorCPU>()) {
+          const auto& tensor = input.Get<TensorCPU>();
+          auto delta = items.find(def().input(i));
+          CopyItems(
+              tensor,
+              delta == items.end()
+                  ? typename SaveOp<Context>::ItemRanges{std::make_pair(
+                        0, tensor.size())}
+                  : delta->second,
+              blob->GetMutable<TensorCPU>(),
+              &tasks);
+        } else if (input.IsType<Tensor<Context>>()) {
+          blob->GetMutable<Tensor<Context>>()->ShareDataCopyOnWrite(
+              input.Get<Tensor<Context>>());
+        } else {
+          // Other blobs are copied through their serialization.
+          CAFFE_ENFORCE(
+              blob->Deserialize(input.Serialize(def().input(i))),
+              "Cannot copy blob ",
+              def().input(i),
+              " for an asynchronous snapshot.");
+        }
+      }
+      tasks.Wait();
+    } catch (...) {
+      MarkAgain(taken);
+      throw;
+    }
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_ = true;
+    }
+    thread_ = std::thread([this, sub_op, blobs, iter, db_name, taken]() {
+      std::exception_ptr exception;
+      try {
+        vector<const Blob*> inputs;
+        for (const auto& blob : *blobs) {
+          inputs.push_back(blob.get());
+        }
+        CAFFE_ENFORCE(sub_op->Save(inputs), "Snapshot ", iter, " failed.");
+      } catch (...) {
+        exception = std::current_exception();
+      }
+      // The copies are released before the next snapshot is taken.
+      blobs->clear();
+      if (exception) {
+        MarkAgain(taken);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (exception) {
+        exception_ = exception;
+      } else {
+        completed_iter_ = iter;
+        last_db_name_ = db_name;
+      }
+      pending_ = false;
+      cv_.notify_all();
+    });
+  }
+
+  // Copies the given ranges of items of a tensor to a tensor of the same
+  // shape, one chunk per task. The other items are left uninitialized, as the
+  // snapshot does not save them.
+  static void CopyItems(
+      const TensorCPU& src,
+      const typename SaveOp<Context>::ItemRanges& ranges,
+      TensorCPU* dst,
+      TaskGroup* tasks) {
+    dst->Resize(src.dims());
+    if (src.size() == 0) {
+      dst->raw_mutable_data(src.meta());
+      return;
+    }
+    const TypeMeta& meta = src.meta();
+    const char* src_data = static_cast<const char*>(src.raw_data());
+    char* dst_data =
+        static_cast<char*>(dst->raw_mutable_data_uninitialized(meta));
+    for (const auto& range : ranges) {
+      for (TIndex begin = range.first; begin < range.second;
+           begin += FLAGS_caffe2_tensor_chunk_size) {
+        const TIndex size = std::min<TIndex>(
+            FLAGS_caffe2_tensor_chunk_size, range.second - begin);
+        tasks->Schedule([meta, src_data, dst_data, begin, size]() {
+          const size_t offset = begin * meta.itemsize();
+          if (meta.copy()) {
+            meta.copy()(src_data + offset, dst_data + offset, size);
+          } else {
+            memcpy(
+                dst_data + offset, src_data + offset, size * meta.itemsize());
+          }
+        });
+      }
+    }
+  }
+
   string db_pattern_;
   int every_;
+  int full_every_;
+  bool async_;
+  int snapshots_ = 0;
+  string last_db_name_;
   Workspace* ws_;
   OperatorDef save_op_def_;
+  // The state of the snapshot written in the background, if async_ is set.
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool pending_ = false;
+  int64_t completed_iter_ = -1;
+  std::exception_ptr exception_;
+  std::thread thread_;
 };
 
 }  // namespace caffe2
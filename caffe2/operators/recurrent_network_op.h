@@ -10,16 +10,38 @@ namespace caffe2 {
 
 namespace detail {
 
+// Blobs are never removed from a workspace, so the blobs below are only
+// looked up by name the first time they are used, and the pointers are kept
+// for the following runs and timesteps.
+inline Blob* getBlob(Blob** cached, const std::string& name, Workspace* ws) {
+  if (!*cached) {
+    *cached = CHECK_NOTNULL(ws->GetBlob(name));
+  }
+  return *cached;
+}
+
+inline Blob* createBlob(Blob** cached, const std::string& name, Workspace* ws) {
+  if (!*cached) {
+    *cached = CHECK_NOTNULL(ws->CreateBlob(name));
+  }
+  return *cached;
+}
+
 struct Param {
   std::string param;
   std::string grad;
   std::string accGrad;
+  Blob* paramBlob{nullptr};
+  Blob* gradBlob{nullptr};
+  Blob* accGradBlob{nullptr};
 };
 
 struct RecurrentInput {
   std::string state;
   std::string input;
   int32_t size;
+  Blob* stateBlob{nullptr};
+  Blob* inputBlob{nullptr};
 };
 
 struct RecurrentGradient {
@@ -27,36 +49,45 @@ struct RecurrentGradient {
   std::string grad;
   std::string externalGrad;
   int32_t offset;
+  Blob* paramBlob{nullptr};
+  Blob* gradBlob{nullptr};
+  Blob* externalGradBlob{nullptr};
 };
 
 struct OffsetAlias {
   std::string src;
   std::string dst;
   int32_t offset{0};
+  Blob* srcBlob{nullptr};
+  Blob* dstBlob{nullptr};
 };
 
 struct Scratch {
   std::string name;
   int32_t sizePerStep;
+  Blob* blob{nullptr};
 };
 
 struct Link {
   std::string internal;
   std::string external;
   int32_t offset{0};
+  Blob* internalBlob{nullptr};
+  Blob* externalBlob{nullptr};
 };
 
 template <typename T, typename Context>
-void applyOffsetAlias(const OffsetAlias& oc, Workspace* ws, Context* context) {
-  VLOG(1) << "Aliasing: " << oc.src << " to: " << oc.dst
-          << " at offset: " << oc.offset;
-  auto* src = CHECK_NOTNULL(ws->GetBlob(oc.src))
+void applyOffsetAlias(OffsetAlias* oc, Workspace* ws, Context* context) {
+  VLOG(1) << "Aliasing: " << oc->src << " to: " << oc->dst
+          << " at offset: " << oc->offset;
+  auto* src = getBlob(&oc->srcBlob, oc->src, ws)
+                  ->template GetMutable<Tensor<Context>>();
+  auto* dst = createBlob(&oc->dstBlob, oc->dst, ws)
                   ->template GetMutable<Tensor<Context>>();
-  auto* dst = ws->CreateBlob(oc.dst)->template GetMutable<Tensor<Context>>();
   auto timestep = src->size() / src->dim(0);
   auto dims = src->dims();
   const int32_t startDstTimestep =
-      oc.offset >= 0 ? oc.offset : src->dim(0) + oc.offset;
+      oc->offset >= 0 ? oc->offset : src->dim(0) + oc->offset;
   const int32_t numDstTimesteps = src->dim(0) - startDstTimestep;
   CAFFE_ENFORCE(
       numDstTimesteps >= 1, "Invalid number of timesteps: ", numDstTimesteps);
@@ -70,54 +101,55 @@ void applyOffsetAlias(const OffsetAlias& oc, Workspace* ws, Context* context) {
 
 template <typename T, typename Context>
 void initializeRecurrentInput(
-    const RecurrentInput& rc,
+    RecurrentInput* rc,
     int32_t seqLen,
     int32_t batchSize,
     Workspace* ws,
     Context* context) {
-  auto* state = CHECK_NOTNULL(ws->GetBlob(rc.state))
+  auto* state = getBlob(&rc->stateBlob, rc->state, ws)
                     ->template GetMutable<Tensor<Context>>();
-  const auto& input =
-      CHECK_NOTNULL(ws->GetBlob(rc.input))->template Get<Tensor<Context>>();
+  const auto& input = getBlob(&rc->inputBlob, rc->input, ws)
+                          ->template Get<Tensor<Context>>();
   CAFFE_ENFORCE(input.ndim() == 3, input.ndim());
   CAFFE_ENFORCE(input.dim(0) == 1, input.dim(0));
   CAFFE_ENFORCE(input.dim(1) == batchSize, input.dim(1), batchSize);
-  CAFFE_ENFORCE(input.dim(2), rc.size);
+  CAFFE_ENFORCE(input.dim(2), rc->size);
 
   // States at [0, ..., T] (inclusive)
-  state->Resize(seqLen + 1, batchSize, rc.size);
+  state->Resize(seqLen + 1, batchSize, rc->size);
   context->template Copy<T, Context, Context>(
-      batchSize * rc.size,
+      batchSize * rc->size,
       input.template data<T>(),
       state->template mutable_data<T>());
 }
 
 template <typename Context>
 void initializeScratch(
-    const Scratch& scratch,
+    Scratch* scratch,
     int32_t seqLength,
     int32_t batchSize,
     Workspace* ws) {
   CHECK_NOTNULL(ws);
-  VLOG(1) << "Initializing scratch: " << scratch.name;
-  ws->GetBlob(scratch.name)
+  VLOG(1) << "Initializing scratch: " << scratch->name;
+  getBlob(&scratch->blob, scratch->name, ws)
       ->template GetMutable<Tensor<Context>>()
-      ->Resize(std::vector<TIndex>{seqLength, batchSize, scratch.sizePerStep});
+      ->Resize(
+          std::vector<TIndex>{seqLength, batchSize, scratch->sizePerStep});
 }
 
 template <typename T, typename Context>
-void applyLink(const Link& link, size_t t, Workspace* ws) {
-  VLOG(1) << "Linking: " << link.internal << " to: " << link.external
-          << " at offset: " << link.offset;
-  auto* internalTensor = CHECK_NOTNULL(ws->CreateBlob(link.internal))
+void applyLink(Link* link, size_t t, Workspace* ws) {
+  VLOG(1) << "Linking: " << link->internal << " to: " << link->external
+          << " at offset: " << link->offset;
+  auto* internalTensor = createBlob(&link->internalBlob, link->internal, ws)
                              ->template GetMutable<Tensor<Context>>();
-  auto* externalTensor = CHECK_NOTNULL(ws->GetBlob(link.external))
+  auto* externalTensor = getBlob(&link->externalBlob, link->external, ws)
                              ->template GetMutable<Tensor<Context>>();
   CHECK_GT(externalTensor->size(), 0);
   const TIndex externalTimestepSize =
       externalTensor->size() / externalTensor->dim(0);
   auto* externalData = externalTensor->template mutable_data<T>() +
-      (t + link.offset) * externalTimestepSize;
+      (t + link->offset) * externalTimestepSize;
   auto internalDims = externalTensor->dims();
   // Single timestep
   internalDims[0] = 1;
@@ -174,7 +206,8 @@ class RecurrentNetworkOp final : public Operator<Context> {
     CAFFE_ENFORCE(
         stepNetDef.type() == "simple", "Step Net must be `simple`", stepNet);
 
-    ws_.CreateBlob(timestep_)->template GetMutable<TensorCPU>()->Resize(1);
+    timestepBlob_ = ws_.CreateBlob(timestep_);
+    timestepBlob_->template GetMutable<TensorCPU>()->Resize(1);
 
     for (const auto& blob : stepNetDef.external_input()) {
       ws_.CreateBlob(blob);
@@ -266,28 +299,27 @@ class RecurrentNetworkOp final : public Operator<Context> {
   bool RunOnDevice() {
     const auto seqLen = Input(0).dim32(0);
     const auto batchSize = Input(0).dim32(1);
-    for (const auto& ri : recurrentInputs_) {
+    for (auto& ri : recurrentInputs_) {
       detail::initializeRecurrentInput<T, Context>(
-          ri, seqLen, batchSize, &ws_, &context_);
+          &ri, seqLen, batchSize, &ws_, &context_);
     }
 
     for (auto& scratch : scratches_) {
-      detail::initializeScratch<Context>(scratch, seqLen, batchSize, &ws_);
+      detail::initializeScratch<Context>(&scratch, seqLen, batchSize, &ws_);
     }
 
     for (auto t = 0; t < seqLen; ++t) {
-      for (const auto& link : links_) {
-        detail::applyLink<T, Context>(link, t, &ws_);
+      for (auto& link : links_) {
+        detail::applyLink<T, Context>(&link, t, &ws_);
       }
       // Since we have a SimpleNet, there are no races here.
-      CHECK_NOTNULL(ws_.GetBlob(timestep_))
-          ->template GetMutable<TensorCPU>()
+      timestepBlob_->template GetMutable<TensorCPU>()
           ->template mutable_data<int32_t>()[0] = t;
       stepNet_->RunAsync();
     }
 
-    for (const auto& alias : aliases_) {
-      detail::applyOffsetAlias<T, Context>(alias, &ws_, &context_);
+    for (auto& alias : aliases_) {
+      detail::applyOffsetAlias<T, Context>(&alias, &ws_, &context_);
     }
 
     return true;
@@ -301,6 +333,7 @@ class RecurrentNetworkOp final : public Operator<Context> {
   std::vector<detail::OffsetAlias> aliases_;
   std::vector<detail::RecurrentInput> recurrentInputs_;
   std::string timestep_;
+  Blob* timestepBlob_{nullptr};
 };
 
 template <typename T, class Context>
@@ -337,7 +370,8 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
         OperatorBase::GetSingleArgument<string>("backward_step_net", "");
     NetDef stepNetDef;
     CHECK(google::protobuf::TextFormat::ParseFromString(stepNet, &stepNetDef));
-    ws_.CreateBlob(timestep_)->template GetMutable<TensorCPU>()->Resize(1);
+    timestepBlob_ = ws_.CreateBlob(timestep_);
+    timestepBlob_->template GetMutable<TensorCPU>()->Resize(1);
 
     for (const auto& blob : stepNetDef.external_input()) {
       ws_.CreateBlob(blob);
@@ -445,11 +479,11 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
     const auto seqLen = Input(0).dim32(0);
     const auto batchSize = Input(0).dim32(1);
     for (auto& param : params_) {
-      const auto& p = CHECK_NOTNULL(ws_.GetBlob(param.param))
+      const auto& p = detail::getBlob(&param.paramBlob, param.param, &ws_)
                           ->template Get<Tensor<Context>>();
-      auto* g = CHECK_NOTNULL(ws_.CreateBlob(param.grad))
+      auto* g = detail::createBlob(&param.gradBlob, param.grad, &ws_)
                     ->template GetMutable<Tensor<Context>>();
-      auto* ag = CHECK_NOTNULL(ws_.CreateBlob(param.accGrad))
+      auto* ag = detail::createBlob(&param.accGradBlob, param.accGrad, &ws_)
                      ->template GetMutable<Tensor<Context>>();
       g->ResizeLike(p);
       ag->ResizeLike(p);
@@ -458,9 +492,9 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
     }
 
     for (auto& rg : recurrentGradients_) {
-      const auto& p =
-          CHECK_NOTNULL(ws_.GetBlob(rg.param))->template Get<Tensor<Context>>();
-      auto* g = CHECK_NOTNULL(ws_.CreateBlob(rg.grad))
+      const auto& p = detail::getBlob(&rg.paramBlob, rg.param, &ws_)
+                          ->template Get<Tensor<Context>>();
+      auto* g = detail::createBlob(&rg.gradBlob, rg.grad, &ws_)
                     ->template GetMutable<Tensor<Context>>();
       g->ResizeLike(p);
       CHECK_EQ(g->ndim(), 3);
@@ -474,15 +508,13 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
     }
 
     for (auto& scratch : scratches_) {
-      detail::initializeScratch<Context>(scratch, seqLen, batchSize, &ws_);
+      detail::initializeScratch<Context>(&scratch, seqLen, batchSize, &ws_);
     }
 
     auto accumulateParameterGradients = [&]() {
       for (const auto& param : params_) {
-        const auto& g = CHECK_NOTNULL(ws_.GetBlob(param.grad))
-                            ->template Get<Tensor<Context>>();
-        auto* ag = CHECK_NOTNULL(ws_.GetBlob(param.accGrad))
-                       ->template GetMutable<Tensor<Context>>();
+        const auto& g = param.gradBlob->template Get<Tensor<Context>>();
+        auto* ag = param.accGradBlob->template GetMutable<Tensor<Context>>();
         CHECK(ag->dims() == g.dims());
         math::Add<T, Context>(
             g.size(),
@@ -495,17 +527,17 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
 
     auto accumulateInputGradients = [&](int t) {
       // Input gradients
-      for (const auto& rg : recurrentGradients_) {
+      for (auto& rg : recurrentGradients_) {
         if (rg.externalGrad.empty()) {
           continue;
         }
         VLOG(1) << "Accumulating into: " << rg.grad << " from "
                 << rg.externalGrad << " at time: " << t
                 << ", offset: " << rg.offset;
-        auto* g = CHECK_NOTNULL(ws_.GetBlob(rg.grad))
-                      ->template GetMutable<Tensor<Context>>();
-        const auto& og = CHECK_NOTNULL(ws_.GetBlob(rg.externalGrad))
-                             ->template Get<Tensor<Context>>();
+        auto* g = rg.gradBlob->template GetMutable<Tensor<Context>>();
+        const auto& og =
+            detail::getBlob(&rg.externalGradBlob, rg.externalGrad, &ws_)
+                ->template Get<Tensor<Context>>();
 
         // g[T+offset] += og[T]
         CHECK_EQ(g->size() / g->dim(0), og.size() / og.dim(0));
@@ -523,28 +555,25 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
     for (int32_t t = seqLen - 1; t >= 0; --t) {
       VLOG(1) << "Running step: " << t;
       accumulateInputGradients(t);
-      for (const auto& link : links_) {
-        detail::applyLink<T, Context>(link, t, &ws_);
+      for (auto& link : links_) {
+        detail::applyLink<T, Context>(&link, t, &ws_);
       }
       // Since we have a SimpleNet, there are no races here.
-      ws_.GetBlob(timestep_)
-          ->template GetMutable<TensorCPU>()
+      timestepBlob_->template GetMutable<TensorCPU>()
           ->template mutable_data<int32_t>()[0] = t;
       stepNet_->RunAsync();
       accumulateParameterGradients();
     }
 
-    for (const auto& alias : aliases_) {
-      detail::applyOffsetAlias<T, Context>(alias, &ws_, &context_);
+    for (auto& alias : aliases_) {
+      detail::applyOffsetAlias<T, Context>(&alias, &ws_, &context_);
     }
 
     for (const auto& param : params_) {
       // Swap the accumulated gradients with the actual gradients so
       // the rest of the network sees the accumulated gradients.
       using std::swap;
-      swap(
-          *(CHECK_NOTNULL(ws_.GetBlob(param.accGrad))),
-          *(CHECK_NOTNULL(ws_.GetBlob(param.grad))));
+      swap(*param.accGradBlob, *param.gradBlob);
     }
     return true;
   }
@@ -558,6 +587,7 @@ class RecurrentNetworkGradientOp final : public Operator<Context> {
   std::vector<detail::RecurrentGradient> recurrentGradients_;
   std::vector<detail::OffsetAlias> aliases_;
   std::vector<int32_t> recurrentSizes_;
+  Blob* timestepBlob_{nullptr};
   std::string timestep_;
 };
 }
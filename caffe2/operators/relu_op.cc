@@ -13,9 +13,15 @@ bool ReluOp<float, CPUContext>::RunOnDevice() {
 
 #ifdef CAFFE2_USE_ACCELERATE
   const float zero = 0.0f;
-  vDSP_vthres(X.data<float>(), 1, &zero, Y->mutable_data<float>(), 1, X.size());
+  vDSP_vthres(
+      X.data<float>(),
+      1,
+      &zero,
+      Y->mutable_data_uninitialized<float>(),
+      1,
+      X.size());
 #else
-  EigenVectorMap<float>(Y->mutable_data<float>(), X.size()) =
+  EigenVectorMap<float>(Y->mutable_data_uninitialized<float>(), X.size()) =
       ConstEigenVectorMap<float>(X.data<float>(), X.size()).cwiseMax(0.f);
 #endif
   /* Naive implementation
@@ -56,6 +62,7 @@ OPERATOR_SCHEMA(Relu)
   .NumInputs(1)
   .NumOutputs(1)
   .AllowInplace({{0, 0}})
+  .IdenticalTypeAndShape()
   .SetDoc(R"DOC(
 Relu takes one input data (Tensor<T>) and produces one output data
 (Tensor<T>) where the rectified linear function, y = max(0, x), is applied to
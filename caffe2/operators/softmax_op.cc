@@ -11,7 +11,7 @@ bool SoftmaxOp<float, CPUContext>::RunOnDevice() {
   int N = X.dim32(0);
   int D = X.dim32(1);
   Y->ResizeLike(X);
-  float* Ydata = Y->mutable_data<float>();
+  float* Ydata = Y->mutable_data_uninitialized<float>();
   // First, get scales
   if (scale_.size() != N) {
     scale_.Resize(N);
@@ -92,6 +92,7 @@ REGISTER_CPU_OPERATOR(SoftmaxGradient, SoftmaxGradientOp<float, CPUContext>);
 OPERATOR_SCHEMA(Softmax)
   .NumInputs(1)
   .NumOutputs(1)
+  .IdenticalTypeAndShape()
   .SetDoc(R"DOC(
 The operator computes the softmax normalized values for each layer in the batch
  of the given input. The input is a 2-D tensor (Tensor<float>) of size
@@ -149,6 +149,19 @@ OPERATOR_SCHEMA(SpatialBN)
     .NumInputs(5)
     .NumOutputs({1, 5})
     .EnforceInplace({{3, 1}, {4, 2}})
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorProto>& in) {
+      ArgumentHelper helper(def);
+      const StorageOrder order = StringToStorageOrder(
+          helper.GetSingleArgument<string>("order", "NCHW"));
+      CAFFE_ENFORCE(in[0].dims_size() == 4);
+      const int C = in[0].dims(order == StorageOrder::NCHW ? 1 : 3);
+      vector<TensorProto> out(
+          def.output_size(),
+          CreateTensorShape(vector<int>{C}, TensorProto::FLOAT));
+      out[0] = in[0];
+      return out;
+    })
     .SetDoc(R"DOC(
 Carries out spatial batch normalization as described in the paper
 https://arxiv.org/abs/1502.03167. Depending on the mode it is being run,
@@ -42,6 +42,7 @@ OPERATOR_SCHEMA(Tanh)
   .NumInputs(1)
   .NumOutputs(1)
   .AllowInplace({{0, 0}})
+  .IdenticalTypeAndShape()
   .SetDoc(R"DOC(
 Calculates the hyperbolic tangent of the given input tensor element-wise. This
 operation can be done in an in-place fashion too, by providing the same input
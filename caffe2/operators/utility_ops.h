@@ -191,12 +191,8 @@ class FlattenOp : public Operator<Context> {
     auto& input = Input(0);
     auto* output = Output(0);
     DCHECK_GT(input.size(), 0);
-    output->Resize(input.dim(0), input.size() / input.dim(0));
-    context_.template CopyItems<Context, Context>(
-        input.meta(),
-        input.size(),
-        input.raw_data(),
-        output->raw_mutable_data(input.meta()));
+    output->ShareDataCopyOnWrite(input);
+    output->Reshape(vector<TIndex>{input.dim(0), input.size() / input.dim(0)});
     return true;
   }
 };
@@ -515,13 +511,30 @@ class CopyOp : public Operator<Context> {
   bool RunOnDevice() override {
     auto& input = OperatorBase::Input<Tensor<SrcContext>>(0);
     auto* output = OperatorBase::Output<Tensor<DstContext>>(0);
+    CopyTensor(input, output, std::is_same<SrcContext, DstContext>());
+    return true;
+  }
+
+ private:
+  // Tensors on the same device share the storage until one of them is
+  // written.
+  void CopyTensor(
+      const Tensor<SrcContext>& input,
+      Tensor<DstContext>* output,
+      std::true_type /*same_context*/) {
+    output->ShareDataCopyOnWrite(input);
+  }
+
+  void CopyTensor(
+      const Tensor<SrcContext>& input,
+      Tensor<DstContext>* output,
+      std::false_type /*same_context*/) {
     output->ResizeLike(input);
     this->context_.template CopyItems<SrcContext, DstContext>(
         input.meta(),
         input.size(),
         input.raw_data(),
         output->raw_mutable_data(input.meta()));
-    return true;
   }
 };
 
@@ -688,52 +701,22 @@ class SliceOp : public Operator<Context> {
       }
     }
     if (dim == -1) {
-      output->CopyFrom(data, &context_);
-      return true;
-    }
-    auto unit = std::accumulate(
-        data.dims().begin() + dim + 1,
-        data.dims().end(),
-        1,
-        std::multiplies<SIndex>());
-    auto num_blocks = std::accumulate(
-        data.dims().begin(),
-        data.dims().begin() + dim,
-        1,
-        std::multiplies<SIndex>());
-    output->Resize(dst_sizes);
-    auto* src_bytes = (char*)data.raw_data();
-    auto* dst_bytes = (char*)output->raw_mutable_data(data.meta());
-
-    auto src_nbytes = data.nbytes();
-    auto dst_nbytes = output->nbytes();
-
-    auto src_block_size = unit * data.dims()[dim];
-    auto dst_block_size = unit * (ends_idx[dim] - starts_idx[dim]);
-    auto src_offset = unit * starts_idx[dim];
-
-    if (num_blocks == 0 || dst_block_size == 0) {
+      output->ShareDataCopyOnWrite(data);
       return true;
     }
-
-    auto itemsize = data.meta().itemsize();
-    auto src_block_size_bytes = itemsize * src_block_size;
-    auto dst_block_size_bytes = itemsize * dst_block_size;
-    auto src_offset_bytes = src_bytes + itemsize * src_offset;
-    auto dst_offset_bytes = dst_bytes;
-    for (int i = 0; i < num_blocks; ++i) {
-      DCHECK_LE(
-          src_offset_bytes + dst_block_size_bytes, src_bytes + src_nbytes);
-      DCHECK_LE(
-          dst_offset_bytes + dst_block_size_bytes, dst_bytes + dst_nbytes);
-      this->context_.template CopyItems<Context, Context>(
-          data.meta(),
-          dst_block_size,
-          (void*)src_offset_bytes,
-          (void*)dst_offset_bytes);
-      src_offset_bytes += src_block_size_bytes;
-      dst_offset_bytes += dst_block_size_bytes;
+    // The output is a view of the input, which is only copied if the slice
+    // is not contiguous and gets read.
+    vector<TIndex> strides(data.ndim());
+    TIndex stride = 1;
+    for (int i = data.ndim() - 1; i >= 0; --i) {
+      strides[i] = stride;
+      stride *= data.dims()[i];
     }
+    output->ShareDataStrided(
+        data,
+        vector<TIndex>(dst_sizes.begin(), dst_sizes.end()),
+        strides,
+        starts_idx[dim] * strides[dim]);
     return true;
   }
 
@@ -865,11 +848,8 @@ class ReshapeOp : public Operator<Context> {
     }
 
     auto* output = Output(0);
-    output->Resize(new_shape_);
-    context_.template CopyBytes<Context, Context>(
-        input.nbytes(),
-        input.raw_data(),
-        output->raw_mutable_data(input.meta()));
+    output->ShareDataCopyOnWrite(input);
+    output->Reshape(new_shape_);
 
     return true;
   }
@@ -935,7 +915,7 @@ class SqueezeOp : public Operator<Context> {
   bool RunOnDevice() override {
     auto& input = Input(0);
     auto* output = Output(0);
-    output->CopyFrom(input, &context_);
+    output->ShareDataCopyOnWrite(input);
 
     CAFFE_ENFORCE(
         input.dims().back() + 1 >= dims_.size(),
@@ -987,7 +967,7 @@ class ExpandDimsOp : public Operator<Context> {
   bool RunOnDevice() override {
     auto& input = Input(0);
     auto* output = Output(0);
-    output->CopyFrom(input, &context_);
+    output->ShareDataCopyOnWrite(input);
     if (dims_.empty()) {
       return true;
     }
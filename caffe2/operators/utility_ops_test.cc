@@ -1,3 +1,4 @@
+#include <cmath>
 #include <iostream>
 
 #include "caffe2/core/flags.h"
@@ -51,4 +52,184 @@ TEST(UtilityOpTest, testEnsureCPUOutput) {
   }
 }
 
+TEST(UtilityOpTest, testCopyIsCopyOnWrite) {
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("Copy");
+  def.add_input("X");
+  def.add_output("Y");
+  AddConstInput(vector<TIndex>{5, 10}, 3.14, "X", &ws);
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  EXPECT_NE(nullptr, op.get());
+  EXPECT_TRUE(op->Run());
+  auto* X = ws.GetBlob("X")->GetMutable<TensorCPU>();
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  EXPECT_EQ(Y.dims(), X->dims());
+  EXPECT_EQ(Y.data<float>(), X->data<float>());
+  // Writing the input does not change the copy.
+  X->mutable_data<float>()[0] = 0;
+  EXPECT_NE(Y.data<float>(), X->data<float>());
+  EXPECT_EQ(Y.data<float>()[0], 3.14f);
+}
+
+TEST(UtilityOpTest, testAliasThenCopy) {
+  Workspace ws;
+  AddConstInput(vector<TIndex>{5, 10}, 3.14, "X", &ws);
+  OperatorDef alias_def;
+  alias_def.set_type("Alias");
+  alias_def.add_input("X");
+  alias_def.add_output("A");
+  OperatorDef copy_def;
+  copy_def.set_type("Copy");
+  copy_def.add_input("X");
+  copy_def.add_output("Y");
+  EXPECT_TRUE(ws.RunOperatorOnce(alias_def));
+  EXPECT_TRUE(ws.RunOperatorOnce(copy_def));
+  // Writes through the alias reach the aliased blob, but not the copy.
+  auto* A = ws.GetBlob("A")->GetMutable<TensorCPU>();
+  A->mutable_data<float>()[0] = 0;
+  const auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  EXPECT_EQ(A->data<float>(), X.data<float>());
+  EXPECT_EQ(X.data<float>()[0], 0);
+  EXPECT_EQ(Y.data<float>()[0], 3.14f);
+}
+
+TEST(UtilityOpTest, testAliasOfCopyOnWriteParentInArena) {
+  Workspace parent;
+  AddConstInput(vector<TIndex>{5, 10}, 3.14, "X", &parent);
+  OperatorDef copy_def;
+  copy_def.set_type("Copy");
+  copy_def.add_input("X");
+  copy_def.add_output("Y");
+  EXPECT_TRUE(parent.RunOperatorOnce(copy_def));
+  const auto& X = parent.GetBlob("X")->Get<TensorCPU>();
+  auto* Y = parent.GetBlob("Y")->GetMutable<TensorCPU>();
+  const float* X_data = X.data<float>();
+  {
+    Workspace child(&parent);
+    child.EnableArena();
+    OperatorDef alias_def;
+    alias_def.set_type("Alias");
+    alias_def.add_input("X");
+    alias_def.add_output("A");
+    EXPECT_TRUE(child.RunOperatorOnce(alias_def));
+    // The alias shares the storage of the parent blob, which the copy only
+    // copies when it writes it.
+    auto* A = child.GetBlob("A")->GetMutable<TensorCPU>();
+    EXPECT_EQ(A->data<float>(), X_data);
+    Y->mutable_data<float>()[1] = 0;
+    EXPECT_NE(Y->data<float>(), X_data);
+    // Writes through the alias reach the parent blob, but not the copy.
+    A->mutable_data<float>()[0] = 0;
+    EXPECT_EQ(A->data<float>(), X_data);
+    EXPECT_EQ(X.data<float>()[0], 0);
+    EXPECT_EQ(Y->data<float>()[0], 3.14f);
+    EXPECT_EQ(child.GetArena()->allocated_bytes(), 0u);
+  }
+  EXPECT_EQ(X.data<float>(), X_data);
+  EXPECT_EQ(X.data<float>()[0], 0);
+  EXPECT_EQ(X.data<float>()[49], 3.14f);
+}
+
+TEST(UtilityOpTest, testInPlaceOpOnCopy) {
+  for (const string type : {"Sigmoid", "Relu", "Exp"}) {
+    Workspace ws;
+    auto* X = ws.CreateBlob("X")->GetMutable<TensorCPU>();
+    X->Resize(4);
+    for (int i = 0; i < X->size(); ++i) {
+      X->mutable_data<float>()[i] = 10 + i;
+    }
+    OperatorDef copy_def;
+    copy_def.set_type("Copy");
+    copy_def.add_input("X");
+    copy_def.add_output("Y");
+    OperatorDef def;
+    def.set_type(type);
+    def.add_input("Y");
+    def.add_output("Y");
+    unique_ptr<OperatorBase> copy_op(CreateOperator(copy_def, &ws));
+    unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+    EXPECT_TRUE(copy_op->Run());
+    EXPECT_TRUE(op->Run());
+    // The op reads the copied values, and leaves its input alone.
+    const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+    for (int i = 0; i < Y.size(); ++i) {
+      const float x = 10 + i;
+      const float expected = type == "Sigmoid"
+          ? 1.f / (1.f + std::exp(-x))
+          : type == "Exp" ? std::exp(x) : x;
+      EXPECT_NEAR(Y.data<float>()[i], expected, 1e-5 * expected) << type;
+      EXPECT_EQ(X->data<float>()[i], x);
+    }
+  }
+}
+
+TEST(UtilityOpTest, testReshapeSharesStorage) {
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("Reshape");
+  def.add_input("X");
+  def.add_output("Y");
+  def.add_output("old_shape");
+  auto* shape = def.add_arg();
+  shape->set_name("shape");
+  shape->add_ints(-1);
+  AddConstInput(vector<TIndex>{5, 10}, 3.14, "X", &ws);
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  EXPECT_NE(nullptr, op.get());
+  EXPECT_TRUE(op->Run());
+  const auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+  auto* Y = ws.GetBlob("Y")->GetMutable<TensorCPU>();
+  EXPECT_EQ(Y->dims(), vector<TIndex>{50});
+  EXPECT_EQ(X.dims(), (vector<TIndex>{5, 10}));
+  EXPECT_EQ(Y->data<float>(), X.data<float>());
+  Y->mutable_data<float>()[0] = 0;
+  EXPECT_EQ(X.data<float>()[0], 3.14f);
+}
+
+TEST(UtilityOpTest, testSliceIsView) {
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("Slice");
+  def.add_input("X");
+  def.add_input("starts");
+  def.add_input("ends");
+  def.add_output("Y");
+  auto* X = ws.CreateBlob("X")->GetMutable<TensorCPU>();
+  X->Resize(4, 3);
+  float* X_data = X->mutable_data<float>();
+  for (int i = 0; i < X->size(); ++i) {
+    X_data[i] = i;
+  }
+  auto* starts = ws.CreateBlob("starts")->GetMutable<TensorCPU>();
+  auto* ends = ws.CreateBlob("ends")->GetMutable<TensorCPU>();
+  starts->Resize(2);
+  ends->Resize(2);
+  // Rows 1 and 2 are contiguous in X.
+  starts->mutable_data<int>()[0] = 1;
+  starts->mutable_data<int>()[1] = 0;
+  ends->mutable_data<int>()[0] = 3;
+  ends->mutable_data<int>()[1] = -1;
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  EXPECT_NE(nullptr, op.get());
+  EXPECT_TRUE(op->Run());
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  EXPECT_EQ(Y.dims(), (vector<TIndex>{2, 3}));
+  EXPECT_TRUE(Y.IsContiguous());
+  EXPECT_EQ(Y.data<float>(), X_data + 3);
+
+  // Column 1 is not, and is copied once it is read.
+  starts->mutable_data<int>()[0] = 0;
+  starts->mutable_data<int>()[1] = 1;
+  ends->mutable_data<int>()[0] = -1;
+  ends->mutable_data<int>()[1] = 2;
+  EXPECT_TRUE(op->Run());
+  EXPECT_EQ(Y.dims(), (vector<TIndex>{4, 1}));
+  EXPECT_FALSE(Y.IsContiguous());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(Y.data<float>()[i], 3 * i + 1);
+  }
+}
+
 } // namespace caffe2
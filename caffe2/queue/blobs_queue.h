@@ -36,7 +36,7 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
             queueName + "_" + to_string(i) + "_" + to_string(j);
         if (enforceUniqueName) {
           CAFFE_ENFORCE(
-              !ws->GetBlob(blobName),
+              !ws->HasBlob(blobName),
               "Queue internal blob already exists: ",
               blobName);
         }
@@ -12,35 +12,55 @@ class CreateBlobsQueueOp final : public Operator<Context> {
   USE_OPERATOR_CONTEXT_FUNCTIONS;
 
   CreateBlobsQueueOp(const OperatorDef& operator_def, Workspace* ws)
-      : Operator<Context>(operator_def, ws), ws_(ws) {}
+      : Operator<Context>(operator_def, ws),
+        ws_(ws),
+        capacity_(OperatorBase::template GetSingleArgument<int>("capacity", 1)),
+        numBlobs_(
+            OperatorBase::template GetSingleArgument<int>("num_blobs", 1)),
+        enforceUniqueName_(OperatorBase::template GetSingleArgument<int>(
+            "enforce_unique_name",
+            false)) {
+    CHECK_EQ(def().output().size(), 1);
+  }
 
   bool RunOnDevice() override {
-    const auto capacity =
-        OperatorBase::template GetSingleArgument<int>("capacity", 1);
-    const auto numBlobs =
-        OperatorBase::template GetSingleArgument<int>("num_blobs", 1);
-    const auto enforceUniqueName =
-        OperatorBase::template GetSingleArgument<int>(
-            "enforce_unique_name", false);
-    CHECK_EQ(def().output().size(), 1);
-    const auto name = def().output().Get(0);
+    const auto& name = def().output().Get(0);
     auto queuePtr = Operator<Context>::Outputs()[0]
                         ->template GetMutable<std::shared_ptr<BlobsQueue>>();
     CHECK(queuePtr);
     *queuePtr = std::make_shared<BlobsQueue>(
-        ws_, name, capacity, numBlobs, enforceUniqueName);
+        ws_, name, capacity_, numBlobs_, enforceUniqueName_);
     return true;
   }
 
  private:
   Workspace* ws_{nullptr};
+  const int capacity_;
+  const int numBlobs_;
+  const bool enforceUniqueName_;
 };
 
+// The operators that block until the queue has room or data. They run on
+// the I/O worker pool instead of blocking a worker of the net.
 template <typename Context>
-class EnqueueBlobsOp final : public Operator<Context> {
+class BlockingQueueOp : public Operator<Context> {
  public:
-  USE_OPERATOR_CONTEXT_FUNCTIONS;
   using Operator<Context>::Operator;
+
+  bool HasAsyncCompletion() const override {
+    return true;
+  }
+  void RunWithCompletion(OperatorBase::CompletionCallback done) override {
+    RunOnIOWorkerPool(this, std::move(done));
+  }
+};
+
+template <typename Context>
+class EnqueueBlobsOp final : public BlockingQueueOp<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  using BlockingQueueOp<Context>::BlockingQueueOp;
+
   bool RunOnDevice() override {
     CAFFE_ENFORCE(InputSize() > 1);
     auto queue = Operator<Context>::Inputs()[0]
@@ -53,10 +73,11 @@ class EnqueueBlobsOp final : public Operator<Context> {
 };
 
 template <typename Context>
-class DequeueBlobsOp final : public Operator<Context> {
+class DequeueBlobsOp final : public BlockingQueueOp<Context> {
  public:
   USE_OPERATOR_CONTEXT_FUNCTIONS;
-  using Operator<Context>::Operator;
+  using BlockingQueueOp<Context>::BlockingQueueOp;
+
   bool RunOnDevice() override {
     CAFFE_ENFORCE(InputSize() == 1);
     auto queue =
@@ -87,10 +108,11 @@ class CloseBlobsQueueOp final : public Operator<Context> {
 };
 
 template <typename Context>
-class SafeEnqueueBlobsOp final : public Operator<Context> {
+class SafeEnqueueBlobsOp final : public BlockingQueueOp<Context> {
  public:
   USE_OPERATOR_CONTEXT_FUNCTIONS;
-  using Operator<Context>::Operator;
+  using BlockingQueueOp<Context>::BlockingQueueOp;
+
   bool RunOnDevice() override {
     auto queue = Operator<Context>::Inputs()[0]
                      ->template Get<std::shared_ptr<BlobsQueue>>();
@@ -108,10 +130,11 @@ class SafeEnqueueBlobsOp final : public Operator<Context> {
 };
 
 template <typename Context>
-class SafeDequeueBlobsOp final : public Operator<Context> {
+class SafeDequeueBlobsOp final : public BlockingQueueOp<Context> {
  public:
   USE_OPERATOR_CONTEXT_FUNCTIONS;
-  using Operator<Context>::Operator;
+  using BlockingQueueOp<Context>::BlockingQueueOp;
+
   bool RunOnDevice() override {
     CAFFE_ENFORCE(InputSize() == 1);
     auto queue = Operator<Context>::Inputs()[0]
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "caffe2/core/operator.h"
+#include "caffe2/sgd/dirty_rows.h"
 
 namespace caffe2 {
 
@@ -78,7 +79,8 @@ class SparseAdagradOp final : public Operator<Context> {
   USE_OPERATOR_CONTEXT_FUNCTIONS;
   SparseAdagradOp(const OperatorDef& operator_def, Workspace* ws)
       : Operator<Context>(operator_def, ws),
-        epsilon_(OperatorBase::GetSingleArgument<float>("epsilon", 1e-5)) {}
+        epsilon_(OperatorBase::GetSingleArgument<float>("epsilon", 1e-5)),
+        dirty_rows_(MaybeTrackDirtyRows(this, ws)) {}
 
   bool RunOnDevice() override {
     return DispatchHelper<TensorTypes<int32_t, int64_t>>::call(
@@ -121,11 +123,15 @@ class SparseAdagradOp final : public Operator<Context> {
             &context_);
       }
     }
+    for (auto* dirty_rows : dirty_rows_) {
+      dirty_rows->Mark(indices, n, Input(PARAM).dim(0));
+    }
     return true;
   }
 
  protected:
   T epsilon_;
+  vector<DirtyRows*> dirty_rows_;
   INPUT_TAGS(PARAM, MOMENT_1, INDICES, GRAD, LR);
   OUTPUT_TAGS(OUTPUT_PARAM, OUTPUT_MOMENT_1);
 };
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "caffe2/core/dirty_rows.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// The doc of the track_dirty_rows argument of the sparse optimizers.
+constexpr char kTrackDirtyRowsDoc[] =
+    "(int, default 0) if set, the updated rows of the outputs are recorded "
+    "for the delta snapshots of the Snapshot operator.";
+
+// Returns the DirtyRows of the outputs of a sparse optimizer, which mark the
+// rows it updated since the last snapshot, if it has the track_dirty_rows
+// argument, and none otherwise.
+inline vector<DirtyRows*> MaybeTrackDirtyRows(OperatorBase* op, Workspace* ws) {
+  vector<DirtyRows*> dirty_rows;
+  if (op->GetSingleArgument<int>("track_dirty_rows", 0)) {
+    for (const string& output : op->def().output()) {
+      dirty_rows.push_back(
+          ws->CreateBlob(DirtyRowsBlobName(output))->GetMutable<DirtyRows>());
+    }
+  }
+  return dirty_rows;
+}
+
+}  // namespace caffe2
@@ -124,6 +124,9 @@ void SparseFtrlOp<T>::DoRun() {
           &context_);
     }
   }
+  for (auto* dirty_rows : dirty_rows_) {
+    dirty_rows->Mark(idxs, K, N);
+  }
 }
 
 namespace {
@@ -135,7 +138,8 @@ REGISTER_CPU_OPERATOR(SparseFtrl, SparseFtrlOp<float>);
 OPERATOR_SCHEMA(SparseFtrl)
     .NumInputs(4)
     .NumOutputs(2)
-    .EnforceInplace({{0, 0}, {1, 1}});
+    .EnforceInplace({{0, 0}, {1, 1}})
+    .Arg("track_dirty_rows", kTrackDirtyRowsDoc);
 SHOULD_NOT_DO_GRADIENT(SparseFtrl);
 }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "caffe2/core/operator.h"
+#include "caffe2/sgd/dirty_rows.h"
 
 namespace caffe2 {
 
@@ -36,7 +37,9 @@ template <typename T>
 class SparseFtrlOp final : public Operator<CPUContext> {
  public:
   SparseFtrlOp(const OperatorDef& operator_def, Workspace* ws)
-      : Operator<CPUContext>(operator_def, ws), params_(this) {}
+      : Operator<CPUContext>(operator_def, ws),
+        params_(this),
+        dirty_rows_(MaybeTrackDirtyRows(this, ws)) {}
 
   bool RunOnDevice() override {
     // Use run-time polymorphism
@@ -54,6 +57,7 @@ class SparseFtrlOp final : public Operator<CPUContext> {
 
  protected:
   FtrlParams<T> params_;
+  vector<DirtyRows*> dirty_rows_;
   INPUT_TAGS(VAR, N_Z, INDICES, GRAD);
   OUTPUT_TAGS(OUTPUT_VAR, OUTPUT_N_Z);
 
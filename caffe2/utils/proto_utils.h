@@ -161,10 +161,12 @@ inline bool HasArgument(const OperatorDef& def, const string& name) {
  * that are present in the operator. To save memory, the argument helper
  * does not copy the operator def, so one would need to make sure that the
  * lifetime of the OperatorDef object outlives that of the ArgumentHelper.
+ * The same holds for the net-level arguments of a NetDef.
  */
 class ArgumentHelper {
  public:
   explicit ArgumentHelper(const OperatorDef& def);
+  explicit ArgumentHelper(const NetDef& netdef);
   bool HasArgument(const string& name) const;
 
   template <typename T>
@@ -2,8 +2,10 @@
 #define CAFFE2_UTILS_SIMPLE_QUEUE_H_
 
 #include <condition_variable>  // NOLINT
+#include <cstdint>
 #include <mutex>  // NOLINT
 #include <queue>
+#include <vector>
 
 #include "caffe2/core/logging.h"
 
@@ -70,6 +72,65 @@ class SimpleQueue {
   SimpleQueue(const SimpleQueue& src) {}
 };
 
+// SimplePriorityQueue has the same semantics as SimpleQueue, except that every
+// value is pushed with a priority, and Pop() returns the value with the
+// highest priority. Values with the same priority are popped in the order they
+// were pushed, so if all priorities are equal this behaves like SimpleQueue.
+template <typename T>
+class SimplePriorityQueue {
+ public:
+  SimplePriorityQueue() : no_more_jobs_(false), sequence_(0) {}
+
+  bool Pop(T* value) {
+    std::unique_lock<std::mutex> mutex_lock(mutex_);
+    while (queue_.size() == 0 && !no_more_jobs_) cv_.wait(mutex_lock);
+    if (queue_.size() == 0 && no_more_jobs_) return false;
+    *value = queue_.top().value;
+    queue_.pop();
+    return true;
+  }
+
+  void Push(const T& value, float priority) {
+    {
+      std::lock_guard<std::mutex> mutex_lock(mutex_);
+      CHECK(!no_more_jobs_)
+          << "Cannot push to a closed queue.";
+      queue_.push(Entry{priority, sequence_++, value});
+    }
+    cv_.notify_one();
+  }
+
+  void NoMoreJobs() {
+    {
+      std::lock_guard<std::mutex> mutex_lock(mutex_);
+      no_more_jobs_ = true;
+    }
+    cv_.notify_all();
+  }
+
+ private:
+  struct Entry {
+    float priority;
+    uint64_t sequence;
+    T value;
+    // std::priority_queue pops the largest entry first.
+    bool operator<(const Entry& other) const {
+      if (priority != other.priority) {
+        return priority < other.priority;
+      }
+      return sequence > other.sequence;
+    }
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::priority_queue<Entry, std::vector<Entry>> queue_;
+  bool no_more_jobs_;
+  uint64_t sequence_;
+  // We do not allow copy constructors.
+  SimplePriorityQueue(const SimplePriorityQueue& src) {}
+};
+
 }  // namespace caffe2
 
 #endif  // CAFFE2_UTILS_SIMPLE_QUEUE_H_
@@ -67,6 +67,21 @@ TEST(SimpleQueueDeathTest, CannotAddAfterQueueFinished) {
                "Check failed: !no_more_jobs_ Cannot push to a closed queue.");
 }
 
+TEST(SimplePriorityQueueTest, PopsByPriorityThenFIFO) {
+  SimplePriorityQueue<int> queue;
+  queue.Push(0, 1.f);
+  queue.Push(1, 2.f);
+  queue.Push(2, 1.f);
+  queue.Push(3, 3.f);
+  queue.Push(4, 2.f);
+  queue.NoMoreJobs();
+  int value;
+  for (int expected : {3, 1, 4, 0, 2}) {
+    EXPECT_TRUE(queue.Pop(&value));
+    EXPECT_EQ(value, expected);
+  }
+  EXPECT_FALSE(queue.Pop(&value));
+}
 
 }  // namespace caffe2
 
@@ -0,0 +1,111 @@
+#ifndef CAFFE2_UTILS_WORK_STEALING_DEQUE_H_
+#define CAFFE2_UTILS_WORK_STEALING_DEQUE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "caffe2/core/common.h"
+
+namespace caffe2 {
+
+// A bounded, lock-free work stealing deque (Chase and Lev, "Dynamic Circular
+// Work-Stealing Deque", SPAA 2005), without the dynamic resizing part.
+//
+// The deque has a single owner thread that calls Push() and Pop() at the
+// bottom end, and any number of thief threads that call Steal() at the top
+// end. The owner thus gets LIFO order, which keeps the data of recently
+// finished jobs warm in its cache, while the thieves take the oldest jobs.
+//
+// The capacity is fixed at construction time. This fits the DAG executors
+// well: every operator is pushed at most once per run, so a capacity equal to
+// the number of operators in the net is always enough.
+template <typename T>
+class WorkStealingDeque {
+ public:
+  explicit WorkStealingDeque(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1), buffer_(mask_ + 1) {}
+
+  // Pushes a value to the bottom of the deque. Only the owner thread may call
+  // this. Returns false if the deque is full.
+  bool Push(const T& value) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t > static_cast<int64_t>(mask_)) {
+      return false;
+    }
+    buffer_[b & mask_].store(value, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Pops a value from the bottom of the deque. Only the owner thread may call
+  // this. Returns false if the deque is empty, or if the last value was
+  // stolen by a thief in the meantime.
+  bool Pop(T* value) {
+    const int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      // Empty deque.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    *value = buffer_[b & mask_].load(std::memory_order_relaxed);
+    if (t < b) {
+      // There are still other values left, so no thief can compete with us.
+      return true;
+    }
+    // This is the last value: race against the thieves for it.
+    const bool won = top_.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return won;
+  }
+
+  // Steals a value from the top of the deque. Any thread may call this.
+  // Returns false if the deque is empty or if another thread won the race for
+  // the top value.
+  bool Steal(T* value) {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return false;
+    }
+    *value = buffer_[t & mask_].load(std::memory_order_relaxed);
+    return top_.compare_exchange_strong(
+        t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  // Returns an approximation of the number of values in the deque.
+  size_t SizeApprox() const {
+    const int64_t b = bottom_.load(std::memory_order_relaxed);
+    const int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  static size_t RoundUpToPowerOfTwo(size_t n) {
+    size_t result = 1;
+    while (result < n) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t mask_;
+  std::vector<std::atomic<T>> buffer_;
+  std::atomic<int64_t> top_{0};
+  std::atomic<int64_t> bottom_{0};
+
+  DISABLE_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+}  // namespace caffe2
+
+#endif  // CAFFE2_UTILS_WORK_STEALING_DEQUE_H_
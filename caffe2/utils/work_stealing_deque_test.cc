@@ -0,0 +1,83 @@
+#include <atomic>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "caffe2/utils/work_stealing_deque.h"
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+TEST(WorkStealingDequeTest, OwnerIsLIFO) {
+  WorkStealingDeque<int> deque(4);
+  EXPECT_EQ(deque.capacity(), 4);
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(deque.Push(i));
+  }
+  EXPECT_FALSE(deque.Push(4));
+  int value;
+  for (int i = 3; i >= 0; --i) {
+    EXPECT_TRUE(deque.Pop(&value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_FALSE(deque.Pop(&value));
+}
+
+TEST(WorkStealingDequeTest, ThiefIsFIFO) {
+  WorkStealingDeque<int> deque(3);
+  // Capacity is rounded up to the next power of two.
+  EXPECT_EQ(deque.capacity(), 4);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(deque.Push(i));
+  }
+  int value;
+  EXPECT_TRUE(deque.Steal(&value));
+  EXPECT_EQ(value, 0);
+  EXPECT_TRUE(deque.Pop(&value));
+  EXPECT_EQ(value, 2);
+  EXPECT_TRUE(deque.Steal(&value));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(deque.Steal(&value));
+  EXPECT_FALSE(deque.Pop(&value));
+}
+
+TEST(WorkStealingDequeTest, ConcurrentStealing) {
+  const int kNumValues = 100000;
+  const int kNumThieves = 3;
+  WorkStealingDeque<int> deque(kNumValues);
+  std::vector<std::atomic<int>> seen(kNumValues);
+  for (auto& s : seen) {
+    s = 0;
+  }
+  std::atomic<bool> done{false};
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < kNumThieves; ++i) {
+    thieves.emplace_back([&]() {
+      int value;
+      while (!done || deque.SizeApprox() > 0) {
+        if (deque.Steal(&value)) {
+          ++seen[value];
+        }
+      }
+    });
+  }
+  int value;
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_TRUE(deque.Push(i));
+    if (i % 3 == 0 && deque.Pop(&value)) {
+      ++seen[value];
+    }
+  }
+  while (deque.Pop(&value)) {
+    ++seen[value];
+  }
+  done = true;
+  for (auto& thief : thieves) {
+    thief.join();
+  }
+  // Every value has been taken exactly once.
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_EQ(seen[i], 1) << "Value " << i;
+  }
+}
+
+}  // namespace caffe2